@@ -34,12 +34,19 @@
 #define PC_IF		SerialUSB
 
 
+//-----------------------------------------------------------------------------
+// section includes
+//-----------------------------------------------------------------------------
+
+#include <utils/UartBridge.h>
+
+
 //-----------------------------------------------------------------------------
 // section RAM
 //-----------------------------------------------------------------------------
 
-char buff[500];
-int len;
+// ring buffer per direction, non blocking writes
+WiMODUartBridge bridge(PC_IF, WIMOD_IF);
 
 
 //-----------------------------------------------------------------------------
@@ -56,19 +63,8 @@ void setup() {
 void loop() {
 
   // put your main code here, to run repeatedly:
-  len = PC_IF.available();
-  if (len > 0) {
-      PC_IF.readBytes(buff, len);
-      WIMOD_IF.write(buff, len);
-  }
-
-  len = WIMOD_IF.available();
-  if (len > 0) {
-      WIMOD_IF.readBytes(buff, len);
-      PC_IF.write(buff, len);
-  }
-
-  // keep this delay command under all contitions.
-  delay(10);
+  bridge.Process();
 
+  // do not use a delay() function here.
+  // the driver rx buffers are small and overflow during a delay
 }
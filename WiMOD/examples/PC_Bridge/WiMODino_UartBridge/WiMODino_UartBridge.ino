@@ -30,12 +30,19 @@
 #define WIMOD_IF    SerialWiMOD
 #define PC_IF     	SerialUSB
 
+//-----------------------------------------------------------------------------
+// section includes
+//-----------------------------------------------------------------------------
+
+#include <utils/UartBridge.h>
+
+
 //-----------------------------------------------------------------------------
 // section RAM
 //-----------------------------------------------------------------------------
 
-char buff[500];
-int len;
+// ring buffer per direction, non blocking writes
+WiMODUartBridge bridge(PC_IF, WIMOD_IF);
 
 //-----------------------------------------------------------------------------
 // section code
@@ -51,19 +58,8 @@ void setup() {
 void loop() {
 
 	// put your main code here, to run repeatedly:
-	len = WIMOD_IF.available();
-	if (len > 0) {
-		WIMOD_IF.readBytes(buff, len);
-		PC_IF.write(buff, len);
-	}
-
-	len = PC_IF.available();
-	if (len > 0) {
-		PC_IF.readBytes(buff, len);
-		WIMOD_IF.write(buff, len);
-	}
+	bridge.Process();
 
 	// do not use a delay() function here.
-	// the arduino plaform uses a 64 byte low level buffer that is likely to
-	// overflow, if a delay is used here
+	// the driver rx buffers are small and overflow during a delay
 }
@@ -0,0 +1,708 @@
+//------------------------------------------------------------------------------
+//! @file WiMODLRBASE_Bulk.cpp
+//! @ingroup WiMODLR_BASE
+//! <!------------------------------------------------------------------------->
+//! @brief Windowed bulk transfer over RadioLink
+//! @version 0.1
+//! <!------------------------------------------------------------------------->
+//!
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+//
+// Section Includes Files
+//
+//------------------------------------------------------------------------------
+
+#include "WiMODLRBASE_Bulk.h"
+
+#include <string.h>
+
+//------------------------------------------------------------------------------
+//
+// Section public functions - WiMODLRBASE_BulkSender
+//
+//------------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Constructor
+ *
+ * @param wimod     reference to the LR-BASE interface
+ */
+WiMODLRBASE_BulkSender::WiMODLRBASE_BulkSender(WiMODLRBASE& wimod)
+{
+    init();
+    this->wimod = &wimod;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Constructor
+ *
+ * @param wimod     reference to the LR-BASE PLUS interface
+ */
+WiMODLRBASE_BulkSender::WiMODLRBASE_BulkSender(WiMODLRBASE_PLUS& wimod)
+{
+    init();
+    this->wimodPlus = &wimod;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Destructor
+ */
+WiMODLRBASE_BulkSender::~WiMODLRBASE_BulkSender(void)
+{
+
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Sets the number of segments sent per poll (1 ... WIMOD_BULK_MAX_WINDOW)
+ *
+ * A window of 1 is the plain C-Data stop and wait scheme. The setting is
+ * used from the next Start() on.
+ */
+void WiMODLRBASE_BulkSender::SetWindowSize(UINT8 segments)
+{
+    windowSize = MAX(1, MIN(segments, WIMOD_BULK_MAX_WINDOW));
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Sets the number of unanswered polls (or failed send commands) in
+ *        a row after which the transfer is given up
+ */
+void WiMODLRBASE_BulkSender::SetMaxRetries(UINT8 retries)
+{
+    maxRetries = retries;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Starts a new transfer
+ *
+ * Reads the current radio config (see TWiMODLR_BulkStats) and resets the
+ * counters. The first frame is sent by the next call of Process().
+ *
+ * @param dstGroupAddress   group address of the receiver
+ *
+ * @param dstDeviceAddress  device address of the receiver
+ *
+ * @param data      data to send (not copied)
+ *
+ * @param length    length of the data (max. WIMOD_BULK_MAX_SEGMENTS segments)
+ *
+ * @retval true     if the transfer has been started
+ */
+bool WiMODLRBASE_BulkSender::Start(UINT8 dstGroupAddress, UINT16 dstDeviceAddress,
+                                   const UINT8* data, UINT16 length)
+{
+    UINT32 segments = ((UINT32) length + WIMOD_BULK_SEGMENT_SIZE - 1) / WIMOD_BULK_SEGMENT_SIZE;
+
+    if ((state == BulkState_Active) || (data == NULL) || (length == 0)
+            || (segments > WIMOD_BULK_MAX_SEGMENTS)) {
+        return false;
+    }
+
+    memset(&stats, 0x00, sizeof(stats));
+    readRadioSetting();
+    stats.WindowSize = windowSize;
+    stats.Segments   = (UINT16) segments;
+
+    txMsg.DestinationGroupAddress  = dstGroupAddress;
+    txMsg.DestinationDeviceAddress = dstDeviceAddress;
+
+    this->data   = data;
+    this->length = length;
+    numSegments  = (UINT16) segments;
+    baseSeq      = 0;
+    nextSeq      = 0;
+    ackedMask    = 0;
+    resendMask   = 0;
+    retries      = 0;
+    sendErrors   = 0;
+    awaitingAck  = false;
+    session++;
+
+    state     = BulkState_Active;
+    startTime = millis();
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Sends the next frame of the transfer
+ *
+ * Segments reported as lost go first, then new segments up to the end of
+ * the window. The last frame before the window is exhausted is sent as
+ * C-Data; nothing is sent until its ack (or ack timeout) has been processed.
+ *
+ * A busy module (MEDIA_BUSY / BUFFER_FULL) only delays the frame; any other
+ * failed send command counts as an error, more than the max. retries in a
+ * row end the transfer with BulkState_Failed.
+ *
+ * @param hciResult Result of the local command transmission to module
+ *                  This is an optional parameter.
+ *
+ * @param rspStatus Status byte contained in the local response of the module
+ *                  This is an optional parameter.
+ *
+ * @retval true     if a frame has been handed over to the module
+ *
+ * @code
+ * WiMODLRBASE_BulkSender bulk(wimod);
+ *
+ * void onAckRx(TWiMODLR_HCIMessage& rxMsg) {
+ *  wimod.convert(rxMsg, &radioRxMsg);
+ *  bulk.ProcessAck(radioRxMsg);
+ * }
+ *
+ * void onAckTimeout(void) {
+ *  bulk.ProcessAckTimeout();
+ * }
+ *
+ * void setup() {
+ *  ...
+ *  wimod.RegisterAckRxClient(onAckRx);
+ *  wimod.RegisterAckRxTimeoutClient(onAckTimeout);
+ *  bulk.Start(0x10, 0x1234, image, sizeof(image));
+ * }
+ *
+ * void loop() {
+ *  bulk.Process();
+ *  wimod.Process();
+ * }
+ * @endcode
+ */
+bool WiMODLRBASE_BulkSender::Process(TWiMODLRResultCodes* hciResult, UINT8* rspStatus)
+{
+    TWiMODLRResultCodes hciRes = WiMODLR_RESULT_OK;
+    UINT8               status = RADIOLINK_STATUS_OK;
+    UINT16              limit;
+    UINT16              next;
+    UINT8               i;
+    bool                resend;
+    bool                poll;
+    bool                ok;
+
+    if ((state != BulkState_Active) || awaitingAck) {
+        return false;
+    }
+
+    limit = MIN(numSegments, baseSeq + windowSize);
+
+    for (i = 0; baseSeq + i < nextSeq; i++) {
+        if (resendMask & (1UL << i)) {
+            break;
+        }
+    }
+    resend = (baseSeq + i < nextSeq);
+    if (!resend) {
+        if (nextSeq >= limit) {
+            return false;
+        }
+        i = (UINT8) (nextSeq - baseSeq);
+    }
+
+    // poll if this is the last frame that may go out before an ack
+    next = resend ? nextSeq : nextSeq + 1;
+    poll = ((resendMask & ~(1UL << i)) == 0) && (next >= limit);
+
+    ok = sendSegment((UINT8) (baseSeq + i), poll, &hciRes, &status);
+    if (hciResult) {
+        *hciResult = hciRes;
+    }
+    if (rspStatus) {
+        *rspStatus = status;
+    }
+    if (!ok) {
+        if (((hciRes != WiMODLR_RESULT_OK)
+                || ((status != RADIOLINK_STATUS_MEDIA_BUSY) && (status != RADIOLINK_STATUS_BUFFER_FULL)))
+                && (++sendErrors > maxRetries)) {
+            finish(BulkState_Failed);
+        }
+        return false;
+    }
+    sendErrors = 0;
+
+    if (resend) {
+        resendMask &= ~(1UL << i);
+        stats.Retransmissions++;
+    } else {
+        nextSeq++;
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Stops the current transfer
+ */
+void WiMODLRBASE_BulkSender::Abort(void)
+{
+    if (state == BulkState_Active) {
+        finish(BulkState_Idle);
+    }
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Adds the airtime of a TX U-Data indication to the statistics
+ */
+void WiMODLRBASE_BulkSender::ProcessUDataTxIndication(const TWiMODLR_RadioLink_UdataInd& txInd)
+{
+    if (state == BulkState_Active) {
+        stats.AirtimeMs += txInd.AirTime;
+    }
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Adds the airtime of a TX C-Data indication to the statistics
+ */
+void WiMODLRBASE_BulkSender::ProcessCDataTxIndication(const TWiMODLR_RadioLink_CdataInd& txInd)
+{
+    if (state == BulkState_Active) {
+        stats.AirtimeMs += txInd.AirTime;
+    }
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Processes the RX Ack indication of a poll
+ *
+ * The poll itself has been received by the peer; the ack data tells which
+ * of the segments sent before it made it. Everything else that has been
+ * sent is sent again.
+ *
+ * @param ackMsg    converted RX Ack indication
+ *
+ * @retval true     if the ack has been expected
+ */
+bool WiMODLRBASE_BulkSender::ProcessAck(const TWiMODLR_RadioLink_Msg& ackMsg)
+{
+    UINT32 bitmap;
+    UINT16 nextExpected;
+    UINT16 seq;
+    UINT8  i;
+
+    if ((state != BulkState_Active) || !awaitingAck) {
+        return false;
+    }
+    awaitingAck = false;
+
+    // without valid ack data nothing is known about the U-Data segments
+    if ((ackMsg.Length < WIMOD_BULK_ACK_SIZE) || (ackMsg.Payload[0] != WIMOD_BULK_FRAME_ACK)
+            || (ackMsg.Payload[1] != session)) {
+        lost();
+        return true;
+    }
+
+    nextExpected = ackMsg.Payload[2];
+    bitmap       = NTOH32(&ackMsg.Payload[3]);
+    retries      = 0;
+
+    ackedMask |= (1UL << (UINT8) (pollSeq - baseSeq));
+    for (seq = baseSeq, i = 0; seq < nextSeq; seq++, i++) {
+        if ((seq < nextExpected)
+                || ((seq > nextExpected) && (seq - nextExpected <= 32) && (bitmap & (1UL << (seq - nextExpected - 1))))) {
+            ackedMask |= (1UL << i);
+        }
+    }
+    // the ack data is updated after each segment: not reported means lost
+    resendMask = ~ackedMask;
+    if (nextSeq - baseSeq < 32) {
+        resendMask &= (1UL << (nextSeq - baseSeq)) - 1;
+    }
+
+    while ((baseSeq < nextSeq) && (ackedMask & 0x01)) {
+        stats.BytesDelivered += (baseSeq == numSegments - 1)
+                                ? length - baseSeq * WIMOD_BULK_SEGMENT_SIZE : WIMOD_BULK_SEGMENT_SIZE;
+        ackedMask  >>= 1;
+        resendMask >>= 1;
+        baseSeq++;
+    }
+
+    if (baseSeq == numSegments) {
+        finish(BulkState_Done);
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Processes the Ack Timeout indication of a poll
+ *
+ * Only the poll is sent again; the state of the segments before it is
+ * taken from the ack of the repeated poll.
+ */
+void WiMODLRBASE_BulkSender::ProcessAckTimeout(void)
+{
+    if ((state != BulkState_Active) || !awaitingAck) {
+        return;
+    }
+    awaitingAck = false;
+    stats.AckTimeouts++;
+
+    if (++retries > maxRetries) {
+        finish(BulkState_Failed);
+        return;
+    }
+    resendMask |= (1UL << (UINT8) (pollSeq - baseSeq));
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the state of the current / last transfer
+ */
+TWiMODLR_BulkState WiMODLRBASE_BulkSender::GetState(void)
+{
+    return state;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Copies the counters of the current / last transfer
+ */
+void WiMODLRBASE_BulkSender::GetStats(TWiMODLR_BulkStats* stats)
+{
+    if (stats) {
+        memcpy(stats, &this->stats, sizeof(TWiMODLR_BulkStats));
+        if (state == BulkState_Active) {
+            stats->ElapsedMs = millis() - startTime;
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the acked payload bytes per second of the current / last
+ *        transfer (wall clock, incl. HCI and ack turnaround)
+ */
+UINT32 WiMODLRBASE_BulkSender::GetThroughput(void)
+{
+    UINT32 elapsed = stats.ElapsedMs;
+
+    if (state == BulkState_Active) {
+        elapsed = millis() - startTime;
+    }
+    if (elapsed == 0) {
+        return 0;
+    }
+    return (UINT32) (((UINT64) stats.BytesDelivered * 1000) / elapsed);
+}
+
+//------------------------------------------------------------------------------
+//
+// Section protected functions - WiMODLRBASE_BulkSender
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+void WiMODLRBASE_BulkSender::init(void)
+{
+    memset(&txMsg, 0x00, sizeof(txMsg));
+    memset(&stats, 0x00, sizeof(stats));
+
+    wimod       = NULL;
+    wimodPlus   = NULL;
+    state       = BulkState_Idle;
+    data        = NULL;
+    length      = 0;
+    numSegments = 0;
+    baseSeq     = 0;
+    nextSeq     = 0;
+    ackedMask   = 0;
+    resendMask  = 0;
+    session     = 0;
+    pollSeq     = 0;
+    windowSize  = WIMOD_BULK_DEFAULT_WINDOW;
+    maxRetries  = WIMOD_BULK_DEFAULT_MAX_RETRIES;
+    retries     = 0;
+    sendErrors  = 0;
+    awaitingAck = false;
+    startTime   = 0;
+}
+
+bool WiMODLRBASE_BulkSender::sendSegment(UINT8 seq, bool poll,
+                                         TWiMODLRResultCodes* hciResult, UINT8* rspStatus)
+{
+    UINT16 offset = (UINT16) seq * WIMOD_BULK_SEGMENT_SIZE;
+    UINT8  len    = (UINT8) MIN(length - offset, WIMOD_BULK_SEGMENT_SIZE);
+    bool   ok;
+
+    txMsg.Payload[0] = WIMOD_BULK_FRAME_DATA;
+    txMsg.Payload[1] = session;
+    txMsg.Payload[2] = seq;
+    txMsg.Payload[3] = (UINT8) (numSegments - 1);
+    memcpy(&txMsg.Payload[WIMOD_BULK_HEADER_SIZE], &data[offset], len);
+    txMsg.Length = WIMOD_BULK_HEADER_SIZE + len;
+
+    if (wimod) {
+        ok = poll ? wimod->SendCData(&txMsg, hciResult, rspStatus)
+                  : wimod->SendUData(&txMsg, hciResult, rspStatus);
+    } else {
+        ok = poll ? wimodPlus->SendCData(&txMsg, hciResult, rspStatus)
+                  : wimodPlus->SendUData(&txMsg, hciResult, rspStatus);
+    }
+    if (!ok) {
+        return false;
+    }
+
+    stats.Frames++;
+    if (poll) {
+        stats.Polls++;
+        pollSeq     = seq;
+        awaitingAck = true;
+    }
+    return true;
+}
+
+void WiMODLRBASE_BulkSender::lost(void)
+{
+    // send everything in flight again (at least the poll); the peer may
+    // not run the bulk receiver, so this counts as a failed poll
+    resendMask = (nextSeq - baseSeq < 32) ? (1UL << (nextSeq - baseSeq)) - 1 : 0xFFFFFFFF;
+    resendMask &= ~ackedMask;
+
+    if (++retries > maxRetries) {
+        finish(BulkState_Failed);
+    }
+}
+
+void WiMODLRBASE_BulkSender::readRadioSetting(void)
+{
+    if (wimod) {
+        TWiMODLR_DevMgmt_RadioConfig radioCfg;
+
+        if (wimod->GetRadioConfig(&radioCfg)) {
+            stats.Modulation      = radioCfg.Modulation;
+            stats.Bandwidth       = (radioCfg.Modulation == Modulation_FSK)
+                                    ? (UINT8) radioCfg.FskDatarate : (UINT8) radioCfg.LoRaBandWidth;
+            stats.SpreadingFactor = radioCfg.LoRaSpreadingFactor;
+        }
+    } else {
+        TWiMODLR_DevMgmt_RadioConfigPlus radioCfg;
+
+        if (wimodPlus->GetRadioConfig(&radioCfg)) {
+            stats.Modulation      = radioCfg.Modulation;
+            stats.SpreadingFactor = radioCfg.LoRaSpreadingFactor;
+            switch (radioCfg.Modulation) {
+                case LRBASE_PLUS_Modulation_FLRC:
+                    stats.Bandwidth = radioCfg.FLRCBandWidth;
+                    break;
+                case LRBASE_PLUS_Modulation_FSK:
+                    stats.Bandwidth = radioCfg.FSKBandWidth;
+                    break;
+                default:
+                    stats.Bandwidth = radioCfg.LoRaBandWidth;
+                    break;
+            }
+        }
+    }
+}
+
+void WiMODLRBASE_BulkSender::finish(TWiMODLR_BulkState result)
+{
+    stats.ElapsedMs = millis() - startTime;
+    state           = result;
+    awaitingAck     = false;
+}
+//! @endcond
+
+//------------------------------------------------------------------------------
+//
+// Section public functions - WiMODLRBASE_BulkReceiver
+//
+//------------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Constructor
+ *
+ * @param wimod     reference to the LR-BASE interface
+ */
+WiMODLRBASE_BulkReceiver::WiMODLRBASE_BulkReceiver(WiMODLRBASE& wimod)
+{
+    init();
+    this->wimod = &wimod;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Constructor
+ *
+ * @param wimod     reference to the LR-BASE PLUS interface
+ */
+WiMODLRBASE_BulkReceiver::WiMODLRBASE_BulkReceiver(WiMODLRBASE_PLUS& wimod)
+{
+    init();
+    this->wimodPlus = &wimod;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Destructor
+ */
+WiMODLRBASE_BulkReceiver::~WiMODLRBASE_BulkReceiver(void)
+{
+
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Registers a callback for each completely received transfer
+ */
+void WiMODLRBASE_BulkReceiver::RegisterDataClient(TBulkDataCallback cb)
+{
+    dataCallback = cb;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Processes a received segment and updates the ack data
+ *
+ * @param rxMsg     converted RX U-Data or RX C-Data indication
+ *
+ * @param hciResult Result of the SetAckData command
+ *                  This is an optional parameter.
+ *
+ * @param rspStatus Status byte of the SetAckData response
+ *                  This is an optional parameter.
+ *
+ * @retval true     if the frame was a segment that could be stored and the
+ *                  ack data has been updated
+ */
+bool WiMODLRBASE_BulkReceiver::ProcessRxData(const TWiMODLR_RadioLink_Msg& rxMsg,
+                                             TWiMODLRResultCodes* hciResult, UINT8* rspStatus)
+{
+    UINT8 seq;
+    UINT8 last;
+    UINT8 len;
+    bool  ok;
+
+    if ((rxMsg.Length <= WIMOD_BULK_HEADER_SIZE) || (rxMsg.Payload[0] != WIMOD_BULK_FRAME_DATA)) {
+        return false;
+    }
+
+    seq  = rxMsg.Payload[2];
+    last = rxMsg.Payload[3];
+    len  = rxMsg.Length - WIMOD_BULK_HEADER_SIZE;
+    if ((seq > last) || (len > WIMOD_BULK_SEGMENT_SIZE)
+            || ((seq < last) && (len != WIMOD_BULK_SEGMENT_SIZE))
+            || ((UINT32) (last + 1) * WIMOD_BULK_SEGMENT_SIZE > WIMOD_BULK_RX_BUFFER_SIZE)) {
+        return false;
+    }
+
+    if (!active || (rxMsg.Payload[1] != session) || (last != lastSeq)) {
+        reset(rxMsg.Payload[1], last);
+    }
+
+    if (isReceived(seq)) {
+        duplicates++;
+    } else {
+        memcpy(&buffer[(UINT16) seq * WIMOD_BULK_SEGMENT_SIZE],
+               &rxMsg.Payload[WIMOD_BULK_HEADER_SIZE], len);
+        received[seq >> 3] |= (1 << (seq & 0x07));
+        if (seq == last) {
+            length = (UINT16) seq * WIMOD_BULK_SEGMENT_SIZE + len;
+        }
+        while ((nextExpected <= lastSeq) && isReceived((UINT8) nextExpected)) {
+            nextExpected++;
+        }
+    }
+
+    ok = updateAckData(rxMsg, hciResult, rspStatus);
+
+    if (!complete && (nextExpected > lastSeq)) {
+        complete = true;
+        if (dataCallback) {
+            dataCallback(buffer, length);
+        }
+    }
+    return ok;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the number of segments received more than once
+ */
+UINT16 WiMODLRBASE_BulkReceiver::GetDuplicates(void)
+{
+    return duplicates;
+}
+
+//------------------------------------------------------------------------------
+//
+// Section protected functions - WiMODLRBASE_BulkReceiver
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+void WiMODLRBASE_BulkReceiver::init(void)
+{
+    memset(&ackMsg, 0x00, sizeof(ackMsg));
+    memset(received, 0x00, sizeof(received));
+
+    wimod        = NULL;
+    wimodPlus    = NULL;
+    active       = false;
+    complete     = false;
+    session      = 0;
+    lastSeq      = 0;
+    nextExpected = 0;
+    length       = 0;
+    duplicates   = 0;
+    dataCallback = NULL;
+}
+
+void WiMODLRBASE_BulkReceiver::reset(UINT8 session, UINT8 lastSeq)
+{
+    memset(received, 0x00, sizeof(received));
+
+    this->session = session;
+    this->lastSeq = lastSeq;
+    active        = true;
+    complete      = false;
+    nextExpected  = 0;
+    length        = 0;
+}
+
+bool WiMODLRBASE_BulkReceiver::isReceived(UINT8 seq)
+{
+    return (received[seq >> 3] & (1 << (seq & 0x07))) != 0;
+}
+
+bool WiMODLRBASE_BulkReceiver::updateAckData(const TWiMODLR_RadioLink_Msg& rxMsg,
+                                             TWiMODLRResultCodes* hciResult, UINT8* rspStatus)
+{
+    UINT32 bitmap = 0;
+    UINT16 seq;
+    UINT8  i;
+
+    for (i = 0, seq = nextExpected + 1; (i < 32) && (seq <= lastSeq); i++, seq++) {
+        if (isReceived((UINT8) seq)) {
+            bitmap |= (1UL << i);
+        }
+    }
+
+    ackMsg.DestinationGroupAddress  = rxMsg.SourceGroupAddress;
+    ackMsg.DestinationDeviceAddress = rxMsg.SourceDeviceAddress;
+    ackMsg.Payload[0] = WIMOD_BULK_FRAME_ACK;
+    ackMsg.Payload[1] = session;
+    ackMsg.Payload[2] = (UINT8) nextExpected;
+    HTON32(&ackMsg.Payload[3], bitmap);
+    ackMsg.Length = WIMOD_BULK_ACK_SIZE;
+
+    if (wimod) {
+        return wimod->SetAckData(&ackMsg, hciResult, rspStatus);
+    }
+    return wimodPlus->SetAckData(&ackMsg, hciResult, rspStatus);
+}
+//! @endcond
+
+//------------------------------------------------------------------------------
+// EOF
+//------------------------------------------------------------------------------
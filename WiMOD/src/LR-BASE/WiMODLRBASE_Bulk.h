@@ -0,0 +1,236 @@
+//------------------------------------------------------------------------------
+//! @file WiMODLRBASE_Bulk.h
+//! @ingroup WiMODLR_BASE
+//! <!------------------------------------------------------------------------->
+//! @brief Declarations for a windowed bulk transfer over RadioLink
+//! @version 0.1
+//! <!------------------------------------------------------------------------->
+//!
+//! SendCData() costs a full round trip (frame + ack) per packet. For bulk
+//! transfers between two nodes the data is split into segments that are sent
+//! back to back as U-Data; only the last segment of a window is sent as
+//! C-Data ("poll"). The receiving host keeps its ack data (SetAckData) up to
+//! date after every segment, so the module's ack of the poll carries a
+//! cumulative ack plus a bitmap of the segments received beyond it. Missing
+//! segments are sent again with the next window; a lost poll (AckRxTimeout)
+//! is repeated.
+//!
+//! Segment:        | 0x01 | session | seq | last seq | data ... |
+//! Ack data:       | 0x02 | session | next expected seq | bitmap (32 bit) |
+//!
+//! Bit i of the bitmap reports segment (next expected + 1 + i). All segments
+//! but the last one carry WIMOD_BULK_SEGMENT_SIZE bytes.
+//!
+//! Works with the LR-BASE (WiMODLRBASE) and the LR-BASE PLUS firmware
+//! (WiMODLRBASE_PLUS); both use the same RadioLink SAP.
+//!
+//------------------------------------------------------------------------------
+
+
+#ifndef ARDUINO_WIMODLRBASE_BULK_H_
+#define ARDUINO_WIMODLRBASE_BULK_H_
+
+//------------------------------------------------------------------------------
+//
+// Section Includes Files
+//
+//------------------------------------------------------------------------------
+
+#include "../WiMODLR_BASE.h"
+#include "../WiMODLR_BASE_PLUS.h"
+
+//------------------------------------------------------------------------------
+//
+// Section defines
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+#define WIMOD_BULK_FRAME_DATA                       0x01
+#define WIMOD_BULK_FRAME_ACK                        0x02
+
+#define WIMOD_BULK_HEADER_SIZE                      4
+#define WIMOD_BULK_ACK_SIZE                         7                           // fits WIMOD_RADIOLINK_ACK_DATA_LEN
+#define WIMOD_BULK_SEGMENT_SIZE                     (WIMOD_RADIOLINK_PAYLOAD_LEN - WIMOD_BULK_HEADER_SIZE)
+#define WIMOD_BULK_MAX_SEGMENTS                     255                         // 8 bit sequence numbers
+#define WIMOD_BULK_MAX_WINDOW                       32                          // ack bitmap
+#define WIMOD_BULK_DEFAULT_WINDOW                   8
+#define WIMOD_BULK_DEFAULT_MAX_RETRIES              8                           // poll timeouts in a row
+
+#ifndef WIMOD_BULK_RX_BUFFER_SIZE
+#define WIMOD_BULK_RX_BUFFER_SIZE                   2048                        // max. size of a received transfer
+#endif
+//! @endcond
+
+/**
+ * @brief State of a bulk transfer
+ */
+typedef enum TWiMODLR_BulkState
+{
+    BulkState_Idle = 0,                                                         /*!< no transfer started */
+    BulkState_Active,                                                           /*!< transfer in progress */
+    BulkState_Done,                                                             /*!< all segments acked */
+    BulkState_Failed,                                                           /*!< too many poll timeouts / send errors in a row */
+} TWiMODLR_BulkState;
+
+/**
+ * @brief Counters of a bulk transfer
+ *
+ * The radio setting is read from the module at Start(), so each record
+ * states the setting it was measured with. Modulation / Bandwidth /
+ * SpreadingFactor hold the raw enum values of the firmware in use
+ * (TRadioCfg_... for LR-BASE, TRadioCfg_...Plus for LR-BASE PLUS); for FLRC
+ * Bandwidth is the FLRC bandwidth, for FSK the FSK datarate / bandwidth.
+ */
+typedef struct TWiMODLR_BulkStats
+{
+    UINT8       Modulation;                                                     /*!< modulation at start of transfer */
+    UINT8       Bandwidth;                                                      /*!< bandwidth / bitrate setting */
+    UINT8       SpreadingFactor;                                                /*!< LoRa spreading factor */
+    UINT8       WindowSize;                                                     /*!< segments per poll */
+    UINT32      BytesDelivered;                                                 /*!< payload bytes acked */
+    UINT16      Segments;                                                       /*!< segments of the transfer */
+    UINT16      Frames;                                                         /*!< U-Data + C-Data frames sent */
+    UINT16      Retransmissions;                                                /*!< segments sent more than once */
+    UINT16      Polls;                                                          /*!< C-Data frames sent */
+    UINT16      AckTimeouts;                                                    /*!< AckRxTimeout indications */
+    UINT32      AirtimeMs;                                                      /*!< sum of the reported TX airtime */
+    UINT32      ElapsedMs;                                                      /*!< Start() until done / failed */
+} TWiMODLR_BulkStats;
+
+
+// C++11 check
+#ifdef WIMOD_USE_CPP11
+    /** Type definition for a 'transfer received' callback */
+    typedef std::function<void (const UINT8* data, UINT16 length)> TBulkDataCallback;
+#else
+    /** Type definition for a 'transfer received' callback function */
+    typedef void (*TBulkDataCallback)(const UINT8* data, UINT16 length);
+#endif
+
+
+//------------------------------------------------------------------------------
+//
+// Section class
+//
+//------------------------------------------------------------------------------
+
+/**
+ * @brief Sending side of the bulk transfer
+ *
+ * Start() takes the data by reference (it is not copied, keep it valid until
+ * the transfer is done). Process() hands the next frame to the module; it is
+ * meant to be called from the main loop. A module that is still busy with
+ * the previous frame (MEDIA_BUSY / BUFFER_FULL) just delays the next one;
+ * after more than SetMaxRetries() unanswered polls or other send errors in
+ * a row the transfer ends with BulkState_Failed.
+ * The converted TX U-Data / TX C-Data, RX Ack and Ack Timeout indications
+ * have to be fed into the Process...() functions.
+ */
+class WiMODLRBASE_BulkSender {
+public:
+    WiMODLRBASE_BulkSender(WiMODLRBASE& wimod);
+    WiMODLRBASE_BulkSender(WiMODLRBASE_PLUS& wimod);
+    ~WiMODLRBASE_BulkSender(void);
+
+    void        SetWindowSize(UINT8 segments);
+    void        SetMaxRetries(UINT8 retries);
+
+    bool        Start(UINT8 dstGroupAddress, UINT16 dstDeviceAddress, const UINT8* data, UINT16 length);
+    bool        Process(TWiMODLRResultCodes* hciResult = NULL, UINT8* rspStatus = NULL);
+    void        Abort(void);
+
+    void        ProcessUDataTxIndication(const TWiMODLR_RadioLink_UdataInd& txInd);
+    void        ProcessCDataTxIndication(const TWiMODLR_RadioLink_CdataInd& txInd);
+    bool        ProcessAck(const TWiMODLR_RadioLink_Msg& ackMsg);
+    void        ProcessAckTimeout(void);
+
+    TWiMODLR_BulkState GetState(void);
+    void        GetStats(TWiMODLR_BulkStats* stats);
+    UINT32      GetThroughput(void);
+
+protected:
+    //! @cond Doxygen_Suppress
+    void        init(void);
+    bool        sendSegment(UINT8 seq, bool poll, TWiMODLRResultCodes* hciResult, UINT8* rspStatus);
+    void        lost(void);
+    void        readRadioSetting(void);
+    void        finish(TWiMODLR_BulkState result);
+    //! @endcond
+private:
+    //! @cond Doxygen_Suppress
+    WiMODLRBASE*            wimod;
+    WiMODLRBASE_PLUS*       wimodPlus;
+    TWiMODLR_RadioLink_Msg  txMsg;
+    TWiMODLR_BulkStats      stats;
+    TWiMODLR_BulkState      state;
+
+    const UINT8*            data;
+    UINT16                  length;
+    UINT16                  numSegments;
+    UINT16                  baseSeq;                                            // oldest unacked segment
+    UINT16                  nextSeq;                                            // first segment never sent
+    UINT32                  ackedMask;                                          // bit i: baseSeq + i acked
+    UINT32                  resendMask;                                         // bit i: baseSeq + i lost
+    UINT8                   session;
+    UINT8                   pollSeq;
+    UINT8                   windowSize;
+    UINT8                   maxRetries;
+    UINT8                   retries;                                            // unanswered polls in a row
+    UINT8                   sendErrors;                                         // failed send commands in a row
+    bool                    awaitingAck;                                        // poll sent
+    UINT32                  startTime;
+    //! @endcond
+};
+
+
+/**
+ * @brief Receiving side of the bulk transfer
+ *
+ * Feed the converted RX U-Data and RX C-Data indications into
+ * ProcessRxData(). The ack data is updated after every segment; the host
+ * has to process the indications without delay, otherwise the ack of a
+ * poll reports an older state and segments are sent twice.
+ */
+class WiMODLRBASE_BulkReceiver {
+public:
+    WiMODLRBASE_BulkReceiver(WiMODLRBASE& wimod);
+    WiMODLRBASE_BulkReceiver(WiMODLRBASE_PLUS& wimod);
+    ~WiMODLRBASE_BulkReceiver(void);
+
+    void        RegisterDataClient(TBulkDataCallback cb);
+
+    bool        ProcessRxData(const TWiMODLR_RadioLink_Msg& rxMsg,
+                              TWiMODLRResultCodes* hciResult = NULL, UINT8* rspStatus = NULL);
+    UINT16      GetDuplicates(void);
+
+protected:
+    //! @cond Doxygen_Suppress
+    void        init(void);
+    void        reset(UINT8 session, UINT8 lastSeq);
+    bool        isReceived(UINT8 seq);
+    bool        updateAckData(const TWiMODLR_RadioLink_Msg& rxMsg,
+                              TWiMODLRResultCodes* hciResult, UINT8* rspStatus);
+    //! @endcond
+private:
+    //! @cond Doxygen_Suppress
+    WiMODLRBASE*            wimod;
+    WiMODLRBASE_PLUS*       wimodPlus;
+    TWiMODLR_RadioLink_Msg  ackMsg;
+    UINT8                   buffer[WIMOD_BULK_RX_BUFFER_SIZE];
+    UINT8                   received[(WIMOD_BULK_MAX_SEGMENTS + 7) / 8];
+
+    bool                    active;
+    bool                    complete;
+    UINT8                   session;
+    UINT8                   lastSeq;
+    UINT16                  nextExpected;
+    UINT16                  length;
+    UINT16                  duplicates;
+
+    TBulkDataCallback       dataCallback;
+    //! @endcond
+};
+
+
+#endif /* ARDUINO_WIMODLRBASE_BULK_H_ */
@@ -0,0 +1,505 @@
+//------------------------------------------------------------------------------
+//! @file WiMODLRBASE_ChannelSurvey.cpp
+//! @ingroup WiMODLR_BASE
+//! <!------------------------------------------------------------------------->
+//! @brief Channel survey / occupancy map
+//! @version 0.1
+//! <!------------------------------------------------------------------------->
+//!
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+//
+// Section Includes Files
+//
+//------------------------------------------------------------------------------
+
+#include "WiMODLRBASE_ChannelSurvey.h"
+
+#include <string.h>
+
+//------------------------------------------------------------------------------
+//
+// Section public functions
+//
+//------------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Constructor
+ *
+ * @param wimod     reference to the LR-BASE interface
+ */
+WiMODLRBASE_ChannelSurvey::WiMODLRBASE_ChannelSurvey(WiMODLRBASE& wimod)
+{
+    init();
+    this->wimod = &wimod;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Constructor
+ *
+ * @param wimod     reference to the LR-BASE PLUS interface
+ */
+WiMODLRBASE_ChannelSurvey::WiMODLRBASE_ChannelSurvey(WiMODLRBASE_PLUS& wimod)
+{
+    init();
+    this->wimodPlus = &wimod;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Destructor
+ */
+WiMODLRBASE_ChannelSurvey::~WiMODLRBASE_ChannelSurvey(void)
+{
+
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Removes all channels and results
+ */
+void WiMODLRBASE_ChannelSurvey::ClearPlan(void)
+{
+    if (state == Survey_Idle) {
+        numChannels = 0;
+        ranked      = false;
+    }
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Adds a channel to the frequency plan
+ *
+ * @param frequency     center frequency [Hz]
+ *
+ * @retval true     if the channel has been added
+ */
+bool WiMODLRBASE_ChannelSurvey::AddChannel(UINT32 frequency)
+{
+    TWiMODLR_ChannelSurveyEntry* channel;
+
+    if ((state != Survey_Idle) || (numChannels >= WIMOD_SURVEY_MAX_CHANNELS)) {
+        return false;
+    }
+
+    channel = &channels[numChannels];
+    memset(channel, 0x00, sizeof(TWiMODLR_ChannelSurveyEntry));
+    channel->Frequency = frequency;
+    if (wimod) {
+        wimod->calcFreqToRegister(frequency, &channel->RfFreq_MSB, &channel->RfFreq_MID, &channel->RfFreq_LSB);
+    } else {
+        wimodPlus->calcFreqToRegister(frequency, &channel->RfFreq_MSB, &channel->RfFreq_MID, &channel->RfFreq_LSB);
+    }
+    ranking[numChannels] = numChannels;
+    numChannels++;
+    ranked = false;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Adds equally spaced channels to the frequency plan
+ *
+ * @param firstFrequency    center frequency of the first channel [Hz]
+ *
+ * @param spacing           channel spacing [Hz]
+ *
+ * @param count             number of channels
+ *
+ * @retval number of channels added
+ *
+ * @code
+ * // SX127x: 868.1 ... 869.5 MHz
+ * survey.AddChannels(868100000, 200000, 8);
+ * // SX1280: 2.402 ... 2.480 GHz
+ * survey.AddChannels(2402000000UL, 2000000, 40);
+ * @endcode
+ */
+UINT8 WiMODLRBASE_ChannelSurvey::AddChannels(UINT32 firstFrequency, UINT32 spacing, UINT8 count)
+{
+    UINT8 i;
+
+    for (i = 0; i < count; i++) {
+        if (!AddChannel(firstFrequency + (UINT32) i * spacing)) {
+            break;
+        }
+    }
+    return i;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Sets the listening time per channel and the number of rounds
+ *
+ * Short dwells over several rounds average out bursty traffic better than
+ * one long dwell.
+ */
+void WiMODLRBASE_ChannelSurvey::SetDwell(UINT16 dwellMs, UINT8 rounds)
+{
+    this->dwellMs = MAX(dwellMs, WIMOD_SURVEY_MIN_DWELL);
+    this->rounds  = MAX(rounds, 1);
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Sets the number of probes sent per dwell (0: listen only)
+ */
+void WiMODLRBASE_ChannelSurvey::SetProbes(UINT8 probesPerDwell)
+{
+    probes = probesPerDwell;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Starts the survey
+ *
+ * The current radio config is kept and written back at the end.
+ *
+ * @retval true     if the survey has been started
+ */
+bool WiMODLRBASE_ChannelSurvey::Start(void)
+{
+    UINT8 i;
+    bool  ok;
+
+    if ((state != Survey_Idle) || (numChannels == 0)) {
+        return false;
+    }
+
+    ok = wimod ? wimod->GetRadioConfig(&baseCfg) : wimodPlus->GetRadioConfig(&baseCfgPlus);
+    if (!ok) {
+        return false;
+    }
+
+    for (i = 0; i < numChannels; i++) {
+        channels[i].RxPackets      = 0;
+        channels[i].RxAddressMatch = 0;
+        channels[i].RxCRCError     = 0;
+        channels[i].TxPackets      = 0;
+        channels[i].TxMediaBusy    = 0;
+        channels[i].DwellMs        = 0;
+        channels[i].Score          = 0;
+        ranking[i] = i;
+    }
+
+    current = 0;
+    round   = 0;
+    ranked  = false;
+    state   = Survey_Tune;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Runs the survey; call from the main loop
+ *
+ * @retval true     while the survey is running
+ *
+ * @code
+ * WiMODLRBASE_ChannelSurvey survey(wimod);
+ *
+ * void setup() {
+ *  ...
+ *  survey.AddChannels(868100000, 200000, 8);
+ *  survey.SetDwell(1000, 5);
+ *  survey.Start();
+ * }
+ *
+ * void loop() {
+ *  if (!survey.Process() && !printed) {
+ *      survey.PrintResults(Serial);
+ *      radioCfg.StoreNwmFlag = 0x01;
+ *      wimod.calcFreqToRegister(survey.GetBestFrequency(),
+ *                               &radioCfg.RfFreq_MSB, &radioCfg.RfFreq_MID, &radioCfg.RfFreq_LSB);
+ *      wimod.SetRadioConfig(&radioCfg);
+ *      printed = true;
+ *  }
+ *  wimod.Process();
+ * }
+ * @endcode
+ */
+bool WiMODLRBASE_ChannelSurvey::Process(void)
+{
+    TWiMODLR_ChannelSurveyEntry*  channel = &channels[current];
+    TWiMODLR_DevMgmt_SystemStatus status;
+    UINT32                        now     = millis();
+    UINT32                        elapsed;
+
+    switch (state) {
+        case Survey_Idle:
+            return false;
+
+        case Survey_Tune:
+            if (!tune(channel) || !readCounters(&counters)) {
+                // module unusable; keep what has been collected so far
+                Abort();
+                return false;
+            }
+            probesSent = 0;
+            listenTime = now;
+            state      = Survey_Listen;
+            break;
+
+        case Survey_Listen:
+            elapsed = now - listenTime;
+
+            // spread the probes over the dwell
+            if ((probesSent < probes) && (elapsed >= (UINT32) dwellMs * (probesSent + 1) / (probes + 1))) {
+                sendProbe();
+                probesSent++;
+            }
+            if (elapsed < dwellMs) {
+                break;
+            }
+
+            if (readCounters(&status)) {
+                channel->RxPackets      += status.RxPackets - counters.RxPackets;
+                channel->RxAddressMatch += status.RxAddressMatch - counters.RxAddressMatch;
+                channel->RxCRCError     += status.RxCRCError - counters.RxCRCError;
+                channel->TxPackets      += status.TxPackets - counters.TxPackets;
+                channel->TxMediaBusy    += status.TxMediaBusyEvents - counters.TxMediaBusyEvents;
+                channel->DwellMs        += elapsed;
+            }
+
+            if (++current >= numChannels) {
+                current = 0;
+                if (++round >= rounds) {
+                    restore();
+                    rank();
+                    state = Survey_Idle;
+                    break;
+                }
+            }
+            state = Survey_Tune;
+            break;
+    }
+    return state != Survey_Idle;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Stops the survey and restores the radio config
+ *
+ * The channels surveyed so far are ranked.
+ */
+void WiMODLRBASE_ChannelSurvey::Abort(void)
+{
+    if (state != Survey_Idle) {
+        restore();
+        rank();
+        state = Survey_Idle;
+    }
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns true while the survey is running
+ */
+bool WiMODLRBASE_ChannelSurvey::IsRunning(void)
+{
+    return state != Survey_Idle;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the number of channels of the plan
+ */
+UINT8 WiMODLRBASE_ChannelSurvey::GetNumChannels(void)
+{
+    return numChannels;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns a channel in plan order or NULL
+ */
+const TWiMODLR_ChannelSurveyEntry* WiMODLRBASE_ChannelSurvey::GetChannel(UINT8 index)
+{
+    return (index < numChannels) ? &channels[index] : NULL;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns a channel by rank (0: least congested) or NULL
+ */
+const TWiMODLR_ChannelSurveyEntry* WiMODLRBASE_ChannelSurvey::GetRanked(UINT8 rank)
+{
+    if (!ranked || (rank >= numChannels)) {
+        return NULL;
+    }
+    return &channels[ranking[rank]];
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the frequency of the least congested channel or 0
+ */
+UINT32 WiMODLRBASE_ChannelSurvey::GetBestFrequency(void)
+{
+    const TWiMODLR_ChannelSurveyEntry* best = GetRanked(0);
+
+    return best ? best->Frequency : 0;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Prints the occupancy map, least congested channel first
+ *
+ * Columns: rank, frequency [Hz], RX ok, RX address match, CRC errors,
+ * probes, busy, dwell [ms], score; separated by ';'.
+ */
+void WiMODLRBASE_ChannelSurvey::PrintResults(Stream& s)
+{
+    const TWiMODLR_ChannelSurveyEntry* c;
+    UINT8                              i;
+
+    s.print(F("rank;freq;rx;rxadr;crcerr;tx;busy;dwell;score\r\n"));
+    for (i = 0; i < numChannels; i++) {
+        c = ranked ? &channels[ranking[i]] : &channels[i];
+
+        s.print(i);                 s.print(F(";"));
+        s.print(c->Frequency);      s.print(F(";"));
+        s.print(c->RxPackets);      s.print(F(";"));
+        s.print(c->RxAddressMatch); s.print(F(";"));
+        s.print(c->RxCRCError);     s.print(F(";"));
+        s.print(c->TxPackets);      s.print(F(";"));
+        s.print(c->TxMediaBusy);    s.print(F(";"));
+        s.print(c->DwellMs);        s.print(F(";"));
+        s.print(c->Score);          s.print(F("\r\n"));
+    }
+}
+
+//------------------------------------------------------------------------------
+//
+// Section protected functions
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+void WiMODLRBASE_ChannelSurvey::init(void)
+{
+    wimod       = NULL;
+    wimodPlus   = NULL;
+    memset(&baseCfg, 0x00, sizeof(baseCfg));
+    memset(&baseCfgPlus, 0x00, sizeof(baseCfgPlus));
+    memset(&counters, 0x00, sizeof(counters));
+
+    numChannels = 0;
+    dwellMs     = WIMOD_SURVEY_DEFAULT_DWELL;
+    rounds      = WIMOD_SURVEY_DEFAULT_ROUNDS;
+    probes      = 0;
+    state       = Survey_Idle;
+    current     = 0;
+    round       = 0;
+    probesSent  = 0;
+    listenTime  = 0;
+    ranked      = false;
+}
+
+// writes the frequency of the channel to the radio config (RAM only)
+bool WiMODLRBASE_ChannelSurvey::tune(const TWiMODLR_ChannelSurveyEntry* channel)
+{
+    if (wimod) {
+        TWiMODLR_DevMgmt_RadioConfig cfg;
+
+        memcpy(&cfg, &baseCfg, sizeof(cfg));
+        cfg.StoreNwmFlag = 0;
+        cfg.RfFreq_LSB   = channel->RfFreq_LSB;
+        cfg.RfFreq_MID   = channel->RfFreq_MID;
+        cfg.RfFreq_MSB   = channel->RfFreq_MSB;
+        return wimod->SetRadioConfig(&cfg);
+    } else {
+        TWiMODLR_DevMgmt_RadioConfigPlus cfg;
+
+        memcpy(&cfg, &baseCfgPlus, sizeof(cfg));
+        cfg.StoreNwmFlag = 0;
+        cfg.RfFreq_LSB   = channel->RfFreq_LSB;
+        cfg.RfFreq_MID   = channel->RfFreq_MID;
+        cfg.RfFreq_MSB   = channel->RfFreq_MSB;
+        return wimodPlus->SetRadioConfig(&cfg);
+    }
+}
+
+void WiMODLRBASE_ChannelSurvey::restore(void)
+{
+    if (wimod) {
+        baseCfg.StoreNwmFlag = 0;
+        wimod->SetRadioConfig(&baseCfg);
+    } else {
+        baseCfgPlus.StoreNwmFlag = 0;
+        wimodPlus->SetRadioConfig(&baseCfgPlus);
+    }
+}
+
+bool WiMODLRBASE_ChannelSurvey::readCounters(TWiMODLR_DevMgmt_SystemStatus* status)
+{
+    TWiMODLR_DevMgmt_SystemStatusPlus statusPlus;
+
+    if (wimod) {
+        return wimod->GetSystemStatus(status);
+    }
+    if (!wimodPlus->GetSystemStatus(&statusPlus)) {
+        return false;
+    }
+    status->RxPackets         = statusPlus.RxPackets;
+    status->RxAddressMatch    = statusPlus.RxAddressMatch;
+    status->RxCRCError        = statusPlus.RxCRCError;
+    status->TxPackets         = statusPlus.TxPackets;
+    status->TxError           = statusPlus.TxError;
+    status->TxMediaBusyEvents = statusPlus.TxMediaBusyEvents;
+    return true;
+}
+
+bool WiMODLRBASE_ChannelSurvey::sendProbe(void)
+{
+    TWiMODLR_RadioLink_Msg probe;
+
+    probe.DestinationGroupAddress  = RADIOLINK_BROADCAST_GROUP_ADR;
+    probe.DestinationDeviceAddress = RADIOLINK_BROADCAST_DEVICE_ADR;
+    probe.Payload[0] = 0x00;
+    probe.Length     = 1;
+
+    // a rejected probe (LBT) shows up in the busy counter
+    return wimod ? wimod->SendUData(&probe) : wimodPlus->SendUData(&probe);
+}
+
+// score and insertion sort of the ranking; ties go to fewer busy events,
+// then fewer CRC errors
+void WiMODLRBASE_ChannelSurvey::rank(void)
+{
+    TWiMODLR_ChannelSurveyEntry* c;
+    const TWiMODLR_ChannelSurveyEntry* a;
+    const TWiMODLR_ChannelSurveyEntry* b;
+    UINT8                        i, j, tmp;
+
+    for (i = 0; i < numChannels; i++) {
+        c = &channels[i];
+        c->Score = c->DwellMs ? (UINT32) (((UINT64) (c->RxPackets + c->RxCRCError + c->TxMediaBusy) * 60000) / c->DwellMs)
+                              : 0xFFFFFFFF;
+        ranking[i] = i;
+    }
+
+    for (i = 1; i < numChannels; i++) {
+        for (j = i; j > 0; j--) {
+            a = &channels[ranking[j - 1]];
+            b = &channels[ranking[j]];
+            if ((a->Score < b->Score)
+                    || ((a->Score == b->Score) && (a->TxMediaBusy < b->TxMediaBusy))
+                    || ((a->Score == b->Score) && (a->TxMediaBusy == b->TxMediaBusy) && (a->RxCRCError <= b->RxCRCError))) {
+                break;
+            }
+            tmp            = ranking[j - 1];
+            ranking[j - 1] = ranking[j];
+            ranking[j]     = tmp;
+        }
+    }
+    ranked = true;
+}
+//! @endcond
+
+//------------------------------------------------------------------------------
+// EOF
+//------------------------------------------------------------------------------
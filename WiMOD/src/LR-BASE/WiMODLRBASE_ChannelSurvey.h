@@ -0,0 +1,157 @@
+//------------------------------------------------------------------------------
+//! @file WiMODLRBASE_ChannelSurvey.h
+//! @ingroup WiMODLR_BASE
+//! <!------------------------------------------------------------------------->
+//! @brief Declarations for a channel survey / occupancy map
+//! @version 0.1
+//! <!------------------------------------------------------------------------->
+//!
+//! Steps through a frequency plan and listens on each channel for a dwell
+//! time. The frequency is converted to the transceiver registers by the
+//! facade (SX127x for LR-BASE, SX1280 for LR-BASE PLUS) and written to the
+//! radio config in RAM; the counters of GetSystemStatus() before and after
+//! the dwell give the traffic seen on the channel:
+//!
+//! - RX packets (CRC ok) and RX CRC errors: foreign and own-network traffic
+//! - TX media busy events: LBT found the channel occupied
+//!
+//! Busy events only show up when something is sent, so optional probes
+//! (one byte U-Data to the broadcast address) can be sent during the dwell;
+//! LBT has to be enabled in the radio config for them to count. Mind the
+//! duty cycle rules of the band when using probes.
+//!
+//! Several rounds over the plan are summed up. Each channel gets a score
+//! (events per minute) and the plan is ranked from the least to the most
+//! congested channel. The original radio config is restored at the end.
+//!
+//! Works with the LR-BASE (WiMODLRBASE) and the LR-BASE PLUS firmware
+//! (WiMODLRBASE_PLUS).
+//!
+//------------------------------------------------------------------------------
+
+
+#ifndef ARDUINO_WIMODLRBASE_CHANNELSURVEY_H_
+#define ARDUINO_WIMODLRBASE_CHANNELSURVEY_H_
+
+//------------------------------------------------------------------------------
+//
+// Section Includes Files
+//
+//------------------------------------------------------------------------------
+
+#include "../WiMODLR_BASE.h"
+#include "../WiMODLR_BASE_PLUS.h"
+
+//------------------------------------------------------------------------------
+//
+// Section defines
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+#define WIMOD_SURVEY_DEFAULT_DWELL                  2000                        // ms per channel and round
+#define WIMOD_SURVEY_DEFAULT_ROUNDS                 3
+#define WIMOD_SURVEY_MIN_DWELL                      20                          // ms
+
+#ifndef WIMOD_SURVEY_MAX_CHANNELS
+#define WIMOD_SURVEY_MAX_CHANNELS                   32
+#endif
+//! @endcond
+
+/**
+ * @brief Survey result of one channel (sum of all rounds)
+ */
+typedef struct TWiMODLR_ChannelSurveyEntry
+{
+    UINT32      Frequency;                                                      /*!< [Hz] */
+    UINT8       RfFreq_LSB;                                                     /*!< lower part of the frequency register */
+    UINT8       RfFreq_MID;                                                     /*!< mid part of the frequency register */
+    UINT8       RfFreq_MSB;                                                     /*!< high part of the frequency register */
+    UINT32      RxPackets;                                                      /*!< received packets with CRC ok */
+    UINT32      RxAddressMatch;                                                 /*!< received packets for this node */
+    UINT32      RxCRCError;                                                     /*!< received packets with CRC error */
+    UINT32      TxPackets;                                                      /*!< probes sent */
+    UINT32      TxMediaBusy;                                                    /*!< probes blocked by LBT */
+    UINT32      DwellMs;                                                        /*!< listening time */
+    UINT32      Score;                                                          /*!< RX + CRC errors + busy per minute */
+} TWiMODLR_ChannelSurveyEntry;
+
+
+//------------------------------------------------------------------------------
+//
+// Section class
+//
+//------------------------------------------------------------------------------
+
+/**
+ * @brief Channel survey for RadioLink
+ *
+ * Call Process() from the main loop; all HCI commands are issued from there.
+ * The module must not be used for anything else while the survey is running.
+ */
+class WiMODLRBASE_ChannelSurvey {
+public:
+    WiMODLRBASE_ChannelSurvey(WiMODLRBASE& wimod);
+    WiMODLRBASE_ChannelSurvey(WiMODLRBASE_PLUS& wimod);
+    ~WiMODLRBASE_ChannelSurvey(void);
+
+    void        ClearPlan(void);
+    bool        AddChannel(UINT32 frequency);
+    UINT8       AddChannels(UINT32 firstFrequency, UINT32 spacing, UINT8 count);
+    void        SetDwell(UINT16 dwellMs, UINT8 rounds);
+    void        SetProbes(UINT8 probesPerDwell);
+
+    bool        Start(void);
+    bool        Process(void);
+    void        Abort(void);
+    bool        IsRunning(void);
+
+    UINT8       GetNumChannels(void);
+    const TWiMODLR_ChannelSurveyEntry* GetChannel(UINT8 index);
+    const TWiMODLR_ChannelSurveyEntry* GetRanked(UINT8 rank);
+    UINT32      GetBestFrequency(void);
+    void        PrintResults(Stream& s);
+
+protected:
+    //! @cond Doxygen_Suppress
+    typedef enum TSurveyState
+    {
+        Survey_Idle = 0,
+        Survey_Tune,
+        Survey_Listen,
+    } TSurveyState;
+
+    void        init(void);
+    bool        tune(const TWiMODLR_ChannelSurveyEntry* channel);
+    void        restore(void);
+    bool        readCounters(TWiMODLR_DevMgmt_SystemStatus* status);
+    bool        sendProbe(void);
+    void        rank(void);
+    //! @endcond
+private:
+    //! @cond Doxygen_Suppress
+    WiMODLRBASE*                    wimod;
+    WiMODLRBASE_PLUS*               wimodPlus;
+    TWiMODLR_DevMgmt_RadioConfig    baseCfg;
+    TWiMODLR_DevMgmt_RadioConfigPlus baseCfgPlus;
+    TWiMODLR_DevMgmt_SystemStatus   counters;                                   // snapshot at the start of the dwell
+
+    TWiMODLR_ChannelSurveyEntry     channels[WIMOD_SURVEY_MAX_CHANNELS];
+    UINT8                           ranking[WIMOD_SURVEY_MAX_CHANNELS];         // channel indices, least congested first
+    UINT8                           numChannels;
+
+    UINT16                          dwellMs;
+    UINT8                           rounds;
+    UINT8                           probes;
+
+    TSurveyState                    state;
+    UINT8                           current;
+    UINT8                           round;
+    UINT8                           probesSent;
+    UINT32                          listenTime;                                 // millis() at the start of the dwell
+    bool                            ranked;
+    //! @endcond
+};
+
+
+#endif /* ARDUINO_WIMODLRBASE_CHANNELSURVEY_H_ */
@@ -0,0 +1,213 @@
+//------------------------------------------------------------------------------
+//! @file WiMODLRBASE_ConfigApply.cpp
+//! @ingroup WiMODLR_BASE
+//! <!------------------------------------------------------------------------->
+//! @brief Desired state radio config helper for the LR-BASE firmware
+//! @version 0.1
+//! <!------------------------------------------------------------------------->
+//!
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+//
+// Section Includes Files
+//
+//------------------------------------------------------------------------------
+
+#include "WiMODLRBASE_ConfigApply.h"
+
+#include <string.h>
+
+//------------------------------------------------------------------------------
+//
+// Section public functions
+//
+//------------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Constructor
+ *
+ * @param wimod     reference to the LR-BASE interface
+ */
+WiMODLRBASE_ConfigApply::WiMODLRBASE_ConfigApply(WiMODLRBASE& wimod) :
+    wimod(wimod)
+{
+    store = DevMgmt_ConfigStore_NVM;
+    Clear();
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Destructor
+ */
+WiMODLRBASE_ConfigApply::~WiMODLRBASE_ConfigApply(void)
+{
+
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Removes all declared fields
+ */
+void WiMODLRBASE_ConfigApply::Clear(void)
+{
+    memset(&radioCfg, 0x00, sizeof(radioCfg));
+    fieldMask  = 0;
+    diffFields = 0;
+    numWrites  = 0;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Selects the target memory of the radio config write
+ *
+ * @param store     DevMgmt_ConfigStore_RAM or DevMgmt_ConfigStore_NVM
+ */
+void WiMODLRBASE_ConfigApply::SetStore(TWiMODLR_DevMgmt_ConfigStore store)
+{
+    this->store = store;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Declares the desired values of the radio config
+ *
+ * @param radioCfg  struct holding the desired values
+ *
+ * @param fields    LRBASE_CFG_FIELD_* flags of the fields to enforce
+ */
+void WiMODLRBASE_ConfigApply::SetRadioConfig(const TWiMODLR_DevMgmt_RadioConfig& radioCfg,
+                                             UINT32 fields)
+{
+    this->radioCfg = radioCfg;
+    fieldMask      = fields & LRBASE_CFG_FIELDS_ALL;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Brings the radio config of the module into the declared state
+ *
+ * The radio config is read once; SetRadioConfig is only called if at least
+ * one declared field differs.
+ *
+ * @param hciResult Result of the failing (or last) local command transmission
+ *                  This is an optional parameter.
+ *
+ * @param rspStatus Status byte of the failing (or last) response
+ *                  This is an optional parameter.
+ *
+ * @retval true     if the module is in the declared state
+ */
+bool WiMODLRBASE_ConfigApply::Apply(TWiMODLRResultCodes* hciResult, UINT8* rspStatus)
+{
+    TWiMODLR_DevMgmt_RadioConfig current;
+
+    diffFields = 0;
+    numWrites  = 0;
+
+    if (fieldMask == 0) {
+        return true;
+    }
+
+    if (!wimod.GetRadioConfig(&current, hciResult, rspStatus)) {
+        return false;
+    }
+
+    diffFields = diff(current) & fieldMask;
+    if (diffFields == 0) {
+        return true;
+    }
+
+    merge(current, diffFields);
+    current.StoreNwmFlag = (UINT8) store;
+
+    numWrites++;
+    return wimod.SetRadioConfig(&current, hciResult, rspStatus);
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the LRBASE_CFG_FIELD_* flags that differed during the last Apply()
+ */
+UINT32 WiMODLRBASE_ConfigApply::GetDiffFields(void)
+{
+    return diffFields;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the number of set commands issued by the last Apply()
+ */
+UINT8 WiMODLRBASE_ConfigApply::GetNumWrites(void)
+{
+    return numWrites;
+}
+
+//------------------------------------------------------------------------------
+//
+// Section protected functions
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+UINT32 WiMODLRBASE_ConfigApply::diff(const TWiMODLR_DevMgmt_RadioConfig& current)
+{
+    UINT32 fields = 0;
+
+    if (current.RadioMode != radioCfg.RadioMode)                     fields |= LRBASE_CFG_FIELD_RADIO_MODE;
+    if (current.GroupAddress != radioCfg.GroupAddress)               fields |= LRBASE_CFG_FIELD_GROUP_ADDRESS;
+    if (current.TxGroupAddress != radioCfg.TxGroupAddress)           fields |= LRBASE_CFG_FIELD_TX_GROUP_ADDRESS;
+    if (current.DeviceAddress != radioCfg.DeviceAddress)             fields |= LRBASE_CFG_FIELD_DEVICE_ADDRESS;
+    if (current.TxDeviceAddress != radioCfg.TxDeviceAddress)         fields |= LRBASE_CFG_FIELD_TX_DEVICE_ADDRESS;
+    if (current.Modulation != radioCfg.Modulation)                   fields |= LRBASE_CFG_FIELD_MODULATION;
+    if ((current.RfFreq_LSB != radioCfg.RfFreq_LSB)
+            || (current.RfFreq_MID != radioCfg.RfFreq_MID)
+            || (current.RfFreq_MSB != radioCfg.RfFreq_MSB))          fields |= LRBASE_CFG_FIELD_RF_FREQ;
+    if (current.LoRaBandWidth != radioCfg.LoRaBandWidth)             fields |= LRBASE_CFG_FIELD_LORA_BANDWIDTH;
+    if (current.LoRaSpreadingFactor != radioCfg.LoRaSpreadingFactor) fields |= LRBASE_CFG_FIELD_LORA_SF;
+    if (current.ErrorCoding != radioCfg.ErrorCoding)                 fields |= LRBASE_CFG_FIELD_ERROR_CODING;
+    if (current.PowerLevel != radioCfg.PowerLevel)                   fields |= LRBASE_CFG_FIELD_POWER_LEVEL;
+    if (current.TxControl != radioCfg.TxControl)                     fields |= LRBASE_CFG_FIELD_TX_CONTROL;
+    if (current.RxControl != radioCfg.RxControl)                     fields |= LRBASE_CFG_FIELD_RX_CONTROL;
+    if (current.RxWindowTime != radioCfg.RxWindowTime)               fields |= LRBASE_CFG_FIELD_RX_WINDOW_TIME;
+    if (current.LedControl != radioCfg.LedControl)                   fields |= LRBASE_CFG_FIELD_LED_CONTROL;
+    if (current.MiscOptions != radioCfg.MiscOptions)                 fields |= LRBASE_CFG_FIELD_MISC_OPTIONS;
+    if (current.FskDatarate != radioCfg.FskDatarate)                 fields |= LRBASE_CFG_FIELD_FSK_DATARATE;
+    if (current.PowerSavingMode != radioCfg.PowerSavingMode)         fields |= LRBASE_CFG_FIELD_POWER_SAVING;
+    if (current.LbtThreshold != radioCfg.LbtThreshold)               fields |= LRBASE_CFG_FIELD_LBT_THRESHOLD;
+
+    return fields;
+}
+
+void WiMODLRBASE_ConfigApply::merge(TWiMODLR_DevMgmt_RadioConfig& current, UINT32 fields)
+{
+    if (fields & LRBASE_CFG_FIELD_RADIO_MODE)        current.RadioMode           = radioCfg.RadioMode;
+    if (fields & LRBASE_CFG_FIELD_GROUP_ADDRESS)     current.GroupAddress        = radioCfg.GroupAddress;
+    if (fields & LRBASE_CFG_FIELD_TX_GROUP_ADDRESS)  current.TxGroupAddress      = radioCfg.TxGroupAddress;
+    if (fields & LRBASE_CFG_FIELD_DEVICE_ADDRESS)    current.DeviceAddress       = radioCfg.DeviceAddress;
+    if (fields & LRBASE_CFG_FIELD_TX_DEVICE_ADDRESS) current.TxDeviceAddress     = radioCfg.TxDeviceAddress;
+    if (fields & LRBASE_CFG_FIELD_MODULATION)        current.Modulation          = radioCfg.Modulation;
+    if (fields & LRBASE_CFG_FIELD_RF_FREQ) {
+        current.RfFreq_LSB = radioCfg.RfFreq_LSB;
+        current.RfFreq_MID = radioCfg.RfFreq_MID;
+        current.RfFreq_MSB = radioCfg.RfFreq_MSB;
+    }
+    if (fields & LRBASE_CFG_FIELD_LORA_BANDWIDTH)    current.LoRaBandWidth       = radioCfg.LoRaBandWidth;
+    if (fields & LRBASE_CFG_FIELD_LORA_SF)           current.LoRaSpreadingFactor = radioCfg.LoRaSpreadingFactor;
+    if (fields & LRBASE_CFG_FIELD_ERROR_CODING)      current.ErrorCoding         = radioCfg.ErrorCoding;
+    if (fields & LRBASE_CFG_FIELD_POWER_LEVEL)       current.PowerLevel          = radioCfg.PowerLevel;
+    if (fields & LRBASE_CFG_FIELD_TX_CONTROL)        current.TxControl           = radioCfg.TxControl;
+    if (fields & LRBASE_CFG_FIELD_RX_CONTROL)        current.RxControl           = radioCfg.RxControl;
+    if (fields & LRBASE_CFG_FIELD_RX_WINDOW_TIME)    current.RxWindowTime        = radioCfg.RxWindowTime;
+    if (fields & LRBASE_CFG_FIELD_LED_CONTROL)       current.LedControl          = radioCfg.LedControl;
+    if (fields & LRBASE_CFG_FIELD_MISC_OPTIONS)      current.MiscOptions         = radioCfg.MiscOptions;
+    if (fields & LRBASE_CFG_FIELD_FSK_DATARATE)      current.FskDatarate         = radioCfg.FskDatarate;
+    if (fields & LRBASE_CFG_FIELD_POWER_SAVING)      current.PowerSavingMode     = radioCfg.PowerSavingMode;
+    if (fields & LRBASE_CFG_FIELD_LBT_THRESHOLD)     current.LbtThreshold        = radioCfg.LbtThreshold;
+}
+//! @endcond
+
+//------------------------------------------------------------------------------
+// EOF
+//------------------------------------------------------------------------------
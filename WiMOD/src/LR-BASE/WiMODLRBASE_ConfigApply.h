@@ -0,0 +1,108 @@
+//------------------------------------------------------------------------------
+//! @file WiMODLRBASE_ConfigApply.h
+//! @ingroup WiMODLR_BASE
+//! <!------------------------------------------------------------------------->
+//! @brief Declarations for a desired state radio config helper of the LR-BASE firmware
+//! @version 0.1
+//! <!------------------------------------------------------------------------->
+//!
+//! Counterpart of WiMODLoRaWAN_ConfigApply for the RadioLink configuration of
+//! the LR-BASE firmware: the radio config is read once, compared field by
+//! field and only written if a declared field differs.
+//!
+//------------------------------------------------------------------------------
+
+
+#ifndef ARDUINO_WIMODLRBASE_CONFIGAPPLY_H_
+#define ARDUINO_WIMODLRBASE_CONFIGAPPLY_H_
+
+//------------------------------------------------------------------------------
+//
+// Section Includes Files
+//
+//------------------------------------------------------------------------------
+
+#include "../WiMODLR_BASE.h"
+
+//------------------------------------------------------------------------------
+//
+// Section defines
+//
+//------------------------------------------------------------------------------
+
+/*
+ * field flags of TWiMODLR_DevMgmt_RadioConfig
+ */
+#define LRBASE_CFG_FIELD_RADIO_MODE                 0x00000001                  /*!< RadioMode */
+#define LRBASE_CFG_FIELD_GROUP_ADDRESS              0x00000002                  /*!< GroupAddress */
+#define LRBASE_CFG_FIELD_TX_GROUP_ADDRESS           0x00000004                  /*!< TxGroupAddress */
+#define LRBASE_CFG_FIELD_DEVICE_ADDRESS             0x00000008                  /*!< DeviceAddress */
+#define LRBASE_CFG_FIELD_TX_DEVICE_ADDRESS          0x00000010                  /*!< TxDeviceAddress */
+#define LRBASE_CFG_FIELD_MODULATION                 0x00000020                  /*!< Modulation */
+#define LRBASE_CFG_FIELD_RF_FREQ                    0x00000040                  /*!< RfFreq_LSB / MID / MSB */
+#define LRBASE_CFG_FIELD_LORA_BANDWIDTH             0x00000080                  /*!< LoRaBandWidth */
+#define LRBASE_CFG_FIELD_LORA_SF                    0x00000100                  /*!< LoRaSpreadingFactor */
+#define LRBASE_CFG_FIELD_ERROR_CODING               0x00000200                  /*!< ErrorCoding */
+#define LRBASE_CFG_FIELD_POWER_LEVEL                0x00000400                  /*!< PowerLevel */
+#define LRBASE_CFG_FIELD_TX_CONTROL                 0x00000800                  /*!< TxControl */
+#define LRBASE_CFG_FIELD_RX_CONTROL                 0x00001000                  /*!< RxControl */
+#define LRBASE_CFG_FIELD_RX_WINDOW_TIME             0x00002000                  /*!< RxWindowTime */
+#define LRBASE_CFG_FIELD_LED_CONTROL                0x00004000                  /*!< LedControl */
+#define LRBASE_CFG_FIELD_MISC_OPTIONS               0x00008000                  /*!< MiscOptions */
+#define LRBASE_CFG_FIELD_FSK_DATARATE               0x00010000                  /*!< FskDatarate */
+#define LRBASE_CFG_FIELD_POWER_SAVING               0x00020000                  /*!< PowerSavingMode */
+#define LRBASE_CFG_FIELD_LBT_THRESHOLD              0x00040000                  /*!< LbtThreshold */
+
+//! @cond Doxygen_Suppress
+#define LRBASE_CFG_FIELDS_ALL                       0x0007FFFF
+//! @endcond
+
+
+//------------------------------------------------------------------------------
+//
+// Section class
+//
+//------------------------------------------------------------------------------
+
+/**
+ * @brief Desired state radio config helper for the LR-BASE firmware
+ *
+ * Only declared fields are enforced; all other fields keep the value that
+ * is read from the module. The StoreNwmFlag of the write is taken from
+ * SetStore(), so a temporary change (e.g. a test channel) does not cost an
+ * NVM write cycle.
+ */
+class WiMODLRBASE_ConfigApply {
+public:
+    WiMODLRBASE_ConfigApply(WiMODLRBASE& wimod);
+    ~WiMODLRBASE_ConfigApply(void);
+
+    void        Clear(void);
+    void        SetStore(TWiMODLR_DevMgmt_ConfigStore store);
+    void        SetRadioConfig(const TWiMODLR_DevMgmt_RadioConfig& radioCfg,
+                               UINT32 fields = LRBASE_CFG_FIELDS_ALL);
+
+    bool        Apply(TWiMODLRResultCodes* hciResult = NULL, UINT8* rspStatus = NULL);
+
+    UINT32      GetDiffFields(void);
+    UINT8       GetNumWrites(void);
+
+protected:
+    //! @cond Doxygen_Suppress
+    UINT32      diff(const TWiMODLR_DevMgmt_RadioConfig& current);
+    void        merge(TWiMODLR_DevMgmt_RadioConfig& current, UINT32 fields);
+    //! @endcond
+private:
+    //! @cond Doxygen_Suppress
+    WiMODLRBASE&                    wimod;
+
+    TWiMODLR_DevMgmt_RadioConfig    radioCfg;
+    UINT32                          fieldMask;
+    UINT32                          diffFields;
+    TWiMODLR_DevMgmt_ConfigStore    store;
+    UINT8                           numWrites;
+    //! @endcond
+};
+
+
+#endif /* ARDUINO_WIMODLRBASE_CONFIGAPPLY_H_ */
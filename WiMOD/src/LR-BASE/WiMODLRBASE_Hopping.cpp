@@ -0,0 +1,750 @@
+//------------------------------------------------------------------------------
+//! @file WiMODLRBASE_Hopping.cpp
+//! @ingroup WiMODLR_BASE
+//! <!------------------------------------------------------------------------->
+//! @brief Pseudo-random frequency hopping scheduler
+//! @version 0.1
+//! <!------------------------------------------------------------------------->
+//!
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+//
+// Section Includes Files
+//
+//------------------------------------------------------------------------------
+
+#include "WiMODLRBASE_Hopping.h"
+
+#include <string.h>
+
+//------------------------------------------------------------------------------
+//
+// Section defines
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+#define HOP_RENDEZVOUS_CHANNEL                      0
+#define HOP_NO_CHANNEL                              0xFF
+//! @endcond
+
+//------------------------------------------------------------------------------
+//
+// Section public functions
+//
+//------------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Constructor
+ *
+ * @param wimod     reference to the LR-BASE interface
+ */
+WiMODLRBASE_Hopping::WiMODLRBASE_Hopping(WiMODLRBASE& wimod)
+{
+    init();
+    this->wimod = &wimod;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Constructor
+ *
+ * @param wimod     reference to the LR-BASE PLUS interface
+ */
+WiMODLRBASE_Hopping::WiMODLRBASE_Hopping(WiMODLRBASE_PLUS& wimod)
+{
+    init();
+    this->wimodPlus = &wimod;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Destructor
+ */
+WiMODLRBASE_Hopping::~WiMODLRBASE_Hopping(void)
+{
+
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Removes all channels
+ */
+void WiMODLRBASE_Hopping::ClearChannels(void)
+{
+    if (!running) {
+        numChannels = 0;
+    }
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Adds a channel to the hop table
+ *
+ * The first channel is the rendezvous channel. The register values are
+ * computed here, once.
+ *
+ * @param frequency     center frequency [Hz]
+ *
+ * @retval true     if the channel has been added
+ */
+bool WiMODLRBASE_Hopping::AddChannel(UINT32 frequency)
+{
+    TWiMODLR_HopChannel* channel;
+
+    if (running || (numChannels >= WIMOD_HOP_MAX_CHANNELS)) {
+        return false;
+    }
+
+    channel = &channels[numChannels++];
+    memset(channel, 0x00, sizeof(TWiMODLR_HopChannel));
+    channel->Frequency = frequency;
+    if (wimod) {
+        wimod->calcFreqToRegister(frequency, &channel->RfFreq_MSB, &channel->RfFreq_MID, &channel->RfFreq_LSB);
+    } else {
+        wimodPlus->calcFreqToRegister(frequency, &channel->RfFreq_MSB, &channel->RfFreq_MID, &channel->RfFreq_LSB);
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Sets the shared hop sequence
+ *
+ * @param seed      seed of the channel permutation; same on all peers
+ *
+ * @param mode      hop per dwell period or per frame
+ *
+ * @param dwellMs   dwell period [ms] (Hop_PerDwell only)
+ */
+void WiMODLRBASE_Hopping::SetSequence(UINT32 seed, TWiMODLR_HopMode mode, UINT16 dwellMs)
+{
+    if (!running) {
+        this->seed    = seed;
+        this->mode    = mode;
+        this->dwellMs = MAX(dwellMs, 1);
+    }
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Selects the leader role (default: follower)
+ */
+void WiMODLRBASE_Hopping::SetLeader(bool leader)
+{
+    if (!running) {
+        this->leader = leader;
+    }
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Sets the rendezvous fallback
+ *
+ * @param timeoutMs     follower: silence until it parks on the rendezvous
+ *                      channel; leader: time it keeps sending there
+ *
+ * @param maxFailures   leader: C-Data ack timeouts in a row until it falls back
+ */
+void WiMODLRBASE_Hopping::SetSyncTimeout(UINT16 timeoutMs, UINT8 maxFailures)
+{
+    syncTimeout       = timeoutMs;
+    this->maxFailures = MAX(maxFailures, 1);
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Sets the blacklist rule of the leader
+ *
+ * @param busyPercent   (LBT rejects + ack timeouts) / attempts that
+ *                      blacklist a channel; 0 disables the blacklist
+ *
+ * @param minSamples    attempts needed before a channel is judged
+ *
+ * @param holdMs        time a channel stays blacklisted
+ */
+void WiMODLRBASE_Hopping::SetBlacklist(UINT8 busyPercent, UINT8 minSamples, UINT32 holdMs)
+{
+    this->busyPercent = busyPercent;
+    this->minSamples  = MAX(minSamples, 1);
+    this->holdMs      = holdMs;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Registers the callback for received payload
+ *
+ * The callback gets the received message and the payload behind the hop
+ * header.
+ */
+void WiMODLRBASE_Hopping::RegisterDataClient(THopDataCallback cb)
+{
+    dataCallback = cb;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Starts hopping
+ *
+ * The current radio config is the base for all channels. The leader starts
+ * at hop 0, a follower on the rendezvous channel until it hears the leader.
+ *
+ * @retval true     if the first channel has been tuned
+ */
+bool WiMODLRBASE_Hopping::Start(void)
+{
+    UINT8 i;
+    bool  ok;
+
+    if (running || (numChannels == 0)) {
+        return false;
+    }
+
+    ok = wimod ? wimod->GetRadioConfig(&baseCfg) : wimodPlus->GetRadioConfig(&baseCfgPlus);
+    if (!ok) {
+        return false;
+    }
+
+    for (i = 0; i < numChannels; i++) {
+        channels[i].Attempts      = 0;
+        channels[i].Busy          = 0;
+        channels[i].Failures      = 0;
+        channels[i].BlacklistTime = 0;
+    }
+    shuffle();
+
+    blacklist      = 0;
+    nextBlacklist  = 0;
+    announced      = 0;
+    hop            = 0;
+    epoch          = millis();
+    lastRx         = epoch - WIMOD_HOP_ACK_GUARD;
+    synced         = leader;
+    tuned          = HOP_NO_CHANNEL;
+    failures       = 0;
+    probeNext      = false;
+    inRendezvous   = false;
+    awaitingAck    = false;
+    running        = true;
+
+    Process();
+    return tuned != HOP_NO_CHANNEL;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Stops hopping and restores the base config
+ */
+void WiMODLRBASE_Hopping::Stop(void)
+{
+    if (running) {
+        restore();
+        running     = false;
+        awaitingAck = false;
+    }
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Follows the hop sequence; call from the main loop
+ *
+ * The channel is not changed while a C-Data ack is outstanding or shortly
+ * after a reception (the module may still send the ack).
+ *
+ * @retval true     while hopping is active
+ */
+bool WiMODLRBASE_Hopping::Process(void)
+{
+    UINT32 now = millis();
+    UINT16 phase;
+    UINT8  target;
+
+    if (!running) {
+        return false;
+    }
+
+    if (leader) {
+        if (inRendezvous && (now - rendezvousTime >= syncTimeout)) {
+            inRendezvous = false;
+        }
+        updateBlacklist(now);
+    } else if (synced && (now - lastRx >= syncTimeout)) {
+        synced = false;
+        stats.SyncLost++;
+    }
+
+    if ((leader && inRendezvous) || (!leader && !synced)) {
+        target = HOP_RENDEZVOUS_CHANNEL;
+    } else {
+        target = channelOf(hopAt(now, &phase));
+    }
+
+    if ((target != tuned) && !awaitingAck && (now - lastRx >= WIMOD_HOP_ACK_GUARD)) {
+        tune(target);
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Sends a frame on the current hop
+ *
+ * A rejected frame (LBT, busy module) is not queued; call again later.
+ * In Hop_PerPacket mode the leader moves to the next hop once the frame is
+ * out (U-Data) or acked (C-Data).
+ *
+ * @param dstGroup      destination group address
+ *
+ * @param dstDevice     destination device address
+ *
+ * @param data          payload
+ *
+ * @param length        payload length (max. WIMOD_HOP_PAYLOAD_LEN)
+ *
+ * @param confirmed     send as C-Data
+ *
+ * @retval true     if the frame has been accepted by the module
+ */
+bool WiMODLRBASE_Hopping::Send(UINT8 dstGroup, UINT16 dstDevice, const UINT8* data, UINT8 length,
+                               bool confirmed, TWiMODLRResultCodes* hciResult, UINT8* rspStatus)
+{
+    TWiMODLRResultCodes localHciRes    = WiMODLR_RESULT_TRANMIT_ERROR;
+    UINT8               localStatusRsp = 0;
+    UINT16              phase = 0;
+    UINT16              curHop;
+    bool                busy;
+    bool                ok;
+
+    if (!running || awaitingAck || (length > WIMOD_HOP_PAYLOAD_LEN) || (!data && length)) {
+        return false;
+    }
+
+    Process();
+    if (tuned == HOP_NO_CHANNEL) {
+        return false;
+    }
+
+    curHop = hopAt(millis(), &phase);
+
+    txMsg.DestinationGroupAddress  = dstGroup;
+    txMsg.DestinationDeviceAddress = dstDevice;
+    txMsg.Payload[0] = WIMOD_HOP_FRAME_ID;
+    HTON16(&txMsg.Payload[1], curHop);
+    HTON16(&txMsg.Payload[3], phase);
+    HTON32(&txMsg.Payload[5], leader ? nextBlacklist : blacklist);
+    if (length) {
+        memcpy(&txMsg.Payload[WIMOD_HOP_HEADER_SIZE], data, length);
+    }
+    txMsg.Length = WIMOD_HOP_HEADER_SIZE + length;
+
+    if (wimod) {
+        ok = confirmed ? wimod->SendCData(&txMsg, &localHciRes, &localStatusRsp)
+                       : wimod->SendUData(&txMsg, &localHciRes, &localStatusRsp);
+    } else {
+        ok = confirmed ? wimodPlus->SendCData(&txMsg, &localHciRes, &localStatusRsp)
+                       : wimodPlus->SendUData(&txMsg, &localHciRes, &localStatusRsp);
+    }
+    if (hciResult) {
+        *hciResult = localHciRes;
+    }
+    if (rspStatus) {
+        *rspStatus = localStatusRsp;
+    }
+
+    busy = !ok && (localHciRes == WiMODLR_RESULT_OK)
+           && ((localStatusRsp == RADIOLINK_STATUS_MEDIA_BUSY) || (localStatusRsp == RADIOLINK_STATUS_BUFFER_FULL));
+    countAttempt(tuned, busy);
+
+    if (!ok) {
+        // nothing went on air, so the peer cannot have lost track
+        if (busy) {
+            stats.Busy++;
+        }
+        return false;
+    }
+
+    stats.Sent++;
+    announced = nextBlacklist;
+    if (confirmed) {
+        pendingChannel = tuned;
+        awaitingAck    = true;
+    } else {
+        delivered();
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Processes a received U-Data / C-Data frame
+ *
+ * A follower takes hop, phase and blacklist of the frame.
+ *
+ * @retval true     if the frame was a hop frame
+ */
+bool WiMODLRBASE_Hopping::ProcessRxData(const TWiMODLR_RadioLink_Msg& rxMsg)
+{
+    UINT32 now = millis();
+    UINT16 rxHop;
+    UINT16 rxPhase;
+    UINT16 phase;
+
+    if ((rxMsg.Length < WIMOD_HOP_HEADER_SIZE) || (rxMsg.Payload[0] != WIMOD_HOP_FRAME_ID)) {
+        return false;
+    }
+
+    rxHop   = NTOH16(&rxMsg.Payload[1]);
+    rxPhase = NTOH16(&rxMsg.Payload[3]);
+    stats.Received++;
+    lastRx = now;
+
+    if (!leader) {
+        if (synced && (hopAt(now, &phase) != rxHop)) {
+            stats.Resyncs++;
+        }
+        if (mode == Hop_PerPacket) {
+            hop = rxHop + 1;
+        } else {
+            epoch = now - ((UINT32) rxHop * dwellMs + MIN(rxPhase, dwellMs - 1));
+        }
+        blacklist     = NTOH32(&rxMsg.Payload[5]);
+        nextBlacklist = blacklist;
+        synced        = true;
+    }
+
+    if (dataCallback) {
+        dataCallback(rxMsg, &rxMsg.Payload[WIMOD_HOP_HEADER_SIZE], rxMsg.Length - WIMOD_HOP_HEADER_SIZE);
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Processes the RX Ack indication of a C-Data frame
+ */
+void WiMODLRBASE_Hopping::ProcessAck(void)
+{
+    if (awaitingAck) {
+        awaitingAck  = false;
+        inRendezvous = false;
+        delivered();
+    }
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Processes the Ack Timeout indication of a C-Data frame
+ */
+void WiMODLRBASE_Hopping::ProcessAckTimeout(void)
+{
+    UINT32 now = millis();
+
+    if (!awaitingAck) {
+        return;
+    }
+    awaitingAck = false;
+    stats.AckTimeouts++;
+    if (pendingChannel < numChannels) {
+        channels[pendingChannel].Failures++;
+    }
+    // per packet: the frame or only its ack may be lost, so the peer waits
+    // on this hop or the next one; alternate between both
+    if (leader && (mode == Hop_PerPacket)) {
+        if (probeNext) {
+            hop--;
+        } else {
+            hop++;
+        }
+        probeNext = !probeNext;
+    }
+    failed(now);
+    updateBlacklist(now);
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the number of channels of the hop table
+ */
+UINT8 WiMODLRBASE_Hopping::GetNumChannels(void)
+{
+    return numChannels;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns a channel of the hop table or NULL
+ */
+const TWiMODLR_HopChannel* WiMODLRBASE_Hopping::GetChannel(UINT8 index)
+{
+    return (index < numChannels) ? &channels[index] : NULL;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the active blacklist (bit n: channel n avoided)
+ */
+UINT32 WiMODLRBASE_Hopping::GetBlacklist(void)
+{
+    return blacklist;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the tuned channel (index of the table) or 0xFF
+ */
+UINT8 WiMODLRBASE_Hopping::GetCurrentChannel(void)
+{
+    return tuned;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns true if the node follows the hop sequence
+ *
+ * Always true for the leader; a follower is synced after it heard a frame
+ * and until the sync timeout.
+ */
+bool WiMODLRBASE_Hopping::IsSynced(void)
+{
+    return running && synced;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Copies the counters of the scheduler
+ */
+void WiMODLRBASE_Hopping::GetStats(TWiMODLR_HopStats* stats)
+{
+    if (stats) {
+        memcpy(stats, &this->stats, sizeof(TWiMODLR_HopStats));
+    }
+}
+
+//------------------------------------------------------------------------------
+//
+// Section protected functions
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+void WiMODLRBASE_Hopping::init(void)
+{
+    wimod          = NULL;
+    wimodPlus      = NULL;
+    memset(&baseCfg, 0x00, sizeof(baseCfg));
+    memset(&baseCfgPlus, 0x00, sizeof(baseCfgPlus));
+    memset(&txMsg, 0x00, sizeof(txMsg));
+    memset(&stats, 0x00, sizeof(stats));
+
+    numChannels    = 0;
+    blacklist      = 0;
+    nextBlacklist  = 0;
+    announced      = 0;
+    seed           = 0;
+    mode           = Hop_PerDwell;
+    dwellMs        = WIMOD_HOP_DEFAULT_DWELL;
+    leader         = false;
+    syncTimeout    = WIMOD_HOP_DEFAULT_SYNC_TIMEOUT;
+    maxFailures    = WIMOD_HOP_DEFAULT_MAX_FAILURES;
+    busyPercent    = WIMOD_HOP_DEFAULT_BUSY_PERCENT;
+    minSamples     = WIMOD_HOP_DEFAULT_MIN_SAMPLES;
+    holdMs         = WIMOD_HOP_DEFAULT_HOLD_TIME;
+
+    running        = false;
+    synced         = false;
+    hop            = 0;
+    epoch          = 0;
+    tuned          = HOP_NO_CHANNEL;
+    failures       = 0;
+    probeNext      = false;
+    inRendezvous   = false;
+    rendezvousTime = 0;
+    lastRx         = 0;
+    pendingChannel = 0;
+    awaitingAck    = false;
+    dataCallback   = NULL;
+}
+
+// Fisher-Yates with xorshift32; identical on all peers for the same seed
+void WiMODLRBASE_Hopping::shuffle(void)
+{
+    UINT32 x = seed ? seed : 0x2545F491;
+    UINT8  i, j, tmp;
+
+    for (i = 0; i < numChannels; i++) {
+        sequence[i] = i;
+    }
+    for (i = numChannels - 1; i > 0; i--) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        j = (UINT8) (x % (i + 1));
+        tmp         = sequence[i];
+        sequence[i] = sequence[j];
+        sequence[j] = tmp;
+    }
+}
+
+// channel of a hop; blacklisted entries move on to the next usable one
+UINT8 WiMODLRBASE_Hopping::channelOf(UINT16 hop)
+{
+    UINT8 start = (UINT8) (hop % numChannels);
+    UINT8 i, channel;
+
+    for (i = 0; i < numChannels; i++) {
+        channel = sequence[(start + i) % numChannels];
+        if (!(blacklist & (1UL << channel))) {
+            return channel;
+        }
+    }
+    return sequence[start];
+}
+
+UINT16 WiMODLRBASE_Hopping::hopAt(UINT32 now, UINT16* phase)
+{
+    UINT32 elapsed;
+
+    if (mode == Hop_PerPacket) {
+        *phase = 0;
+        return hop;
+    }
+    elapsed = now - epoch;
+    *phase  = (UINT16) (elapsed % dwellMs);
+    return (UINT16) (elapsed / dwellMs);
+}
+
+// writes the frequency of the channel to the radio config (RAM only)
+bool WiMODLRBASE_Hopping::tune(UINT8 channel)
+{
+    const TWiMODLR_HopChannel* c = &channels[channel];
+    bool                       ok;
+
+    if (wimod) {
+        TWiMODLR_DevMgmt_RadioConfig cfg;
+
+        memcpy(&cfg, &baseCfg, sizeof(cfg));
+        cfg.StoreNwmFlag = 0;
+        cfg.RfFreq_LSB   = c->RfFreq_LSB;
+        cfg.RfFreq_MID   = c->RfFreq_MID;
+        cfg.RfFreq_MSB   = c->RfFreq_MSB;
+        ok = wimod->SetRadioConfig(&cfg);
+    } else {
+        TWiMODLR_DevMgmt_RadioConfigPlus cfg;
+
+        memcpy(&cfg, &baseCfgPlus, sizeof(cfg));
+        cfg.StoreNwmFlag = 0;
+        cfg.RfFreq_LSB   = c->RfFreq_LSB;
+        cfg.RfFreq_MID   = c->RfFreq_MID;
+        cfg.RfFreq_MSB   = c->RfFreq_MSB;
+        ok = wimodPlus->SetRadioConfig(&cfg);
+    }
+    if (ok) {
+        tuned = channel;
+        stats.Hops++;
+    }
+    return ok;
+}
+
+void WiMODLRBASE_Hopping::restore(void)
+{
+    if (wimod) {
+        baseCfg.StoreNwmFlag = 0;
+        wimod->SetRadioConfig(&baseCfg);
+    } else {
+        baseCfgPlus.StoreNwmFlag = 0;
+        wimodPlus->SetRadioConfig(&baseCfgPlus);
+    }
+    tuned = HOP_NO_CHANNEL;
+}
+
+void WiMODLRBASE_Hopping::countAttempt(UINT8 channel, bool busy)
+{
+    TWiMODLR_HopChannel* c = &channels[channel];
+
+    c->Attempts++;
+    if (busy) {
+        c->Busy++;
+    }
+    if (c->Attempts >= WIMOD_HOP_SAMPLE_WINDOW) {
+        c->Attempts /= 2;
+        c->Busy     /= 2;
+        c->Failures /= 2;
+    }
+    if (leader) {
+        updateBlacklist(millis());
+    }
+}
+
+// leader only: blacklist channels above the busy rate, release them after
+// the hold time; changes become active with the next frame that is out
+void WiMODLRBASE_Hopping::updateBlacklist(UINT32 now)
+{
+    TWiMODLR_HopChannel* c;
+    UINT8                usable = 0;
+    UINT8                i;
+
+    if (!leader) {
+        return;
+    }
+
+    for (i = 0; i < numChannels; i++) {
+        if (!(nextBlacklist & (1UL << i))) {
+            usable++;
+        }
+    }
+
+    // the rendezvous channel stays in the sequence, so followers parked
+    // there meet the leader even without C-Data
+    for (i = HOP_RENDEZVOUS_CHANNEL + 1; i < numChannels; i++) {
+        c = &channels[i];
+        if (nextBlacklist & (1UL << i)) {
+            if (now - c->BlacklistTime >= holdMs) {
+                nextBlacklist &= ~(1UL << i);
+                c->Attempts = 0;
+                c->Busy     = 0;
+                c->Failures = 0;
+                usable++;
+            }
+        } else if ((busyPercent > 0) && (c->Attempts >= minSamples) && (usable > WIMOD_HOP_MIN_USABLE)
+                       && ((UINT32) (c->Busy + c->Failures) * 100 >= (UINT32) c->Attempts * busyPercent)) {
+            nextBlacklist |= 1UL << i;
+            c->BlacklistTime = now;
+            usable--;
+            stats.Blacklisted++;
+        }
+    }
+}
+
+// frame is out (U-Data) or acked (C-Data)
+void WiMODLRBASE_Hopping::delivered(void)
+{
+    failures = 0;
+    if (leader) {
+        // the peer knows the announced list now
+        blacklist = announced;
+        if (mode == Hop_PerPacket) {
+            hop++;
+            probeNext = false;
+        }
+    }
+}
+
+void WiMODLRBASE_Hopping::failed(UINT32 now)
+{
+    if (!leader || inRendezvous) {
+        return;
+    }
+    if (++failures >= maxFailures) {
+        failures       = 0;
+        inRendezvous   = true;
+        rendezvousTime = now;
+        stats.Rendezvous++;
+    }
+}
+//! @endcond
+
+//------------------------------------------------------------------------------
+// EOF
+//------------------------------------------------------------------------------
@@ -0,0 +1,238 @@
+//------------------------------------------------------------------------------
+//! @file WiMODLRBASE_Hopping.h
+//! @ingroup WiMODLR_BASE
+//! <!------------------------------------------------------------------------->
+//! @brief Declarations for a pseudo-random frequency hopping scheduler
+//! @version 0.1
+//! <!------------------------------------------------------------------------->
+//!
+//! The radio config pins one RF frequency; a busy channel makes LBT reject
+//! most frames. The scheduler spreads the traffic over a table of channels
+//! whose register values are computed once. Before a frame is sent (or when
+//! the dwell period ends) the frequency registers are written to the radio
+//! config in RAM (StoreNwmFlag = 0).
+//!
+//! The hop sequence is a permutation of the table, shuffled with a seed
+//! shared by all peers:
+//!
+//! - Hop_PerDwell:  hop n = (time since start) / dwell
+//! - Hop_PerPacket: hop n is incremented with every frame of the leader
+//!
+//! Per packet hopping needs C-Data from the leader to stay in step: after an
+//! ack timeout the leader alternates between the hop and the next one, as
+//! either the frame or only the ack may have been lost.
+//!
+//! One node is the leader; it decides when to hop and which channels to
+//! avoid. Every frame carries a small header with the leader's state, so
+//! followers adopt hop, dwell phase and blacklist from any frame they hear:
+//!
+//! Frame:  | 0x48 | hop (16 bit) | phase [ms] (16 bit) | blacklist (32 bit) | payload ... |
+//!
+//! The leader counts attempts and LBT rejects (MEDIA_BUSY) per channel and
+//! blacklists channels above a busy rate for a hold time. Blacklisted hops
+//! are mapped to the next usable channel of the sequence.
+//!
+//! Lost sync is recovered on the rendezvous channel (table entry 0): a
+//! follower that hears nothing for the sync timeout parks there, and the
+//! leader sends there for one sync timeout after repeated C-Data ack
+//! timeouts. The rendezvous channel is never blacklisted, so pick a quiet
+//! one (e.g. with WiMODLRBASE_ChannelSurvey).
+//!
+//! Works with the LR-BASE (WiMODLRBASE) and the LR-BASE PLUS firmware
+//! (WiMODLRBASE_PLUS).
+//!
+//------------------------------------------------------------------------------
+
+
+#ifndef ARDUINO_WIMODLRBASE_HOPPING_H_
+#define ARDUINO_WIMODLRBASE_HOPPING_H_
+
+//------------------------------------------------------------------------------
+//
+// Section Includes Files
+//
+//------------------------------------------------------------------------------
+
+#include "../WiMODLR_BASE.h"
+#include "../WiMODLR_BASE_PLUS.h"
+
+//------------------------------------------------------------------------------
+//
+// Section defines
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+#define WIMOD_HOP_FRAME_ID                          0x48
+#define WIMOD_HOP_HEADER_SIZE                       9
+#define WIMOD_HOP_PAYLOAD_LEN                       (WIMOD_RADIOLINK_PAYLOAD_LEN - WIMOD_HOP_HEADER_SIZE)
+#define WIMOD_HOP_MAX_CHANNELS                      32                          // blacklist bitmap
+
+#define WIMOD_HOP_DEFAULT_DWELL                     400                         // ms
+#define WIMOD_HOP_DEFAULT_SYNC_TIMEOUT              10000                       // ms
+#define WIMOD_HOP_DEFAULT_MAX_FAILURES              4                           // ack timeouts in a row, then rendezvous
+#define WIMOD_HOP_DEFAULT_BUSY_PERCENT              50
+#define WIMOD_HOP_DEFAULT_MIN_SAMPLES               8
+#define WIMOD_HOP_DEFAULT_HOLD_TIME                 60000                       // ms a channel stays blacklisted
+#define WIMOD_HOP_MIN_USABLE                        2                           // never blacklist below
+#define WIMOD_HOP_SAMPLE_WINDOW                     32                          // counters are halved here
+#define WIMOD_HOP_ACK_GUARD                         50                          // ms no retune after RX (ack)
+//! @endcond
+
+/**
+ * @brief When to move to the next hop
+ */
+typedef enum TWiMODLR_HopMode
+{
+    Hop_PerDwell = 0,                                                           /*!< time slotted, one hop per dwell period */
+    Hop_PerPacket,                                                              /*!< one hop per frame of the leader */
+} TWiMODLR_HopMode;
+
+/**
+ * @brief A channel of the hop table
+ *
+ * Attempts and Busy are halved every WIMOD_HOP_SAMPLE_WINDOW attempts so the
+ * busy rate follows the recent conditions.
+ */
+typedef struct TWiMODLR_HopChannel
+{
+    UINT32      Frequency;                                                      /*!< [Hz] */
+    UINT8       RfFreq_LSB;                                                     /*!< lower part of the frequency register */
+    UINT8       RfFreq_MID;                                                     /*!< mid part of the frequency register */
+    UINT8       RfFreq_MSB;                                                     /*!< high part of the frequency register */
+    UINT16      Attempts;                                                       /*!< send attempts (leader) */
+    UINT16      Busy;                                                           /*!< attempts rejected by LBT */
+    UINT16      Failures;                                                       /*!< C-Data ack timeouts */
+    UINT32      BlacklistTime;                                                  /*!< millis() of blacklisting */
+} TWiMODLR_HopChannel;
+
+/**
+ * @brief Counters of the scheduler
+ */
+typedef struct TWiMODLR_HopStats
+{
+    UINT32      Sent;                                                           /*!< frames accepted by the module */
+    UINT32      Received;                                                       /*!< hop frames received */
+    UINT32      Busy;                                                           /*!< frames rejected by LBT / busy module */
+    UINT32      AckTimeouts;                                                    /*!< C-Data ack timeouts */
+    UINT32      Hops;                                                           /*!< retunes */
+    UINT32      Resyncs;                                                        /*!< follower hop corrections */
+    UINT32      SyncLost;                                                       /*!< follower fell back to rendezvous */
+    UINT32      Rendezvous;                                                     /*!< leader fell back to rendezvous */
+    UINT32      Blacklisted;                                                    /*!< channels blacklisted */
+} TWiMODLR_HopStats;
+
+
+// C++11 check
+#ifdef WIMOD_USE_CPP11
+    /** Type definition for a 'hop payload received' callback */
+    typedef std::function<void (const TWiMODLR_RadioLink_Msg& rxMsg, const UINT8* data, UINT8 length)> THopDataCallback;
+#else
+    /** Type definition for a 'hop payload received' callback function */
+    typedef void (*THopDataCallback)(const TWiMODLR_RadioLink_Msg& rxMsg, const UINT8* data, UINT8 length);
+#endif
+
+
+//------------------------------------------------------------------------------
+//
+// Section class
+//
+//------------------------------------------------------------------------------
+
+/**
+ * @brief Pseudo-random frequency hopping for RadioLink
+ *
+ * Send through Send(); feed the converted RX U-Data / C-Data indications
+ * into ProcessRxData() and the RX Ack / Ack Timeout indications into
+ * ProcessAck() and ProcessAckTimeout(); call Process() from the main loop.
+ * All peers need the same channel table, seed, mode and dwell.
+ */
+class WiMODLRBASE_Hopping {
+public:
+    WiMODLRBASE_Hopping(WiMODLRBASE& wimod);
+    WiMODLRBASE_Hopping(WiMODLRBASE_PLUS& wimod);
+    ~WiMODLRBASE_Hopping(void);
+
+    void        ClearChannels(void);
+    bool        AddChannel(UINT32 frequency);
+    void        SetSequence(UINT32 seed, TWiMODLR_HopMode mode, UINT16 dwellMs = WIMOD_HOP_DEFAULT_DWELL);
+    void        SetLeader(bool leader);
+    void        SetSyncTimeout(UINT16 timeoutMs, UINT8 maxFailures);
+    void        SetBlacklist(UINT8 busyPercent, UINT8 minSamples, UINT32 holdMs);
+    void        RegisterDataClient(THopDataCallback cb);
+
+    bool        Start(void);
+    void        Stop(void);
+    bool        Process(void);
+
+    bool        Send(UINT8 dstGroup, UINT16 dstDevice, const UINT8* data, UINT8 length, bool confirmed = false,
+                     TWiMODLRResultCodes* hciResult = NULL, UINT8* rspStatus = NULL);
+    bool        ProcessRxData(const TWiMODLR_RadioLink_Msg& rxMsg);
+    void        ProcessAck(void);
+    void        ProcessAckTimeout(void);
+
+    UINT8       GetNumChannels(void);
+    const TWiMODLR_HopChannel* GetChannel(UINT8 index);
+    UINT32      GetBlacklist(void);
+    UINT8       GetCurrentChannel(void);
+    bool        IsSynced(void);
+    void        GetStats(TWiMODLR_HopStats* stats);
+
+protected:
+    //! @cond Doxygen_Suppress
+    void        init(void);
+    void        shuffle(void);
+    UINT8       channelOf(UINT16 hop);
+    UINT16      hopAt(UINT32 now, UINT16* phase);
+    bool        tune(UINT8 channel);
+    void        restore(void);
+    void        countAttempt(UINT8 channel, bool busy);
+    void        updateBlacklist(UINT32 now);
+    void        delivered(void);
+    void        failed(UINT32 now);
+    //! @endcond
+private:
+    //! @cond Doxygen_Suppress
+    WiMODLRBASE*                    wimod;
+    WiMODLRBASE_PLUS*               wimodPlus;
+    TWiMODLR_DevMgmt_RadioConfig    baseCfg;
+    TWiMODLR_DevMgmt_RadioConfigPlus baseCfgPlus;
+    TWiMODLR_RadioLink_Msg          txMsg;
+
+    TWiMODLR_HopChannel             channels[WIMOD_HOP_MAX_CHANNELS];
+    UINT8                           sequence[WIMOD_HOP_MAX_CHANNELS];           // shuffled channel indices
+    UINT8                           numChannels;
+    UINT32                          blacklist;                                  // bit n: channel n avoided
+    UINT32                          nextBlacklist;                              // leader: announced, not yet active
+    UINT32                          announced;                                  // leader: sent with the last frame
+
+    UINT32                          seed;
+    TWiMODLR_HopMode                mode;
+    UINT16                          dwellMs;
+    bool                            leader;
+    UINT16                          syncTimeout;
+    UINT8                           maxFailures;
+    UINT8                           busyPercent;
+    UINT8                           minSamples;
+    UINT32                          holdMs;
+
+    bool                            running;
+    bool                            synced;                                     // follower: hop known
+    UINT16                          hop;                                        // per packet: current hop
+    UINT32                          epoch;                                      // per dwell: millis() of hop 0
+    UINT8                           tuned;                                      // channel in the radio config
+    UINT8                           failures;                                   // leader: ack timeouts in a row
+    bool                            probeNext;                                  // leader: retry on hop + 1
+    bool                            inRendezvous;                               // leader: sending on the rendezvous channel
+    UINT32                          rendezvousTime;                             // leader: millis() of fallback
+    UINT32                          lastRx;                                     // follower: millis() of last frame
+    UINT8                           pendingChannel;                             // channel of the frame awaiting an ack
+    bool                            awaitingAck;
+
+    TWiMODLR_HopStats               stats;
+    THopDataCallback                dataCallback;
+    //! @endcond
+};
+
+
+#endif /* ARDUINO_WIMODLRBASE_HOPPING_H_ */
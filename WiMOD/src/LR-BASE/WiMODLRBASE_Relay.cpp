@@ -0,0 +1,612 @@
+//------------------------------------------------------------------------------
+//! @file WiMODLRBASE_Relay.cpp
+//! @ingroup WiMODLR_BASE
+//! <!------------------------------------------------------------------------->
+//! @brief Store and forward relay for RadioLink
+//! @version 0.1
+//! <!------------------------------------------------------------------------->
+//!
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+//
+// Section Includes Files
+//
+//------------------------------------------------------------------------------
+
+#include "WiMODLRBASE_Relay.h"
+
+#include <string.h>
+
+//------------------------------------------------------------------------------
+//
+// Section defines
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+#define RELAY_ROUTE_KEY(group, device)              (((UINT32) (group) << 16) | (UINT16) (device))
+#define RELAY_MSG_KEY(group, device, id)            (((UINT32) (group) << 24) | ((UINT32) (UINT16) (device) << 8) | (UINT8) (id))
+//! @endcond
+
+//------------------------------------------------------------------------------
+//
+// Section public functions
+//
+//------------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Constructor
+ *
+ * @param wimod     reference to the LR-BASE interface
+ */
+WiMODLRBASE_Relay::WiMODLRBASE_Relay(WiMODLRBASE& wimod) :
+    wimod(wimod)
+{
+    memset(routes, 0x00, sizeof(routes));
+    memset(dupKeys, 0x00, sizeof(dupKeys));
+    memset(dupTimes, 0x00, sizeof(dupTimes));
+    memset(queue, 0x00, sizeof(queue));
+    memset(&stats, 0x00, sizeof(stats));
+
+    numRoutes        = 0;
+    dupNext          = 0;
+    dupCount         = 0;
+    queueFirst       = 0;
+    queueCount       = 0;
+    awaitingAck      = false;
+    localGroup       = 0;
+    localDevice      = 0;
+    msgId            = 0;
+    tokenInterval    = WIMOD_RELAY_DEFAULT_INTERVAL;
+    tokenBurst       = WIMOD_RELAY_DEFAULT_BURST;
+    tokens           = WIMOD_RELAY_DEFAULT_BURST;
+    tokenTime        = 0;
+    backoffBase      = WIMOD_RELAY_DEFAULT_BACKOFF_BASE;
+    backoffMax       = WIMOD_RELAY_DEFAULT_BACKOFF_MAX;
+    maxAttempts      = WIMOD_RELAY_DEFAULT_MAX_ATTEMPTS;
+    deliveryCallback = NULL;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Destructor
+ */
+WiMODLRBASE_Relay::~WiMODLRBASE_Relay(void)
+{
+
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Sets the address of this node (see GroupAddress / DeviceAddress of
+ *        the radio config)
+ */
+void WiMODLRBASE_Relay::SetLocalAddress(UINT8 groupAddress, UINT16 deviceAddress)
+{
+    localGroup  = groupAddress;
+    localDevice = deviceAddress;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Sets the token bucket of the sender
+ *
+ * @param intervalMs    time to earn one token; 0 disables the rate limit
+ *
+ * @param burst         max. number of tokens (frames sent back to back)
+ */
+void WiMODLRBASE_Relay::SetRateLimit(UINT16 intervalMs, UINT8 burst)
+{
+    tokenInterval = intervalMs;
+    tokenBurst    = MAX(burst, 1);
+    tokens        = tokenBurst;
+    tokenTime     = millis();
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Sets the backoff after a busy channel or a missing ack
+ *
+ * The n-th failed attempt delays the frame by a random time of up to
+ * MIN(baseMs * 2^(n-1), maxMs); the frame is dropped after maxAttempts.
+ */
+void WiMODLRBASE_Relay::SetBackoff(UINT16 baseMs, UINT16 maxMs, UINT8 maxAttempts)
+{
+    backoffBase       = baseMs;
+    backoffMax        = maxMs;
+    this->maxAttempts = MAX(maxAttempts, 1);
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Registers a callback for messages addressed to this node
+ */
+void WiMODLRBASE_Relay::RegisterDeliveryClient(TRelayDeliveryCallback cb)
+{
+    deliveryCallback = cb;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Adds or replaces a route
+ *
+ * @param dstGroup      group address of the final destination
+ *
+ * @param dstDevice     device address of the final destination or
+ *                      WIMOD_RELAY_ANY_DEVICE for the whole group
+ *
+ * @param nextGroup     group address of the next hop
+ *
+ * @param nextDevice    device address of the next hop
+ *
+ * @param confirmed     send as C-Data (with ack and retransmission)
+ *
+ * @retval true     if the route has been stored
+ * @retval false    if the table is full
+ */
+bool WiMODLRBASE_Relay::AddRoute(UINT8 dstGroup, UINT16 dstDevice, UINT8 nextGroup, UINT16 nextDevice,
+                                 bool confirmed)
+{
+    UINT32 key = RELAY_ROUTE_KEY(dstGroup, dstDevice);
+    bool   found;
+    UINT8  idx = findRouteIndex(key, &found);
+
+    if (!found) {
+        if (numRoutes >= WIMOD_RELAY_MAX_ROUTES) {
+            return false;
+        }
+        memmove(&routes[idx + 1], &routes[idx], (numRoutes - idx) * sizeof(TWiMODLR_RelayRoute));
+        numRoutes++;
+    }
+
+    routes[idx].Key               = key;
+    routes[idx].NextGroupAddress  = nextGroup;
+    routes[idx].NextDeviceAddress = nextDevice;
+    routes[idx].Confirmed         = confirmed;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Removes a route
+ *
+ * @retval true     if the route existed
+ */
+bool WiMODLRBASE_Relay::RemoveRoute(UINT8 dstGroup, UINT16 dstDevice)
+{
+    bool  found;
+    UINT8 idx = findRouteIndex(RELAY_ROUTE_KEY(dstGroup, dstDevice), &found);
+
+    if (!found) {
+        return false;
+    }
+    numRoutes--;
+    memmove(&routes[idx], &routes[idx + 1], (numRoutes - idx) * sizeof(TWiMODLR_RelayRoute));
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Removes all routes
+ */
+void WiMODLRBASE_Relay::ClearRoutes(void)
+{
+    numRoutes = 0;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the number of routes in the table
+ */
+UINT8 WiMODLRBASE_Relay::GetNumRoutes(void)
+{
+    return numRoutes;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Originates a message
+ *
+ * The message is queued; without a route it is sent directly to the
+ * destination.
+ *
+ * @param dstGroup  group address of the final destination
+ *
+ * @param dstDevice device address of the final destination
+ *
+ * @param data      payload (copied)
+ *
+ * @param length    length of the payload (max. WIMOD_RELAY_PAYLOAD_LEN)
+ *
+ * @retval true     if the message has been queued
+ */
+bool WiMODLRBASE_Relay::Send(UINT8 dstGroup, UINT16 dstDevice, const UINT8* data, UINT8 length)
+{
+    const TWiMODLR_RelayRoute* route;
+    UINT8                      frame[WIMOD_RADIOLINK_PAYLOAD_LEN];
+    UINT32                     now = millis();
+
+    if ((data == NULL) || (length > WIMOD_RELAY_PAYLOAD_LEN)) {
+        return false;
+    }
+
+    frame[0] = WIMOD_RELAY_FRAME_ID;
+    frame[1] = WIMOD_RELAY_DEFAULT_TTL;
+    frame[2] = msgId;
+    frame[3] = localGroup;
+    HTON16(&frame[4], localDevice);
+    frame[6] = dstGroup;
+    HTON16(&frame[7], dstDevice);
+    memcpy(&frame[WIMOD_RELAY_HEADER_SIZE], data, length);
+
+    route = findRoute(dstGroup, dstDevice);
+    if (route) {
+        if (!enqueue(frame, WIMOD_RELAY_HEADER_SIZE + length, route->NextGroupAddress,
+                     route->NextDeviceAddress, route->Confirmed, now)) {
+            return false;
+        }
+    } else if (!enqueue(frame, WIMOD_RELAY_HEADER_SIZE + length, dstGroup, dstDevice, false, now)) {
+        return false;
+    }
+
+    // echoes of our own message are dropped
+    isDuplicate(localGroup, localDevice, msgId, now);
+    msgId++;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Processes a received frame
+ *
+ * Frames for this node are passed to the delivery callback, all others are
+ * queued for the next hop. Broadcasts to the local group are delivered and
+ * forwarded if a route exists.
+ *
+ * @param rxMsg     converted RX U-Data or RX C-Data indication
+ *
+ * @retval true     if the frame was a relay frame of a valid length (max.
+ *                  WIMOD_RADIOLINK_PAYLOAD_LEN)
+ */
+bool WiMODLRBASE_Relay::ProcessRxData(const TWiMODLR_RadioLink_Msg& rxMsg)
+{
+    const TWiMODLR_RelayRoute* route;
+    UINT32                     now = millis();
+    UINT8                      frame[WIMOD_RADIOLINK_PAYLOAD_LEN];
+    UINT8                      srcGroup;
+    UINT16                     srcDevice;
+    UINT8                      dstGroup;
+    UINT16                     dstDevice;
+    bool                       delivered = false;
+
+    if ((rxMsg.Length < WIMOD_RELAY_HEADER_SIZE) || (rxMsg.Payload[0] != WIMOD_RELAY_FRAME_ID)) {
+        return false;
+    }
+    // longer than a RadioLink payload: could not be sent on anyway
+    if (rxMsg.Length > WIMOD_RADIOLINK_PAYLOAD_LEN) {
+        stats.Oversized++;
+        return false;
+    }
+
+    srcGroup  = rxMsg.Payload[3];
+    srcDevice = NTOH16(&rxMsg.Payload[4]);
+    dstGroup  = rxMsg.Payload[6];
+    dstDevice = NTOH16(&rxMsg.Payload[7]);
+    stats.Received++;
+
+    if (isDuplicate(srcGroup, srcDevice, rxMsg.Payload[2], now)) {
+        stats.Duplicates++;
+        return true;
+    }
+
+    if ((dstGroup == localGroup)
+            && ((dstDevice == localDevice) || (dstDevice == RADIOLINK_BROADCAST_DEVICE_ADR))) {
+        stats.Delivered++;
+        delivered = true;
+        if (deliveryCallback) {
+            deliveryCallback(srcGroup, srcDevice, &rxMsg.Payload[WIMOD_RELAY_HEADER_SIZE],
+                             rxMsg.Length - WIMOD_RELAY_HEADER_SIZE);
+        }
+        if (dstDevice == localDevice) {
+            return true;
+        }
+    }
+
+    route = findRoute(dstGroup, dstDevice);
+    if (route == NULL) {
+        if (!delivered) {
+            stats.NoRoute++;
+        }
+        return true;
+    }
+    if (rxMsg.Payload[1] == 0) {
+        stats.TtlExpired++;
+        return true;
+    }
+
+    memcpy(frame, rxMsg.Payload, rxMsg.Length);
+    frame[1]--;
+    enqueue(frame, rxMsg.Length, route->NextGroupAddress, route->NextDeviceAddress,
+            route->Confirmed, now);
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Processes the RX Ack indication of a forwarded C-Data frame
+ */
+void WiMODLRBASE_Relay::ProcessAck(void)
+{
+    if (awaitingAck) {
+        awaitingAck = false;
+        dequeue(true, millis());
+    }
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Processes the Ack Timeout indication of a forwarded C-Data frame
+ */
+void WiMODLRBASE_Relay::ProcessAckTimeout(void)
+{
+    if (awaitingAck) {
+        awaitingAck = false;
+        stats.Retransmissions++;
+        backoff(millis());
+    }
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Sends the oldest queued frame if its backoff has expired and a
+ *        token is available
+ *
+ * @param hciResult Result of the local command transmission to module
+ *                  This is an optional parameter.
+ *
+ * @param rspStatus Status byte contained in the local response of the module
+ *                  This is an optional parameter.
+ *
+ * @retval true     if a frame has been handed over to the module
+ *
+ * @code
+ * WiMODLRBASE_Relay relay(wimod);
+ *
+ * void onRxData(TWiMODLR_HCIMessage& rxMsg) {
+ *  wimod.convert(rxMsg, &radioRxMsg);
+ *  relay.ProcessRxData(radioRxMsg);
+ * }
+ *
+ * void setup() {
+ *  ...
+ *  relay.SetLocalAddress(0x10, 0x0001);
+ *  relay.AddRoute(0x20, WIMOD_RELAY_ANY_DEVICE, 0x20, 0x0001, true);
+ *  wimod.RegisterUDataRxClient(onRxData);
+ *  wimod.RegisterCDataRxClient(onRxData);
+ * }
+ *
+ * void loop() {
+ *  relay.Process();
+ *  wimod.Process();
+ * }
+ * @endcode
+ */
+bool WiMODLRBASE_Relay::Process(TWiMODLRResultCodes* hciResult, UINT8* rspStatus)
+{
+    TWiMODLR_RelayEntry* entry;
+    TWiMODLRResultCodes  localHciRes;
+    UINT8                localStatusRsp;
+    UINT32               now = millis();
+    bool                 ok;
+
+    if ((queueCount == 0) || awaitingAck) {
+        return false;
+    }
+
+    entry = &queue[queueFirst];
+    if ((INT32) (now - entry->NotBefore) < 0) {
+        return false;
+    }
+    if (!takeToken(now)) {
+        stats.RateLimited++;
+        return false;
+    }
+
+    if (entry->Confirmed) {
+        ok = wimod.SendCData(&entry->Msg, &localHciRes, &localStatusRsp);
+    } else {
+        ok = wimod.SendUData(&entry->Msg, &localHciRes, &localStatusRsp);
+    }
+    if (hciResult) {
+        *hciResult = localHciRes;
+    }
+    if (rspStatus) {
+        *rspStatus = localStatusRsp;
+    }
+
+    if (!ok) {
+        if ((localHciRes == WiMODLR_RESULT_OK)
+                && ((localStatusRsp == RADIOLINK_STATUS_MEDIA_BUSY)
+                        || (localStatusRsp == RADIOLINK_STATUS_BUFFER_FULL))) {
+            stats.Busy++;
+        }
+        backoff(now);
+        return false;
+    }
+
+    if (tokenInterval > 0) {
+        tokens--;
+    }
+    if (entry->Confirmed) {
+        awaitingAck = true;
+    } else {
+        dequeue(true, now);
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the number of queued frames
+ */
+UINT8 WiMODLRBASE_Relay::GetQueueLength(void)
+{
+    return queueCount;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Copies the counters of the relay
+ */
+void WiMODLRBASE_Relay::GetStats(TWiMODLR_RelayStats* stats)
+{
+    if (stats) {
+        memcpy(stats, &this->stats, sizeof(TWiMODLR_RelayStats));
+    }
+}
+
+//------------------------------------------------------------------------------
+//
+// Section protected functions
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+const TWiMODLR_RelayRoute* WiMODLRBASE_Relay::findRoute(UINT8 group, UINT16 device)
+{
+    bool  found;
+    UINT8 idx = findRouteIndex(RELAY_ROUTE_KEY(group, device), &found);
+
+    if (!found) {
+        idx = findRouteIndex(RELAY_ROUTE_KEY(group, WIMOD_RELAY_ANY_DEVICE), &found);
+    }
+    return found ? &routes[idx] : NULL;
+}
+
+// binary search; returns the position of the key or where it has to be inserted
+UINT8 WiMODLRBASE_Relay::findRouteIndex(UINT32 key, bool* found)
+{
+    UINT8 lo = 0;
+    UINT8 hi = numRoutes;
+    UINT8 mid;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (routes[mid].Key < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    *found = (lo < numRoutes) && (routes[lo].Key == key);
+    return lo;
+}
+
+// remembers the message; true if it has been seen within WIMOD_RELAY_DUP_TIMEOUT
+bool WiMODLRBASE_Relay::isDuplicate(UINT8 srcGroup, UINT16 srcDevice, UINT8 msgId, UINT32 now)
+{
+    UINT32 key = RELAY_MSG_KEY(srcGroup, srcDevice, msgId);
+    UINT8  i;
+
+    for (i = 0; i < dupCount; i++) {
+        if ((dupKeys[i] == key) && (now - dupTimes[i] < WIMOD_RELAY_DUP_TIMEOUT)) {
+            return true;
+        }
+    }
+
+    dupKeys[dupNext]  = key;
+    dupTimes[dupNext] = now;
+    dupNext = (dupNext + 1) % WIMOD_RELAY_DUP_CACHE_SIZE;
+    if (dupCount < WIMOD_RELAY_DUP_CACHE_SIZE) {
+        dupCount++;
+    }
+    return false;
+}
+
+bool WiMODLRBASE_Relay::enqueue(const UINT8* frame, UINT8 length, UINT8 nextGroup, UINT16 nextDevice,
+                                bool confirmed, UINT32 rxTime)
+{
+    TWiMODLR_RelayEntry* entry;
+
+    if (queueCount >= WIMOD_RELAY_QUEUE_SIZE) {
+        stats.QueueFull++;
+        return false;
+    }
+
+    entry = &queue[(queueFirst + queueCount) % WIMOD_RELAY_QUEUE_SIZE];
+    entry->Msg.DestinationGroupAddress  = nextGroup;
+    entry->Msg.DestinationDeviceAddress = nextDevice;
+    entry->Msg.Length                   = length;
+    memcpy(entry->Msg.Payload, frame, length);
+    entry->RxTime    = rxTime;
+    entry->NotBefore = rxTime;
+    entry->Attempts  = 0;
+    entry->Confirmed = confirmed;
+    queueCount++;
+    return true;
+}
+
+void WiMODLRBASE_Relay::dequeue(bool sent, UINT32 now)
+{
+    UINT32 latency;
+
+    if (queueCount == 0) {
+        return;
+    }
+    if (sent) {
+        latency = now - queue[queueFirst].RxTime;
+        stats.Forwarded++;
+        stats.LatencySumMs += latency;
+        stats.LatencyMaxMs  = MAX(stats.LatencyMaxMs, latency);
+    }
+    queueFirst = (queueFirst + 1) % WIMOD_RELAY_QUEUE_SIZE;
+    queueCount--;
+}
+
+// delays the oldest frame by a random time; drops it after maxAttempts
+void WiMODLRBASE_Relay::backoff(UINT32 now)
+{
+    TWiMODLR_RelayEntry* entry = &queue[queueFirst];
+    UINT32               window = backoffBase;
+    UINT8                i;
+
+    if (++entry->Attempts >= maxAttempts) {
+        stats.Failed++;
+        dequeue(false, now);
+        return;
+    }
+
+    for (i = 1; (i < entry->Attempts) && (window < backoffMax); i++) {
+        window <<= 1;
+    }
+    window = MIN(window, (UINT32) backoffMax);
+    entry->NotBefore = now + 1 + (UINT32) random((long) window);
+}
+
+bool WiMODLRBASE_Relay::takeToken(UINT32 now)
+{
+    UINT32 earned;
+
+    if (tokenInterval == 0) {
+        return true;
+    }
+    if (tokens >= tokenBurst) {
+        // full bucket: the next token is earned one interval after this one is spent
+        tokenTime = now;
+        return true;
+    }
+
+    earned = (now - tokenTime) / tokenInterval;
+    if (earned > 0) {
+        tokens     = (UINT8) MIN((UINT32) tokenBurst, tokens + earned);
+        tokenTime += earned * tokenInterval;
+    }
+    return tokens > 0;
+}
+//! @endcond
+
+//------------------------------------------------------------------------------
+// EOF
+//------------------------------------------------------------------------------
@@ -0,0 +1,219 @@
+//------------------------------------------------------------------------------
+//! @file WiMODLRBASE_Relay.h
+//! @ingroup WiMODLR_BASE
+//! <!------------------------------------------------------------------------->
+//! @brief Declarations for a store and forward relay for RadioLink
+//! @version 0.1
+//! <!------------------------------------------------------------------------->
+//!
+//! The radio only receives frames for its own group (or broadcast), so the
+//! final destination and the originator travel in a small relay header in
+//! front of the payload. The relay node looks up the next hop for the final
+//! destination in a routing table and sends the frame on, as U-Data or
+//! C-Data depending on the route.
+//!
+//! Frame:  | 0x52 | ttl | msg id | src group | src device | dst group | dst device | payload ... |
+//!
+//! Device addresses are 16 bit, big endian. (src group, src device, msg id)
+//! identifies a message; it is kept in a small cache to drop copies that
+//! arrive on more than one path or are repeated by a C-Data retransmission.
+//!
+//! Sending is limited by a token bucket. A busy channel (LBT, MEDIA_BUSY) or
+//! a missing C-Data ack delays the frame by a random, exponentially growing
+//! backoff.
+//!
+//------------------------------------------------------------------------------
+
+
+#ifndef ARDUINO_WIMODLRBASE_RELAY_H_
+#define ARDUINO_WIMODLRBASE_RELAY_H_
+
+//------------------------------------------------------------------------------
+//
+// Section Includes Files
+//
+//------------------------------------------------------------------------------
+
+#include "../WiMODLR_BASE.h"
+
+//------------------------------------------------------------------------------
+//
+// Section defines
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+#define WIMOD_RELAY_FRAME_ID                        0x52
+#define WIMOD_RELAY_HEADER_SIZE                     9
+#define WIMOD_RELAY_PAYLOAD_LEN                     (WIMOD_RADIOLINK_PAYLOAD_LEN - WIMOD_RELAY_HEADER_SIZE)
+#define WIMOD_RELAY_DEFAULT_TTL                     4
+
+#define WIMOD_RELAY_DEFAULT_INTERVAL                1000                        // ms per token
+#define WIMOD_RELAY_DEFAULT_BURST                   4                           // tokens
+#define WIMOD_RELAY_DEFAULT_BACKOFF_BASE            50                          // ms
+#define WIMOD_RELAY_DEFAULT_BACKOFF_MAX             2000                        // ms
+#define WIMOD_RELAY_DEFAULT_MAX_ATTEMPTS            5
+#define WIMOD_RELAY_DUP_TIMEOUT                     30000                       // ms a msg id is remembered
+
+#ifndef WIMOD_RELAY_MAX_ROUTES
+#define WIMOD_RELAY_MAX_ROUTES                      16
+#endif
+
+#ifndef WIMOD_RELAY_DUP_CACHE_SIZE
+#define WIMOD_RELAY_DUP_CACHE_SIZE                  16
+#endif
+
+#ifndef WIMOD_RELAY_QUEUE_SIZE
+#define WIMOD_RELAY_QUEUE_SIZE                      4
+#endif
+//! @endcond
+
+/** Device address of a route that matches every device of a group */
+#define WIMOD_RELAY_ANY_DEVICE                      RADIOLINK_BROADCAST_DEVICE_ADR
+
+/**
+ * @brief An entry of the routing table
+ */
+typedef struct TWiMODLR_RelayRoute
+{
+    UINT32      Key;                                                            /*!< dst group << 16 | dst device */
+    UINT8       NextGroupAddress;                                               /*!< group address of the next hop */
+    UINT16      NextDeviceAddress;                                              /*!< device address of the next hop */
+    bool        Confirmed;                                                      /*!< send as C-Data */
+} TWiMODLR_RelayRoute;
+
+/**
+ * @brief A frame waiting for transmission
+ */
+typedef struct TWiMODLR_RelayEntry
+{
+    TWiMODLR_RadioLink_Msg Msg;                                                 /*!< frame incl. relay header */
+    UINT32      RxTime;                                                         /*!< millis() of reception / Send() */
+    UINT32      NotBefore;                                                      /*!< millis() of the next attempt */
+    UINT8       Attempts;                                                       /*!< failed attempts so far */
+    bool        Confirmed;                                                      /*!< send as C-Data */
+} TWiMODLR_RelayEntry;
+
+/**
+ * @brief Counters of the relay
+ *
+ * LatencySumMs / LatencyMaxMs cover the time from reception (or Send()) to
+ * the frame being accepted by the module (U-Data) or acked (C-Data).
+ */
+typedef struct TWiMODLR_RelayStats
+{
+    UINT32      Received;                                                       /*!< relay frames received */
+    UINT32      Delivered;                                                      /*!< frames for this node */
+    UINT32      Forwarded;                                                      /*!< frames sent on successfully */
+    UINT32      Duplicates;                                                     /*!< dropped by the msg id cache */
+    UINT32      Oversized;                                                      /*!< dropped, longer than a RadioLink payload */
+    UINT32      NoRoute;                                                        /*!< dropped, no route */
+    UINT32      TtlExpired;                                                     /*!< dropped, ttl exhausted */
+    UINT32      QueueFull;                                                      /*!< dropped, queue full */
+    UINT32      Failed;                                                         /*!< dropped after max. attempts */
+    UINT32      Busy;                                                           /*!< attempts delayed by LBT / busy module */
+    UINT32      Retransmissions;                                                /*!< C-Data frames sent again */
+    UINT32      RateLimited;                                                    /*!< Process() calls without token */
+    UINT32      LatencySumMs;                                                   /*!< sum of the forwarding latency */
+    UINT32      LatencyMaxMs;                                                   /*!< max. forwarding latency */
+} TWiMODLR_RelayStats;
+
+
+// C++11 check
+#ifdef WIMOD_USE_CPP11
+    /** Type definition for a 'message for this node' callback */
+    typedef std::function<void (UINT8 srcGroup, UINT16 srcDevice, const UINT8* data, UINT8 length)> TRelayDeliveryCallback;
+#else
+    /** Type definition for a 'message for this node' callback function */
+    typedef void (*TRelayDeliveryCallback)(UINT8 srcGroup, UINT16 srcDevice, const UINT8* data, UINT8 length);
+#endif
+
+
+//------------------------------------------------------------------------------
+//
+// Section class
+//
+//------------------------------------------------------------------------------
+
+/**
+ * @brief Store and forward relay for RadioLink
+ *
+ * Feed the converted RX U-Data / RX C-Data indications into ProcessRxData()
+ * and the RX Ack / Ack Timeout indications into ProcessAck() and
+ * ProcessAckTimeout(); call Process() from the main loop. The relay is used
+ * on end nodes as well: Send() originates a message and frames for the
+ * local address are passed to the delivery callback.
+ */
+class WiMODLRBASE_Relay {
+public:
+    WiMODLRBASE_Relay(WiMODLRBASE& wimod);
+    ~WiMODLRBASE_Relay(void);
+
+    void        SetLocalAddress(UINT8 groupAddress, UINT16 deviceAddress);
+    void        SetRateLimit(UINT16 intervalMs, UINT8 burst);
+    void        SetBackoff(UINT16 baseMs, UINT16 maxMs, UINT8 maxAttempts);
+    void        RegisterDeliveryClient(TRelayDeliveryCallback cb);
+
+    bool        AddRoute(UINT8 dstGroup, UINT16 dstDevice, UINT8 nextGroup, UINT16 nextDevice,
+                         bool confirmed = false);
+    bool        RemoveRoute(UINT8 dstGroup, UINT16 dstDevice);
+    void        ClearRoutes(void);
+    UINT8       GetNumRoutes(void);
+
+    bool        Send(UINT8 dstGroup, UINT16 dstDevice, const UINT8* data, UINT8 length);
+    bool        ProcessRxData(const TWiMODLR_RadioLink_Msg& rxMsg);
+    void        ProcessAck(void);
+    void        ProcessAckTimeout(void);
+    bool        Process(TWiMODLRResultCodes* hciResult = NULL, UINT8* rspStatus = NULL);
+
+    UINT8       GetQueueLength(void);
+    void        GetStats(TWiMODLR_RelayStats* stats);
+
+protected:
+    //! @cond Doxygen_Suppress
+    const TWiMODLR_RelayRoute* findRoute(UINT8 group, UINT16 device);
+    UINT8       findRouteIndex(UINT32 key, bool* found);
+    bool        isDuplicate(UINT8 srcGroup, UINT16 srcDevice, UINT8 msgId, UINT32 now);
+    bool        enqueue(const UINT8* frame, UINT8 length, UINT8 nextGroup, UINT16 nextDevice,
+                        bool confirmed, UINT32 rxTime);
+    void        dequeue(bool sent, UINT32 now);
+    void        backoff(UINT32 now);
+    bool        takeToken(UINT32 now);
+    //! @endcond
+private:
+    //! @cond Doxygen_Suppress
+    WiMODLRBASE&            wimod;
+
+    TWiMODLR_RelayRoute     routes[WIMOD_RELAY_MAX_ROUTES];                     // sorted by Key
+    UINT8                   numRoutes;
+
+    UINT32                  dupKeys[WIMOD_RELAY_DUP_CACHE_SIZE];
+    UINT32                  dupTimes[WIMOD_RELAY_DUP_CACHE_SIZE];
+    UINT8                   dupNext;
+    UINT8                   dupCount;
+
+    TWiMODLR_RelayEntry     queue[WIMOD_RELAY_QUEUE_SIZE];
+    UINT8                   queueFirst;
+    UINT8                   queueCount;
+    bool                    awaitingAck;
+
+    UINT8                   localGroup;
+    UINT16                  localDevice;
+    UINT8                   msgId;
+
+    UINT16                  tokenInterval;
+    UINT8                   tokenBurst;
+    UINT8                   tokens;
+    UINT32                  tokenTime;
+
+    UINT16                  backoffBase;
+    UINT16                  backoffMax;
+    UINT8                   maxAttempts;
+
+    TWiMODLR_RelayStats     stats;
+    TRelayDeliveryCallback  deliveryCallback;
+    //! @endcond
+};
+
+
+#endif /* ARDUINO_WIMODLRBASE_RELAY_H_ */
@@ -0,0 +1,760 @@
+//------------------------------------------------------------------------------
+//! @file WiMODLRBASE_PLUS_RltSweep.cpp
+//! @ingroup WiMODLR_BASE_PLUS
+//! <!------------------------------------------------------------------------->
+//! @brief Radio link test sweep over radio settings
+//! @version 0.1
+//! <!------------------------------------------------------------------------->
+//!
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+//
+// Section Includes Files
+//
+//------------------------------------------------------------------------------
+
+#include "WiMODLRBASE_PLUS_RltSweep.h"
+
+#include <string.h>
+
+//------------------------------------------------------------------------------
+//
+// Section defines
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+#define RLT_SWEEP_ACK_WAIT_MAX                      10000                       // ms without ack / timeout indication
+#define RLT_SWEEP_TURNAROUND                        20                          // ms per RLT packet and reply
+//! @endcond
+
+//------------------------------------------------------------------------------
+//
+// Section local functions
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+// writes the setting of a sweep point into a radio config (RAM only)
+static void RltSweep_applyPoint(TWiMODLR_DevMgmt_RadioConfigPlus* cfg, const TWiMODLR_RltSweepResult& point)
+{
+    cfg->StoreNwmFlag = 0;
+    cfg->Modulation   = (TRadioCfg_ModulationPlus) point.Modulation;
+    cfg->PowerLevel   = (TRadioCfg_PowerLevelPlus) point.PowerLevel;
+
+    switch (point.Modulation) {
+        case LRBASE_PLUS_Modulation_LoRa:
+            cfg->LoRaBandWidth       = (TRadioCfg_LoRaBandwidthPlus) point.Bandwidth;
+            cfg->LoRaSpreadingFactor = (TRadioCfg_LoRaSpreadingFactorPlus) point.SpreadingFactor;
+            cfg->LoRaErrorCoding     = (TRadioCfg_LoRaErrorCodingPlus) point.ErrorCoding;
+            break;
+        case LRBASE_PLUS_Modulation_FLRC:
+            cfg->FLRCBandWidth       = (TRadioCfg_FLRCBandwidthPlus) point.Bandwidth;
+            cfg->FLRCErrorCoding     = (TRadioCfg_FLRCErrorCodingPlus) point.ErrorCoding;
+            break;
+        default:
+            cfg->FSKBandWidth        = (TRadioCfg_FSKBandwidthPlus) point.Bandwidth;
+            break;
+    }
+}
+
+// net bit rate of a setting [bit/s]
+static UINT32 RltSweep_bitRate(const TWiMODLR_RltSweepResult& point)
+{
+    static const UINT32 loraBw[] = { 0, 0, 203125, 406250, 812500, 1625000 };
+    static const UINT32 flrcBr[] = { 0, 260000, 325000, 520000, 650000, 1040000, 1300000 };
+    UINT32 cr;
+
+    switch (point.Modulation) {
+        case LRBASE_PLUS_Modulation_LoRa:
+            if ((point.Bandwidth >= sizeof(loraBw) / sizeof(loraBw[0])) || (point.SpreadingFactor > 12)) {
+                return 0;
+            }
+            // 4/5, 4/6, 4/7, 4/8, LI 4/5, LI 4/6, LI 4/8
+            cr = (point.ErrorCoding <= 4) ? point.ErrorCoding : ((point.ErrorCoding == 7) ? 4 : point.ErrorCoding - 4);
+            return (UINT32) (((UINT64) loraBw[point.Bandwidth] * point.SpreadingFactor * 4)
+                             / ((UINT32) (1UL << point.SpreadingFactor) * (4 + cr)));
+        case LRBASE_PLUS_Modulation_FLRC:
+            if (point.Bandwidth >= sizeof(flrcBr) / sizeof(flrcBr[0])) {
+                return 0;
+            }
+            switch (point.ErrorCoding) {
+                case LRBASE_PLUS_FLRC_ErrorCoding_1_2:
+                    return flrcBr[point.Bandwidth] / 2;
+                case LRBASE_PLUS_FLRC_ErrorCoding_3_4:
+                    return flrcBr[point.Bandwidth] * 3 / 4;
+                default:
+                    return flrcBr[point.Bandwidth];
+            }
+        default:
+            switch (point.Bandwidth) {
+                case LRBASE_PLUS_FSKBandwith_2_0MBs_2_4_MHz:
+                    return 2000000;
+                case LRBASE_PLUS_FSKBandwith_1_0MBs_1_2_MHz:
+                    return 1000000;
+                case LRBASE_PLUS_FSKBandwith_0_250MBs_0_3_MHz:
+                    return 250000;
+                default:
+                    return 125000;
+            }
+    }
+}
+//! @endcond
+
+//------------------------------------------------------------------------------
+//
+// Section public functions - WiMODLRBASE_PLUS_RltSweep
+//
+//------------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Constructor
+ *
+ * @param wimod     reference to the LR-BASE PLUS interface
+ */
+WiMODLRBASE_PLUS_RltSweep::WiMODLRBASE_PLUS_RltSweep(WiMODLRBASE_PLUS& wimod) :
+    wimod(wimod)
+{
+    memset(&baseCfg, 0x00, sizeof(baseCfg));
+    memset(&cmdMsg, 0x00, sizeof(cmdMsg));
+
+    packetSize = WIMOD_RLT_SWEEP_DEFAULT_PACKET_SIZE;
+    numPackets = WIMOD_RLT_SWEEP_DEFAULT_NUM_PACKETS;
+    state      = Sweep_Idle;
+    current    = 0;
+    retries    = 0;
+    stateTime  = 0;
+    peerTime   = 0;
+    dwellMs    = 0;
+    statusSeen = false;
+    Clear();
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Destructor
+ */
+WiMODLRBASE_PLUS_RltSweep::~WiMODLRBASE_PLUS_RltSweep(void)
+{
+
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Removes the grid and all results
+ */
+void WiMODLRBASE_PLUS_RltSweep::Clear(void)
+{
+    memset(results, 0x00, sizeof(results));
+    numResults     = 0;
+    loraSfMask     = 0;
+    loraBwMask     = 0;
+    loraCrMask     = 0;
+    flrcBwMask     = 0;
+    flrcCrMask     = 0;
+    fskBwMask      = 0;
+    numPowerLevels = 0;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Selects the LoRa settings to test
+ *
+ * @param sfMask        bit n set: TRadioCfg_LoRaSpreadingFactorPlus n
+ *
+ * @param bandwidthMask bit n set: TRadioCfg_LoRaBandwidthPlus n
+ *
+ * @param codingMask    bit n set: TRadioCfg_LoRaErrorCodingPlus n
+ */
+void WiMODLRBASE_PLUS_RltSweep::SetLoRaGrid(UINT16 sfMask, UINT8 bandwidthMask, UINT8 codingMask)
+{
+    loraSfMask = sfMask;
+    loraBwMask = bandwidthMask;
+    loraCrMask = codingMask;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Selects the FLRC settings to test
+ *
+ * @param bandwidthMask bit n set: TRadioCfg_FLRCBandwidthPlus n
+ *
+ * @param codingMask    bit n set: TRadioCfg_FLRCErrorCodingPlus n
+ */
+void WiMODLRBASE_PLUS_RltSweep::SetFlrcGrid(UINT8 bandwidthMask, UINT8 codingMask)
+{
+    flrcBwMask = bandwidthMask;
+    flrcCrMask = codingMask;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Selects the FSK settings to test
+ *
+ * @param bandwidthMask bit n set: TRadioCfg_FSKBandwidthPlus n
+ */
+void WiMODLRBASE_PLUS_RltSweep::SetFskGrid(UINT16 bandwidthMask)
+{
+    fskBwMask = bandwidthMask;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Selects the power levels [dBm] to test
+ *
+ * Without power levels all points use the power of the base config.
+ */
+void WiMODLRBASE_PLUS_RltSweep::SetPowerLevels(const INT8* levels, UINT8 numLevels)
+{
+    numPowerLevels = 0;
+    if (levels) {
+        numPowerLevels = MIN(numLevels, WIMOD_RLT_SWEEP_MAX_POWER_LEVELS);
+        memcpy(powerLevels, levels, numPowerLevels);
+    }
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Sets size and number of the RLT packets per point
+ */
+void WiMODLRBASE_PLUS_RltSweep::SetTest(UINT8 packetSize, UINT16 numPackets)
+{
+    this->packetSize = packetSize;
+    this->numPackets = MAX(numPackets, 1);
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Starts the sweep
+ *
+ * The current radio config of the module is the base config: commands are
+ * sent with it and both ends return to it after each point. The peer has
+ * to run WiMODLRBASE_PLUS_RltFollower with the same base config.
+ *
+ * @param peerGroupAddress  group address of the peer
+ *
+ * @param peerDeviceAddress device address of the peer
+ *
+ * @retval true     if the sweep has been started
+ */
+bool WiMODLRBASE_PLUS_RltSweep::Start(UINT8 peerGroupAddress, UINT16 peerDeviceAddress)
+{
+    if (state != Sweep_Idle) {
+        return false;
+    }
+    if (!wimod.GetRadioConfig(&baseCfg)) {
+        return false;
+    }
+
+    buildPoints();
+    if (numResults == 0) {
+        return false;
+    }
+
+    cmdMsg.DestinationGroupAddress  = peerGroupAddress;
+    cmdMsg.DestinationDeviceAddress = peerDeviceAddress;
+
+    current = 0;
+    retries = 0;
+    state   = Sweep_SendCmd;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Runs the sweep; call from the main loop
+ *
+ * All HCI commands are issued from here, never from the indication
+ * handlers.
+ *
+ * @retval true     while the sweep is running
+ *
+ * @code
+ * WiMODLRBASE_PLUS_RltSweep sweep(wimod);
+ *
+ * void onRltStatus(TWiMODLR_HCIMessage& rxMsg) {
+ *  TWiMODLR_RLT_Status status;
+ *  if (wimod.convert(rxMsg, &status)) {
+ *      sweep.ProcessRltStatus(status);
+ *  }
+ * }
+ *
+ * void setup() {
+ *  ...
+ *  wimod.RegisterRltStatusClient(onRltStatus);
+ *  wimod.RegisterAckRxClient(onAckRx);                // -> sweep.ProcessAck()
+ *  wimod.RegisterAckRxTimeoutClient(onAckTimeout);    // -> sweep.ProcessAckTimeout()
+ *
+ *  sweep.SetLoRaGrid((1 << 7) | (1 << 9) | (1 << 12), (1 << 2) | (1 << 5), 1 << 1);
+ *  sweep.SetFlrcGrid((1 << 1) | (1 << 6), (1 << 1) | (1 << 3));
+ *  sweep.Start(0x10, 0x0002);
+ * }
+ *
+ * void loop() {
+ *  if (!sweep.Process() && !printed) {
+ *      sweep.PrintResults(Serial);
+ *      printed = true;
+ *  }
+ *  wimod.Process();
+ * }
+ * @endcode
+ */
+bool WiMODLRBASE_PLUS_RltSweep::Process(void)
+{
+    TWiMODLR_DevMgmt_RadioConfigPlus cfg;
+    TWiMODLR_RLT_Parameter           params;
+    TWiMODLR_RltSweepResult*         point = &results[current];
+    UINT32                           now   = millis();
+
+    switch (state) {
+        case Sweep_Idle:
+            return false;
+
+        case Sweep_SendCmd:
+            dwellMs = estimateDwell(*point);
+            cmdMsg.Payload[0] = WIMOD_RLT_SWEEP_CMD_ID;
+            cmdMsg.Payload[1] = current;
+            cmdMsg.Payload[2] = point->Modulation;
+            cmdMsg.Payload[3] = point->Bandwidth;
+            cmdMsg.Payload[4] = point->SpreadingFactor;
+            cmdMsg.Payload[5] = point->ErrorCoding;
+            cmdMsg.Payload[6] = (UINT8) point->PowerLevel;
+            HTON16(&cmdMsg.Payload[7], (UINT16) MIN((dwellMs + 99) / 100, 0xFFFFUL));
+            cmdMsg.Length = WIMOD_RLT_SWEEP_CMD_SIZE;
+
+            // the peer may switch even if its ack gets lost
+            peerTime  = now;
+            stateTime = now;
+            if (wimod.SendCData(&cmdMsg)) {
+                state = Sweep_WaitAck;
+            } else if (++retries > WIMOD_RLT_SWEEP_CMD_RETRIES) {
+                finishPoint(RltPoint_NoPeer);
+            }
+            break;
+
+        case Sweep_WaitAck:
+            if (now - stateTime > RLT_SWEEP_ACK_WAIT_MAX) {
+                ProcessAckTimeout();
+            }
+            break;
+
+        case Sweep_Switch:
+            if (now - stateTime < WIMOD_RLT_SWEEP_SWITCH_DELAY) {
+                break;
+            }
+            memcpy(&cfg, &baseCfg, sizeof(cfg));
+            RltSweep_applyPoint(&cfg, *point);
+            if (!wimod.SetRadioConfig(&cfg)) {
+                finishPoint(RltPoint_Error);
+                break;
+            }
+
+            params.DestGroupAddress = cmdMsg.DestinationGroupAddress;
+            params.DestDevAddress   = cmdMsg.DestinationDeviceAddress;
+            params.PacketSize       = packetSize;
+            params.NumPackets       = numPackets;
+            params.TestMode         = RLT_TestMode_Single;
+            statusSeen = false;
+            stateTime  = now;
+            state      = Sweep_Testing;
+            if (!wimod.StartRadioLinkTest(&params)) {
+                finishPoint(RltPoint_Error);
+            }
+            break;
+
+        case Sweep_Testing:
+            // stop in time before the peer falls back to the base config
+            if ((statusSeen && (point->LocalTx >= numPackets))
+                    || (now - peerTime >= dwellMs - WIMOD_RLT_SWEEP_GUARD_TIME / 2)) {
+                wimod.StopRadioLinkTest();
+                finishPoint(RltPoint_Done);
+            }
+            break;
+
+        case Sweep_WaitPeer:
+            if (now - peerTime >= dwellMs + WIMOD_RLT_SWEEP_SWITCH_DELAY) {
+                nextPoint();
+            }
+            break;
+    }
+    return state != Sweep_Idle;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Stops the sweep and returns to the base config
+ */
+void WiMODLRBASE_PLUS_RltSweep::Abort(void)
+{
+    if (state == Sweep_Testing) {
+        wimod.StopRadioLinkTest();
+    }
+    if ((state == Sweep_Testing) || (state == Sweep_Switch)) {
+        wimod.SetRadioConfig(&baseCfg);
+    }
+    state = Sweep_Idle;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns true while the sweep is running
+ */
+bool WiMODLRBASE_PLUS_RltSweep::IsRunning(void)
+{
+    return state != Sweep_Idle;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Takes the counters of an RLT status indication
+ */
+void WiMODLRBASE_PLUS_RltSweep::ProcessRltStatus(const TWiMODLR_RLT_Status& status)
+{
+    TWiMODLR_RltSweepResult* point = &results[current];
+
+    if (state != Sweep_Testing) {
+        return;
+    }
+    point->LocalTx   = status.LocalTxCounter;
+    point->LocalRx   = status.LocalRxCounter;
+    point->PeerTx    = status.PeerTxCounter;
+    point->PeerRx    = status.PeerRxCounter;
+    point->LocalRssi = (INT16) status.LocalRSSI;
+    point->PeerRssi  = (INT16) status.PeerRSSI;
+    point->LocalSnr  = (INT8) status.LocalSNR;
+    point->PeerSnr   = (INT8) status.PeerSNR;
+    statusSeen = true;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Processes the RX Ack indication of a command
+ */
+void WiMODLRBASE_PLUS_RltSweep::ProcessAck(void)
+{
+    if (state == Sweep_WaitAck) {
+        peerTime  = millis();
+        stateTime = peerTime;
+        state     = Sweep_Switch;
+    }
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Processes the Ack Timeout indication of a command
+ */
+void WiMODLRBASE_PLUS_RltSweep::ProcessAckTimeout(void)
+{
+    if (state != Sweep_WaitAck) {
+        return;
+    }
+    if (++retries > WIMOD_RLT_SWEEP_CMD_RETRIES) {
+        finishPoint(RltPoint_NoPeer);
+    } else {
+        state = Sweep_SendCmd;
+    }
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the number of points of the sweep
+ */
+UINT8 WiMODLRBASE_PLUS_RltSweep::GetNumResults(void)
+{
+    return numResults;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns a point of the sweep or NULL
+ */
+const TWiMODLR_RltSweepResult* WiMODLRBASE_PLUS_RltSweep::GetResult(UINT8 index)
+{
+    return (index < numResults) ? &results[index] : NULL;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the tested point with the highest throughput and a PER of
+ *        at most maxPerMilli, or NULL
+ *
+ * On equal throughput the lower power level wins.
+ */
+const TWiMODLR_RltSweepResult* WiMODLRBASE_PLUS_RltSweep::GetBest(UINT16 maxPerMilli)
+{
+    const TWiMODLR_RltSweepResult* best = NULL;
+    UINT8                          i;
+
+    for (i = 0; i < numResults; i++) {
+        const TWiMODLR_RltSweepResult* r = &results[i];
+
+        if ((r->Status != RltPoint_Done) || (r->PerMilli > maxPerMilli)) {
+            continue;
+        }
+        if ((best == NULL) || (r->Throughput > best->Throughput)
+                || ((r->Throughput == best->Throughput) && (r->PowerLevel < best->PowerLevel))) {
+            best = r;
+        }
+    }
+    return best;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Prints the result table, one line per point
+ *
+ * Columns: modulation, bandwidth, sf, coding, power, status, local tx /
+ * rx, peer tx / rx, local / peer RSSI, local / peer SNR, PER [1/1000],
+ * throughput [bit/s]; separated by ';'.
+ */
+void WiMODLRBASE_PLUS_RltSweep::PrintResults(Stream& s)
+{
+    UINT8 i;
+
+    s.print(F("mod;bw;sf;cr;pwr;st;ltx;lrx;ptx;prx;lrssi;prssi;lsnr;psnr;per;bps\r\n"));
+    for (i = 0; i < numResults; i++) {
+        const TWiMODLR_RltSweepResult* r = &results[i];
+
+        s.print(r->Modulation);         s.print(F(";"));
+        s.print(r->Bandwidth);          s.print(F(";"));
+        s.print(r->SpreadingFactor);    s.print(F(";"));
+        s.print(r->ErrorCoding);        s.print(F(";"));
+        s.print(r->PowerLevel);         s.print(F(";"));
+        s.print(r->Status);             s.print(F(";"));
+        s.print(r->LocalTx);            s.print(F(";"));
+        s.print(r->LocalRx);            s.print(F(";"));
+        s.print(r->PeerTx);             s.print(F(";"));
+        s.print(r->PeerRx);             s.print(F(";"));
+        s.print(r->LocalRssi);          s.print(F(";"));
+        s.print(r->PeerRssi);           s.print(F(";"));
+        s.print(r->LocalSnr);           s.print(F(";"));
+        s.print(r->PeerSnr);            s.print(F(";"));
+        s.print(r->PerMilli);           s.print(F(";"));
+        s.print(r->Throughput);         s.print(F("\r\n"));
+    }
+}
+
+//------------------------------------------------------------------------------
+//
+// Section protected functions - WiMODLRBASE_PLUS_RltSweep
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+void WiMODLRBASE_PLUS_RltSweep::buildPoints(void)
+{
+    INT8  power;
+    UINT8 p, bw, sf, cr;
+
+    numResults = 0;
+    for (p = 0; p < MAX(numPowerLevels, 1); p++) {
+        power = (numPowerLevels > 0) ? powerLevels[p] : (INT8) baseCfg.PowerLevel;
+
+        for (bw = 0; bw < 8; bw++) {
+            for (sf = 0; sf < 16; sf++) {
+                for (cr = 0; cr < 8; cr++) {
+                    if ((loraBwMask & (1 << bw)) && (loraSfMask & (1 << sf)) && (loraCrMask & (1 << cr))) {
+                        addPoint(LRBASE_PLUS_Modulation_LoRa, bw, sf, cr, power);
+                    }
+                }
+            }
+            for (cr = 0; cr < 8; cr++) {
+                if ((flrcBwMask & (1 << bw)) && (flrcCrMask & (1 << cr))) {
+                    addPoint(LRBASE_PLUS_Modulation_FLRC, bw, 0, cr, power);
+                }
+            }
+        }
+        for (bw = 0; bw < 16; bw++) {
+            if (fskBwMask & (1 << bw)) {
+                addPoint(LRBASE_PLUS_Modulation_FSK, bw, 0, 0, power);
+            }
+        }
+    }
+}
+
+bool WiMODLRBASE_PLUS_RltSweep::addPoint(UINT8 modulation, UINT8 bandwidth, UINT8 sf, UINT8 coding, INT8 power)
+{
+    TWiMODLR_RltSweepResult* point;
+
+    if (numResults >= WIMOD_RLT_SWEEP_MAX_POINTS) {
+        return false;
+    }
+    point = &results[numResults++];
+    memset(point, 0x00, sizeof(TWiMODLR_RltSweepResult));
+    point->Modulation      = modulation;
+    point->Bandwidth       = bandwidth;
+    point->SpreadingFactor = sf;
+    point->ErrorCoding     = coding;
+    point->PowerLevel      = power;
+    point->Status          = RltPoint_Pending;
+    point->PerMilli        = 1000;
+    return true;
+}
+
+// time both ends stay on the test setting [ms]
+UINT32 WiMODLRBASE_PLUS_RltSweep::estimateDwell(const TWiMODLR_RltSweepResult& point)
+{
+    UINT32 bitRate  = RltSweep_bitRate(point);
+    UINT32 airtime  = 0;
+
+    if (bitRate > 0) {
+        // payload + ~12 byte header / sync word, rounded up to ms
+        airtime = ((UINT32) (packetSize + 12) * 8 * 1000 + bitRate - 1) / bitRate;
+    }
+    if (point.Modulation == LRBASE_PLUS_Modulation_LoRa) {
+        // preamble: 12.25 symbols
+        static const UINT32 loraBw[] = { 0, 0, 203125, 406250, 812500, 1625000 };
+        if ((point.Bandwidth < sizeof(loraBw) / sizeof(loraBw[0])) && (loraBw[point.Bandwidth] > 0)) {
+            airtime += (UINT32) (((UINT64) 1225 << point.SpreadingFactor) * 10 / loraBw[point.Bandwidth]) + 1;
+        }
+    }
+    return (UINT32) numPackets * (2 * airtime + RLT_SWEEP_TURNAROUND) + WIMOD_RLT_SWEEP_GUARD_TIME;
+}
+
+void WiMODLRBASE_PLUS_RltSweep::finishPoint(TWiMODLR_RltPointStatus status)
+{
+    TWiMODLR_RltSweepResult* point = &results[current];
+    UINT32                   up;
+    UINT32                   down;
+
+    if ((state == Sweep_Testing) || (state == Sweep_Switch)) {
+        wimod.SetRadioConfig(&baseCfg);
+    }
+
+    point->Status = status;
+    if (status == RltPoint_Done) {
+        up   = point->LocalTx ? ((UINT32) (point->LocalTx - MIN(point->PeerRx, point->LocalTx)) * 1000) / point->LocalTx : 1000;
+        down = point->PeerTx ? ((UINT32) (point->PeerTx - MIN(point->LocalRx, point->PeerTx)) * 1000) / point->PeerTx : 1000;
+        point->PerMilli   = (UINT16) MAX(up, down);
+        point->Throughput = (UINT32) (((UINT64) RltSweep_bitRate(*point) * (1000 - point->PerMilli)) / 1000);
+    }
+
+    // the peer may still be on the test setting
+    state = Sweep_WaitPeer;
+}
+
+void WiMODLRBASE_PLUS_RltSweep::nextPoint(void)
+{
+    retries = 0;
+    if (++current >= numResults) {
+        current = 0;
+        state   = Sweep_Idle;
+        return;
+    }
+    state = Sweep_SendCmd;
+}
+//! @endcond
+
+//------------------------------------------------------------------------------
+//
+// Section public functions - WiMODLRBASE_PLUS_RltFollower
+//
+//------------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Constructor
+ *
+ * @param wimod     reference to the LR-BASE PLUS interface
+ */
+WiMODLRBASE_PLUS_RltFollower::WiMODLRBASE_PLUS_RltFollower(WiMODLRBASE_PLUS& wimod) :
+    wimod(wimod)
+{
+    memset(&baseCfg, 0x00, sizeof(baseCfg));
+    memset(&point, 0x00, sizeof(point));
+
+    dwellMs    = 0;
+    switchTime = 0;
+    pending    = false;
+    ackSent    = false;
+    switched   = false;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Destructor
+ */
+WiMODLRBASE_PLUS_RltFollower::~WiMODLRBASE_PLUS_RltFollower(void)
+{
+
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Processes a received C-Data frame
+ *
+ * @retval true     if the frame was a sweep command
+ */
+bool WiMODLRBASE_PLUS_RltFollower::ProcessRxData(const TWiMODLR_RadioLink_Msg& rxMsg)
+{
+    if ((rxMsg.Length < WIMOD_RLT_SWEEP_CMD_SIZE) || (rxMsg.Payload[0] != WIMOD_RLT_SWEEP_CMD_ID)) {
+        return false;
+    }
+    if (switched) {
+        return true;
+    }
+
+    point.Modulation      = rxMsg.Payload[2];
+    point.Bandwidth       = rxMsg.Payload[3];
+    point.SpreadingFactor = rxMsg.Payload[4];
+    point.ErrorCoding     = rxMsg.Payload[5];
+    point.PowerLevel      = (INT8) rxMsg.Payload[6];
+    dwellMs = (UINT32) NTOH16(&rxMsg.Payload[7]) * 100;
+    pending = true;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Processes the TX Ack indication; the switch follows in Process()
+ */
+void WiMODLRBASE_PLUS_RltFollower::ProcessAckTx(void)
+{
+    if (pending) {
+        pending    = false;
+        ackSent    = true;
+        switchTime = millis();
+    }
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Switches to the commanded setting and back; call from the main loop
+ *
+ * @retval true     while the test setting is active
+ */
+bool WiMODLRBASE_PLUS_RltFollower::Process(void)
+{
+    TWiMODLR_DevMgmt_RadioConfigPlus cfg;
+
+    if (ackSent) {
+        ackSent = false;
+        if (wimod.GetRadioConfig(&baseCfg)) {
+            memcpy(&cfg, &baseCfg, sizeof(cfg));
+            RltSweep_applyPoint(&cfg, point);
+            switched = wimod.SetRadioConfig(&cfg);
+        }
+    }
+
+    if (switched && (millis() - switchTime >= dwellMs)) {
+        baseCfg.StoreNwmFlag = 0;
+        wimod.SetRadioConfig(&baseCfg);
+        switched = false;
+    }
+    return switched;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns true while the test setting is active
+ */
+bool WiMODLRBASE_PLUS_RltFollower::IsSwitched(void)
+{
+    return switched;
+}
+
+//------------------------------------------------------------------------------
+// EOF
+//------------------------------------------------------------------------------
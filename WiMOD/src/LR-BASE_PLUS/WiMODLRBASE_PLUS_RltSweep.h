@@ -0,0 +1,218 @@
+//------------------------------------------------------------------------------
+//! @file WiMODLRBASE_PLUS_RltSweep.h
+//! @ingroup WiMODLR_BASE_PLUS
+//! <!------------------------------------------------------------------------->
+//! @brief Declarations for a radio link test sweep over radio settings
+//! @version 0.1
+//! <!------------------------------------------------------------------------->
+//!
+//! Runs a radio link test (RLT) for each combination of the selected
+//! modulations, bandwidths, spreading factors, error codings and power
+//! levels, and keeps the counters, RSSI and SNR of each run in a fixed size
+//! result table.
+//!
+//! Both ends have to use the same setting for a test, so the peer runs a
+//! WiMODLRBASE_PLUS_RltFollower. Before each test point the sweep sends the
+//! setting to the peer as C-Data on the base (start) config:
+//!
+//! Command:    | 0x53 | point | modulation | bandwidth | sf | coding | power | dwell [100 ms] (16 bit) |
+//!
+//! The follower switches once its ack is out, and returns to the base config
+//! when the dwell time is over. The sweep runs the test in between and
+//! switches back, too.
+//!
+//------------------------------------------------------------------------------
+
+
+#ifndef ARDUINO_WIMODLRBASE_PLUS_RLTSWEEP_H_
+#define ARDUINO_WIMODLRBASE_PLUS_RLTSWEEP_H_
+
+//------------------------------------------------------------------------------
+//
+// Section Includes Files
+//
+//------------------------------------------------------------------------------
+
+#include "../WiMODLR_BASE_PLUS.h"
+
+//------------------------------------------------------------------------------
+//
+// Section defines
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+#define WIMOD_RLT_SWEEP_CMD_ID                      0x53
+#define WIMOD_RLT_SWEEP_CMD_SIZE                    9
+
+#define WIMOD_RLT_SWEEP_DEFAULT_PACKET_SIZE         32
+#define WIMOD_RLT_SWEEP_DEFAULT_NUM_PACKETS         20
+#define WIMOD_RLT_SWEEP_CMD_RETRIES                 3
+#define WIMOD_RLT_SWEEP_SWITCH_DELAY                100                         // ms for the peer to switch
+#define WIMOD_RLT_SWEEP_GUARD_TIME                  500                         // ms added to the dwell time
+#define WIMOD_RLT_SWEEP_MAX_POWER_LEVELS            4
+
+#ifndef WIMOD_RLT_SWEEP_MAX_POINTS
+#define WIMOD_RLT_SWEEP_MAX_POINTS                  48
+#endif
+//! @endcond
+
+/**
+ * @brief State of a sweep point
+ */
+typedef enum TWiMODLR_RltPointStatus
+{
+    RltPoint_Pending = 0,                                                       /*!< not tested yet */
+    RltPoint_Done,                                                              /*!< test finished */
+    RltPoint_NoPeer,                                                            /*!< peer did not ack the command */
+    RltPoint_Error,                                                             /*!< config or RLT rejected */
+} TWiMODLR_RltPointStatus;
+
+/**
+ * @brief One point of the sweep and its results
+ *
+ * Bandwidth is the LoRa, FLRC or FSK bandwidth enum, depending on the
+ * modulation; ErrorCoding the LoRa or FLRC coding (unused for FSK).
+ * PerMilli is the worse of the two directions in 1/1000.
+ */
+typedef struct TWiMODLR_RltSweepResult
+{
+    UINT8       Modulation;                                                     /*!< TRadioCfg_ModulationPlus */
+    UINT8       Bandwidth;                                                      /*!< bandwidth enum of the modulation */
+    UINT8       SpreadingFactor;                                                /*!< TRadioCfg_LoRaSpreadingFactorPlus */
+    UINT8       ErrorCoding;                                                    /*!< coding enum of the modulation */
+    INT8        PowerLevel;                                                     /*!< TRadioCfg_PowerLevelPlus [dBm] */
+    UINT8       Status;                                                         /*!< TWiMODLR_RltPointStatus */
+    UINT16      LocalTx;                                                        /*!< packets sent to the peer */
+    UINT16      LocalRx;                                                        /*!< replies received */
+    UINT16      PeerTx;                                                         /*!< replies sent by the peer */
+    UINT16      PeerRx;                                                         /*!< packets received by the peer */
+    INT16       LocalRssi;                                                      /*!< [dBm] */
+    INT16       PeerRssi;                                                       /*!< [dBm] */
+    INT8        LocalSnr;                                                       /*!< [dB] */
+    INT8        PeerSnr;                                                        /*!< [dB] */
+    UINT16      PerMilli;                                                       /*!< packet error rate [1/1000] */
+    UINT32      Throughput;                                                     /*!< net bit rate x (1 - PER) [bit/s] */
+} TWiMODLR_RltSweepResult;
+
+
+//------------------------------------------------------------------------------
+//
+// Section class
+//
+//------------------------------------------------------------------------------
+
+/**
+ * @brief Radio link test sweep (LR-BASE PLUS firmware)
+ *
+ * The grid is given as bit masks of the enum values, e.g. a LoRa SF mask of
+ * (1 << 7) | (1 << 9) for SF7 and SF9. Feed the converted RLT status, RX Ack
+ * and Ack Timeout indications into the Process...() functions and call
+ * Process() from the main loop.
+ */
+class WiMODLRBASE_PLUS_RltSweep {
+public:
+    WiMODLRBASE_PLUS_RltSweep(WiMODLRBASE_PLUS& wimod);
+    ~WiMODLRBASE_PLUS_RltSweep(void);
+
+    void        Clear(void);
+    void        SetLoRaGrid(UINT16 sfMask, UINT8 bandwidthMask, UINT8 codingMask);
+    void        SetFlrcGrid(UINT8 bandwidthMask, UINT8 codingMask);
+    void        SetFskGrid(UINT16 bandwidthMask);
+    void        SetPowerLevels(const INT8* levels, UINT8 numLevels);
+    void        SetTest(UINT8 packetSize, UINT16 numPackets);
+
+    bool        Start(UINT8 peerGroupAddress, UINT16 peerDeviceAddress);
+    bool        Process(void);
+    void        Abort(void);
+    bool        IsRunning(void);
+
+    void        ProcessRltStatus(const TWiMODLR_RLT_Status& status);
+    void        ProcessAck(void);
+    void        ProcessAckTimeout(void);
+
+    UINT8       GetNumResults(void);
+    const TWiMODLR_RltSweepResult* GetResult(UINT8 index);
+    const TWiMODLR_RltSweepResult* GetBest(UINT16 maxPerMilli);
+    void        PrintResults(Stream& s);
+
+protected:
+    //! @cond Doxygen_Suppress
+    typedef enum TSweepState
+    {
+        Sweep_Idle = 0,
+        Sweep_SendCmd,
+        Sweep_WaitAck,
+        Sweep_Switch,
+        Sweep_Testing,
+        Sweep_WaitPeer,
+    } TSweepState;
+
+    void        buildPoints(void);
+    bool        addPoint(UINT8 modulation, UINT8 bandwidth, UINT8 sf, UINT8 coding, INT8 power);
+    UINT32      estimateDwell(const TWiMODLR_RltSweepResult& point);
+    void        finishPoint(TWiMODLR_RltPointStatus status);
+    void        nextPoint(void);
+    //! @endcond
+private:
+    //! @cond Doxygen_Suppress
+    WiMODLRBASE_PLUS&               wimod;
+    TWiMODLR_DevMgmt_RadioConfigPlus baseCfg;
+    TWiMODLR_RadioLink_Msg          cmdMsg;
+    TWiMODLR_RltSweepResult         results[WIMOD_RLT_SWEEP_MAX_POINTS];
+    UINT8                           numResults;
+
+    UINT16                          loraSfMask;
+    UINT8                           loraBwMask;
+    UINT8                           loraCrMask;
+    UINT8                           flrcBwMask;
+    UINT8                           flrcCrMask;
+    UINT16                          fskBwMask;
+    INT8                            powerLevels[WIMOD_RLT_SWEEP_MAX_POWER_LEVELS];
+    UINT8                           numPowerLevels;
+    UINT8                           packetSize;
+    UINT16                          numPackets;
+
+    TSweepState                     state;
+    UINT8                           current;
+    UINT8                           retries;
+    UINT32                          stateTime;                                  // millis() of the last state change
+    UINT32                          peerTime;                                   // millis() the peer switched
+    UINT32                          dwellMs;
+    bool                            statusSeen;
+    //! @endcond
+};
+
+
+/**
+ * @brief Peer side of the radio link test sweep
+ *
+ * Feed the converted RX C-Data and TX Ack indications into ProcessRxData()
+ * and ProcessAckTx(); call Process() from the main loop. The RLT replies are
+ * sent by the firmware itself.
+ */
+class WiMODLRBASE_PLUS_RltFollower {
+public:
+    WiMODLRBASE_PLUS_RltFollower(WiMODLRBASE_PLUS& wimod);
+    ~WiMODLRBASE_PLUS_RltFollower(void);
+
+    bool        ProcessRxData(const TWiMODLR_RadioLink_Msg& rxMsg);
+    void        ProcessAckTx(void);
+    bool        Process(void);
+    bool        IsSwitched(void);
+
+private:
+    //! @cond Doxygen_Suppress
+    WiMODLRBASE_PLUS&               wimod;
+    TWiMODLR_DevMgmt_RadioConfigPlus baseCfg;
+    TWiMODLR_RltSweepResult         point;
+    UINT32                          dwellMs;
+    UINT32                          switchTime;
+    bool                            pending;                                    // command received, ack not sent yet
+    bool                            ackSent;                                    // switch in the next Process()
+    bool                            switched;
+    //! @endcond
+};
+
+
+#endif /* ARDUINO_WIMODLRBASE_PLUS_RLTSWEEP_H_ */
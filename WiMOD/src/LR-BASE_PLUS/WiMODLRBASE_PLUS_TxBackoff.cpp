@@ -0,0 +1,512 @@
+//------------------------------------------------------------------------------
+//! @file WiMODLRBASE_PLUS_TxBackoff.cpp
+//! @ingroup WiMODLR_BASE_PLUS
+//! <!------------------------------------------------------------------------->
+//! @brief LBT aware transmit backoff engine
+//! @version 0.1
+//! <!------------------------------------------------------------------------->
+//!
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+//
+// Section Includes Files
+//
+//------------------------------------------------------------------------------
+
+#include "WiMODLRBASE_PLUS_TxBackoff.h"
+
+#include <string.h>
+
+//------------------------------------------------------------------------------
+//
+// Section public functions
+//
+//------------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Constructor
+ *
+ * @param wimod     reference to the LR-BASE PLUS interface
+ */
+WiMODLRBASE_PLUS_TxBackoff::WiMODLRBASE_PLUS_TxBackoff(WiMODLRBASE_PLUS& wimod) :
+    wimod(wimod)
+{
+    memset(dests, 0x00, sizeof(dests));
+    nextDest      = 0;
+    inFlight      = NULL;
+    awaitingAck   = false;
+    sendTime      = 0;
+    holdUntil     = 0;
+
+    backoffBase   = WIMOD_TXBO_DEFAULT_BACKOFF_BASE;
+    backoffMax    = WIMOD_TXBO_DEFAULT_BACKOFF_MAX;
+    maxAttempts   = WIMOD_TXBO_DEFAULT_MAX_ATTEMPTS;
+    txIndications = true;
+
+    statusPoll    = WIMOD_TXBO_DEFAULT_STATUS_POLL;
+    statusTime    = 0;
+    lastMediaBusy = 0;
+    statusValid   = false;
+
+    ResetStats();
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Destructor
+ */
+WiMODLRBASE_PLUS_TxBackoff::~WiMODLRBASE_PLUS_TxBackoff(void)
+{
+
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Reads the radio config of the module
+ *
+ * Without HCI TX indications (DEVMGMT_RADIO_CFG_MISC_HCI_TX_IND_ENABLED) a
+ * U-Data frame counts as delivered once the module accepted it; busy
+ * events at air time are then only seen through the status poll.
+ *
+ * @retval true     if the config could be read
+ */
+bool WiMODLRBASE_PLUS_TxBackoff::Begin(void)
+{
+    TWiMODLR_DevMgmt_RadioConfigPlus radioCfg;
+
+    if (!wimod.GetRadioConfig(&radioCfg)) {
+        return false;
+    }
+    txIndications = (radioCfg.MiscOptions & DEVMGMT_RADIO_CFG_MISC_HCI_TX_IND_ENABLED) != 0;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Sets the backoff parameters
+ *
+ * @param baseMs        window of the first retry; doubled per failed attempt
+ *
+ * @param maxMs         max. backoff window
+ *
+ * @param maxAttempts   failed attempts after which a frame is dropped
+ */
+void WiMODLRBASE_PLUS_TxBackoff::SetBackoff(UINT16 baseMs, UINT16 maxMs, UINT8 maxAttempts)
+{
+    backoffBase       = MAX(baseMs, 1);
+    backoffMax        = MAX(maxMs, backoffBase);
+    this->maxAttempts = MAX(maxAttempts, 1);
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Sets the interval for reading TxMediaBusyEvents (0: off)
+ */
+void WiMODLRBASE_PLUS_TxBackoff::SetStatusPoll(UINT16 intervalMs)
+{
+    statusPoll  = intervalMs;
+    statusValid = false;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Queues a frame for a destination
+ *
+ * @param dstGroup      destination group address
+ *
+ * @param dstDevice     destination device address
+ *
+ * @param data          payload
+ *
+ * @param length        payload length (max. WIMOD_RADIOLINK_PAYLOAD_LEN)
+ *
+ * @param confirmed     send as C-Data
+ *
+ * @retval true     if the frame has been queued
+ */
+bool WiMODLRBASE_PLUS_TxBackoff::Send(UINT8 dstGroup, UINT16 dstDevice, const UINT8* data, UINT8 length,
+                                      bool confirmed)
+{
+    TWiMODLR_TxBackoffDest*  dest;
+    TWiMODLR_TxBackoffFrame* frame;
+
+    if ((length > WIMOD_RADIOLINK_PAYLOAD_LEN) || (!data && length)) {
+        return false;
+    }
+
+    dest = findDest(dstGroup, dstDevice, true);
+    if (!dest || (dest->Count >= WIMOD_TXBO_QUEUE_SIZE)) {
+        stats.QueueFull++;
+        return false;
+    }
+
+    frame = &dest->Frames[(dest->First + dest->Count) % WIMOD_TXBO_QUEUE_SIZE];
+    frame->Msg.DestinationGroupAddress  = dstGroup;
+    frame->Msg.DestinationDeviceAddress = dstDevice;
+    frame->Msg.Length                   = length;
+    if (length) {
+        memcpy(frame->Msg.Payload, data, length);
+    }
+    frame->QueueTime = millis();
+    frame->Confirmed = confirmed;
+    dest->Count++;
+    stats.Queued++;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Sends the next due frame; call from the main loop
+ *
+ * Destinations take turns; one frame is on its way at a time.
+ *
+ * @retval true     if a frame has been handed to the module
+ */
+bool WiMODLRBASE_PLUS_TxBackoff::Process(TWiMODLRResultCodes* hciResult, UINT8* rspStatus)
+{
+    TWiMODLRResultCodes      localHciRes    = WiMODLR_RESULT_TRANMIT_ERROR;
+    UINT8                    localStatusRsp = 0;
+    TWiMODLR_TxBackoffDest*  dest = NULL;
+    TWiMODLR_TxBackoffFrame* frame;
+    UINT32                   now  = millis();
+    UINT8                    i;
+    bool                     ok;
+
+    pollStatus(now);
+
+    if (inFlight) {
+        if (now - sendTime < WIMOD_TXBO_IND_TIMEOUT) {
+            return false;
+        }
+        // indication missing: U-Data went out, C-Data counts as not acked
+        if (awaitingAck) {
+            ProcessAckTimeout();
+        } else {
+            delivered(now);
+        }
+    }
+
+    if ((INT32) (now - holdUntil) < 0) {
+        return false;
+    }
+
+    for (i = 0; i < WIMOD_TXBO_MAX_DESTINATIONS; i++) {
+        TWiMODLR_TxBackoffDest* d = &dests[(nextDest + i) % WIMOD_TXBO_MAX_DESTINATIONS];
+
+        if ((d->Count > 0) && ((INT32) (now - d->NotBefore) >= 0)) {
+            dest     = d;
+            nextDest = (nextDest + i + 1) % WIMOD_TXBO_MAX_DESTINATIONS;
+            break;
+        }
+    }
+    if (!dest) {
+        return false;
+    }
+
+    frame = &dest->Frames[dest->First];
+    if (frame->Confirmed) {
+        ok = wimod.SendCData(&frame->Msg, &localHciRes, &localStatusRsp);
+    } else {
+        ok = wimod.SendUData(&frame->Msg, &localHciRes, &localStatusRsp);
+    }
+    if (hciResult) {
+        *hciResult = localHciRes;
+    }
+    if (rspStatus) {
+        *rspStatus = localStatusRsp;
+    }
+    stats.Attempts++;
+
+    if (!ok) {
+        if ((localHciRes == WiMODLR_RESULT_OK)
+                && ((localStatusRsp == RADIOLINK_STATUS_MEDIA_BUSY)
+                        || (localStatusRsp == RADIOLINK_STATUS_BUFFER_FULL))) {
+            busy(dest, now);
+        } else {
+            backoff(dest, now);
+        }
+        return false;
+    }
+
+    inFlight    = dest;
+    sendTime    = now;
+    awaitingAck = frame->Confirmed;
+    if (!frame->Confirmed && !txIndications) {
+        delivered(now);
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Processes the U-Data TX indication
+ */
+void WiMODLRBASE_PLUS_TxBackoff::ProcessUDataTxIndication(const TWiMODLR_RadioLink_UdataInd& txInd)
+{
+    UINT32 now = millis();
+
+    if (!inFlight || awaitingAck) {
+        return;
+    }
+    stats.AirtimeMs += txInd.AirTime;
+    if (txInd.Status == RADIOLINK_STATUS_OK) {
+        delivered(now);
+    } else if (txInd.Status == RADIOLINK_STATUS_MEDIA_BUSY) {
+        busy(inFlight, now);
+        inFlight = NULL;
+    } else {
+        backoff(inFlight, now);
+        inFlight = NULL;
+    }
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Processes the C-Data TX indication
+ *
+ * A C-Data frame that went out waits for the ack; one that did not is
+ * retried after a backoff.
+ */
+void WiMODLRBASE_PLUS_TxBackoff::ProcessCDataTxIndication(const TWiMODLR_RadioLink_CdataInd& txInd)
+{
+    UINT32 now = millis();
+
+    if (!inFlight || !awaitingAck) {
+        return;
+    }
+    stats.AirtimeMs += txInd.AirTime;
+    if (txInd.Status == RADIOLINK_STATUS_OK) {
+        return;
+    }
+    awaitingAck = false;
+    if (txInd.Status == RADIOLINK_STATUS_MEDIA_BUSY) {
+        busy(inFlight, now);
+    } else {
+        backoff(inFlight, now);
+    }
+    inFlight = NULL;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Processes the RX Ack indication of a C-Data frame
+ */
+void WiMODLRBASE_PLUS_TxBackoff::ProcessAck(void)
+{
+    if (inFlight && awaitingAck) {
+        delivered(millis());
+    }
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Processes the Ack Timeout indication of a C-Data frame
+ *
+ * Only the destination of the frame backs off.
+ */
+void WiMODLRBASE_PLUS_TxBackoff::ProcessAckTimeout(void)
+{
+    if (inFlight && awaitingAck) {
+        stats.AckTimeouts++;
+        awaitingAck = false;
+        backoff(inFlight, millis());
+        inFlight = NULL;
+    }
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the number of queued frames of all destinations
+ */
+UINT8 WiMODLRBASE_PLUS_TxBackoff::GetQueueDepth(void)
+{
+    UINT8 depth = 0;
+    UINT8 i;
+
+    for (i = 0; i < WIMOD_TXBO_MAX_DESTINATIONS; i++) {
+        depth += dests[i].Count;
+    }
+    return depth;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the number of queued frames of a destination
+ */
+UINT8 WiMODLRBASE_PLUS_TxBackoff::GetQueueDepth(UINT8 dstGroup, UINT16 dstDevice)
+{
+    TWiMODLR_TxBackoffDest* dest = findDest(dstGroup, dstDevice, false);
+
+    return dest ? dest->Count : 0;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the share of attempts refused for a busy channel [1/1000]
+ */
+UINT16 WiMODLRBASE_PLUS_TxBackoff::GetBusyRate(void)
+{
+    if (stats.Attempts == 0) {
+        return 0;
+    }
+    return (UINT16) MIN(((UINT64) stats.Busy * 1000) / stats.Attempts, 1000);
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the delivered payload since the last stats reset [byte/s]
+ */
+UINT32 WiMODLRBASE_PLUS_TxBackoff::GetThroughput(void)
+{
+    UINT32 elapsed = millis() - statsTime;
+
+    if (elapsed == 0) {
+        return 0;
+    }
+    return (UINT32) (((UINT64) stats.BytesDelivered * 1000) / elapsed);
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Copies the counters of the engine
+ */
+void WiMODLRBASE_PLUS_TxBackoff::GetStats(TWiMODLR_TxBackoffStats* stats)
+{
+    if (stats) {
+        memcpy(stats, &this->stats, sizeof(TWiMODLR_TxBackoffStats));
+    }
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Clears the counters and restarts the throughput measurement
+ */
+void WiMODLRBASE_PLUS_TxBackoff::ResetStats(void)
+{
+    memset(&stats, 0x00, sizeof(stats));
+    statsTime = millis();
+}
+
+//------------------------------------------------------------------------------
+//
+// Section protected functions
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+TWiMODLR_TxBackoffDest* WiMODLRBASE_PLUS_TxBackoff::findDest(UINT8 group, UINT16 device, bool create)
+{
+    TWiMODLR_TxBackoffDest* unused = NULL;
+    UINT8                   i;
+
+    for (i = 0; i < WIMOD_TXBO_MAX_DESTINATIONS; i++) {
+        TWiMODLR_TxBackoffDest* d = &dests[i];
+
+        // a slot without frames and backoff is free
+        if ((d->Count == 0) && (d->Attempts == 0) && (d != inFlight)) {
+            if (!unused) {
+                unused = d;
+            }
+            continue;
+        }
+        if ((d->GroupAddress == group) && (d->DeviceAddress == device)) {
+            return d;
+        }
+    }
+    if (!create || !unused) {
+        return NULL;
+    }
+
+    unused->GroupAddress  = group;
+    unused->DeviceAddress = device;
+    unused->First         = 0;
+    unused->Count         = 0;
+    unused->Attempts      = 0;
+    unused->NotBefore     = millis();
+    return unused;
+}
+
+void WiMODLRBASE_PLUS_TxBackoff::delivered(UINT32 now)
+{
+    TWiMODLR_TxBackoffDest*  dest  = inFlight;
+    TWiMODLR_TxBackoffFrame* frame = &dest->Frames[dest->First];
+    UINT32                   latency = now - frame->QueueTime;
+
+    stats.Delivered++;
+    stats.BytesDelivered += frame->Msg.Length;
+    stats.LatencySumMs   += latency;
+    stats.LatencyMaxMs    = MAX(stats.LatencyMaxMs, latency);
+
+    dest->First    = (dest->First + 1) % WIMOD_TXBO_QUEUE_SIZE;
+    dest->Count--;
+    dest->Attempts = 0;
+    inFlight       = NULL;
+    awaitingAck    = false;
+}
+
+// busy channel: the destination backs off, everybody waits a little
+void WiMODLRBASE_PLUS_TxBackoff::busy(TWiMODLR_TxBackoffDest* dest, UINT32 now)
+{
+    stats.Busy++;
+    hold(now);
+    backoff(dest, now);
+}
+
+void WiMODLRBASE_PLUS_TxBackoff::hold(UINT32 now)
+{
+    UINT32 until = now + 1 + (UINT32) random((long) backoffBase);
+
+    if ((INT32) (until - holdUntil) > 0) {
+        holdUntil = until;
+    }
+}
+
+void WiMODLRBASE_PLUS_TxBackoff::backoff(TWiMODLR_TxBackoffDest* dest, UINT32 now)
+{
+    UINT32 window;
+
+    if (++dest->Attempts >= maxAttempts) {
+        stats.Dropped++;
+        dest->First     = (dest->First + 1) % WIMOD_TXBO_QUEUE_SIZE;
+        dest->Count--;
+        dest->Attempts  = 0;
+        dest->NotBefore = now;
+        return;
+    }
+
+    window = (UINT32) backoffBase << MIN(dest->Attempts - 1, 16);
+    window = MIN(window, (UINT32) backoffMax);
+    dest->NotBefore = now + window / 2 + (UINT32) random((long) (window / 2 + 1));
+}
+
+void WiMODLRBASE_PLUS_TxBackoff::pollStatus(UINT32 now)
+{
+    TWiMODLR_DevMgmt_SystemStatusPlus status;
+    UINT32                            delta;
+
+    if ((statusPoll == 0) || (statusValid && (now - statusTime < statusPoll))) {
+        return;
+    }
+    statusTime = now;
+    if (!wimod.GetSystemStatus(&status)) {
+        return;
+    }
+
+    if (statusValid) {
+        delta = status.TxMediaBusyEvents - lastMediaBusy;
+        stats.MediaBusyEvents += delta;
+        if (delta > 0) {
+            // the channel was busy recently; keep the next attempt apart
+            hold(now);
+        }
+    }
+    lastMediaBusy = status.TxMediaBusyEvents;
+    statusValid   = true;
+}
+//! @endcond
+
+//------------------------------------------------------------------------------
+// EOF
+//------------------------------------------------------------------------------
@@ -0,0 +1,176 @@
+//------------------------------------------------------------------------------
+//! @file WiMODLRBASE_PLUS_TxBackoff.h
+//! @ingroup WiMODLR_BASE_PLUS
+//! <!------------------------------------------------------------------------->
+//! @brief Declarations for an LBT aware transmit backoff engine
+//! @version 0.1
+//! <!------------------------------------------------------------------------->
+//!
+//! With LBT enabled (LRBASE_PLUS_TxCtrl_LBT_On, LbtThreshold) the module
+//! refuses to send on a busy channel: the send request is answered with
+//! MEDIA_BUSY / BUFFER_FULL, or the TX indication reports MEDIA_BUSY. The
+//! engine queues frames per destination and retries them after a random,
+//! exponentially growing backoff ("equal jitter": half the window fixed,
+//! half random). Every destination has its own queue and backoff, so a
+//! peer that does not ack C-Data does not hold up frames for the others.
+//! A busy channel additionally pauses all destinations for a short random
+//! time.
+//!
+//! Busy events the engine cannot see (TX indications disabled) are picked
+//! up from the TxMediaBusyEvents counter of GetSystemStatus(), polled at a
+//! configurable interval.
+//!
+//------------------------------------------------------------------------------
+
+
+#ifndef ARDUINO_WIMODLRBASE_PLUS_TXBACKOFF_H_
+#define ARDUINO_WIMODLRBASE_PLUS_TXBACKOFF_H_
+
+//------------------------------------------------------------------------------
+//
+// Section Includes Files
+//
+//------------------------------------------------------------------------------
+
+#include "../WiMODLR_BASE_PLUS.h"
+
+//------------------------------------------------------------------------------
+//
+// Section defines
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+#define WIMOD_TXBO_DEFAULT_BACKOFF_BASE             20                          // ms
+#define WIMOD_TXBO_DEFAULT_BACKOFF_MAX              5000                        // ms
+#define WIMOD_TXBO_DEFAULT_MAX_ATTEMPTS             8
+#define WIMOD_TXBO_DEFAULT_STATUS_POLL              0                           // ms, 0 = off
+#define WIMOD_TXBO_IND_TIMEOUT                      10000                       // ms without TX indication / ack
+
+#ifndef WIMOD_TXBO_MAX_DESTINATIONS
+#define WIMOD_TXBO_MAX_DESTINATIONS                 4
+#endif
+
+#ifndef WIMOD_TXBO_QUEUE_SIZE
+#define WIMOD_TXBO_QUEUE_SIZE                       3                           // frames per destination
+#endif
+//! @endcond
+
+/**
+ * @brief A queued frame
+ */
+typedef struct TWiMODLR_TxBackoffFrame
+{
+    TWiMODLR_RadioLink_Msg Msg;                                                 /*!< frame incl. destination */
+    UINT32      QueueTime;                                                      /*!< millis() of Send() */
+    bool        Confirmed;                                                      /*!< send as C-Data */
+} TWiMODLR_TxBackoffFrame;
+
+/**
+ * @brief Queue and backoff state of one destination
+ */
+typedef struct TWiMODLR_TxBackoffDest
+{
+    UINT8       GroupAddress;                                                   /*!< destination group address */
+    UINT16      DeviceAddress;                                                  /*!< destination device address */
+    UINT8       First;                                                          /*!< oldest frame */
+    UINT8       Count;                                                          /*!< queued frames */
+    UINT8       Attempts;                                                       /*!< failed attempts of the oldest frame */
+    UINT32      NotBefore;                                                      /*!< millis() of the next attempt */
+    TWiMODLR_TxBackoffFrame Frames[WIMOD_TXBO_QUEUE_SIZE];                      /*!< ring buffer */
+} TWiMODLR_TxBackoffDest;
+
+/**
+ * @brief Counters of the backoff engine
+ */
+typedef struct TWiMODLR_TxBackoffStats
+{
+    UINT32      Queued;                                                         /*!< frames accepted by Send() */
+    UINT32      QueueFull;                                                      /*!< frames refused by Send() */
+    UINT32      Attempts;                                                       /*!< send requests to the module */
+    UINT32      Busy;                                                           /*!< attempts refused for a busy channel */
+    UINT32      AckTimeouts;                                                    /*!< C-Data without ack */
+    UINT32      Delivered;                                                      /*!< frames sent (U-Data) or acked (C-Data) */
+    UINT32      Dropped;                                                        /*!< frames given up */
+    UINT32      MediaBusyEvents;                                                /*!< TxMediaBusyEvents of the module (polled) */
+    UINT32      BytesDelivered;                                                 /*!< payload bytes delivered */
+    UINT32      AirtimeMs;                                                      /*!< sum of the reported airtime */
+    UINT32      LatencySumMs;                                                   /*!< Send() to delivery */
+    UINT32      LatencyMaxMs;                                                   /*!< max. Send() to delivery */
+} TWiMODLR_TxBackoffStats;
+
+
+//------------------------------------------------------------------------------
+//
+// Section class
+//
+//------------------------------------------------------------------------------
+
+/**
+ * @brief LBT aware transmit backoff engine (LR-BASE PLUS firmware)
+ *
+ * Queue frames with Send() and call Process() from the main loop. Feed the
+ * converted U-Data / C-Data TX indications and the RX Ack / Ack Timeout
+ * indications into the Process...() functions.
+ */
+class WiMODLRBASE_PLUS_TxBackoff {
+public:
+    WiMODLRBASE_PLUS_TxBackoff(WiMODLRBASE_PLUS& wimod);
+    ~WiMODLRBASE_PLUS_TxBackoff(void);
+
+    bool        Begin(void);
+    void        SetBackoff(UINT16 baseMs, UINT16 maxMs, UINT8 maxAttempts);
+    void        SetStatusPoll(UINT16 intervalMs);
+
+    bool        Send(UINT8 dstGroup, UINT16 dstDevice, const UINT8* data, UINT8 length, bool confirmed = false);
+    bool        Process(TWiMODLRResultCodes* hciResult = NULL, UINT8* rspStatus = NULL);
+
+    void        ProcessUDataTxIndication(const TWiMODLR_RadioLink_UdataInd& txInd);
+    void        ProcessCDataTxIndication(const TWiMODLR_RadioLink_CdataInd& txInd);
+    void        ProcessAck(void);
+    void        ProcessAckTimeout(void);
+
+    UINT8       GetQueueDepth(void);
+    UINT8       GetQueueDepth(UINT8 dstGroup, UINT16 dstDevice);
+    UINT16      GetBusyRate(void);
+    UINT32      GetThroughput(void);
+    void        GetStats(TWiMODLR_TxBackoffStats* stats);
+    void        ResetStats(void);
+
+protected:
+    //! @cond Doxygen_Suppress
+    TWiMODLR_TxBackoffDest* findDest(UINT8 group, UINT16 device, bool create);
+    void        delivered(UINT32 now);
+    void        busy(TWiMODLR_TxBackoffDest* dest, UINT32 now);
+    void        hold(UINT32 now);
+    void        backoff(TWiMODLR_TxBackoffDest* dest, UINT32 now);
+    void        pollStatus(UINT32 now);
+    //! @endcond
+private:
+    //! @cond Doxygen_Suppress
+    WiMODLRBASE_PLUS&       wimod;
+
+    TWiMODLR_TxBackoffDest  dests[WIMOD_TXBO_MAX_DESTINATIONS];
+    UINT8                   nextDest;                                           // round robin start
+    TWiMODLR_TxBackoffDest* inFlight;                                           // waiting for indication / ack
+    bool                    awaitingAck;
+    UINT32                  sendTime;                                           // millis() of the last send request
+    UINT32                  holdUntil;                                          // channel busy: all destinations wait
+
+    UINT16                  backoffBase;
+    UINT16                  backoffMax;
+    UINT8                   maxAttempts;
+    bool                    txIndications;                                      // module sends TX indications
+
+    UINT16                  statusPoll;
+    UINT32                  statusTime;
+    UINT32                  lastMediaBusy;
+    bool                    statusValid;
+
+    UINT32                  statsTime;                                          // millis() of the stats reset
+    TWiMODLR_TxBackoffStats stats;
+    //! @endcond
+};
+
+
+#endif /* ARDUINO_WIMODLRBASE_PLUS_TXBACKOFF_H_ */
@@ -0,0 +1,443 @@
+//------------------------------------------------------------------------------
+//! @file WiMODLoRaWAN_ConfigApply.cpp
+//! @ingroup WiMODLoRaWAN
+//! <!------------------------------------------------------------------------->
+//! @brief Desired state config helper for the LoRaWAN firmware
+//! @version 0.1
+//! <!------------------------------------------------------------------------->
+//!
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+//
+// Section Includes Files
+//
+//------------------------------------------------------------------------------
+
+#include "WiMODLoRaWAN_ConfigApply.h"
+
+#include <string.h>
+
+//------------------------------------------------------------------------------
+//
+// Section public functions
+//
+//------------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Constructor
+ *
+ * @param wimod     reference to the LoRaWAN interface
+ */
+WiMODLoRaWAN_ConfigApply::WiMODLoRaWAN_ConfigApply(WiMODLoRaWAN& wimod) :
+    wimod(wimod)
+{
+    store = DevMgmt_ConfigStore_NVM;
+    Clear();
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Destructor
+ */
+WiMODLoRaWAN_ConfigApply::~WiMODLoRaWAN_ConfigApply(void)
+{
+
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Removes all declared fields
+ */
+void WiMODLoRaWAN_ConfigApply::Clear(void)
+{
+    memset(&radioStackCfg, 0x00, sizeof(radioStackCfg));
+    memset(&hciCfg, 0x00, sizeof(hciCfg));
+    rfGain         = 0;
+    linkAdrReqCfg  = LinkAdrCfg_Option_LoRaWAN_V1_0_2;
+    numTxPwrLimits = 0;
+    fieldMask      = 0;
+    diffFields     = 0;
+    numReads       = 0;
+    numWrites      = 0;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Selects the target memory for configs that support a StoreNwmFlag
+ *
+ * @param store     DevMgmt_ConfigStore_RAM or DevMgmt_ConfigStore_NVM
+ */
+void WiMODLoRaWAN_ConfigApply::SetStore(TWiMODLR_DevMgmt_ConfigStore store)
+{
+    this->store = store;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Declares the desired values of the radio stack config
+ *
+ * @param radioCfg  struct holding the desired values
+ *
+ * @param fields    LORAWAN_CFG_FIELD_* flags of the fields to enforce
+ */
+void WiMODLoRaWAN_ConfigApply::SetRadioStackConfig(const TWiMODLORAWAN_RadioStackConfig& radioCfg,
+                                                   UINT32 fields)
+{
+    radioStackCfg = radioCfg;
+    fieldMask     = (fieldMask & ~LORAWAN_CFG_FIELDS_RADIO_STACK)
+                  | (fields & LORAWAN_CFG_FIELDS_RADIO_STACK);
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Declares the desired values of the HCI config
+ *
+ * The StoreNwmFlag of the given struct is ignored; see SetStore().
+ *
+ * @param hciCfg    struct holding the desired values
+ *
+ * @param fields    LORAWAN_CFG_FIELD_HCI_* flags of the fields to enforce
+ */
+void WiMODLoRaWAN_ConfigApply::SetHciConfig(const TWiMODLR_DevMgmt_HciConfig& hciCfg,
+                                            UINT32 fields)
+{
+    this->hciCfg = hciCfg;
+    fieldMask    = (fieldMask & ~LORAWAN_CFG_FIELDS_HCI)
+                 | (fields & LORAWAN_CFG_FIELDS_HCI);
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Declares the desired rf gain of the custom config
+ */
+void WiMODLoRaWAN_ConfigApply::SetCustomConfig(INT8 rfGain)
+{
+    this->rfGain = rfGain;
+    fieldMask   |= LORAWAN_CFG_FIELD_RF_GAIN;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Declares the desired tx power limit of a single sub band
+ *
+ * @param subBandIndex  index of the sub band
+ *
+ * @param limitFlag     limit flag (on / off)
+ *
+ * @param limitValue    limit in dBm
+ *
+ * @retval true     if the entry has been stored
+ * @retval false    if no more entries are available
+ */
+bool WiMODLoRaWAN_ConfigApply::SetTxPowerLimit(UINT8 subBandIndex, UINT8 limitFlag, UINT8 limitValue)
+{
+    UINT8 i;
+
+    for (i = 0; i < numTxPwrLimits; i++) {
+        if (txPwrSubBand[i] == subBandIndex) {
+            break;
+        }
+    }
+    if (i >= WIMOD_CFG_APPLY_MAX_TX_PWR_LIMITS) {
+        return false;
+    }
+    if (i == numTxPwrLimits) {
+        numTxPwrLimits++;
+    }
+
+    txPwrSubBand[i] = subBandIndex;
+    txPwrFlag[i]    = limitFlag;
+    txPwrValue[i]   = limitValue;
+    fieldMask      |= LORAWAN_CFG_FIELD_TX_PWR_LIMIT;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Declares the desired LinkAdrReq config
+ */
+void WiMODLoRaWAN_ConfigApply::SetLinkAdrReqConfig(TWiMODLORAWAN_LinkAdrReqConfig linkAdrReqCfg)
+{
+    this->linkAdrReqCfg = linkAdrReqCfg;
+    fieldMask          |= LORAWAN_CFG_FIELD_LINK_ADR_REQ;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Brings the module into the declared state
+ *
+ * Every declared section is read exactly once; a set command is only issued
+ * if at least one declared field of that section differs. The procedure
+ * stops at the first failing command.
+ *
+ * @param hciResult Result of the failing (or last) local command transmission
+ *                  This is an optional parameter.
+ *
+ * @param rspStatus Status byte of the failing (or last) response
+ *                  This is an optional parameter.
+ *
+ * @retval true     if the module is in the declared state
+ *
+ * @code
+ * #include <LoRaWAN/WiMODLoRaWAN_ConfigApply.h>
+ *
+ * WiMODLoRaWAN_ConfigApply cfgApply(wimod);
+ *
+ * void setup() {
+ *  ...
+ *  radioCfg.DataRateIndex = LoRaWAN_DataRate_EU868_LoRa_SF9_125kHz;
+ *  radioCfg.Options       = LORAWAN_STK_OPTION_ADR;
+ *  cfgApply.SetRadioStackConfig(radioCfg, LORAWAN_CFG_FIELD_DATA_RATE
+ *                                       | LORAWAN_CFG_FIELD_OPTIONS);
+ *  cfgApply.SetStore(DevMgmt_ConfigStore_RAM);
+ *  cfgApply.Apply();
+ *
+ *  if (cfgApply.GetNumWrites() == 0) {
+ *      // nothing changed
+ *  }
+ * }
+ * @endcode
+ */
+bool WiMODLoRaWAN_ConfigApply::Apply(TWiMODLRResultCodes* hciResult, UINT8* rspStatus)
+{
+    diffFields = 0;
+    numReads   = 0;
+    numWrites  = 0;
+
+    return applyRadioStackConfig(hciResult, rspStatus)
+        && applyCustomConfig(hciResult, rspStatus)
+        && applyTxPowerLimits(hciResult, rspStatus)
+        && applyLinkAdrReqConfig(hciResult, rspStatus)
+        && applyHciConfig(hciResult, rspStatus);
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the LORAWAN_CFG_FIELD_* flags that differed during the last Apply()
+ */
+UINT32 WiMODLoRaWAN_ConfigApply::GetDiffFields(void)
+{
+    return diffFields;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the number of get commands issued by the last Apply()
+ */
+UINT8 WiMODLoRaWAN_ConfigApply::GetNumReads(void)
+{
+    return numReads;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the number of set commands issued by the last Apply()
+ */
+UINT8 WiMODLoRaWAN_ConfigApply::GetNumWrites(void)
+{
+    return numWrites;
+}
+
+//------------------------------------------------------------------------------
+//
+// Section protected functions
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+bool WiMODLoRaWAN_ConfigApply::applyRadioStackConfig(TWiMODLRResultCodes* hciResult, UINT8* rspStatus)
+{
+    TWiMODLORAWAN_RadioStackConfig current;
+    UINT32                         diff = 0;
+
+    if ((fieldMask & LORAWAN_CFG_FIELDS_RADIO_STACK) == 0) {
+        return true;
+    }
+
+    // sub band masks are only reported for US915
+    memset(&current, 0x00, sizeof(current));
+
+    numReads++;
+    if (!wimod.GetRadioStackConfig(&current, hciResult, rspStatus)) {
+        return false;
+    }
+
+    if (current.DataRateIndex != radioStackCfg.DataRateIndex) {
+        diff |= LORAWAN_CFG_FIELD_DATA_RATE;
+    }
+    if (current.TXPowerLevel != radioStackCfg.TXPowerLevel) {
+        diff |= LORAWAN_CFG_FIELD_TX_POWER;
+    }
+    if (current.Options != radioStackCfg.Options) {
+        diff |= LORAWAN_CFG_FIELD_OPTIONS;
+    }
+    if (current.PowerSavingMode != radioStackCfg.PowerSavingMode) {
+        diff |= LORAWAN_CFG_FIELD_POWER_SAVING;
+    }
+    if (current.Retransmissions != radioStackCfg.Retransmissions) {
+        diff |= LORAWAN_CFG_FIELD_RETRANSMISSIONS;
+    }
+    if (current.BandIndex != radioStackCfg.BandIndex) {
+        diff |= LORAWAN_CFG_FIELD_BAND_INDEX;
+    }
+    if ((current.SubBandMask1 != radioStackCfg.SubBandMask1)
+            || (current.SubBandMask2 != radioStackCfg.SubBandMask2)) {
+        diff |= LORAWAN_CFG_FIELD_SUB_BANDS;
+    }
+    diff &= fieldMask;
+
+    if (diff == 0) {
+        return true;
+    }
+    diffFields |= diff;
+
+    // merge the declared fields into the current config
+    if (diff & LORAWAN_CFG_FIELD_DATA_RATE)       current.DataRateIndex   = radioStackCfg.DataRateIndex;
+    if (diff & LORAWAN_CFG_FIELD_TX_POWER)        current.TXPowerLevel    = radioStackCfg.TXPowerLevel;
+    if (diff & LORAWAN_CFG_FIELD_OPTIONS)         current.Options         = radioStackCfg.Options;
+    if (diff & LORAWAN_CFG_FIELD_POWER_SAVING)    current.PowerSavingMode = radioStackCfg.PowerSavingMode;
+    if (diff & LORAWAN_CFG_FIELD_RETRANSMISSIONS) current.Retransmissions = radioStackCfg.Retransmissions;
+    if (diff & LORAWAN_CFG_FIELD_BAND_INDEX)      current.BandIndex       = radioStackCfg.BandIndex;
+    if (diff & LORAWAN_CFG_FIELD_SUB_BANDS) {
+        current.SubBandMask1 = radioStackCfg.SubBandMask1;
+        current.SubBandMask2 = radioStackCfg.SubBandMask2;
+    }
+
+    numWrites++;
+    return wimod.SetRadioStackConfig(&current, hciResult, rspStatus);
+}
+
+bool WiMODLoRaWAN_ConfigApply::applyCustomConfig(TWiMODLRResultCodes* hciResult, UINT8* rspStatus)
+{
+    INT8 current;
+
+    if ((fieldMask & LORAWAN_CFG_FIELD_RF_GAIN) == 0) {
+        return true;
+    }
+
+    numReads++;
+    if (!wimod.GetCustomConfig(&current, hciResult, rspStatus)) {
+        return false;
+    }
+    if (current == rfGain) {
+        return true;
+    }
+
+    diffFields |= LORAWAN_CFG_FIELD_RF_GAIN;
+    numWrites++;
+    return wimod.SetCustomConfig(rfGain, hciResult, rspStatus);
+}
+
+bool WiMODLoRaWAN_ConfigApply::applyTxPowerLimits(TWiMODLRResultCodes* hciResult, UINT8* rspStatus)
+{
+    TWiMODLORAWAN_TxPwrLimitConfig current;
+    TWiMODLORAWAN_TxPwrLimitConfig entry;
+    UINT8                          i;
+    UINT8                          j;
+
+    if ((fieldMask & LORAWAN_CFG_FIELD_TX_PWR_LIMIT) == 0) {
+        return true;
+    }
+
+    numReads++;
+    if (!wimod.GetTxPowerLimitConfig(&current, hciResult, rspStatus)) {
+        return false;
+    }
+
+    // the set command carries exactly one sub band
+    for (i = 0; i < numTxPwrLimits; i++) {
+        for (j = 0; j < current.NumOfEntries; j++) {
+            if (current.SubBandIndex[j] == txPwrSubBand[i]) {
+                break;
+            }
+        }
+        if ((j < current.NumOfEntries)
+                && (current.TxPwrLimitFlag[j] == txPwrFlag[i])
+                && (current.TxPwrLimitValue[j] == txPwrValue[i])) {
+            continue;
+        }
+
+        diffFields |= LORAWAN_CFG_FIELD_TX_PWR_LIMIT;
+
+        entry.SubBandIndex[0]    = txPwrSubBand[i];
+        entry.TxPwrLimitFlag[0]  = txPwrFlag[i];
+        entry.TxPwrLimitValue[0] = txPwrValue[i];
+
+        numWrites++;
+        if (!wimod.SetTxPowerLimitConfig(entry, hciResult, rspStatus)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool WiMODLoRaWAN_ConfigApply::applyLinkAdrReqConfig(TWiMODLRResultCodes* hciResult, UINT8* rspStatus)
+{
+    TWiMODLORAWAN_LinkAdrReqConfig current;
+
+    if ((fieldMask & LORAWAN_CFG_FIELD_LINK_ADR_REQ) == 0) {
+        return true;
+    }
+
+    numReads++;
+    if (!wimod.GetLinkAdrReqConfig(&current, hciResult, rspStatus)) {
+        return false;
+    }
+    if (current == linkAdrReqCfg) {
+        return true;
+    }
+
+    diffFields |= LORAWAN_CFG_FIELD_LINK_ADR_REQ;
+    numWrites++;
+    return wimod.SetLinkAdrReqConfig(linkAdrReqCfg, hciResult, rspStatus);
+}
+
+bool WiMODLoRaWAN_ConfigApply::applyHciConfig(TWiMODLRResultCodes* hciResult, UINT8* rspStatus)
+{
+    TWiMODLR_DevMgmt_HciConfig current;
+    UINT32                     diff = 0;
+
+    if ((fieldMask & LORAWAN_CFG_FIELDS_HCI) == 0) {
+        return true;
+    }
+
+    numReads++;
+    if (!wimod.GetHciConfig(&current, hciResult, rspStatus)) {
+        return false;
+    }
+
+    if (current.BaudrateID != hciCfg.BaudrateID) {
+        diff |= LORAWAN_CFG_FIELD_HCI_BAUDRATE;
+    }
+    if (current.NumWakeUpChars != hciCfg.NumWakeUpChars) {
+        diff |= LORAWAN_CFG_FIELD_HCI_WAKEUP_CHARS;
+    }
+    if (current.TxHoldTime != hciCfg.TxHoldTime) {
+        diff |= LORAWAN_CFG_FIELD_HCI_TX_HOLD_TIME;
+    }
+    if (current.RxHoldTime != hciCfg.RxHoldTime) {
+        diff |= LORAWAN_CFG_FIELD_HCI_RX_HOLD_TIME;
+    }
+    diff &= fieldMask;
+
+    if (diff == 0) {
+        return true;
+    }
+    diffFields |= diff;
+
+    if (diff & LORAWAN_CFG_FIELD_HCI_BAUDRATE)      current.BaudrateID     = hciCfg.BaudrateID;
+    if (diff & LORAWAN_CFG_FIELD_HCI_WAKEUP_CHARS)  current.NumWakeUpChars = hciCfg.NumWakeUpChars;
+    if (diff & LORAWAN_CFG_FIELD_HCI_TX_HOLD_TIME)  current.TxHoldTime     = hciCfg.TxHoldTime;
+    if (diff & LORAWAN_CFG_FIELD_HCI_RX_HOLD_TIME)  current.RxHoldTime     = hciCfg.RxHoldTime;
+    current.StoreNwmFlag = (UINT8) store;
+
+    numWrites++;
+    return wimod.SetHciConfig(&current, hciResult, rspStatus);
+}
+//! @endcond
+
+//------------------------------------------------------------------------------
+// EOF
+//------------------------------------------------------------------------------
@@ -0,0 +1,133 @@
+//------------------------------------------------------------------------------
+//! @file WiMODLoRaWAN_ConfigApply.h
+//! @ingroup WiMODLoRaWAN
+//! <!------------------------------------------------------------------------->
+//! @brief Declarations for a desired state config helper of the LoRaWAN firmware
+//! @version 0.1
+//! <!------------------------------------------------------------------------->
+//!
+//! The user declares the wanted values once; Apply() reads the current config
+//! of each declared section, compares it field by field and only sends the
+//! set commands for sections that actually differ. An unchanged module is
+//! configured by read commands only (no NVM write cycle).
+//!
+//------------------------------------------------------------------------------
+
+
+#ifndef ARDUINO_WIMODLORAWAN_CONFIGAPPLY_H_
+#define ARDUINO_WIMODLORAWAN_CONFIGAPPLY_H_
+
+//------------------------------------------------------------------------------
+//
+// Section Includes Files
+//
+//------------------------------------------------------------------------------
+
+#include "../WiMODLoRaWAN.h"
+
+//------------------------------------------------------------------------------
+//
+// Section defines
+//
+//------------------------------------------------------------------------------
+
+/*
+ * field flags; used for declaring the desired fields and for reporting the
+ * fields that differed during the last Apply()
+ */
+#define LORAWAN_CFG_FIELD_DATA_RATE                 0x00000001                  /*!< RadioStackConfig.DataRateIndex */
+#define LORAWAN_CFG_FIELD_TX_POWER                  0x00000002                  /*!< RadioStackConfig.TXPowerLevel */
+#define LORAWAN_CFG_FIELD_OPTIONS                   0x00000004                  /*!< RadioStackConfig.Options */
+#define LORAWAN_CFG_FIELD_POWER_SAVING              0x00000008                  /*!< RadioStackConfig.PowerSavingMode */
+#define LORAWAN_CFG_FIELD_RETRANSMISSIONS           0x00000010                  /*!< RadioStackConfig.Retransmissions */
+#define LORAWAN_CFG_FIELD_BAND_INDEX                0x00000020                  /*!< RadioStackConfig.BandIndex */
+#define LORAWAN_CFG_FIELD_SUB_BANDS                 0x00000040                  /*!< RadioStackConfig.SubBandMask1/2 (US915 only) */
+
+#define LORAWAN_CFG_FIELD_HCI_BAUDRATE              0x00000100                  /*!< HciConfig.BaudrateID */
+#define LORAWAN_CFG_FIELD_HCI_WAKEUP_CHARS          0x00000200                  /*!< HciConfig.NumWakeUpChars */
+#define LORAWAN_CFG_FIELD_HCI_TX_HOLD_TIME          0x00000400                  /*!< HciConfig.TxHoldTime */
+#define LORAWAN_CFG_FIELD_HCI_RX_HOLD_TIME          0x00000800                  /*!< HciConfig.RxHoldTime */
+
+#define LORAWAN_CFG_FIELD_RF_GAIN                   0x00010000                  /*!< CustomConfig rfGain */
+#define LORAWAN_CFG_FIELD_TX_PWR_LIMIT              0x00020000                  /*!< TxPowerLimitConfig (EU868 only) */
+#define LORAWAN_CFG_FIELD_LINK_ADR_REQ              0x00040000                  /*!< LinkAdrReqConfig */
+
+//! @cond Doxygen_Suppress
+#define LORAWAN_CFG_FIELDS_RADIO_STACK              0x0000007F
+#define LORAWAN_CFG_FIELDS_HCI                      0x00000F00
+
+#define WIMOD_CFG_APPLY_MAX_TX_PWR_LIMITS           8                           // max. declared sub bands
+//! @endcond
+
+
+//------------------------------------------------------------------------------
+//
+// Section class
+//
+//------------------------------------------------------------------------------
+
+/**
+ * @brief Desired state config helper for the LoRaWAN firmware
+ *
+ * Only declared fields are enforced; all other fields keep the value that
+ * is read from the module. Where the HCI supports a StoreNwmFlag (HCI config)
+ * the target memory is taken from SetStore(); the LoRaWAN stack configs have
+ * no such selector and are always persisted by the firmware.
+ *
+ * The HCI config is applied last, as a new baudrate takes effect immediately.
+ */
+class WiMODLoRaWAN_ConfigApply {
+public:
+    WiMODLoRaWAN_ConfigApply(WiMODLoRaWAN& wimod);
+    ~WiMODLoRaWAN_ConfigApply(void);
+
+    void        Clear(void);
+    void        SetStore(TWiMODLR_DevMgmt_ConfigStore store);
+
+    void        SetRadioStackConfig(const TWiMODLORAWAN_RadioStackConfig& radioCfg,
+                                    UINT32 fields = LORAWAN_CFG_FIELDS_RADIO_STACK);
+    void        SetHciConfig(const TWiMODLR_DevMgmt_HciConfig& hciCfg,
+                             UINT32 fields = LORAWAN_CFG_FIELDS_HCI);
+    void        SetCustomConfig(INT8 rfGain);
+    bool        SetTxPowerLimit(UINT8 subBandIndex, UINT8 limitFlag, UINT8 limitValue);
+    void        SetLinkAdrReqConfig(TWiMODLORAWAN_LinkAdrReqConfig linkAdrReqCfg);
+
+    bool        Apply(TWiMODLRResultCodes* hciResult = NULL, UINT8* rspStatus = NULL);
+
+    UINT32      GetDiffFields(void);
+    UINT8       GetNumReads(void);
+    UINT8       GetNumWrites(void);
+
+protected:
+    //! @cond Doxygen_Suppress
+    bool        applyRadioStackConfig(TWiMODLRResultCodes* hciResult, UINT8* rspStatus);
+    bool        applyCustomConfig(TWiMODLRResultCodes* hciResult, UINT8* rspStatus);
+    bool        applyTxPowerLimits(TWiMODLRResultCodes* hciResult, UINT8* rspStatus);
+    bool        applyLinkAdrReqConfig(TWiMODLRResultCodes* hciResult, UINT8* rspStatus);
+    bool        applyHciConfig(TWiMODLRResultCodes* hciResult, UINT8* rspStatus);
+    //! @endcond
+private:
+    //! @cond Doxygen_Suppress
+    WiMODLoRaWAN&                   wimod;
+
+    UINT32                          fieldMask;
+    UINT32                          diffFields;
+    TWiMODLR_DevMgmt_ConfigStore    store;
+
+    TWiMODLORAWAN_RadioStackConfig  radioStackCfg;
+    TWiMODLR_DevMgmt_HciConfig      hciCfg;
+    INT8                            rfGain;
+    TWiMODLORAWAN_LinkAdrReqConfig  linkAdrReqCfg;
+
+    UINT8                           numTxPwrLimits;
+    UINT8                           txPwrSubBand[WIMOD_CFG_APPLY_MAX_TX_PWR_LIMITS];
+    UINT8                           txPwrFlag[WIMOD_CFG_APPLY_MAX_TX_PWR_LIMITS];
+    UINT8                           txPwrValue[WIMOD_CFG_APPLY_MAX_TX_PWR_LIMITS];
+
+    UINT8                           numReads;
+    UINT8                           numWrites;
+    //! @endcond
+};
+
+
+#endif /* ARDUINO_WIMODLORAWAN_CONFIGAPPLY_H_ */
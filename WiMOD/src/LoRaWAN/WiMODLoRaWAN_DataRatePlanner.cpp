@@ -0,0 +1,487 @@
+//------------------------------------------------------------------------------
+//! @file WiMODLoRaWAN_DataRatePlanner.cpp
+//! @ingroup WiMODLoRaWAN
+//! <!------------------------------------------------------------------------->
+//! @brief Host side data rate / tx power planner for the LoRaWAN firmware
+//! @version 0.1
+//! <!------------------------------------------------------------------------->
+//!
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+//
+// Section Includes Files
+//
+//------------------------------------------------------------------------------
+
+#include "WiMODLoRaWAN_DataRatePlanner.h"
+
+#include <string.h>
+
+//------------------------------------------------------------------------------
+//
+// Section local data
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+
+/*
+ * demodulation floor in dB for DR0 ... DR7 (EU868 style numbering);
+ * the fractional values of the SX127x datasheet are rounded up
+ */
+static const INT8 DefaultRequiredSnr[WIMOD_DR_PLANNER_MAX_DATA_RATES] = {
+    -20,    // SF12 / 125kHz
+    -17,    // SF11 / 125kHz
+    -15,    // SF10 / 125kHz
+    -12,    // SF9  / 125kHz
+    -10,    // SF8  / 125kHz
+     -7,    // SF7  / 125kHz
+     -4,    // SF7  / 250kHz
+     10,    // FSK
+};
+
+/*
+ * delivery probability in percent for a link margin of -6 ... +6 dB
+ * (logistic curve with a slope of ~1.5 dB)
+ */
+static const UINT8 MarginToDelivery[] = {
+    2, 5, 9, 15, 24, 36, 50, 64, 76, 85, 91, 95, 98
+};
+
+#define MARGIN_TABLE_OFFSET     6
+#define MARGIN_TABLE_SIZE       ((INT16) sizeof(MarginToDelivery))
+
+//! @endcond
+
+//------------------------------------------------------------------------------
+//
+// Section public functions
+//
+//------------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Constructor
+ *
+ * @param wimod     reference to the (already initialised) LoRaWAN interface
+ */
+WiMODLoRaWAN_DataRatePlanner::WiMODLoRaWAN_DataRatePlanner(WiMODLoRaWAN& wimod) :
+    wimod(wimod)
+{
+    memset(&appliedCfg, 0x00, sizeof(appliedCfg));
+    memset(stats, 0x00, sizeof(stats));
+    memcpy(requiredSnr, DefaultRequiredSnr, sizeof(requiredSnr));
+
+    snrEwma              = 0;
+    snrValid             = false;
+    minDr                = 0;
+    maxDr                = 0;
+    minPower             = LORAWAN_TX_POWER_LEVEL_MIN;
+    maxPower             = LORAWAN_TX_POWER_LEVEL_MAX;
+    powerStep            = WIMOD_DR_PLANNER_DEFAULT_POWER_STEP;
+    target               = WIMOD_DR_PLANNER_DEFAULT_TARGET;
+    holdOff              = WIMOD_DR_PLANNER_DEFAULT_HOLD_OFF;
+    lastTxDr             = 0;
+    pendingTxPackets     = 0;
+    pendingConfirmed     = false;
+    uplinksSinceFeedback = 0;
+    uplinksSinceChange   = 0;
+    configWrites         = 0;
+    isActive             = false;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Destructor
+ */
+WiMODLoRaWAN_DataRatePlanner::~WiMODLoRaWAN_DataRatePlanner(void)
+{
+
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Reads the current radio stack config once and sets the planning range
+ *
+ * The configuration read here is cached; later changes are written back
+ * only if the planner decides to use another data rate or power level.
+ *
+ * @param minDataRate   slowest (most robust) data rate index to use
+ *
+ * @param maxDataRate   fastest data rate index to use
+ *
+ * @param minTxPower    lowest tx power level in dBm
+ *
+ * @param maxTxPower    highest tx power level in dBm
+ *
+ * @param hciResult Result of the local command transmission to module
+ *                  This is an optional parameter.
+ *
+ * @param rspStatus Status byte contained in the local response of the module
+ *                  This is an optional parameter.
+ *
+ * @retval true     if everything is ok
+ * @retval false    if something went wrong; see hciResult & rspStatus for details
+ *
+ * @code
+ * WiMODLoRaWAN wimod(Serial3);
+ * WiMODLoRaWAN_DataRatePlanner planner(wimod);
+ *
+ * void setup() {
+ *  ...
+ *  // SF12 ... SF7, 2 ... 16 dBm
+ *  planner.begin(LoRaWAN_DataRate_EU868_LoRa_SF12_125kHz,
+ *                LoRaWAN_DataRate_EU868_LoRa_SF7_125kHz, 2, 16);
+ * }
+ *
+ * void loop() {
+ *  ...
+ *  planner.PrepareUplink();
+ *  wimod.SendUData(&txData);
+ * }
+ * @endcode
+ */
+bool WiMODLoRaWAN_DataRatePlanner::begin(UINT8 minDataRate, UINT8 maxDataRate,
+                                         UINT8 minTxPower, UINT8 maxTxPower,
+                                         TWiMODLRResultCodes* hciResult,
+                                         UINT8*              rspStatus)
+{
+    minDr    = MIN(minDataRate, (UINT8)(WIMOD_DR_PLANNER_MAX_DATA_RATES - 1));
+    maxDr    = MIN(MAX(maxDataRate, minDr), (UINT8)(WIMOD_DR_PLANNER_MAX_DATA_RATES - 1));
+    minPower = MIN(minTxPower, (UINT8) LORAWAN_TX_POWER_LEVEL_MAX);
+    maxPower = MIN(MAX(maxTxPower, minPower), (UINT8) LORAWAN_TX_POWER_LEVEL_MAX);
+
+    isActive = wimod.GetRadioStackConfig(&appliedCfg, hciResult, rspStatus);
+    lastTxDr = appliedCfg.DataRateIndex;
+
+    return isActive;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Sets the delivery ratio (in percent) the selected data rate must reach
+ */
+void WiMODLoRaWAN_DataRatePlanner::SetTargetDeliveryRatio(UINT8 percent)
+{
+    target = MIN(percent, (UINT8) 100);
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Sets the number of uplinks that must pass before a faster setting is used
+ *
+ * Changes towards a more robust setting are always applied immediately.
+ */
+void WiMODLoRaWAN_DataRatePlanner::SetHoldOff(UINT8 uplinks)
+{
+    holdOff = uplinks;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Sets the granularity used for tx power reduction
+ */
+void WiMODLoRaWAN_DataRatePlanner::SetTxPowerStep(UINT8 stepDb)
+{
+    powerStep = MAX(stepDb, (UINT8) 1);
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Overrides the demodulation floor (SNR in dB) for a data rate index
+ */
+void WiMODLoRaWAN_DataRatePlanner::SetRequiredSnr(UINT8 dataRate, INT8 snrDb)
+{
+    if (dataRate < WIMOD_DR_PLANNER_MAX_DATA_RATES) {
+        requiredSnr[dataRate] = snrDb;
+    }
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Feeds a converted RX U-Data / C-Data indication into the link model
+ */
+void WiMODLoRaWAN_DataRatePlanner::ProcessRxData(const TWiMODLORAWAN_RX_Data& rxData)
+{
+    updateSnr(rxData.SNR, rxData.OptionalInfoAvaiable);
+
+    if ((rxData.StatusFormat & LORAWAN_FORMAT_ACK_RECEIVED) && pendingConfirmed) {
+        recordOutcome(lastTxDr, pendingTxPackets ? pendingTxPackets - 1 : 0, true);
+        pendingConfirmed = false;
+    }
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Feeds a converted RX ACK indication into the link model
+ */
+void WiMODLoRaWAN_DataRatePlanner::ProcessRxAck(const TWiMODLORAWAN_RX_ACK_Data& ackData)
+{
+    updateSnr(ackData.SNR, ackData.OptionalInfoAvaiable);
+
+    if (pendingConfirmed) {
+        recordOutcome(lastTxDr, pendingTxPackets ? pendingTxPackets - 1 : 0, true);
+        pendingConfirmed = false;
+    }
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Feeds a converted TX U-Data / C-Data indication into the link model
+ *
+ * @param txInd     converted tx indication
+ *
+ * @param confirmed true if the indication belongs to a C-Data transmission
+ */
+void WiMODLoRaWAN_DataRatePlanner::ProcessTxIndication(const TWiMODLORAWAN_TxIndData& txInd,
+                                                       bool confirmed)
+{
+    UINT8 numTx = 1;
+
+    if (txInd.FieldAvailability != LORAWAN_OPT_TX_IND_INFOS_NOT_AVAILABLE) {
+        lastTxDr = txInd.DataRateIndex;
+    }
+    if (txInd.FieldAvailability == LORAWAN_OPT_TX_IND_INFOS_INCL_PKT_CNT) {
+        numTx = MAX(txInd.NumTxPackets, (UINT8) 1);
+    }
+
+    if (!confirmed) {
+        return;
+    }
+
+    if (txInd.StatusFormat & LORAWAN_DATA_TX_IND_FORMAT_STATUS_ERR_MAX_RETRANS) {
+        recordOutcome(lastTxDr, numTx, false);
+        pendingConfirmed = false;
+    } else {
+        pendingTxPackets = numTx;
+        pendingConfirmed = true;
+    }
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Selects data rate and tx power for the next uplink
+ *
+ * The radio stack config is only written if the decision differs from the
+ * cached config. Faster settings are delayed by the hold off period, so a
+ * single good downlink does not cause a config write for every uplink.
+ *
+ * @param hciResult Result of the local command transmission to module
+ *                  This is an optional parameter.
+ *
+ * @param rspStatus Status byte contained in the local response of the module
+ *                  This is an optional parameter.
+ *
+ * @retval true     if no write was necessary or the write was ok
+ * @retval false    if the config write failed; see hciResult & rspStatus for details
+ */
+bool WiMODLoRaWAN_DataRatePlanner::PrepareUplink(TWiMODLRResultCodes* hciResult,
+                                                 UINT8*              rspStatus)
+{
+    TWiMODLORAWAN_RadioStackConfig cfg;
+    UINT8                          dr;
+    UINT8                          power;
+    bool                           robust;
+    bool                           result = true;
+
+    if (!isActive) {
+        return false;
+    }
+
+    plan(&dr, &power);
+
+    if ((dr != appliedCfg.DataRateIndex) || (power != appliedCfg.TXPowerLevel)) {
+        robust = (dr < appliedCfg.DataRateIndex)
+              || ((dr == appliedCfg.DataRateIndex) && (power > appliedCfg.TXPowerLevel));
+
+        if (robust || (uplinksSinceChange >= holdOff)) {
+            cfg               = appliedCfg;
+            cfg.DataRateIndex = dr;
+            cfg.TXPowerLevel  = power;
+
+            result = wimod.SetRadioStackConfig(&cfg, hciResult, rspStatus);
+            if (result) {
+                appliedCfg.DataRateIndex = dr;
+                appliedCfg.TXPowerLevel  = power;
+                uplinksSinceChange       = 0;
+                configWrites++;
+            }
+        }
+    }
+
+    if (uplinksSinceChange < 0xFF) {
+        uplinksSinceChange++;
+    }
+    if (uplinksSinceFeedback < 0xFF) {
+        uplinksSinceFeedback++;
+    }
+    return result;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the estimated delivery ratio in percent for a setting
+ *
+ * The estimate blends the SNR based link budget model with the decayed
+ * statistic of confirmed transmissions at the given data rate.
+ */
+UINT8 WiMODLoRaWAN_DataRatePlanner::GetDeliveryEstimate(UINT8 dataRate, UINT8 txPower)
+{
+    TWiMODLORAWAN_DrPlannerStats* entry;
+    INT16                         margin;
+    UINT8                         model = 50;
+
+    if (dataRate >= WIMOD_DR_PLANNER_MAX_DATA_RATES) {
+        return 0;
+    }
+    entry = &stats[dataRate];
+
+    if (snrValid) {
+        // downlink SNR is used as proxy for the uplink SNR at max. power
+        margin = (snrEwma / 16) - requiredSnr[dataRate] - (INT16)(maxPower - MIN(txPower, maxPower));
+        margin -= MIN((INT16)(uplinksSinceFeedback / WIMOD_DR_PLANNER_DEFAULT_STALE_UPLINKS),
+                      (INT16) WIMOD_DR_PLANNER_MAX_STALE_PENALTY);
+        model = modelEstimate(margin);
+    }
+
+    return (UINT8)(((UINT16) entry->Delivered * 100 + (UINT16) model * WIMOD_DR_PLANNER_PRIOR_WEIGHT)
+                 / ((UINT16) entry->Attempts + WIMOD_DR_PLANNER_PRIOR_WEIGHT));
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the data rate index of the cached radio stack config
+ */
+UINT8 WiMODLoRaWAN_DataRatePlanner::GetDataRate(void)
+{
+    return appliedCfg.DataRateIndex;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the tx power level of the cached radio stack config
+ */
+UINT8 WiMODLoRaWAN_DataRatePlanner::GetTxPower(void)
+{
+    return appliedCfg.TXPowerLevel;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the smoothed downlink SNR in dB (or WIMOD_DR_PLANNER_SNR_UNKNOWN)
+ */
+INT8 WiMODLoRaWAN_DataRatePlanner::GetSnrEstimate(void)
+{
+    return snrValid ? (INT8)(snrEwma / 16) : (INT8) WIMOD_DR_PLANNER_SNR_UNKNOWN;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the number of radio stack config writes issued by the planner
+ */
+UINT16 WiMODLoRaWAN_DataRatePlanner::GetConfigWrites(void)
+{
+    return configWrites;
+}
+
+//------------------------------------------------------------------------------
+//
+// Section protected functions
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+void WiMODLoRaWAN_DataRatePlanner::updateSnr(INT8 snr, bool available)
+{
+    INT16 sample;
+
+    if (!available) {
+        return;
+    }
+
+    sample = (INT16) snr * 16;
+    if (snrValid) {
+        // EWMA, alpha = 1/4
+        snrEwma += (sample - snrEwma) / 4;
+    } else {
+        snrEwma  = sample;
+        snrValid = true;
+    }
+    uplinksSinceFeedback = 0;
+}
+
+void WiMODLoRaWAN_DataRatePlanner::recordOutcome(UINT8 dataRate, UINT8 failed, bool delivered)
+{
+    TWiMODLORAWAN_DrPlannerStats* entry;
+    UINT16                        attempts;
+
+    if (dataRate >= WIMOD_DR_PLANNER_MAX_DATA_RATES) {
+        return;
+    }
+    entry    = &stats[dataRate];
+    attempts = (UINT16) entry->Attempts + failed + (delivered ? 1 : 0);
+
+    if (delivered) {
+        entry->Delivered++;
+    }
+    // keep a rolling window by halving the counters
+    while (attempts >= WIMOD_DR_PLANNER_STATS_WINDOW) {
+        attempts         /= 2;
+        entry->Delivered /= 2;
+    }
+    entry->Attempts = (UINT8) attempts;
+}
+
+UINT8 WiMODLoRaWAN_DataRatePlanner::modelEstimate(INT16 marginDb)
+{
+    INT16 index = marginDb + MARGIN_TABLE_OFFSET;
+
+    if (index < 0) {
+        return 0;
+    }
+    if (index >= MARGIN_TABLE_SIZE) {
+        return 100;
+    }
+    return MarginToDelivery[index];
+}
+
+void WiMODLoRaWAN_DataRatePlanner::plan(UINT8* dataRate, UINT8* txPower)
+{
+    INT8 dr;
+    bool haveStats = false;
+
+    for (dr = minDr; dr <= (INT8) maxDr; dr++) {
+        if (stats[dr].Attempts) {
+            haveStats = true;
+        }
+    }
+
+    // nothing known about the link yet: keep the current settings
+    if (!snrValid && !haveStats) {
+        *dataRate = appliedCfg.DataRateIndex;
+        *txPower  = appliedCfg.TXPowerLevel;
+        return;
+    }
+
+    // fastest data rate that meets the target at full power
+    *dataRate = minDr;
+    for (dr = (INT8) maxDr; dr >= (INT8) minDr; dr--) {
+        if (GetDeliveryEstimate((UINT8) dr, maxPower) >= target) {
+            *dataRate = (UINT8) dr;
+            break;
+        }
+    }
+
+    // then reduce the power as long as the target is still met
+    *txPower = maxPower;
+    while ((*txPower >= minPower + powerStep)
+            && (GetDeliveryEstimate(*dataRate, *txPower - powerStep) >= target)) {
+        *txPower -= powerStep;
+    }
+}
+//! @endcond
+
+//------------------------------------------------------------------------------
+// EOF
+//------------------------------------------------------------------------------
@@ -0,0 +1,137 @@
+//------------------------------------------------------------------------------
+//! @file WiMODLoRaWAN_DataRatePlanner.h
+//! @ingroup WiMODLoRaWAN
+//! <!------------------------------------------------------------------------->
+//! @brief Declarations for a host side data rate / tx power planner
+//! @version 0.1
+//! <!------------------------------------------------------------------------->
+//!
+//! The planner is meant for nodes that run with the stack option ADR disabled
+//! (e.g. mobile nodes used for coverage mapping). It keeps a small rolling
+//! link model fed by the RX / ACK / TX indications and selects the fastest
+//! data rate that still meets a target delivery ratio.
+//!
+//------------------------------------------------------------------------------
+
+
+#ifndef ARDUINO_WIMODLORAWAN_DATARATEPLANNER_H_
+#define ARDUINO_WIMODLORAWAN_DATARATEPLANNER_H_
+
+//------------------------------------------------------------------------------
+//
+// Section Includes Files
+//
+//------------------------------------------------------------------------------
+
+#include "../WiMODLoRaWAN.h"
+
+//------------------------------------------------------------------------------
+//
+// Section defines
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+#define WIMOD_DR_PLANNER_MAX_DATA_RATES             8                           // DR0 ... DR7
+
+#define WIMOD_DR_PLANNER_DEFAULT_TARGET             90                          // target delivery ratio in percent
+#define WIMOD_DR_PLANNER_DEFAULT_HOLD_OFF           4                           // min. uplinks before a faster DR is used
+#define WIMOD_DR_PLANNER_DEFAULT_POWER_STEP         2                           // dB
+#define WIMOD_DR_PLANNER_DEFAULT_STALE_UPLINKS      8                           // uplinks w/o feedback per 1 dB penalty
+#define WIMOD_DR_PLANNER_MAX_STALE_PENALTY          6                           // dB
+
+#define WIMOD_DR_PLANNER_STATS_WINDOW               32                          // counters are halved when reached
+#define WIMOD_DR_PLANNER_PRIOR_WEIGHT               4                           // weight of the SNR model vs. statistics
+
+#define WIMOD_DR_PLANNER_SNR_UNKNOWN                (-128)
+//! @endcond
+
+/**
+ * @brief Rolling link statistic for a single data rate
+ */
+typedef struct TWiMODLORAWAN_DrPlannerStats
+{
+    UINT8       Attempts;                                                       /*!< (decayed) number of confirmed transmissions */
+    UINT8       Delivered;                                                      /*!< (decayed) number of acknowledged transmissions */
+} TWiMODLORAWAN_DrPlannerStats;
+
+
+//------------------------------------------------------------------------------
+//
+// Section class
+//
+//------------------------------------------------------------------------------
+
+/**
+ * @brief Client side link adaptive data rate planner for the LoRaWAN firmware
+ *
+ * The planner does not hook into the callback chain of the WiMODLoRaWAN
+ * class; the user has to feed the converted indications from within the
+ * registered callbacks and call PrepareUplink() before each uplink.
+ *
+ * The demodulation floor per data rate defaults to the EU868 style DR
+ * numbering (DR0 = SF12 ... DR5 = SF7, DR6 = SF7/250kHz). Other regions
+ * can adjust the table via SetRequiredSnr().
+ */
+class WiMODLoRaWAN_DataRatePlanner {
+public:
+    WiMODLoRaWAN_DataRatePlanner(WiMODLoRaWAN& wimod);
+    ~WiMODLoRaWAN_DataRatePlanner(void);
+
+    bool        begin(UINT8 minDataRate, UINT8 maxDataRate, UINT8 minTxPower, UINT8 maxTxPower,
+                      TWiMODLRResultCodes* hciResult = NULL, UINT8* rspStatus = NULL);
+
+    void        SetTargetDeliveryRatio(UINT8 percent);
+    void        SetHoldOff(UINT8 uplinks);
+    void        SetTxPowerStep(UINT8 stepDb);
+    void        SetRequiredSnr(UINT8 dataRate, INT8 snrDb);
+
+    void        ProcessRxData(const TWiMODLORAWAN_RX_Data& rxData);
+    void        ProcessRxAck(const TWiMODLORAWAN_RX_ACK_Data& ackData);
+    void        ProcessTxIndication(const TWiMODLORAWAN_TxIndData& txInd, bool confirmed);
+
+    bool        PrepareUplink(TWiMODLRResultCodes* hciResult = NULL, UINT8* rspStatus = NULL);
+
+    UINT8       GetDeliveryEstimate(UINT8 dataRate, UINT8 txPower);
+    UINT8       GetDataRate(void);
+    UINT8       GetTxPower(void);
+    INT8        GetSnrEstimate(void);
+    UINT16      GetConfigWrites(void);
+
+protected:
+    //! @cond Doxygen_Suppress
+    void        updateSnr(INT8 snr, bool available);
+    void        recordOutcome(UINT8 dataRate, UINT8 failed, bool delivered);
+    UINT8       modelEstimate(INT16 marginDb);
+    void        plan(UINT8* dataRate, UINT8* txPower);
+    //! @endcond
+private:
+    //! @cond Doxygen_Suppress
+    WiMODLoRaWAN&                   wimod;
+    TWiMODLORAWAN_RadioStackConfig  appliedCfg;
+    TWiMODLORAWAN_DrPlannerStats    stats[WIMOD_DR_PLANNER_MAX_DATA_RATES];
+    INT8                            requiredSnr[WIMOD_DR_PLANNER_MAX_DATA_RATES];
+
+    INT16                           snrEwma;                                    // in 1/16 dB
+    bool                            snrValid;
+
+    UINT8                           minDr;
+    UINT8                           maxDr;
+    UINT8                           minPower;
+    UINT8                           maxPower;
+    UINT8                           powerStep;
+    UINT8                           target;
+    UINT8                           holdOff;
+
+    UINT8                           lastTxDr;
+    UINT8                           pendingTxPackets;
+    bool                            pendingConfirmed;
+    UINT8                           uplinksSinceFeedback;
+    UINT8                           uplinksSinceChange;
+    UINT16                          configWrites;
+    bool                            isActive;
+    //! @endcond
+};
+
+
+#endif /* ARDUINO_WIMODLORAWAN_DATARATEPLANNER_H_ */
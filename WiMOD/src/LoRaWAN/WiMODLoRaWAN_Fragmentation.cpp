@@ -0,0 +1,620 @@
+//------------------------------------------------------------------------------
+//! @file WiMODLoRaWAN_Fragmentation.cpp
+//! @ingroup WiMODLoRaWAN
+//! <!------------------------------------------------------------------------->
+//! @brief Fragmentation layer with forward error correction for U-Data
+//! @version 0.1
+//! <!------------------------------------------------------------------------->
+//!
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+//
+// Section Includes Files
+//
+//------------------------------------------------------------------------------
+
+#include "WiMODLoRaWAN_Fragmentation.h"
+
+#include <string.h>
+
+//------------------------------------------------------------------------------
+//
+// Section local functions
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+static UINT32 fragPrbs23(UINT32 x)
+{
+    UINT32 b0 = x & 0x01;
+    UINT32 b1 = (x & 0x20) >> 5;
+
+    return (x >> 1) + ((b0 ^ b1) << 22);
+}
+
+/*
+ * Returns the parity row of coded fragment n (1 based) as bit mask.
+ * Same generator as the LoRaWAN fragmented data block transport, so coded
+ * fragments of a standard FUOTA server can be handled as well.
+ */
+static UINT32 fragMatrixLine(UINT16 n, UINT8 numFragments)
+{
+    UINT32 mask = 0;
+    UINT32 x    = 1 + 1001 * (UINT32) n;
+    UINT32 mod  = numFragments;
+    UINT32 r;
+    UINT8  i;
+
+    // M is a power of two
+    if ((numFragments & (numFragments - 1)) == 0) {
+        mod++;
+    }
+
+    for (i = 0; i < numFragments / 2; i++) {
+        r = 1UL << 16;
+        while (r >= numFragments) {
+            x = fragPrbs23(x);
+            r = x % mod;
+        }
+        mask |= (1UL << r);
+    }
+
+    // single fragment: redundancy is a plain repetition
+    if (mask == 0) {
+        mask = 0x01;
+    }
+    return mask;
+}
+
+static UINT8 fragLowestBit(UINT32 mask)
+{
+    UINT8 i = 0;
+
+    while ((mask & 0x01) == 0) {
+        mask >>= 1;
+        i++;
+    }
+    return i;
+}
+
+static void fragXor(UINT8* dst, const UINT8* src, UINT8 size)
+{
+    while (size--) {
+        *dst++ ^= *src++;
+    }
+}
+//! @endcond
+
+//------------------------------------------------------------------------------
+//
+// Section public functions - WiMODLoRaWAN_FragSender
+//
+//------------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Constructor
+ *
+ * @param wimod     reference to the LoRaWAN interface
+ */
+WiMODLoRaWAN_FragSender::WiMODLoRaWAN_FragSender(WiMODLoRaWAN& wimod) :
+    wimod(wimod)
+{
+    blob         = NULL;
+    blobLength   = 0;
+    fragSize     = 0;
+    numFragments = 0;
+    redundancy   = 0;
+    port         = WIMOD_FRAG_DEFAULT_PORT;
+    sessionId    = 0;
+    nextIndex    = 0;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Destructor
+ */
+WiMODLoRaWAN_FragSender::~WiMODLoRaWAN_FragSender(void)
+{
+
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Starts a new fragmentation session
+ *
+ * The fragment size has to fit into the current max. payload size of the
+ * LoRaWAN link (minus WIMOD_FRAG_HEADER_SIZE bytes of session header).
+ *
+ * @param blob          pointer to the data block (not copied)
+ *
+ * @param length        length of the data block
+ *
+ * @param fragSize      payload bytes per fragment
+ *
+ * @param redundancy    number of coded fragments appended to the session
+ *
+ * @param port          LoRaWAN port to use
+ *
+ * @retval true     if the session has been set up
+ * @retval false    if the blob needs more than WIMOD_FRAG_MAX_FRAGMENTS fragments
+ *
+ * @code
+ * WiMODLoRaWAN_FragSender fragTx(wimod);
+ *
+ * fragTx.Start(logBuffer, logLength, 40, 8);
+ * ...
+ * // in loop(), once per allowed uplink
+ * if (!fragTx.IsDone()) {
+ *     fragTx.SendNext();
+ * }
+ * @endcode
+ */
+bool WiMODLoRaWAN_FragSender::Start(const UINT8* blob, UINT16 length, UINT8 fragSize,
+                                    UINT8 redundancy, UINT8 port)
+{
+    UINT16 frags;
+
+    if ((blob == NULL) || (length == 0) || (fragSize == 0)
+            || (fragSize > WIMOD_FRAG_MAX_FRAGMENT_SIZE)) {
+        return false;
+    }
+
+    frags = (length + fragSize - 1) / fragSize;
+    if (frags > WIMOD_FRAG_MAX_FRAGMENTS) {
+        return false;
+    }
+
+    this->blob         = blob;
+    this->blobLength   = length;
+    this->fragSize     = fragSize;
+    this->numFragments = (UINT8) frags;
+    this->redundancy   = redundancy;
+    this->port         = port;
+    this->nextIndex    = 1;
+    sessionId++;
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Sends the next fragment of the current session as U-Data
+ *
+ * The fragment counter only advances if the module accepted the frame, so a
+ * rejected transmission (e.g. duty cycle) is repeated by the next call.
+ *
+ * @param hciResult Result of the local command transmission to module
+ *                  This is an optional parameter.
+ *
+ * @param rspStatus Status byte contained in the local response of the module
+ *                  This is an optional parameter.
+ *
+ * @retval true     if a fragment has been handed over to the module
+ */
+bool WiMODLoRaWAN_FragSender::SendNext(TWiMODLRResultCodes* hciResult, UINT8* rspStatus)
+{
+    if (IsDone()) {
+        return false;
+    }
+
+    txData.Port       = port;
+    txData.Length     = WIMOD_FRAG_HEADER_SIZE + fragSize;
+    txData.Payload[0] = sessionId;
+    txData.Payload[1] = numFragments;
+    HTON16(&txData.Payload[2], nextIndex);
+    HTON16(&txData.Payload[4], blobLength);
+    buildFragment(nextIndex, &txData.Payload[WIMOD_FRAG_HEADER_SIZE]);
+
+    if (!wimod.SendUData(&txData, hciResult, rspStatus)) {
+        return false;
+    }
+    nextIndex++;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Stops the current session
+ */
+void WiMODLoRaWAN_FragSender::Abort(void)
+{
+    blob      = NULL;
+    nextIndex = 0;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns true if all fragments of the session have been sent
+ */
+bool WiMODLoRaWAN_FragSender::IsDone(void)
+{
+    return (blob == NULL) || (nextIndex > GetNumFrames());
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the id of the current session
+ */
+UINT8 WiMODLoRaWAN_FragSender::GetSessionId(void)
+{
+    return sessionId;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the total number of frames (plain + coded) of the session
+ */
+UINT16 WiMODLoRaWAN_FragSender::GetNumFrames(void)
+{
+    return (UINT16) numFragments + redundancy;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the number of frames sent so far
+ */
+UINT16 WiMODLoRaWAN_FragSender::GetFramesSent(void)
+{
+    return (nextIndex > 0) ? (nextIndex - 1) : 0;
+}
+
+//------------------------------------------------------------------------------
+//
+// Section protected functions - WiMODLoRaWAN_FragSender
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+void WiMODLoRaWAN_FragSender::buildFragment(UINT16 index, UINT8* dst)
+{
+    UINT32 mask;
+    UINT16 offset;
+    UINT8  frag;
+    UINT8  i;
+
+    memset(dst, 0x00, fragSize);
+
+    if (index <= numFragments) {
+        mask = 1UL << (index - 1);
+    } else {
+        mask = fragMatrixLine(index - numFragments, numFragments);
+    }
+
+    // last fragment is zero padded
+    for (frag = 0; frag < numFragments; frag++) {
+        if (mask & (1UL << frag)) {
+            offset = (UINT16) frag * fragSize;
+            for (i = 0; (i < fragSize) && (offset + i < blobLength); i++) {
+                dst[i] ^= blob[offset + i];
+            }
+        }
+    }
+}
+//! @endcond
+
+//------------------------------------------------------------------------------
+//
+// Section public functions - WiMODLoRaWAN_FragReceiver
+//
+//------------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Constructor
+ */
+WiMODLoRaWAN_FragReceiver::WiMODLoRaWAN_FragReceiver(void)
+{
+    port         = WIMOD_FRAG_DEFAULT_PORT;
+    doneCallback = NULL;
+    sessionId    = 0;
+    Reset();
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Destructor
+ */
+WiMODLoRaWAN_FragReceiver::~WiMODLoRaWAN_FragReceiver(void)
+{
+
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Sets the LoRaWAN port of the fragmentation layer
+ */
+void WiMODLoRaWAN_FragReceiver::SetPort(UINT8 port)
+{
+    this->port = port;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Registers a callback that is called once a blob has been rebuilt
+ */
+void WiMODLoRaWAN_FragReceiver::RegisterSessionDoneClient(TFragSessionDoneCallback cb)
+{
+    doneCallback = cb;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Feeds a received U-Data frame into the receiver
+ *
+ * A frame with a new session id (or different session parameters) discards
+ * the previous session.
+ *
+ * @param rxData    converted RX U-Data indication
+ *
+ * @retval true     if the frame belongs to the fragmentation layer
+ * @retval false    if the frame has to be processed by the application
+ *
+ * @code
+ * WiMODLoRaWAN_FragReceiver fragRx;
+ *
+ * void onRxData(TWiMODLR_HCIMessage& rxMsg) {
+ *  TWiMODLORAWAN_RX_Data radioRxMsg;
+ *
+ *  wimod.convert(rxMsg, &radioRxMsg);
+ *  if (fragRx.ProcessRxData(radioRxMsg)) {
+ *      return;
+ *  }
+ *  ...
+ * }
+ * @endcode
+ */
+bool WiMODLoRaWAN_FragReceiver::ProcessRxData(const TWiMODLORAWAN_RX_Data& rxData)
+{
+    UINT8  session;
+    UINT8  numFrags;
+    UINT8  size;
+    UINT16 index;
+    UINT16 length;
+
+    if ((rxData.Port != port) || (rxData.Length <= WIMOD_FRAG_HEADER_SIZE)) {
+        return false;
+    }
+
+    session  = rxData.Payload[0];
+    numFrags = rxData.Payload[1];
+    index    = NTOH16(&rxData.Payload[2]);
+    length   = NTOH16(&rxData.Payload[4]);
+    size     = rxData.Length - WIMOD_FRAG_HEADER_SIZE;
+
+    if (!active || (session != sessionId) || (numFrags != numFragments)
+            || (size != fragSize) || (length != blobLength)) {
+        if (!startSession(session, numFrags, size, length)) {
+            return true;
+        }
+    }
+
+    if (complete || (index == 0)) {
+        return true;
+    }
+    framesReceived++;
+
+    if (index <= numFragments) {
+        addPlain((UINT8) (index - 1), &rxData.Payload[WIMOD_FRAG_HEADER_SIZE]);
+    } else {
+        addCoded(fragMatrixLine(index - numFragments, numFragments),
+                 &rxData.Payload[WIMOD_FRAG_HEADER_SIZE]);
+    }
+
+    if ((knownMask | pivotMask) == (0xFFFFFFFFUL >> (WIMOD_FRAG_MAX_FRAGMENTS - numFragments))) {
+        solve();
+        complete = true;
+        if (doneCallback) {
+            doneCallback(sessionId, buffer, blobLength);
+        }
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Discards the current session
+ */
+void WiMODLoRaWAN_FragReceiver::Reset(void)
+{
+    knownMask      = 0;
+    pivotMask      = 0;
+    numFragments   = 0;
+    fragSize       = 0;
+    blobLength     = 0;
+    framesReceived = 0;
+    active         = false;
+    complete       = false;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns true if the blob of the current session has been rebuilt
+ */
+bool WiMODLoRaWAN_FragReceiver::IsComplete(void)
+{
+    return complete;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the rebuilt blob (only valid if IsComplete() is true)
+ */
+const UINT8* WiMODLoRaWAN_FragReceiver::GetData(void)
+{
+    return buffer;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the length of the blob of the current session
+ */
+UINT16 WiMODLoRaWAN_FragReceiver::GetLength(void)
+{
+    return blobLength;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the id of the current session
+ */
+UINT8 WiMODLoRaWAN_FragReceiver::GetSessionId(void)
+{
+    return sessionId;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the number of linear independent fragments still needed
+ */
+UINT8 WiMODLoRaWAN_FragReceiver::GetNumMissing(void)
+{
+    UINT32 mask  = knownMask | pivotMask;
+    UINT8  found = 0;
+
+    while (mask) {
+        mask &= mask - 1;
+        found++;
+    }
+    return numFragments - found;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the number of frames received for the current session
+ */
+UINT16 WiMODLoRaWAN_FragReceiver::GetFramesReceived(void)
+{
+    return framesReceived;
+}
+
+//------------------------------------------------------------------------------
+//
+// Section protected functions - WiMODLoRaWAN_FragReceiver
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+bool WiMODLoRaWAN_FragReceiver::startSession(UINT8 session, UINT8 numFrags, UINT8 size, UINT16 length)
+{
+    Reset();
+
+    if ((numFrags == 0) || (numFrags > WIMOD_FRAG_MAX_FRAGMENTS)
+            || ((UINT16) numFrags * size > WIMOD_FRAG_RX_BUFFER_SIZE)
+            || (length > (UINT16) numFrags * size)
+            || (length <= (UINT16) (numFrags - 1) * size)) {
+        return false;
+    }
+
+    sessionId    = session;
+    numFragments = numFrags;
+    fragSize     = size;
+    blobLength   = length;
+    active       = true;
+    return true;
+}
+
+UINT8* WiMODLoRaWAN_FragReceiver::slot(UINT8 index)
+{
+    return &buffer[(UINT16) index * fragSize];
+}
+
+void WiMODLoRaWAN_FragReceiver::addPlain(UINT8 index, const UINT8* data)
+{
+    UINT32 bit = 1UL << index;
+    UINT32 row = 0;
+    UINT8  p;
+
+    if (knownMask & bit) {
+        return;
+    }
+
+    // the slot holds a parity row; keep it for re-insertion
+    if (pivotMask & bit) {
+        memcpy(scratch, slot(index), fragSize);
+        row        = rowMask[index];
+        pivotMask &= ~bit;
+    }
+
+    memcpy(slot(index), data, fragSize);
+    knownMask |= bit;
+
+    // remove the new fragment from all parity rows
+    for (p = 0; p < numFragments; p++) {
+        if ((pivotMask & (1UL << p)) && (rowMask[p] & bit)) {
+            fragXor(slot(p), slot(index), fragSize);
+            rowMask[p] &= ~bit;
+        }
+    }
+
+    if (row) {
+        insertRow(row);
+    }
+}
+
+void WiMODLoRaWAN_FragReceiver::addCoded(UINT32 mask, const UINT8* data)
+{
+    memcpy(scratch, data, fragSize);
+    insertRow(mask);
+}
+
+/*
+ * reduces the row in scratch against all known fragments and parity rows
+ * and stores it in the slot of its lowest unknown fragment
+ */
+void WiMODLoRaWAN_FragReceiver::insertRow(UINT32 mask)
+{
+    UINT8 p;
+
+    for (p = 0; p < numFragments; p++) {
+        if (mask & knownMask & (1UL << p)) {
+            fragXor(scratch, slot(p), fragSize);
+        }
+    }
+    mask &= ~knownMask;
+
+    while (mask) {
+        p = fragLowestBit(mask);
+        if (pivotMask & (1UL << p)) {
+            mask ^= rowMask[p];
+            fragXor(scratch, slot(p), fragSize);
+        } else {
+            rowMask[p] = mask;
+            memcpy(slot(p), scratch, fragSize);
+            pivotMask |= (1UL << p);
+            return;
+        }
+    }
+    // linear dependent -> no new information
+}
+
+/*
+ * back substitution: all other bits of a row are higher than its pivot and
+ * therefore already solved when walking downwards
+ */
+void WiMODLoRaWAN_FragReceiver::solve(void)
+{
+    UINT8 p;
+    UINT8 b;
+
+    p = numFragments;
+    while (p--) {
+        if ((pivotMask & (1UL << p)) == 0) {
+            continue;
+        }
+        for (b = p + 1; b < numFragments; b++) {
+            if (rowMask[p] & (1UL << b)) {
+                fragXor(slot(p), slot(b), fragSize);
+            }
+        }
+        rowMask[p]  = 1UL << p;
+        pivotMask  &= ~(1UL << p);
+        knownMask  |= (1UL << p);
+    }
+}
+//! @endcond
+
+//------------------------------------------------------------------------------
+// EOF
+//------------------------------------------------------------------------------
@@ -0,0 +1,170 @@
+//------------------------------------------------------------------------------
+//! @file WiMODLoRaWAN_Fragmentation.h
+//! @ingroup WiMODLoRaWAN
+//! <!------------------------------------------------------------------------->
+//! @brief Declarations for a fragmentation layer with forward error correction
+//! @version 0.1
+//! <!------------------------------------------------------------------------->
+//!
+//! A data block (blob) that does not fit into a single U-Data frame is split
+//! into M fixed size fragments, followed by R redundancy fragments. Each
+//! redundancy fragment is the XOR of a pseudo random subset of the M
+//! fragments (parity matrix as used by the LoRaWAN fragmented data block
+//! transport). A receiver can rebuild the blob from any M (or slightly more)
+//! linear independent fragments - no per fragment acknowledgement needed.
+//!
+//! Frame layout (LoRaWAN port WIMOD_FRAG_DEFAULT_PORT):
+//!
+//!  | SessionId | M | FragIndex (LE16) | BlobLength (LE16) | fragment data |
+//!
+//! FragIndex 1 ... M are the plain fragments, M+1 ... M+R the coded ones.
+//!
+//------------------------------------------------------------------------------
+
+
+#ifndef ARDUINO_WIMODLORAWAN_FRAGMENTATION_H_
+#define ARDUINO_WIMODLORAWAN_FRAGMENTATION_H_
+
+//------------------------------------------------------------------------------
+//
+// Section Includes Files
+//
+//------------------------------------------------------------------------------
+
+#include "../WiMODLoRaWAN.h"
+
+//------------------------------------------------------------------------------
+//
+// Section defines
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+#define WIMOD_FRAG_DEFAULT_PORT                     201                         // LoRaWAN port of the fragmentation layer
+#define WIMOD_FRAG_HEADER_SIZE                      6
+#define WIMOD_FRAG_MAX_FRAGMENTS                    32                          // limited by the 32 bit row masks
+#define WIMOD_FRAG_MAX_FRAGMENT_SIZE                (WiMODLORAWAN_APP_PAYLOAD_LEN - WIMOD_FRAG_HEADER_SIZE)
+
+#ifndef WIMOD_FRAG_RX_BUFFER_SIZE
+#define WIMOD_FRAG_RX_BUFFER_SIZE                   1024                        // max. blob size at the receiver
+#endif
+//! @endcond
+
+
+// C++11 check
+#ifdef WIMOD_USE_CPP11
+    /** Type definition for a 'fragmentation session complete' callback */
+    typedef std::function<void (UINT8 sessionId, const UINT8* data, UINT16 length)> TFragSessionDoneCallback;
+#else
+    /** Type definition for a 'fragmentation session complete' callback function */
+    typedef void (*TFragSessionDoneCallback)(UINT8 sessionId, const UINT8* data, UINT16 length);
+#endif
+
+
+//------------------------------------------------------------------------------
+//
+// Section class
+//
+//------------------------------------------------------------------------------
+
+/**
+ * @brief Sending side of the fragmentation layer
+ *
+ * The sender does not copy the blob; the memory has to stay valid until
+ * IsDone() returns true. SendNext() transmits exactly one fragment and is
+ * meant to be called from the main loop whenever the application is allowed
+ * to send (e.g. after the TX U-Data indication).
+ */
+class WiMODLoRaWAN_FragSender {
+public:
+    WiMODLoRaWAN_FragSender(WiMODLoRaWAN& wimod);
+    ~WiMODLoRaWAN_FragSender(void);
+
+    bool        Start(const UINT8* blob, UINT16 length, UINT8 fragSize, UINT8 redundancy,
+                      UINT8 port = WIMOD_FRAG_DEFAULT_PORT);
+    bool        SendNext(TWiMODLRResultCodes* hciResult = NULL, UINT8* rspStatus = NULL);
+    void        Abort(void);
+
+    bool        IsDone(void);
+    UINT8       GetSessionId(void);
+    UINT16      GetNumFrames(void);
+    UINT16      GetFramesSent(void);
+
+protected:
+    //! @cond Doxygen_Suppress
+    void        buildFragment(UINT16 index, UINT8* dst);
+    //! @endcond
+private:
+    //! @cond Doxygen_Suppress
+    WiMODLoRaWAN&           wimod;
+    TWiMODLORAWAN_TX_Data   txData;
+
+    const UINT8*            blob;
+    UINT16                  blobLength;
+    UINT8                   fragSize;
+    UINT8                   numFragments;
+    UINT8                   redundancy;
+    UINT8                   port;
+    UINT8                   sessionId;
+    UINT16                  nextIndex;
+    //! @endcond
+};
+
+
+/**
+ * @brief Receiving side of the fragmentation layer
+ *
+ * The receiver decodes incrementally (gaussian elimination over GF(2)); the
+ * rows of not yet known fragments are kept in the slot of the blob buffer
+ * they will be solved into, so no extra payload memory is needed.
+ */
+class WiMODLoRaWAN_FragReceiver {
+public:
+    WiMODLoRaWAN_FragReceiver(void);
+    ~WiMODLoRaWAN_FragReceiver(void);
+
+    void        SetPort(UINT8 port);
+    void        RegisterSessionDoneClient(TFragSessionDoneCallback cb);
+
+    bool        ProcessRxData(const TWiMODLORAWAN_RX_Data& rxData);
+    void        Reset(void);
+
+    bool        IsComplete(void);
+    const UINT8* GetData(void);
+    UINT16      GetLength(void);
+    UINT8       GetSessionId(void);
+    UINT8       GetNumMissing(void);
+    UINT16      GetFramesReceived(void);
+
+protected:
+    //! @cond Doxygen_Suppress
+    bool        startSession(UINT8 session, UINT8 numFrags, UINT8 size, UINT16 length);
+    void        addPlain(UINT8 index, const UINT8* data);
+    void        addCoded(UINT32 mask, const UINT8* data);
+    void        insertRow(UINT32 mask);
+    void        solve(void);
+    UINT8*      slot(UINT8 index);
+    //! @endcond
+private:
+    //! @cond Doxygen_Suppress
+    UINT8                   buffer[WIMOD_FRAG_RX_BUFFER_SIZE];
+    UINT8                   scratch[WIMOD_FRAG_MAX_FRAGMENT_SIZE];
+    UINT32                  rowMask[WIMOD_FRAG_MAX_FRAGMENTS];
+
+    UINT32                  knownMask;                                          // plain / solved fragments
+    UINT32                  pivotMask;                                          // slots holding a parity row
+    UINT8                   port;
+    UINT8                   sessionId;
+    UINT8                   numFragments;
+    UINT8                   fragSize;
+    UINT16                  blobLength;
+    UINT16                  framesReceived;
+    bool                    active;
+    bool                    complete;
+
+    TFragSessionDoneCallback doneCallback;
+    //! @endcond
+};
+
+
+#endif /* ARDUINO_WIMODLORAWAN_FRAGMENTATION_H_ */
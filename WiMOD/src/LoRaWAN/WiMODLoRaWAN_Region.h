@@ -0,0 +1,448 @@
+//------------------------------------------------------------------------------
+//! @file WiMODLoRaWAN_Region.h
+//! @ingroup WiMODLoRaWAN
+//! <!------------------------------------------------------------------------->
+//! @brief Compile time region descriptor for the LoRaWAN firmware
+//! @version 0.1
+//! <!------------------------------------------------------------------------->
+//!
+//! The SAP headers only name the data rate and channel indices of a region.
+//! This file adds the matching numbers - modulation and max. application
+//! payload per data rate, frequencies of the default channels and the duty
+//! cycle limits of the (sub) bands - as constexpr tables.
+//!
+//! Exactly one region is compiled in; it is selected by a build flag, e.g.
+//! in platformio.ini:
+//!
+//!     build_flags = -DWIMOD_LORAWAN_REGION=WIMOD_LORAWAN_REGION_US915
+//!
+//! Without the flag EU868 is used. The tables of all other regions are not
+//! part of the build. All lookups are constexpr, so they fold to constants
+//! for constant arguments and are O(1) table reads otherwise (the duty cycle
+//! lookup walks the few band entries of the region).
+//!
+//! Max. payload values are the LoRaWAN regional parameters (RP002) figures
+//! for the application payload (N) without FOpts and with dwell time
+//! limitation off. Data rates that are not defined for the region (RFU) are
+//! reported with a max. payload of 0.
+//!
+//------------------------------------------------------------------------------
+
+
+#ifndef ARDUINO_WIMODLORAWAN_REGION_H_
+#define ARDUINO_WIMODLORAWAN_REGION_H_
+
+//------------------------------------------------------------------------------
+//
+// Section Includes Files
+//
+//------------------------------------------------------------------------------
+
+#include "utils/WMDefs.h"
+#include "SAP/WiMOD_SAP_LORAWAN.h"
+
+//------------------------------------------------------------------------------
+//
+// Section defines
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+#define WIMOD_LORAWAN_REGION_EU868                  1
+#define WIMOD_LORAWAN_REGION_US915                  2
+#define WIMOD_LORAWAN_REGION_IN865                  3
+#define WIMOD_LORAWAN_REGION_AS923                  4
+#define WIMOD_LORAWAN_REGION_IL915                  5
+#define WIMOD_LORAWAN_REGION_RU868                  6
+
+#ifndef WIMOD_LORAWAN_REGION
+#define WIMOD_LORAWAN_REGION                        WIMOD_LORAWAN_REGION_EU868
+#endif
+
+#define WIMOD_LORAWAN_REGION_RX2_CHANNEL            128                         // channel index used by the firmware for RX2
+
+#define WIMOD_LORAWAN_REGION_MAC_OVERHEAD           13                          // MHDR + FHDR (w/o FOpts) + FPort + MIC
+#define WIMOD_LORAWAN_REGION_LORA_CR                1                           // coding rate 4/5
+#define WIMOD_LORAWAN_REGION_LORA_PREAMBLE_X4       49                          // (8 + 4.25) preamble symbols x 4
+#define WIMOD_LORAWAN_REGION_FSK_US_PER_BYTE        160                         // 50 kbps
+#define WIMOD_LORAWAN_REGION_FSK_OVERHEAD           11                          // preamble, sync word, length, CRC
+//! @endcond
+
+/**
+ * @brief Modulation and payload limit of a single data rate
+ */
+typedef struct TWiMODLORAWAN_RegionDataRate
+{
+    UINT8       SpreadingFactor;                                                /*!< 7 ... 12; 0 for FSK */
+    UINT16      BandwidthKHz;                                                   /*!< 125, 250, 500; 0 for FSK */
+    UINT8       MaxPayload;                                                     /*!< max. application payload in bytes; 0 if not defined */
+} TWiMODLORAWAN_RegionDataRate;
+
+/**
+ * @brief Duty cycle limit of a (sub) band
+ */
+typedef struct TWiMODLORAWAN_RegionBand
+{
+    UINT32      MinFrequency;                                                   /*!< lower edge in Hz */
+    UINT32      MaxFrequency;                                                   /*!< upper edge in Hz */
+    UINT16      DutyCycleDivider;                                               /*!< 100 = 1%, 1000 = 0.1%; 1 = no limit */
+} TWiMODLORAWAN_RegionBand;
+
+
+//------------------------------------------------------------------------------
+//
+// Section region tables
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+#define WIMOD_LORAWAN_REGION_FSK(n)                 { 0, 0, n }
+#define WIMOD_LORAWAN_REGION_RFU                    { 0, 0, 0 }
+
+#if (WIMOD_LORAWAN_REGION == WIMOD_LORAWAN_REGION_EU868)
+
+static constexpr TLoRaWANregion LoRaWANRegion_Id = LoRaWAN_Region_EU868;
+
+static constexpr TWiMODLORAWAN_RegionDataRate LoRaWANRegion_DataRates[] =
+{
+    { 12, 125,  51 },
+    { 11, 125,  51 },
+    { 10, 125,  51 },
+    {  9, 125, 115 },
+    {  8, 125, 222 },
+    {  7, 125, 222 },
+    {  7, 250, 222 },
+    WIMOD_LORAWAN_REGION_FSK(222),
+};
+
+static constexpr UINT32 LoRaWANRegion_DefaultChannels[] = { 868100000, 868300000, 868500000 };
+
+static constexpr UINT32 LoRaWANRegion_Rx2Frequency = 869525000;
+static constexpr UINT8  LoRaWANRegion_Rx2DataRate  = 0;
+static constexpr UINT16 LoRaWANRegion_MaxDwellTimeMs = 0;
+
+// ETSI EN 300 220 sub bands used by the LoRaWAN firmware
+static constexpr TWiMODLORAWAN_RegionBand LoRaWANRegion_Bands[] =
+{
+    { 863000000, 868000000,  100 },
+    { 868000000, 868600000,  100 },
+    { 868700000, 869200000, 1000 },
+    { 869400000, 869650000,   10 },
+    { 869700000, 870000000,  100 },
+};
+
+#elif (WIMOD_LORAWAN_REGION == WIMOD_LORAWAN_REGION_US915)
+
+static constexpr TLoRaWANregion LoRaWANRegion_Id = LoRaWAN_Region_US915;
+
+static constexpr TWiMODLORAWAN_RegionDataRate LoRaWANRegion_DataRates[] =
+{
+    { 10, 125,  11 },
+    {  9, 125,  53 },
+    {  8, 125, 125 },
+    {  7, 125, 242 },
+    {  8, 500, 242 },
+    WIMOD_LORAWAN_REGION_RFU,
+    WIMOD_LORAWAN_REGION_RFU,
+    WIMOD_LORAWAN_REGION_RFU,
+    // downlink only
+    { 12, 500,  33 },
+    { 11, 500, 109 },
+    { 10, 500, 222 },
+    {  9, 500, 222 },
+    {  8, 500, 222 },
+    {  7, 500, 222 },
+};
+
+// fixed channel plan: 64 x 125 kHz (902.3 MHz + n x 200 kHz) and
+// 8 x 500 kHz (903.0 MHz + n x 1.6 MHz); no table needed
+static constexpr UINT32 LoRaWANRegion_Rx2Frequency = 923300000;
+static constexpr UINT8  LoRaWANRegion_Rx2DataRate  = 8;
+static constexpr UINT16 LoRaWANRegion_MaxDwellTimeMs = 400;
+
+// FCC part 15.247: no duty cycle, dwell time limit instead
+static constexpr TWiMODLORAWAN_RegionBand LoRaWANRegion_Bands[] =
+{
+    { 902000000, 928000000,    1 },
+};
+
+#elif (WIMOD_LORAWAN_REGION == WIMOD_LORAWAN_REGION_IN865)
+
+static constexpr TLoRaWANregion LoRaWANRegion_Id = LoRaWAN_Region_IN865;
+
+static constexpr TWiMODLORAWAN_RegionDataRate LoRaWANRegion_DataRates[] =
+{
+    { 12, 125,  51 },
+    { 11, 125,  51 },
+    { 10, 125,  51 },
+    {  9, 125, 115 },
+    {  8, 125, 222 },
+    {  7, 125, 222 },
+    WIMOD_LORAWAN_REGION_RFU,
+    WIMOD_LORAWAN_REGION_FSK(222),
+};
+
+static constexpr UINT32 LoRaWANRegion_DefaultChannels[] = { 865062500, 865402500, 865985000 };
+
+static constexpr UINT32 LoRaWANRegion_Rx2Frequency = 866550000;
+static constexpr UINT8  LoRaWANRegion_Rx2DataRate  = 2;
+static constexpr UINT16 LoRaWANRegion_MaxDwellTimeMs = 0;
+
+static constexpr TWiMODLORAWAN_RegionBand LoRaWANRegion_Bands[] =
+{
+    { 865000000, 867000000,    1 },
+};
+
+#elif (WIMOD_LORAWAN_REGION == WIMOD_LORAWAN_REGION_AS923)
+
+static constexpr TLoRaWANregion LoRaWANRegion_Id = LoRaWAN_Region_AS923;
+
+static constexpr TWiMODLORAWAN_RegionDataRate LoRaWANRegion_DataRates[] =
+{
+    { 12, 125,  51 },
+    { 11, 125,  51 },
+    { 10, 125,  51 },
+    {  9, 125, 115 },
+    {  8, 125, 242 },
+    {  7, 125, 242 },
+    {  7, 250, 242 },
+    WIMOD_LORAWAN_REGION_FSK(242),
+};
+
+static constexpr UINT32 LoRaWANRegion_DefaultChannels[] = { 923200000, 923400000 };
+
+static constexpr UINT32 LoRaWANRegion_Rx2Frequency = 923200000;
+static constexpr UINT8  LoRaWANRegion_Rx2DataRate  = 2;
+static constexpr UINT16 LoRaWANRegion_MaxDwellTimeMs = 0;
+
+// national rules differ (LBT in Japan, ...); 1% is the common denominator
+static constexpr TWiMODLORAWAN_RegionBand LoRaWANRegion_Bands[] =
+{
+    { 915000000, 928000000,  100 },
+};
+
+#elif (WIMOD_LORAWAN_REGION == WIMOD_LORAWAN_REGION_IL915)
+
+static constexpr TLoRaWANregion LoRaWANRegion_Id = LoRaWAN_Region_IL915;
+
+static constexpr TWiMODLORAWAN_RegionDataRate LoRaWANRegion_DataRates[] =
+{
+    { 12, 125,  51 },
+    { 11, 125,  51 },
+    { 10, 125,  51 },
+    {  9, 125, 115 },
+    {  8, 125, 222 },
+    {  7, 125, 222 },
+    {  7, 250, 222 },
+    WIMOD_LORAWAN_REGION_FSK(222),
+};
+
+static constexpr UINT32 LoRaWANRegion_DefaultChannels[] = { 915700000, 915900000, 916100000 };
+
+static constexpr UINT32 LoRaWANRegion_Rx2Frequency = 916300000;
+static constexpr UINT8  LoRaWANRegion_Rx2DataRate  = 0;
+static constexpr UINT16 LoRaWANRegion_MaxDwellTimeMs = 0;
+
+static constexpr TWiMODLORAWAN_RegionBand LoRaWANRegion_Bands[] =
+{
+    { 915000000, 917000000,  100 },
+};
+
+#elif (WIMOD_LORAWAN_REGION == WIMOD_LORAWAN_REGION_RU868)
+
+static constexpr TLoRaWANregion LoRaWANRegion_Id = LoRaWAN_Region_RU868;
+
+static constexpr TWiMODLORAWAN_RegionDataRate LoRaWANRegion_DataRates[] =
+{
+    { 12, 125,  51 },
+    { 11, 125,  51 },
+    { 10, 125,  51 },
+    {  9, 125, 115 },
+    {  8, 125, 222 },
+    {  7, 125, 222 },
+    {  7, 250, 222 },
+    WIMOD_LORAWAN_REGION_FSK(222),
+};
+
+// RP002 RU864 default channels (869.1 MHz is the RX2 frequency as well)
+static constexpr UINT32 LoRaWANRegion_DefaultChannels[] = { 868900000, 869100000 };
+
+static constexpr UINT32 LoRaWANRegion_Rx2Frequency = 869100000;
+static constexpr UINT8  LoRaWANRegion_Rx2DataRate  = 0;
+static constexpr UINT16 LoRaWANRegion_MaxDwellTimeMs = 0;
+
+static constexpr TWiMODLORAWAN_RegionBand LoRaWANRegion_Bands[] =
+{
+    { 864000000, 869200000,  100 },
+    { 869400000, 869650000,   10 },
+};
+
+#else
+#error "WIMOD_LORAWAN_REGION: unknown region"
+#endif
+
+#define WIMOD_LORAWAN_REGION_NUM_DATA_RATES         (sizeof(LoRaWANRegion_DataRates) / sizeof(LoRaWANRegion_DataRates[0]))
+#define WIMOD_LORAWAN_REGION_NUM_BANDS              (sizeof(LoRaWANRegion_Bands) / sizeof(LoRaWANRegion_Bands[0]))
+//! @endcond
+
+
+//------------------------------------------------------------------------------
+//
+// Section lookup functions
+//
+//------------------------------------------------------------------------------
+
+/**
+ * @brief Checks if a data rate index is defined for the selected region
+ */
+static constexpr bool LoRaWANRegion_isValidDataRate(UINT8 dataRate)
+{
+    return (dataRate < WIMOD_LORAWAN_REGION_NUM_DATA_RATES)
+        && (LoRaWANRegion_DataRates[dataRate].MaxPayload != 0);
+}
+
+/**
+ * @brief Returns the max. application payload for a data rate (0 if invalid)
+ */
+static constexpr UINT8 LoRaWANRegion_getMaxPayload(UINT8 dataRate)
+{
+    return (dataRate < WIMOD_LORAWAN_REGION_NUM_DATA_RATES) ? LoRaWANRegion_DataRates[dataRate].MaxPayload : 0;
+}
+
+/**
+ * @brief Returns the spreading factor of a data rate (0 for FSK / invalid)
+ */
+static constexpr UINT8 LoRaWANRegion_getSpreadingFactor(UINT8 dataRate)
+{
+    return (dataRate < WIMOD_LORAWAN_REGION_NUM_DATA_RATES) ? LoRaWANRegion_DataRates[dataRate].SpreadingFactor : 0;
+}
+
+/**
+ * @brief Returns the bandwidth of a data rate in kHz (0 for FSK / invalid)
+ */
+static constexpr UINT16 LoRaWANRegion_getBandwidth(UINT8 dataRate)
+{
+    return (dataRate < WIMOD_LORAWAN_REGION_NUM_DATA_RATES) ? LoRaWANRegion_DataRates[dataRate].BandwidthKHz : 0;
+}
+
+/**
+ * @brief Returns the carrier frequency in Hz for a firmware channel index
+ *
+ * Only the default channels of the region and the RX2 channel are known;
+ * 0 is returned for channels added by the network.
+ */
+#if (WIMOD_LORAWAN_REGION == WIMOD_LORAWAN_REGION_US915)
+static constexpr UINT32 LoRaWANRegion_getChannelFrequency(UINT8 channel)
+{
+    return (channel < 64) ? (902300000UL + (UINT32)channel * 200000UL)
+         : (channel < 72) ? (903000000UL + (UINT32)(channel - 64) * 1600000UL)
+         : (channel == WIMOD_LORAWAN_REGION_RX2_CHANNEL) ? LoRaWANRegion_Rx2Frequency
+         : 0;
+}
+#else
+static constexpr UINT32 LoRaWANRegion_getChannelFrequency(UINT8 channel)
+{
+    return (channel < sizeof(LoRaWANRegion_DefaultChannels) / sizeof(LoRaWANRegion_DefaultChannels[0]))
+            ? LoRaWANRegion_DefaultChannels[channel]
+         : (channel == WIMOD_LORAWAN_REGION_RX2_CHANNEL) ? LoRaWANRegion_Rx2Frequency
+         : 0;
+}
+#endif
+
+//! @cond Doxygen_Suppress
+static constexpr UINT16 loRaWANRegion_findDutyCycle(UINT32 frequency, UINT8 index)
+{
+    return (index >= WIMOD_LORAWAN_REGION_NUM_BANDS) ? 1
+         : ((frequency >= LoRaWANRegion_Bands[index].MinFrequency) && (frequency <= LoRaWANRegion_Bands[index].MaxFrequency))
+            ? LoRaWANRegion_Bands[index].DutyCycleDivider
+         : loRaWANRegion_findDutyCycle(frequency, index + 1);
+}
+//! @endcond
+
+/**
+ * @brief Returns the duty cycle divider for a frequency (100 = 1%, 1 = no limit)
+ */
+static constexpr UINT16 LoRaWANRegion_getDutyCycleDivider(UINT32 frequency)
+{
+    return loRaWANRegion_findDutyCycle(frequency, 0);
+}
+
+//! @cond Doxygen_Suppress
+static constexpr UINT32 loRaWANRegion_ceilDiv(INT32 num, INT32 den)
+{
+    return (num <= 0) ? 0 : (UINT32)((num + den - 1) / den);
+}
+
+static constexpr UINT32 loRaWANRegion_loraAirtimeUs(UINT8 sf, UINT16 bwKHz, UINT16 phyLength)
+{
+    // Semtech AN1200.13: explicit header, CRC on, low data rate optimisation for SF11/SF12 @ 125kHz
+    return (((UINT32)1000 << sf) / bwKHz)
+        * (WIMOD_LORAWAN_REGION_LORA_PREAMBLE_X4
+           + 4 * (8 + loRaWANRegion_ceilDiv(8 * (INT32)phyLength - 4 * sf + 28 + 16,
+                                            4 * (sf - (((sf >= 11) && (bwKHz == 125)) ? 2 : 0)))
+                       * (4 + WIMOD_LORAWAN_REGION_LORA_CR)))
+        / 4;
+}
+//! @endcond
+
+/**
+ * @brief Returns the airtime in us of an uplink with the given application payload
+ *
+ * The MAC overhead without FOpts is added; 0 is returned for invalid data
+ * rates.
+ */
+static constexpr UINT32 LoRaWANRegion_getAirtimeUs(UINT8 dataRate, UINT8 payloadLength)
+{
+    return !LoRaWANRegion_isValidDataRate(dataRate) ? 0
+         : (LoRaWANRegion_DataRates[dataRate].SpreadingFactor == 0)
+            ? (UINT32)(payloadLength + WIMOD_LORAWAN_REGION_MAC_OVERHEAD + WIMOD_LORAWAN_REGION_FSK_OVERHEAD)
+                * WIMOD_LORAWAN_REGION_FSK_US_PER_BYTE
+         : loRaWANRegion_loraAirtimeUs(LoRaWANRegion_DataRates[dataRate].SpreadingFactor,
+                                       LoRaWANRegion_DataRates[dataRate].BandwidthKHz,
+                                       payloadLength + WIMOD_LORAWAN_REGION_MAC_OVERHEAD);
+}
+
+/**
+ * @brief Returns the min. time in ms between the start of two uplinks on a frequency
+ *
+ * Based on the duty cycle limit of the band only; 0 if there is no limit.
+ */
+static constexpr UINT32 LoRaWANRegion_getMinTxIntervalMs(UINT32 frequency, UINT8 dataRate, UINT8 payloadLength)
+{
+    return (LoRaWANRegion_getDutyCycleDivider(frequency) <= 1) ? 0
+         : (LoRaWANRegion_getAirtimeUs(dataRate, payloadLength) / 1000 + 1) * LoRaWANRegion_getDutyCycleDivider(frequency);
+}
+
+/**
+ * @brief Checks if a payload fits into a single uplink at the given data rate
+ */
+static constexpr bool LoRaWANRegion_isPayloadValid(UINT8 dataRate, UINT8 payloadLength)
+{
+    return LoRaWANRegion_isValidDataRate(dataRate)
+        && (payloadLength <= LoRaWANRegion_getMaxPayload(dataRate))
+        && ((LoRaWANRegion_MaxDwellTimeMs == 0)
+            || (LoRaWANRegion_getAirtimeUs(dataRate, payloadLength) <= (UINT32)LoRaWANRegion_MaxDwellTimeMs * 1000));
+}
+
+/**
+ * @brief Checks if a region setting matches the compiled in one
+ *
+ * The compiled in region can be passed to the WiMODLoRaWAN class directly:
+ *
+ * @code
+ * wimod.begin(LoRaWANRegion_Id);
+ * @endcode
+ */
+static constexpr bool LoRaWANRegion_matches(TLoRaWANregion region)
+{
+    return region == LoRaWANRegion_Id;
+}
+
+//! @cond Doxygen_Suppress
+static_assert(WIMOD_LORAWAN_REGION_NUM_DATA_RATES >= 8, "region table: DR0 ... DR7 required");
+static_assert(LoRaWANRegion_isValidDataRate(LoRaWANRegion_Rx2DataRate), "region table: invalid RX2 data rate");
+static_assert(LoRaWANRegion_getChannelFrequency(WIMOD_LORAWAN_REGION_RX2_CHANNEL) == LoRaWANRegion_Rx2Frequency, "region table: RX2");
+//! @endcond
+
+
+#endif /* ARDUINO_WIMODLORAWAN_REGION_H_ */
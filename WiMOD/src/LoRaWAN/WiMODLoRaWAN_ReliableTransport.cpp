@@ -0,0 +1,503 @@
+//------------------------------------------------------------------------------
+//! @file WiMODLoRaWAN_ReliableTransport.cpp
+//! @ingroup WiMODLoRaWAN
+//! <!------------------------------------------------------------------------->
+//! @brief Windowed reliable transport over U-Data
+//! @version 0.1
+//! <!------------------------------------------------------------------------->
+//!
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+//
+// Section Includes Files
+//
+//------------------------------------------------------------------------------
+
+#include "WiMODLoRaWAN_ReliableTransport.h"
+
+#include <string.h>
+
+//------------------------------------------------------------------------------
+//
+// Section public functions - WiMODLoRaWAN_ReliableTransport
+//
+//------------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Constructor
+ *
+ * @param wimod     reference to the LoRaWAN interface
+ */
+WiMODLoRaWAN_ReliableTransport::WiMODLoRaWAN_ReliableTransport(WiMODLoRaWAN& wimod) :
+    wimod(wimod)
+{
+    memset(window, 0x00, sizeof(window));
+    memset(&stats, 0x00, sizeof(stats));
+
+    port            = WIMOD_RT_DEFAULT_PORT;
+    maxPayload      = WIMOD_RT_DEFAULT_MAX_PAYLOAD;
+    ackTimeout      = WIMOD_RT_DEFAULT_ACK_TIMEOUT;
+    baseSeq         = 0;
+    nextSeq         = 0;
+    uplinksSinceAck = 0;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Destructor
+ */
+WiMODLoRaWAN_ReliableTransport::~WiMODLoRaWAN_ReliableTransport(void)
+{
+
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Sets the LoRaWAN port used for data and ack frames
+ */
+void WiMODLoRaWAN_ReliableTransport::SetPort(UINT8 port)
+{
+    this->port = port;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Sets the max. frame size (see MaxPayloadSize of the nwk status)
+ */
+void WiMODLoRaWAN_ReliableTransport::SetMaxPayload(UINT8 maxPayload)
+{
+    this->maxPayload = MIN(maxPayload, (UINT8) WiMODLORAWAN_APP_PAYLOAD_LEN);
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Sets the number of uplinks without ack after which all records in
+ *        flight are sent again
+ */
+void WiMODLoRaWAN_ReliableTransport::SetAckTimeout(UINT8 uplinks)
+{
+    ackTimeout = uplinks;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Adds a record to the send window
+ *
+ * @param data      record data (copied)
+ *
+ * @param length    length of the record (max. WIMOD_RT_MAX_RECORD_SIZE)
+ *
+ * @retval true     if the record has been queued
+ * @retval false    if the window is full or the record is too large
+ */
+bool WiMODLoRaWAN_ReliableTransport::Queue(const UINT8* data, UINT8 length)
+{
+    TWiMODLORAWAN_RtRecord* record;
+
+    if ((data == NULL) || (length == 0) || (length > WIMOD_RT_MAX_RECORD_SIZE)
+            || (GetFreeSlots() == 0)) {
+        return false;
+    }
+
+    record          = &window[nextSeq % WIMOD_RT_WINDOW_SIZE];
+    record->State   = RtRecord_Queued;
+    record->Seq     = nextSeq;
+    record->Length  = length;
+    record->TxCount = 0;
+    memcpy(record->Data, data, length);
+
+    nextSeq++;
+    stats.RecordsQueued++;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns true if records are waiting for (re)transmission
+ */
+bool WiMODLoRaWAN_ReliableTransport::HasPendingData(void)
+{
+    UINT8 seq;
+
+    for (seq = baseSeq; seq != nextSeq; seq++) {
+        if (window[seq % WIMOD_RT_WINDOW_SIZE].State == RtRecord_Queued) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Packs the queued records (oldest first) into one U-Data frame
+ *
+ * An ack is requested from the receiver if this frame empties the queue or
+ * half of the window is in flight.
+ *
+ * @param hciResult Result of the local command transmission to module
+ *                  This is an optional parameter.
+ *
+ * @param rspStatus Status byte contained in the local response of the module
+ *                  This is an optional parameter.
+ *
+ * @retval true     if a frame has been handed over to the module
+ *
+ * @code
+ * WiMODLoRaWAN_ReliableTransport transport(wimod);
+ *
+ * void onRxData(TWiMODLR_HCIMessage& rxMsg) {
+ *  wimod.convert(rxMsg, &radioRxMsg);
+ *  if (transport.ProcessRxData(radioRxMsg)) {
+ *      return;
+ *  }
+ *  ...
+ * }
+ *
+ * void loop() {
+ *  ...
+ *  transport.Queue(record, sizeof(record));
+ *  if (sendAllowed && transport.HasPendingData()) {
+ *      transport.SendNext();
+ *  }
+ * }
+ * @endcode
+ */
+bool WiMODLoRaWAN_ReliableTransport::SendNext(TWiMODLRResultCodes* hciResult, UINT8* rspStatus)
+{
+    TWiMODLORAWAN_RtRecord* record;
+    UINT32                  included = 0;
+    UINT8                   offset   = WIMOD_RT_DATA_HEADER_SIZE;
+    UINT8                   numRecords = 0;
+    UINT8                   inFlight = 0;
+    UINT8                   unacked  = 0;
+    UINT8                   seq;
+    UINT8                   i;
+
+    // no ack for too long -> assume everything in flight is lost
+    if ((ackTimeout > 0) && (uplinksSinceAck >= ackTimeout)) {
+        for (seq = baseSeq; seq != nextSeq; seq++) {
+            record = &window[seq % WIMOD_RT_WINDOW_SIZE];
+            if (record->State == RtRecord_InFlight) {
+                record->State = RtRecord_Queued;
+            }
+        }
+        uplinksSinceAck = 0;
+    }
+
+    for (seq = baseSeq, i = 0; seq != nextSeq; seq++, i++) {
+        record = &window[seq % WIMOD_RT_WINDOW_SIZE];
+        if (record->State == RtRecord_InFlight) {
+            inFlight++;
+        }
+        if (record->State != RtRecord_Free) {
+            unacked++;
+        }
+        if ((record->State != RtRecord_Queued)
+                || (offset + WIMOD_RT_RECORD_HEADER_SIZE + record->Length > maxPayload)) {
+            continue;
+        }
+        txData.Payload[offset++] = record->Seq;
+        txData.Payload[offset++] = record->Length;
+        memcpy(&txData.Payload[offset], record->Data, record->Length);
+        offset += record->Length;
+        included |= (1UL << i);
+        numRecords++;
+    }
+
+    if (numRecords == 0) {
+        return false;
+    }
+
+    txData.Port       = port;
+    txData.Length     = offset;
+    txData.Payload[0] = WIMOD_RT_FRAME_DATA;
+    txData.Payload[1] = numRecords;
+
+    // request an ack at the end of a burst or if the window runs full
+    inFlight += numRecords;
+    if ((inFlight >= WIMOD_RT_WINDOW_SIZE / 2)
+            || (unacked == inFlight)) {
+        txData.Payload[0] |= WIMOD_RT_FLAG_ACK_REQ;
+    }
+
+    if (!wimod.SendUData(&txData, hciResult, rspStatus)) {
+        return false;
+    }
+
+    for (seq = baseSeq, i = 0; seq != nextSeq; seq++, i++) {
+        if (included & (1UL << i)) {
+            record = &window[seq % WIMOD_RT_WINDOW_SIZE];
+            record->State = RtRecord_InFlight;
+            if (record->TxCount++ > 0) {
+                stats.Retransmissions++;
+            }
+        }
+    }
+    stats.Uplinks++;
+    uplinksSinceAck++;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Feeds a received downlink into the transport
+ *
+ * @param rxData    converted RX U-Data or RX C-Data indication
+ *
+ * @retval true     if the frame was an ack frame of the transport
+ */
+bool WiMODLoRaWAN_ReliableTransport::ProcessRxData(const TWiMODLORAWAN_RX_Data& rxData)
+{
+    if ((rxData.Port != port) || (rxData.Length < WIMOD_RT_ACK_FRAME_SIZE)
+            || ((rxData.Payload[0] & WIMOD_RT_FRAME_TYPE_MASK) != WIMOD_RT_FRAME_ACK)) {
+        return false;
+    }
+
+    processAck(rxData.Payload[1], NTOH32(&rxData.Payload[2]));
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Adds the airtime of a transport uplink to the statistics
+ *
+ * Only feed the indications of uplinks sent by SendNext(); the indication
+ * itself does not carry the port.
+ */
+void WiMODLoRaWAN_ReliableTransport::ProcessTxIndication(const TWiMODLORAWAN_TxIndData& txInd)
+{
+    if (txInd.FieldAvailability != LORAWAN_OPT_TX_IND_INFOS_NOT_AVAILABLE) {
+        stats.AirtimeMs += txInd.RfMsgAirtime;
+    }
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the number of records that can still be queued
+ */
+UINT8 WiMODLoRaWAN_ReliableTransport::GetFreeSlots(void)
+{
+    return WIMOD_RT_WINDOW_SIZE - (UINT8) (nextSeq - baseSeq);
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Copies the counters of the transport
+ */
+void WiMODLoRaWAN_ReliableTransport::GetStats(TWiMODLORAWAN_RtStats* stats)
+{
+    if (stats) {
+        memcpy(stats, &this->stats, sizeof(TWiMODLORAWAN_RtStats));
+    }
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the delivered bytes per airtime second
+ *
+ * @retval 0 if no airtime has been reported yet
+ */
+UINT32 WiMODLoRaWAN_ReliableTransport::GetGoodput(void)
+{
+    if (stats.AirtimeMs == 0) {
+        return 0;
+    }
+    return (UINT32) (((UINT64) stats.BytesDelivered * 1000) / stats.AirtimeMs);
+}
+
+//------------------------------------------------------------------------------
+//
+// Section protected functions - WiMODLoRaWAN_ReliableTransport
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+void WiMODLoRaWAN_ReliableTransport::processAck(UINT8 nextExpected, UINT32 bitmap)
+{
+    TWiMODLORAWAN_RtRecord* record;
+    UINT8                   offset;
+    UINT8                   newest;
+    UINT8                   seq;
+
+    // ack must not refer to records that have never been sent
+    if ((UINT8) (nextExpected - baseSeq) > (UINT8) (nextSeq - baseSeq)) {
+        return;
+    }
+
+    stats.AcksReceived++;
+    uplinksSinceAck = 0;
+
+    // offset of the newest record the ack covers, 0: none past nextExpected
+    newest = 0;
+    for (offset = 32; offset > 0; offset--) {
+        if (bitmap & (1UL << (offset - 1))) {
+            newest = offset;
+            break;
+        }
+    }
+
+    for (seq = baseSeq; seq != nextSeq; seq++) {
+        record = &window[seq % WIMOD_RT_WINDOW_SIZE];
+        if (record->State == RtRecord_Free) {
+            continue;
+        }
+
+        offset = (UINT8) (seq - nextExpected);
+        if ((INT8) offset < 0) {
+            release(*record);
+        } else if ((offset > 0) && (offset <= 32) && (bitmap & (1UL << (offset - 1)))) {
+            release(*record);
+        } else if ((record->State == RtRecord_InFlight) && (offset < newest)) {
+            // a gap below a record the receiver got: lost. Newer records
+            // may still be on their way, they wait for the next ack or
+            // the ack timeout
+            record->State = RtRecord_Queued;
+        }
+    }
+
+    while ((baseSeq != nextSeq) && (window[baseSeq % WIMOD_RT_WINDOW_SIZE].State == RtRecord_Free)) {
+        baseSeq++;
+    }
+}
+
+void WiMODLoRaWAN_ReliableTransport::release(TWiMODLORAWAN_RtRecord& record)
+{
+    // a record that has never been sent can't be acked
+    if (record.TxCount == 0) {
+        return;
+    }
+    stats.RecordsDelivered++;
+    stats.BytesDelivered += record.Length;
+    record.State = RtRecord_Free;
+}
+//! @endcond
+
+//------------------------------------------------------------------------------
+//
+// Section public functions - WiMODLoRaWAN_ReliableReceiver
+//
+//------------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Constructor
+ */
+WiMODLoRaWAN_ReliableReceiver::WiMODLoRaWAN_ReliableReceiver(void)
+{
+    nextExpected   = 0;
+    bitmap         = 0;
+    ackRequested   = false;
+    recordCallback = NULL;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Destructor
+ */
+WiMODLoRaWAN_ReliableReceiver::~WiMODLoRaWAN_ReliableReceiver(void)
+{
+
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Registers a callback for each new (not duplicated) record
+ */
+void WiMODLoRaWAN_ReliableReceiver::RegisterRecordClient(TRtRecordCallback cb)
+{
+    recordCallback = cb;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Processes a data frame of the transport
+ *
+ * @param frame     frame payload (without LoRaWAN port)
+ *
+ * @param length    length of the frame
+ *
+ * @retval number of new records in this frame
+ */
+UINT8 WiMODLoRaWAN_ReliableReceiver::ProcessFrame(const UINT8* frame, UINT8 length)
+{
+    UINT8 offset = WIMOD_RT_DATA_HEADER_SIZE;
+    UINT8 newRecords = 0;
+    UINT8 numRecords;
+    UINT8 seq;
+    UINT8 len;
+    UINT8 diff;
+    bool  fresh;
+
+    if ((frame == NULL) || (length < WIMOD_RT_DATA_HEADER_SIZE)
+            || ((frame[0] & WIMOD_RT_FRAME_TYPE_MASK) != WIMOD_RT_FRAME_DATA)) {
+        return 0;
+    }
+
+    if (frame[0] & WIMOD_RT_FLAG_ACK_REQ) {
+        ackRequested = true;
+    }
+
+    numRecords = frame[1];
+    while (numRecords-- && (offset + WIMOD_RT_RECORD_HEADER_SIZE <= length)) {
+        seq = frame[offset++];
+        len = frame[offset++];
+        if (offset + len > length) {
+            break;
+        }
+
+        fresh = false;
+        diff  = (UINT8) (seq - nextExpected);
+        if (diff == 0) {
+            fresh = true;
+            // advance over all records already received out of order
+            do {
+                nextExpected++;
+                diff    = (UINT8) (bitmap & 0x01);
+                bitmap >>= 1;
+            } while (diff);
+        } else if ((diff <= 32) && !(bitmap & (1UL << (diff - 1)))) {
+            fresh   = true;
+            bitmap |= (1UL << (diff - 1));
+        }
+
+        if (fresh) {
+            newRecords++;
+            if (recordCallback) {
+                recordCallback(seq, &frame[offset], len);
+            }
+        }
+        offset += len;
+    }
+    return newRecords;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns true if the sender asked for an ack since the last BuildAck()
+ */
+bool WiMODLoRaWAN_ReliableReceiver::IsAckRequested(void)
+{
+    return ackRequested;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Builds an ack frame (WIMOD_RT_ACK_FRAME_SIZE bytes)
+ *
+ * @retval length of the frame
+ */
+UINT8 WiMODLoRaWAN_ReliableReceiver::BuildAck(UINT8* frame)
+{
+    frame[0] = WIMOD_RT_FRAME_ACK;
+    frame[1] = nextExpected;
+    HTON32(&frame[2], bitmap);
+
+    ackRequested = false;
+    return WIMOD_RT_ACK_FRAME_SIZE;
+}
+
+//------------------------------------------------------------------------------
+// EOF
+//------------------------------------------------------------------------------
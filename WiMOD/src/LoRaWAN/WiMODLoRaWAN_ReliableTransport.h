@@ -0,0 +1,192 @@
+//------------------------------------------------------------------------------
+//! @file WiMODLoRaWAN_ReliableTransport.h
+//! @ingroup WiMODLoRaWAN
+//! <!------------------------------------------------------------------------->
+//! @brief Declarations for a windowed reliable transport over U-Data
+//! @version 0.1
+//! <!------------------------------------------------------------------------->
+//!
+//! Small application records get a sequence number and are packed into
+//! unconfirmed uplinks. The receiving application answers (from time to time)
+//! with a downlink that holds the next expected sequence number plus a bitmap
+//! of the records received beyond it. Only records reported as missing are
+//! sent again - instead of one MAC level ack (and up to 7 retransmissions of
+//! the whole frame) per message as with C-Data.
+//!
+//! Uplink frame:   | 0x01 [| 0x10 ack req] | n | seq | len | data | seq | len | data | ...
+//! Downlink frame: | 0x02 | next expected seq | bitmap (LE32) |
+//!
+//! Bit i of the bitmap reports record (next expected + 1 + i).
+//!
+//------------------------------------------------------------------------------
+
+
+#ifndef ARDUINO_WIMODLORAWAN_RELIABLETRANSPORT_H_
+#define ARDUINO_WIMODLORAWAN_RELIABLETRANSPORT_H_
+
+//------------------------------------------------------------------------------
+//
+// Section Includes Files
+//
+//------------------------------------------------------------------------------
+
+#include "../WiMODLoRaWAN.h"
+
+//------------------------------------------------------------------------------
+//
+// Section defines
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+#define WIMOD_RT_DEFAULT_PORT                       202
+#define WIMOD_RT_WINDOW_SIZE                        16                          // records in flight; max. 32 (ack bitmap)
+#define WIMOD_RT_MAX_RECORD_SIZE                    32
+#define WIMOD_RT_DEFAULT_MAX_PAYLOAD                51                          // EU868 DR0 ... DR2
+#define WIMOD_RT_DEFAULT_ACK_TIMEOUT                8                           // uplinks without ack before resend
+
+#define WIMOD_RT_FRAME_DATA                         0x01
+#define WIMOD_RT_FRAME_ACK                          0x02
+#define WIMOD_RT_FRAME_TYPE_MASK                    0x0F
+#define WIMOD_RT_FLAG_ACK_REQ                       0x10
+
+#define WIMOD_RT_DATA_HEADER_SIZE                   2
+#define WIMOD_RT_RECORD_HEADER_SIZE                 2
+#define WIMOD_RT_ACK_FRAME_SIZE                     6
+//! @endcond
+
+/**
+ * @brief State of a record slot
+ */
+typedef enum TWiMODLORAWAN_RtRecordState
+{
+    RtRecord_Free = 0,                                                          /*!< slot not used */
+    RtRecord_Queued,                                                            /*!< waiting for (re)transmission */
+    RtRecord_InFlight,                                                          /*!< sent, waiting for ack */
+} TWiMODLORAWAN_RtRecordState;
+
+/**
+ * @brief A single record of the send window
+ */
+typedef struct TWiMODLORAWAN_RtRecord
+{
+    TWiMODLORAWAN_RtRecordState State;                                          /*!< slot state */
+    UINT8       Seq;                                                            /*!< sequence number */
+    UINT8       Length;                                                         /*!< length of the record data */
+    UINT8       TxCount;                                                        /*!< number of transmissions */
+    UINT8       Data[WIMOD_RT_MAX_RECORD_SIZE];                                 /*!< record data */
+} TWiMODLORAWAN_RtRecord;
+
+/**
+ * @brief Counters of the transport
+ *
+ * BytesDelivered per AirtimeMs is the figure to compare with the C-Data
+ * path (sum of acked payload bytes over sum of RfMsgAirtime).
+ */
+typedef struct TWiMODLORAWAN_RtStats
+{
+    UINT32      RecordsQueued;                                                  /*!< records accepted by Queue() */
+    UINT32      RecordsDelivered;                                               /*!< records acked by the receiver */
+    UINT32      BytesDelivered;                                                 /*!< record payload bytes acked */
+    UINT32      Retransmissions;                                                /*!< records sent more than once */
+    UINT32      Uplinks;                                                        /*!< U-Data frames sent */
+    UINT32      AcksReceived;                                                   /*!< ack downlinks processed */
+    UINT32      AirtimeMs;                                                      /*!< sum of the reported airtime */
+} TWiMODLORAWAN_RtStats;
+
+
+// C++11 check
+#ifdef WIMOD_USE_CPP11
+    /** Type definition for a 'record received' callback */
+    typedef std::function<void (UINT8 seq, const UINT8* data, UINT8 length)> TRtRecordCallback;
+#else
+    /** Type definition for a 'record received' callback function */
+    typedef void (*TRtRecordCallback)(UINT8 seq, const UINT8* data, UINT8 length);
+#endif
+
+
+//------------------------------------------------------------------------------
+//
+// Section class
+//
+//------------------------------------------------------------------------------
+
+/**
+ * @brief Sender of the windowed reliable transport
+ *
+ * Feed the converted RX U-Data / RX C-Data and TX U-Data indications into
+ * ProcessRxData() and ProcessTxIndication(); call SendNext() whenever the
+ * application is allowed to send an uplink.
+ */
+class WiMODLoRaWAN_ReliableTransport {
+public:
+    WiMODLoRaWAN_ReliableTransport(WiMODLoRaWAN& wimod);
+    ~WiMODLoRaWAN_ReliableTransport(void);
+
+    void        SetPort(UINT8 port);
+    void        SetMaxPayload(UINT8 maxPayload);
+    void        SetAckTimeout(UINT8 uplinks);
+
+    bool        Queue(const UINT8* data, UINT8 length);
+    bool        HasPendingData(void);
+    bool        SendNext(TWiMODLRResultCodes* hciResult = NULL, UINT8* rspStatus = NULL);
+
+    bool        ProcessRxData(const TWiMODLORAWAN_RX_Data& rxData);
+    void        ProcessTxIndication(const TWiMODLORAWAN_TxIndData& txInd);
+
+    UINT8       GetFreeSlots(void);
+    void        GetStats(TWiMODLORAWAN_RtStats* stats);
+    UINT32      GetGoodput(void);
+
+protected:
+    //! @cond Doxygen_Suppress
+    void        processAck(UINT8 nextExpected, UINT32 bitmap);
+    void        release(TWiMODLORAWAN_RtRecord& record);
+    //! @endcond
+private:
+    //! @cond Doxygen_Suppress
+    WiMODLoRaWAN&           wimod;
+    TWiMODLORAWAN_TX_Data   txData;
+    TWiMODLORAWAN_RtRecord  window[WIMOD_RT_WINDOW_SIZE];
+    TWiMODLORAWAN_RtStats   stats;
+
+    UINT8                   port;
+    UINT8                   maxPayload;
+    UINT8                   ackTimeout;
+    UINT8                   baseSeq;                                            // oldest unacked record
+    UINT8                   nextSeq;                                            // seq of the next queued record
+    UINT8                   uplinksSinceAck;
+    //! @endcond
+};
+
+
+/**
+ * @brief Receiving side of the windowed reliable transport
+ *
+ * Used by the peer that consumes the records (e.g. a gateway side host or a
+ * test harness). Records are passed on as soon as they arrive; duplicates
+ * are filtered.
+ */
+class WiMODLoRaWAN_ReliableReceiver {
+public:
+    WiMODLoRaWAN_ReliableReceiver(void);
+    ~WiMODLoRaWAN_ReliableReceiver(void);
+
+    void        RegisterRecordClient(TRtRecordCallback cb);
+
+    UINT8       ProcessFrame(const UINT8* frame, UINT8 length);
+    bool        IsAckRequested(void);
+    UINT8       BuildAck(UINT8* frame);
+
+private:
+    //! @cond Doxygen_Suppress
+    UINT8                   nextExpected;
+    UINT32                  bitmap;
+    bool                    ackRequested;
+
+    TRtRecordCallback       recordCallback;
+    //! @endcond
+};
+
+
+#endif /* ARDUINO_WIMODLORAWAN_RELIABLETRANSPORT_H_ */
@@ -0,0 +1,443 @@
+//------------------------------------------------------------------------------
+//! @file WiMODLoRaWAN_SplitSend.cpp
+//! @ingroup WiMODLoRaWAN
+//! <!------------------------------------------------------------------------->
+//! @brief Max. payload aware U-Data send path with transparent splitting
+//! @version 0.1
+//! <!------------------------------------------------------------------------->
+//!
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+//
+// Section Includes Files
+//
+//------------------------------------------------------------------------------
+
+#include "WiMODLoRaWAN_SplitSend.h"
+#include "WiMODLoRaWAN_Region.h"
+
+#include <string.h>
+
+//------------------------------------------------------------------------------
+//
+// Section public functions
+//
+//------------------------------------------------------------------------------
+
+/**
+ * @brief Constructor
+ *
+ * @param wimod     reference to an initialized WiMODLoRaWAN instance
+ */
+WiMODLoRaWAN_SplitSender::WiMODLoRaWAN_SplitSender(WiMODLoRaWAN& wimod) :
+    wimod(wimod)
+{
+    splitPort       = WIMOD_SPLIT_DEFAULT_PORT;
+    maxPayload      = 0;
+    dataRate        = 0xFF;
+    maxPayloadValid = false;
+    messageId       = 0;
+    Abort();
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Destructor
+ */
+WiMODLoRaWAN_SplitSender::~WiMODLoRaWAN_SplitSender(void)
+{
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Sets the LoRaWAN port used for the segments of split messages
+ */
+void WiMODLoRaWAN_SplitSender::SetSplitPort(UINT8 port)
+{
+    splitPort = port;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Reads the current max. payload size from the network status
+ *
+ * Called automatically before the next uplink if the cached value is
+ * outdated; may be called by the application after activation.
+ *
+ * @param hciResult Result of the local command transmission to module
+ *                  This is an optional parameter.
+ *
+ * @param rspStatus Status byte contained in the local response of the module
+ *                  This is an optional parameter.
+ *
+ * @retval true     if the cached value has been updated
+ */
+bool WiMODLoRaWAN_SplitSender::RefreshMaxPayload(TWiMODLRResultCodes* hciResult, UINT8* rspStatus)
+{
+    TWiMODLORAWAN_NwkStatus_Data nwkStatus;
+
+    if (!wimod.GetNwkStatus(&nwkStatus, hciResult, rspStatus)) {
+        return false;
+    }
+
+    maxPayload      = MIN(nwkStatus.MaxPayloadSize, (UINT8) WiMODLORAWAN_APP_PAYLOAD_LEN);
+    dataRate        = nwkStatus.DataRateIndex;
+    maxPayloadValid = true;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Tracks data rate changes (ADR, retransmissions on lower data rates)
+ *
+ * On a change the max. payload of the new data rate is taken from the
+ * region table right away and the exact value (which also accounts for
+ * pending MAC commands) is re-read before the next uplink.
+ *
+ * @param txInd     converted TX U-Data / TX C-Data indication
+ */
+void WiMODLoRaWAN_SplitSender::ProcessTxIndication(const TWiMODLORAWAN_TxIndData& txInd)
+{
+    UINT8 estimate;
+
+    if ((txInd.FieldAvailability == LORAWAN_OPT_TX_IND_INFOS_NOT_AVAILABLE)
+            || (txInd.DataRateIndex == dataRate)) {
+        return;
+    }
+
+    dataRate = txInd.DataRateIndex;
+    estimate = LoRaWANRegion_getMaxPayload(dataRate);
+    if (estimate != 0) {
+        maxPayload = MIN(estimate, (UINT8) WiMODLORAWAN_APP_PAYLOAD_LEN);
+    }
+    maxPayloadValid = false;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the cached max. payload size (0 if unknown)
+ */
+UINT8 WiMODLoRaWAN_SplitSender::GetMaxPayload(void)
+{
+    return maxPayload;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns false if the cached max. payload is only an estimate
+ *
+ * After a data rate change the value comes from the region table; call
+ * RefreshMaxPayload() before building a message that has to fit one frame.
+ */
+bool WiMODLoRaWAN_SplitSender::IsMaxPayloadValid(void)
+{
+    return maxPayloadValid;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Sends a message as U-Data; splits it if it exceeds the max. payload
+ *
+ * A message that fits is sent as is on the given port. Otherwise it is
+ * copied into the internal buffer and the first segment is sent; the rest
+ * follows with SendNext(). A split message stays pending even if the module
+ * rejected its first segment.
+ *
+ * @param port      LoRaWAN port of the message
+ *
+ * @param data      message data
+ *
+ * @param length    length of the message (max. WIMOD_SPLIT_TX_BUFFER_SIZE)
+ *
+ * @param hciResult Result of the local command transmission to module
+ *                  This is an optional parameter.
+ *
+ * @param rspStatus Status byte contained in the local response of the module
+ *                  This is an optional parameter.
+ *
+ * @retval true     if the message (or its first segment) has been handed
+ *                  over to the module
+ * @retval false    if a split message is still pending, the message is too
+ *                  large or the module rejected the frame
+ *
+ * @code
+ * WiMODLoRaWAN_SplitSender sender(wimod);
+ *
+ * void onTxInd(TWiMODLR_HCIMessage& rxMsg) {
+ *     TWiMODLORAWAN_TxIndData txInd;
+ *     wimod.convert(rxMsg, &txInd);
+ *     sender.ProcessTxIndication(txInd);
+ * }
+ *
+ * void loop() {
+ *     ...
+ *     if (sender.HasPendingData()) {
+ *         sender.SendNext();
+ *     } else if (reportDue) {
+ *         sender.Send(10, report, reportLength);
+ *     }
+ * }
+ * @endcode
+ */
+bool WiMODLoRaWAN_SplitSender::Send(UINT8 port, const UINT8* data, UINT16 length,
+                                    TWiMODLRResultCodes* hciResult, UINT8* rspStatus)
+{
+    if ((data == NULL) || (length == 0) || (length > WIMOD_SPLIT_TX_BUFFER_SIZE)
+            || HasPendingData()) {
+        return false;
+    }
+
+    if (!maxPayloadValid) {
+        // keep the estimate if the status can't be read
+        RefreshMaxPayload();
+    }
+
+    if (length <= maxPayload) {
+        txData.Port   = port;
+        txData.Length = (UINT8) length;
+        memcpy(txData.Payload, data, length);
+        return sendFrame(hciResult, rspStatus);
+    }
+
+    if (maxPayload <= WIMOD_SPLIT_HEADER_SIZE) {
+        return false;
+    }
+
+    memcpy(buffer, data, length);
+    this->appPort = port;
+    this->length  = length;
+    offset        = 0;
+    nextIndex     = 0;
+    messageId++;
+
+    return SendNext(hciResult, rspStatus);
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Sends the next segment of the pending message
+ *
+ * The segment size follows the current max. payload, so a data rate change
+ * in the middle of a message is handled. The position only advances if the
+ * module accepted the frame.
+ *
+ * @param hciResult Result of the local command transmission to module
+ *                  This is an optional parameter.
+ *
+ * @param rspStatus Status byte contained in the local response of the module
+ *                  This is an optional parameter.
+ *
+ * @retval true     if a segment has been handed over to the module
+ */
+bool WiMODLoRaWAN_SplitSender::SendNext(TWiMODLRResultCodes* hciResult, UINT8* rspStatus)
+{
+    UINT16 segment;
+
+    if (!HasPendingData()) {
+        return false;
+    }
+
+    if (!maxPayloadValid) {
+        RefreshMaxPayload();
+    }
+
+    if ((maxPayload <= WIMOD_SPLIT_HEADER_SIZE) || (nextIndex > WIMOD_SPLIT_INDEX_MASK)) {
+        return false;
+    }
+
+    segment = MIN((UINT16) (maxPayload - WIMOD_SPLIT_HEADER_SIZE), (UINT16) (length - offset));
+
+    txData.Port       = splitPort;
+    txData.Length     = (UINT8) (WIMOD_SPLIT_HEADER_SIZE + segment);
+    txData.Payload[0] = appPort;
+    txData.Payload[1] = messageId;
+    txData.Payload[2] = nextIndex;
+    if (offset + segment == length) {
+        txData.Payload[2] |= WIMOD_SPLIT_FLAG_LAST;
+    }
+    memcpy(&txData.Payload[WIMOD_SPLIT_HEADER_SIZE], &buffer[offset], segment);
+
+    if (!sendFrame(hciResult, rspStatus)) {
+        return false;
+    }
+
+    offset += segment;
+    nextIndex++;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns true if segments of a split message are still to be sent
+ */
+bool WiMODLoRaWAN_SplitSender::HasPendingData(void)
+{
+    return offset < length;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Drops the rest of the pending message
+ */
+void WiMODLoRaWAN_SplitSender::Abort(void)
+{
+    appPort   = 0;
+    nextIndex = 0;
+    length    = 0;
+    offset    = 0;
+}
+
+//------------------------------------------------------------------------------
+//
+// Section protected functions
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+bool WiMODLoRaWAN_SplitSender::sendFrame(TWiMODLRResultCodes* hciResult, UINT8* rspStatus)
+{
+    TWiMODLRResultCodes hciRes = WiMODLR_RESULT_NO_RESPONSE;
+    UINT8               status = LORAWAN_STATUS_OK;
+    bool                ok;
+
+    ok = wimod.SendUData(&txData, &hciRes, &status);
+
+    // too long for the data rate in use: re-read the limit before the next try
+    if ((hciRes == WiMODLR_RESULT_OK) && (status == LORAWAN_STATUS_LENGTH_ERROR)) {
+        maxPayloadValid = false;
+    }
+
+    if (hciResult) {
+        *hciResult = hciRes;
+    }
+    // without a response the status byte is not from this command
+    if (rspStatus && (hciRes == WiMODLR_RESULT_OK)) {
+        *rspStatus = status;
+    }
+    return ok;
+}
+//! @endcond
+
+
+//------------------------------------------------------------------------------
+//
+// Section WiMODLoRaWAN_SplitReceiver
+//
+//------------------------------------------------------------------------------
+
+/**
+ * @brief Constructor
+ */
+WiMODLoRaWAN_SplitReceiver::WiMODLoRaWAN_SplitReceiver(void)
+{
+    splitPort       = WIMOD_SPLIT_DEFAULT_PORT;
+    appPort         = 0;
+    messageId       = 0;
+    nextIndex       = 0;
+    length          = 0;
+    dropped         = 0;
+    active          = false;
+    messageCallback = NULL;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Destructor
+ */
+WiMODLoRaWAN_SplitReceiver::~WiMODLoRaWAN_SplitReceiver(void)
+{
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Sets the LoRaWAN port used for the segments of split messages
+ */
+void WiMODLoRaWAN_SplitReceiver::SetSplitPort(UINT8 port)
+{
+    splitPort = port;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Registers the handler for reassembled messages
+ */
+void WiMODLoRaWAN_SplitReceiver::RegisterMessageClient(TSplitMessageCallback cb)
+{
+    messageCallback = cb;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Processes an uplink payload
+ *
+ * @param port      LoRaWAN port of the uplink
+ *
+ * @param frame     uplink payload
+ *
+ * @param length    length of the payload
+ *
+ * @retval true     if the frame was a segment (consumed)
+ * @retval false    if the frame is a plain message for the application
+ */
+bool WiMODLoRaWAN_SplitReceiver::ProcessFrame(UINT8 port, const UINT8* frame, UINT8 length)
+{
+    UINT8 index;
+    UINT8 size;
+
+    if ((port != splitPort) || (frame == NULL) || (length <= WIMOD_SPLIT_HEADER_SIZE)) {
+        return false;
+    }
+
+    index = frame[2] & WIMOD_SPLIT_INDEX_MASK;
+    size  = length - WIMOD_SPLIT_HEADER_SIZE;
+
+    if (index == 0) {
+        if (active) {
+            dropped++;
+        }
+        active       = true;
+        appPort      = frame[0];
+        messageId    = frame[1];
+        nextIndex    = 0;
+        this->length = 0;
+    } else if (!active || (frame[1] != messageId) || (index != nextIndex)) {
+        // segment lost: the message can't be completed
+        if (active) {
+            dropped++;
+        }
+        active = false;
+        return true;
+    }
+
+    if (this->length + size > WIMOD_SPLIT_RX_BUFFER_SIZE) {
+        dropped++;
+        active = false;
+        return true;
+    }
+
+    memcpy(&buffer[this->length], &frame[WIMOD_SPLIT_HEADER_SIZE], size);
+    this->length += size;
+    nextIndex++;
+
+    if (frame[2] & WIMOD_SPLIT_FLAG_LAST) {
+        active = false;
+        if (messageCallback) {
+            messageCallback(appPort, buffer, this->length);
+        }
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the number of dropped (incomplete) messages
+ */
+UINT16 WiMODLoRaWAN_SplitReceiver::GetDropped(void)
+{
+    return dropped;
+}
+
+//------------------------------------------------------------------------------
+// EOF
+//------------------------------------------------------------------------------
@@ -0,0 +1,156 @@
+//------------------------------------------------------------------------------
+//! @file WiMODLoRaWAN_SplitSend.h
+//! @ingroup WiMODLoRaWAN
+//! <!------------------------------------------------------------------------->
+//! @brief Declarations for a max. payload aware U-Data send path
+//! @version 0.1
+//! <!------------------------------------------------------------------------->
+//!
+//! The usable payload of an uplink depends on the current data rate (and on
+//! pending MAC commands). The sender caches the MaxPayloadSize reported by
+//! the network status and refreshes it whenever a TX indication reports a
+//! data rate change or the module rejects a frame as too long.
+//!
+//! Messages that fit are sent unchanged on their own port. Larger messages
+//! are split into segments that are sent on the split port:
+//!
+//! Segment:        | app port | message id | index [| 0x80 last] | data ... |
+//!
+//------------------------------------------------------------------------------
+
+
+#ifndef ARDUINO_WIMODLORAWAN_SPLITSEND_H_
+#define ARDUINO_WIMODLORAWAN_SPLITSEND_H_
+
+//------------------------------------------------------------------------------
+//
+// Section Includes Files
+//
+//------------------------------------------------------------------------------
+
+#include "../WiMODLoRaWAN.h"
+
+//------------------------------------------------------------------------------
+//
+// Section defines
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+#define WIMOD_SPLIT_DEFAULT_PORT                    203
+#define WIMOD_SPLIT_HEADER_SIZE                     3
+#define WIMOD_SPLIT_FLAG_LAST                       0x80
+#define WIMOD_SPLIT_INDEX_MASK                      0x7F
+
+#ifndef WIMOD_SPLIT_TX_BUFFER_SIZE
+#define WIMOD_SPLIT_TX_BUFFER_SIZE                  512                         // max. size of a split message
+#endif
+
+#ifndef WIMOD_SPLIT_RX_BUFFER_SIZE
+#define WIMOD_SPLIT_RX_BUFFER_SIZE                  512
+#endif
+//! @endcond
+
+
+// C++11 check
+#ifdef WIMOD_USE_CPP11
+    /** Type definition for a 'message reassembled' callback */
+    typedef std::function<void (UINT8 port, const UINT8* data, UINT16 length)> TSplitMessageCallback;
+#else
+    /** Type definition for a 'message reassembled' callback function */
+    typedef void (*TSplitMessageCallback)(UINT8 port, const UINT8* data, UINT16 length);
+#endif
+
+
+//------------------------------------------------------------------------------
+//
+// Section class
+//
+//------------------------------------------------------------------------------
+
+/**
+ * @brief U-Data sender that never exceeds the current max. payload size
+ *
+ * Send() transmits a message or its first segment; the remaining segments
+ * are sent by SendNext(), which is meant to be called from the main loop
+ * whenever the application is allowed to send (e.g. after the TX U-Data
+ * indication). The TX indications have to be fed into ProcessTxIndication().
+ */
+class WiMODLoRaWAN_SplitSender {
+public:
+    WiMODLoRaWAN_SplitSender(WiMODLoRaWAN& wimod);
+    ~WiMODLoRaWAN_SplitSender(void);
+
+    void        SetSplitPort(UINT8 port);
+
+    bool        RefreshMaxPayload(TWiMODLRResultCodes* hciResult = NULL, UINT8* rspStatus = NULL);
+    void        ProcessTxIndication(const TWiMODLORAWAN_TxIndData& txInd);
+    UINT8       GetMaxPayload(void);
+    bool        IsMaxPayloadValid(void);
+
+    bool        Send(UINT8 port, const UINT8* data, UINT16 length,
+                     TWiMODLRResultCodes* hciResult = NULL, UINT8* rspStatus = NULL);
+    bool        SendNext(TWiMODLRResultCodes* hciResult = NULL, UINT8* rspStatus = NULL);
+    bool        HasPendingData(void);
+    void        Abort(void);
+
+protected:
+    //! @cond Doxygen_Suppress
+    bool        sendFrame(TWiMODLRResultCodes* hciResult, UINT8* rspStatus);
+    //! @endcond
+private:
+    //! @cond Doxygen_Suppress
+    WiMODLoRaWAN&           wimod;
+    TWiMODLORAWAN_TX_Data   txData;
+    UINT8                   buffer[WIMOD_SPLIT_TX_BUFFER_SIZE];
+
+    UINT8                   splitPort;
+    UINT8                   maxPayload;
+    UINT8                   dataRate;
+    bool                    maxPayloadValid;                                    // false: re-read before next uplink
+
+    UINT8                   appPort;
+    UINT8                   messageId;
+    UINT8                   nextIndex;
+    UINT16                  length;
+    UINT16                  offset;                                             // first byte not sent yet
+    //! @endcond
+};
+
+
+/**
+ * @brief Receiving side of the split send path
+ *
+ * Used by the peer that consumes the uplinks (e.g. a gateway side host or a
+ * test harness). Segments must arrive in order; a message with a missing
+ * segment is dropped.
+ */
+class WiMODLoRaWAN_SplitReceiver {
+public:
+    WiMODLoRaWAN_SplitReceiver(void);
+    ~WiMODLoRaWAN_SplitReceiver(void);
+
+    void        SetSplitPort(UINT8 port);
+    void        RegisterMessageClient(TSplitMessageCallback cb);
+
+    bool        ProcessFrame(UINT8 port, const UINT8* frame, UINT8 length);
+    UINT16      GetDropped(void);
+
+private:
+    //! @cond Doxygen_Suppress
+    UINT8                   buffer[WIMOD_SPLIT_RX_BUFFER_SIZE];
+
+    UINT8                   splitPort;
+    UINT8                   appPort;
+    UINT8                   messageId;
+    UINT8                   nextIndex;
+    UINT16                  length;
+    UINT16                  dropped;
+    bool                    active;
+
+    TSplitMessageCallback   messageCallback;
+    //! @endcond
+};
+
+
+#endif /* ARDUINO_WIMODLORAWAN_SPLITSEND_H_ */
@@ -0,0 +1,274 @@
+//------------------------------------------------------------------------------
+//! @file WiMODLoRaWAN_WarmBoot.cpp
+//! @ingroup WiMODLoRaWAN
+//! <!------------------------------------------------------------------------->
+//! @brief Warm boot helper for the LoRaWAN firmware
+//! @version 0.1
+//! <!------------------------------------------------------------------------->
+//!
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+//
+// Section Includes Files
+//
+//------------------------------------------------------------------------------
+
+#include "WiMODLoRaWAN_WarmBoot.h"
+
+#include <string.h>
+#include "../utils/CRC16.h"
+
+//------------------------------------------------------------------------------
+//
+// Section public functions
+//
+//------------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Constructor
+ *
+ * @param wimod     reference to the LoRaWAN interface
+ */
+WiMODLoRaWAN_WarmBoot::WiMODLoRaWAN_WarmBoot(WiMODLoRaWAN& wimod) :
+    wimod(wimod)
+{
+    configHash      = WIMOD_WARMBOOT_NO_HASH;
+    deviceAddress   = 0;
+    bootDuration    = 0;
+    compareDataRate = true;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Destructor
+ */
+WiMODLoRaWAN_WarmBoot::~WiMODLoRaWAN_WarmBoot(void)
+{
+
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Calculates the hash of a desired configuration
+ *
+ * Only the fields that are transferred by SetRadioStackConfig are taken
+ * into account. The lower 16 bit cover the radio stack config, the upper
+ * 16 bit the OTAA join parameters.
+ *
+ * @param radioCfg   desired radio stack config
+ *
+ * @param joinParams OTAA parameters
+ *
+ * @retval the 32 bit hash value
+ */
+UINT32 WiMODLoRaWAN_WarmBoot::CalcConfigHash(const TWiMODLORAWAN_RadioStackConfig& radioCfg,
+                                             const TWiMODLORAWAN_JoinParams& joinParams)
+{
+    UINT8  buffer[WiMODLORAWAN_APP_EUI_LEN + WiMODLORAWAN_APP_KEY_LEN];
+    UINT8  offset = 0;
+    UINT16 cfgCrc;
+    UINT16 joinCrc;
+
+    buffer[offset++] = radioCfg.DataRateIndex;
+    buffer[offset++] = radioCfg.TXPowerLevel;
+    buffer[offset++] = radioCfg.Options;
+    buffer[offset++] = radioCfg.PowerSavingMode;
+    buffer[offset++] = radioCfg.Retransmissions;
+    buffer[offset++] = radioCfg.BandIndex;
+    buffer[offset++] = radioCfg.SubBandMask1;
+    buffer[offset++] = radioCfg.SubBandMask2;
+    cfgCrc = ~CRC16_Calc(buffer, offset, CRC16_INIT_VALUE);
+
+    memcpy(buffer, joinParams.AppEUI, WiMODLORAWAN_APP_EUI_LEN);
+    memcpy(&buffer[WiMODLORAWAN_APP_EUI_LEN], joinParams.AppKey, WiMODLORAWAN_APP_KEY_LEN);
+    joinCrc = ~CRC16_Calc(buffer, sizeof(buffer), CRC16_INIT_VALUE);
+
+    return MAKELONG(cfgCrc, joinCrc);
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Selects whether data rate and tx power must match on a warm boot
+ *
+ * Disable this if ADR or a host side planner changes the data rate at
+ * runtime; otherwise every boot would end up in the cold path.
+ */
+void WiMODLoRaWAN_WarmBoot::SetCompareDataRate(bool flag)
+{
+    compareDataRate = flag;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Brings the module into a usable state with as few commands as possible
+ *
+ * If the stored hash matches the desired configuration, the module is asked
+ * for its network status and its radio stack config (two HCI commands).
+ * An active session is used as is; an inactive one is restored via
+ * ReactivateDevice. In all other cases the full cold start sequence is run.
+ *
+ * @param radioCfg   desired radio stack config
+ *
+ * @param joinParams OTAA parameters
+ *
+ * @param storedHash hash stored during the last successful boot
+ *                   (WIMOD_WARMBOOT_NO_HASH if nothing is stored)
+ *
+ * @retval boot mode that has been executed
+ *
+ * @code
+ * #include <Preferences.h>
+ * #include <LoRaWAN/WiMODLoRaWAN_WarmBoot.h>
+ *
+ * WiMODLoRaWAN_WarmBoot warmBoot(wimod);
+ * Preferences           prefs;
+ *
+ * void onJoinedNwk(TWiMODLR_HCIMessage& rxMsg) {
+ *  ...
+ *  // remember config for the next boot
+ *  prefs.putULong("cfghash", warmBoot.GetConfigHash());
+ * }
+ *
+ * void setup() {
+ *  ...
+ *  mode = warmBoot.Start(radioCfg, joinParams, prefs.getULong("cfghash", 0));
+ *  if (mode == LoRaWAN_Boot_Cold_Joining) {
+ *      // wait for joined nwk indication
+ *  }
+ * }
+ * @endcode
+ */
+TWiMODLORAWAN_BootMode WiMODLoRaWAN_WarmBoot::Start(TWiMODLORAWAN_RadioStackConfig& radioCfg,
+                                                    TWiMODLORAWAN_JoinParams& joinParams,
+                                                    UINT32 storedHash)
+{
+    TWiMODLORAWAN_NwkStatus_Data   nwkStatus;
+    TWiMODLORAWAN_RadioStackConfig currentCfg;
+    UINT32                         startTime = millis();
+
+    configHash = CalcConfigHash(radioCfg, joinParams);
+
+    if ((storedHash != WIMOD_WARMBOOT_NO_HASH) && (storedHash == configHash)) {
+        // the nwk status request doubles as ping
+        if (wimod.GetNwkStatus(&nwkStatus)
+                && wimod.GetRadioStackConfig(&currentCfg)
+                && configMatches(currentCfg, radioCfg)) {
+
+            switch (nwkStatus.NetworkStatus)
+            {
+                case LoRaWAN_NwkStatus_Active_ABP:
+                case LoRaWAN_NwkStatus_Active_OTAA:
+                    deviceAddress = nwkStatus.DeviceAddress;
+                    bootDuration  = millis() - startTime;
+                    return LoRaWAN_Boot_Warm_Active;
+
+                case LoRaWAN_NwkStatus_Inactive:
+                    if (wimod.ReactivateDevice(&deviceAddress)) {
+                        bootDuration = millis() - startTime;
+                        return LoRaWAN_Boot_Warm_Reactivated;
+                    }
+                    break;
+
+                default:
+                    break;
+            }
+        }
+    }
+
+    return ColdStart(radioCfg, joinParams);
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Runs the full initialisation sequence and starts an OTAA join
+ *
+ * Reset, DeactivateDevice, Ping, SetRadioStackConfig, SetJoinParameter and
+ * JoinNetwork. The (new) config hash is available via GetConfigHash()
+ * and should be stored once the join has succeeded.
+ *
+ * @param radioCfg   desired radio stack config
+ *
+ * @param joinParams OTAA parameters
+ *
+ * @retval LoRaWAN_Boot_Cold_Joining  if the join request has been sent
+ * @retval LoRaWAN_Boot_Failed        if the module did not accept a command
+ */
+TWiMODLORAWAN_BootMode WiMODLoRaWAN_WarmBoot::ColdStart(TWiMODLORAWAN_RadioStackConfig& radioCfg,
+                                                        TWiMODLORAWAN_JoinParams& joinParams)
+{
+    TWiMODLORAWAN_BootMode mode      = LoRaWAN_Boot_Failed;
+    UINT32                 startTime = millis();
+
+    configHash    = CalcConfigHash(radioCfg, joinParams);
+    deviceAddress = 0;
+
+    wimod.Reset();
+    delay(WIMOD_WARMBOOT_RESET_DELAY_MS);
+    wimod.DeactivateDevice();
+
+    if (wimod.Ping()
+            && wimod.SetRadioStackConfig(&radioCfg)
+            && wimod.SetJoinParameter(joinParams)
+            && wimod.JoinNetwork()) {
+        mode = LoRaWAN_Boot_Cold_Joining;
+    }
+
+    bootDuration = millis() - startTime;
+    return mode;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the hash of the configuration used by the last Start() call
+ */
+UINT32 WiMODLoRaWAN_WarmBoot::GetConfigHash(void)
+{
+    return configHash;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the device address reported during a warm boot
+ */
+UINT32 WiMODLoRaWAN_WarmBoot::GetDeviceAddress(void)
+{
+    return deviceAddress;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the duration of the last boot procedure in ms
+ */
+UINT32 WiMODLoRaWAN_WarmBoot::GetBootDuration(void)
+{
+    return bootDuration;
+}
+
+//------------------------------------------------------------------------------
+//
+// Section protected functions
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+bool WiMODLoRaWAN_WarmBoot::configMatches(const TWiMODLORAWAN_RadioStackConfig& current,
+                                          const TWiMODLORAWAN_RadioStackConfig& desired)
+{
+    if (compareDataRate) {
+        if ((current.DataRateIndex != desired.DataRateIndex)
+                || (current.TXPowerLevel != desired.TXPowerLevel)) {
+            return false;
+        }
+    }
+    return (current.Options         == desired.Options)
+        && (current.PowerSavingMode == desired.PowerSavingMode)
+        && (current.Retransmissions == desired.Retransmissions)
+        && (current.BandIndex       == desired.BandIndex);
+}
+//! @endcond
+
+//------------------------------------------------------------------------------
+// EOF
+//------------------------------------------------------------------------------
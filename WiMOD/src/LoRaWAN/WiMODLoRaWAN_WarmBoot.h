@@ -0,0 +1,98 @@
+//------------------------------------------------------------------------------
+//! @file WiMODLoRaWAN_WarmBoot.h
+//! @ingroup WiMODLoRaWAN
+//! <!------------------------------------------------------------------------->
+//! @brief Declarations for a warm boot helper of the LoRaWAN firmware
+//! @version 0.1
+//! <!------------------------------------------------------------------------->
+//!
+//! The module keeps its radio stack config and LoRaWAN session over a reboot
+//! of the host. This helper checks the module state against a hash of the
+//! desired configuration (kept in non-volatile memory of the host) and only
+//! runs the full reset / config / join sequence if something changed.
+//!
+//------------------------------------------------------------------------------
+
+
+#ifndef ARDUINO_WIMODLORAWAN_WARMBOOT_H_
+#define ARDUINO_WIMODLORAWAN_WARMBOOT_H_
+
+//------------------------------------------------------------------------------
+//
+// Section Includes Files
+//
+//------------------------------------------------------------------------------
+
+#include "../WiMODLoRaWAN.h"
+
+//------------------------------------------------------------------------------
+//
+// Section defines
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+#define WIMOD_WARMBOOT_NO_HASH                      0x00000000                  // no hash stored (yet)
+#define WIMOD_WARMBOOT_RESET_DELAY_MS               100                         // time for the module to restart
+//! @endcond
+
+/**
+ * @brief Result of the boot procedure
+ */
+typedef enum TWiMODLORAWAN_BootMode
+{
+    LoRaWAN_Boot_Warm_Active = 0,                                               /*!< session still active in module; no reset, no join */
+    LoRaWAN_Boot_Warm_Reactivated,                                              /*!< stored session has been reactivated; no join */
+    LoRaWAN_Boot_Cold_Joining,                                                  /*!< module has been re-initialised; OTAA join started */
+    LoRaWAN_Boot_Failed,                                                        /*!< module did not respond / join could not be started */
+} TWiMODLORAWAN_BootMode;
+
+
+//------------------------------------------------------------------------------
+//
+// Section class
+//
+//------------------------------------------------------------------------------
+
+/**
+ * @brief Warm boot helper that skips redundant module re-initialisation
+ *
+ * The hash has to be stored by the user (e.g. ESP32 Preferences / EEPROM)
+ * after the JoinedNwk indication signalled a successful join, and has to be
+ * passed to Start() on the next boot.
+ */
+class WiMODLoRaWAN_WarmBoot {
+public:
+    WiMODLoRaWAN_WarmBoot(WiMODLoRaWAN& wimod);
+    ~WiMODLoRaWAN_WarmBoot(void);
+
+    UINT32                  CalcConfigHash(const TWiMODLORAWAN_RadioStackConfig& radioCfg,
+                                           const TWiMODLORAWAN_JoinParams& joinParams);
+    void                    SetCompareDataRate(bool flag);
+
+    TWiMODLORAWAN_BootMode  Start(TWiMODLORAWAN_RadioStackConfig& radioCfg,
+                                  TWiMODLORAWAN_JoinParams& joinParams, UINT32 storedHash);
+    TWiMODLORAWAN_BootMode  ColdStart(TWiMODLORAWAN_RadioStackConfig& radioCfg,
+                                      TWiMODLORAWAN_JoinParams& joinParams);
+
+    UINT32                  GetConfigHash(void);
+    UINT32                  GetDeviceAddress(void);
+    UINT32                  GetBootDuration(void);
+
+protected:
+    //! @cond Doxygen_Suppress
+    bool                    configMatches(const TWiMODLORAWAN_RadioStackConfig& current,
+                                          const TWiMODLORAWAN_RadioStackConfig& desired);
+    //! @endcond
+private:
+    //! @cond Doxygen_Suppress
+    WiMODLoRaWAN&           wimod;
+    UINT32                  configHash;
+    UINT32                  deviceAddress;
+    UINT32                  bootDuration;
+    bool                    compareDataRate;
+    //! @endcond
+};
+
+
+#endif /* ARDUINO_WIMODLORAWAN_WARMBOOT_H_ */
@@ -523,6 +523,16 @@ typedef struct TWiMODLR_DevMgmt_HciConfig
 } TWiMODLR_DevMgmt_HciConfig;
 
 
+/**
+ * @brief Target memory for config write operations that support a StoreNwmFlag
+ */
+typedef enum TWiMODLR_DevMgmt_ConfigStore
+{
+    DevMgmt_ConfigStore_RAM = 0,                                                /*!< config is lost after reset; no NVM write */
+    DevMgmt_ConfigStore_NVM = 1,                                                /*!< config is written to NVM */
+} TWiMODLR_DevMgmt_ConfigStore;
+
+
 //------------------------------------------------------------------------------
 //
 // Section Macros
@@ -274,16 +274,14 @@ TWiMODLRResultCodes WiMOD_SAP_LoRaWAN::SendUData(const TWiMODLORAWAN_TX_Data* da
 {
     TWiMODLRResultCodes result = WiMODLR_RESULT_TRANMIT_ERROR;
     UINT8              offset = 0;
-    UINT8              tmpSize;
 
     if ( data && (data->Length > 0) && statusRsp) {
 
-        tmpSize = MIN((WiMOD_LORAWAN_TX_PAYLOAD_SIZE-1), data->Length);
-
-        if (txPayloadSize >= tmpSize) {
+        // reject oversized payloads instead of sending a truncated frame
+        if ((data->Length <= WiMODLORAWAN_APP_PAYLOAD_LEN) && (txPayloadSize > data->Length)) {
             txPayload[offset++] = data->Port;
-            memcpy(&txPayload[offset], data->Payload, MIN((WiMOD_LORAWAN_TX_PAYLOAD_SIZE-1), tmpSize));
-            offset += tmpSize;
+            memcpy(&txPayload[offset], data->Payload, data->Length);
+            offset += data->Length;
 
             result = HciParser->SendHCIMessage(LORAWAN_SAP_ID,
                                                LORAWAN_MSG_SEND_UDATA_REQ,
@@ -324,17 +322,22 @@ TWiMODLRResultCodes WiMOD_SAP_LoRaWAN::SendCData(const TWiMODLORAWAN_TX_Data* da
 
     if ( data && (data->Length > 0) && statusRsp) {
 
-        txPayload[offset++] = data->Port;
-        memcpy(&txPayload[offset], data->Payload, MIN((WiMOD_LORAWAN_TX_PAYLOAD_SIZE-1), data->Length));
-        offset += MIN((WiMOD_LORAWAN_TX_PAYLOAD_SIZE-1), data->Length);
+        // reject oversized payloads instead of sending a truncated frame
+        if ((data->Length <= WiMODLORAWAN_APP_PAYLOAD_LEN) && (txPayloadSize > data->Length)) {
+            txPayload[offset++] = data->Port;
+            memcpy(&txPayload[offset], data->Payload, data->Length);
+            offset += data->Length;
 
-        result = HciParser->SendHCIMessage(LORAWAN_SAP_ID,
-                                           LORAWAN_MSG_SEND_CDATA_REQ,
-                                           LORAWAN_MSG_SEND_CDATA_RSP,
-                                           txPayload, offset);
-        // copy response status
-        if (result == WiMODLR_RESULT_OK) {
-            *statusRsp = HciParser->GetRxMessage().Payload[WiMODLR_HCI_RSP_STATUS_POS];
+            result = HciParser->SendHCIMessage(LORAWAN_SAP_ID,
+                                               LORAWAN_MSG_SEND_CDATA_REQ,
+                                               LORAWAN_MSG_SEND_CDATA_RSP,
+                                               txPayload, offset);
+            // copy response status
+            if (result == WiMODLR_RESULT_OK) {
+                *statusRsp = HciParser->GetRxMessage().Payload[WiMODLR_HCI_RSP_STATUS_POS];
+            }
+        } else {
+            result = WiMODLR_RESULT_PAYLOAD_LENGTH_ERROR;
         }
     } else {
         result = WiMODLR_RESULT_PAYLOAD_PTR_ERROR;
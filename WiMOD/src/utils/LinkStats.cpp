@@ -0,0 +1,482 @@
+//------------------------------------------------------------------------------
+//! @file LinkStats.cpp
+//! @ingroup Utils
+//! <!------------------------------------------------------------------------->
+//! @brief Fixed memory link quality statistics store
+//! @version 0.1
+//! <!------------------------------------------------------------------------->
+//!
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+//
+// Section Includes Files
+//
+//------------------------------------------------------------------------------
+
+#include "LinkStats.h"
+
+#include "Arduino.h"
+#include <string.h>
+
+//------------------------------------------------------------------------------
+//
+// Section local functions
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+static UINT8 linkStatsBin(INT16 value, INT16 min, INT16 width)
+{
+    INT16 bin = (value - min) / width;
+
+    if (value < min) {
+        return 0;
+    }
+    if (bin >= WIMOD_LINKSTATS_HIST_BINS) {
+        return WIMOD_LINKSTATS_HIST_BINS - 1;
+    }
+    return (UINT8) bin;
+}
+
+static void linkStatsHistAdd(UINT8* hist, UINT8 bin)
+{
+    UINT8 i;
+
+    // keep the shape, forget the past
+    if (hist[bin] == 0xFF) {
+        for (i = 0; i < WIMOD_LINKSTATS_HIST_BINS; i++) {
+            hist[i] >>= 1;
+        }
+    }
+    hist[bin]++;
+}
+
+static INT16 linkStatsEwma(INT16 ewma, INT16 sample, bool first)
+{
+    INT16 value = sample * 16;
+
+    if (first) {
+        return value;
+    }
+    return ewma + ((value - ewma) >> WIMOD_LINKSTATS_EWMA_SHIFT);
+}
+//! @endcond
+
+//------------------------------------------------------------------------------
+//
+// Section public functions
+//
+//------------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Constructor
+ */
+WiMODLinkStats::WiMODLinkStats(void)
+{
+    Reset();
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Destructor
+ */
+WiMODLinkStats::~WiMODLinkStats(void)
+{
+
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Clears all statistics
+ */
+void WiMODLinkStats::Reset(void)
+{
+    memset(channels, 0x00, sizeof(channels));
+    memset(dataRates, 0x00, sizeof(dataRates));
+    memset(sources, 0x00, sizeof(sources));
+    memset(peers, 0x00, sizeof(peers));
+    memset(&lastRlt, 0x00, sizeof(lastRlt));
+    rltValid  = false;
+    totalGaps = 0;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Adds a LoRaWAN RX U-Data / C-Data indication
+ *
+ * Only indications with optional rx infos are taken into account.
+ */
+void WiMODLinkStats::ProcessLoRaWanRx(const TWiMODLORAWAN_RX_Data& rxData)
+{
+    if (!rxData.OptionalInfoAvaiable) {
+        return;
+    }
+    if (rxData.ChannelIndex < WIMOD_LINKSTATS_NUM_CHANNELS) {
+        addRx(&channels[rxData.ChannelIndex], rxData.RSSI, rxData.SNR);
+    }
+    if (rxData.DataRateIndex < WIMOD_LINKSTATS_NUM_DATARATES) {
+        addRx(&dataRates[rxData.DataRateIndex], rxData.RSSI, rxData.SNR);
+    }
+    addRx(&sources[LinkStats_Source_LoRaWAN], rxData.RSSI, rxData.SNR);
+    addPeerRx(WIMOD_LINKSTATS_NWK_PEER, millis());
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Adds a LoRaWAN RX ACK indication
+ */
+void WiMODLinkStats::ProcessLoRaWanAck(const TWiMODLORAWAN_RX_ACK_Data& ackData)
+{
+    if (!ackData.OptionalInfoAvaiable) {
+        return;
+    }
+    if (ackData.ChannelIndex < WIMOD_LINKSTATS_NUM_CHANNELS) {
+        addRx(&channels[ackData.ChannelIndex], ackData.RSSI, ackData.SNR);
+    }
+    if (ackData.DataRateIndex < WIMOD_LINKSTATS_NUM_DATARATES) {
+        addRx(&dataRates[ackData.DataRateIndex], ackData.RSSI, ackData.SNR);
+    }
+    addRx(&sources[LinkStats_Source_LoRaWAN], ackData.RSSI, ackData.SNR);
+    addPeerRx(WIMOD_LINKSTATS_NWK_PEER, millis());
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Adds a LoRaWAN TX U-Data / C-Data indication
+ *
+ * The packet counter tells how often the frame has been sent. For C-Data
+ * all but the last transmission are counted as lost (each one went
+ * unacknowledged); if the max. number of retransmissions has been reached,
+ * all transmissions are counted as lost. U-Data repetitions (NbTrans) are
+ * sent without waiting for an ack and only count as attempts.
+ *
+ * @param txInd     converted tx indication
+ *
+ * @param confirmed true if the indication belongs to a C-Data transmission
+ */
+void WiMODLinkStats::ProcessLoRaWanTxInd(const TWiMODLORAWAN_TxIndData& txInd, bool confirmed)
+{
+    UINT16 attempts;
+    UINT16 failed;
+
+    if (txInd.FieldAvailability != LORAWAN_OPT_TX_IND_INFOS_INCL_PKT_CNT) {
+        return;
+    }
+
+    attempts = MAX(txInd.NumTxPackets, (UINT8) 1);
+    failed   = 0;
+    if (confirmed) {
+        failed = attempts - 1;
+        if (txInd.StatusFormat & LORAWAN_DATA_TX_IND_FORMAT_STATUS_ERR_MAX_RETRANS) {
+            failed = attempts;
+        }
+    }
+
+    if (txInd.ChannelIndex < WIMOD_LINKSTATS_NUM_CHANNELS) {
+        addTx(&channels[txInd.ChannelIndex], attempts, failed);
+    }
+    if (txInd.DataRateIndex < WIMOD_LINKSTATS_NUM_DATARATES) {
+        addTx(&dataRates[txInd.DataRateIndex], attempts, failed);
+    }
+    addTx(&sources[LinkStats_Source_LoRaWAN], attempts, failed);
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Adds a RadioLink RX U-Data / C-Data message
+ */
+void WiMODLinkStats::ProcessRadioLinkRx(const TWiMODLR_RadioLink_Msg& rxMsg)
+{
+    if (rxMsg.OptionalInfoAvaiable) {
+        addRx(&sources[LinkStats_Source_RadioLink], rxMsg.RSSI, rxMsg.SNR);
+    }
+    addPeerRx(((UINT32) rxMsg.SourceGroupAddress << 16) | rxMsg.SourceDeviceAddress, millis());
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Adds a SensorApp data indication
+ */
+void WiMODLinkStats::ProcessSensorData(const TWiMODLR_SensorApp_SensorData& sensorData)
+{
+    addRx(&sources[LinkStats_Source_SensorApp], sensorData.RSSI, sensorData.SNR);
+    addPeerRx(((UINT32) sensorData.SourceGroupAddress << 16) | sensorData.SourceDevAddress, millis());
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Adds a radio link test status indication
+ *
+ * The loss is derived from the counter deltas against the previous status
+ * (local tx vs. peer rx and peer tx vs. local rx).
+ */
+void WiMODLinkStats::ProcessRltStatus(const TWiMODLR_RLT_Status& rltStatus)
+{
+    UINT16 sent;
+    UINT16 received;
+
+    addRx(&sources[LinkStats_Source_RLT], (INT16) rltStatus.LocalRSSI, (INT8) rltStatus.LocalSNR);
+
+    // a new test run restarts all counters
+    if (rltValid && (rltStatus.TestStatus == 0)) {
+        sent     = rltStatus.LocalTxCounter - lastRlt.LocalTxCounter;
+        received = rltStatus.PeerRxCounter - lastRlt.PeerRxCounter;
+        addTx(&sources[LinkStats_Source_RLT], sent, (sent > received) ? (sent - received) : 0);
+
+        sent     = rltStatus.PeerTxCounter - lastRlt.PeerTxCounter;
+        received = rltStatus.LocalRxCounter - lastRlt.LocalRxCounter;
+        addTx(&sources[LinkStats_Source_RLT], sent, (sent > received) ? (sent - received) : 0);
+    }
+
+    lastRlt  = rltStatus;
+    rltValid = true;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the summary of a (LoRaWAN) channel
+ *
+ * @retval false    if the channel index is out of range
+ */
+bool WiMODLinkStats::GetChannelSummary(UINT8 channel, TWiMODLinkStats_Summary* summary)
+{
+    if ((channel >= WIMOD_LINKSTATS_NUM_CHANNELS) || (summary == NULL)) {
+        return false;
+    }
+    summarize(channels[channel], summary);
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the summary of a (LoRaWAN) data rate
+ *
+ * @retval false    if the data rate index is out of range
+ */
+bool WiMODLinkStats::GetDataRateSummary(UINT8 dataRate, TWiMODLinkStats_Summary* summary)
+{
+    if ((dataRate >= WIMOD_LINKSTATS_NUM_DATARATES) || (summary == NULL)) {
+        return false;
+    }
+    summarize(dataRates[dataRate], summary);
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the summary of all samples of a source
+ */
+bool WiMODLinkStats::GetSourceSummary(TWiMODLinkStats_Source source, TWiMODLinkStats_Summary* summary)
+{
+    if ((source >= LinkStats_Source_Count) || (summary == NULL)) {
+        return false;
+    }
+    summarize(sources[source], summary);
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the timing infos of a peer
+ *
+ * @param peerId    (group address << 16) | device address or WIMOD_LINKSTATS_NWK_PEER
+ *
+ * @retval NULL if the peer is unknown
+ */
+const TWiMODLinkStats_Peer* WiMODLinkStats::GetPeer(UINT32 peerId)
+{
+    UINT8 i;
+
+    for (i = 0; i < WIMOD_LINKSTATS_NUM_PEERS; i++) {
+        if ((peers[i].RxCount > 0) && (peers[i].Id == peerId)) {
+            return &peers[i];
+        }
+    }
+    return NULL;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the channel with the best average SNR
+ *
+ * @param minSamples    min. number of rx samples a channel needs
+ *
+ * @retval channel index or -1 if no channel has enough samples
+ */
+INT16 WiMODLinkStats::GetBestChannel(UINT16 minSamples)
+{
+    INT16 best = -1;
+    UINT8 i;
+
+    for (i = 0; i < WIMOD_LINKSTATS_NUM_CHANNELS; i++) {
+        if (channels[i].RxCount < minSamples) {
+            continue;
+        }
+        if ((best < 0) || (channels[i].SnrEwma > channels[best].SnrEwma)) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Checks whether a peer is silent for longer than expected
+ *
+ * @param peerId    see GetPeer()
+ *
+ * @param now       current millis()
+ *
+ * @retval true if no rx for more than WIMOD_LINKSTATS_GAP_FACTOR average intervals
+ */
+bool WiMODLinkStats::IsPeerOverdue(UINT32 peerId, UINT32 now)
+{
+    const TWiMODLinkStats_Peer* peer = GetPeer(peerId);
+
+    if ((peer == NULL) || (peer->RxCount < 2)) {
+        return false;
+    }
+    return (now - peer->LastRxTime) > (WIMOD_LINKSTATS_GAP_FACTOR * peer->IntervalEwma);
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the number of detected rx gaps (all peers)
+ */
+UINT16 WiMODLinkStats::GetTotalGaps(void)
+{
+    return totalGaps;
+}
+
+//------------------------------------------------------------------------------
+//
+// Section protected functions
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+void WiMODLinkStats::addRx(TWiMODLinkStats_Bucket* bucket, INT16 rssi, INT8 snr)
+{
+    bool first = (bucket->RxCount == 0);
+
+    bucket->RssiEwma = linkStatsEwma(bucket->RssiEwma, rssi, first);
+    bucket->SnrEwma  = linkStatsEwma(bucket->SnrEwma, snr, first);
+
+    linkStatsHistAdd(bucket->RssiHist,
+                     linkStatsBin(rssi, WIMOD_LINKSTATS_RSSI_BIN_MIN, WIMOD_LINKSTATS_RSSI_BIN_WIDTH));
+    linkStatsHistAdd(bucket->SnrHist,
+                     linkStatsBin(snr, WIMOD_LINKSTATS_SNR_BIN_MIN, WIMOD_LINKSTATS_SNR_BIN_WIDTH));
+
+    if (bucket->RxCount < 0xFFFF) {
+        bucket->RxCount++;
+    }
+}
+
+void WiMODLinkStats::addTx(TWiMODLinkStats_Bucket* bucket, UINT16 attempts, UINT16 failed)
+{
+    if (attempts == 0) {
+        return;
+    }
+    if ((UINT32) bucket->TxAttempts + attempts >= WIMOD_LINKSTATS_TX_WINDOW) {
+        bucket->TxAttempts >>= 1;
+        bucket->TxFailed   >>= 1;
+    }
+    bucket->TxAttempts += MIN(attempts, (UINT16) (WIMOD_LINKSTATS_TX_WINDOW / 2));
+    bucket->TxFailed   += MIN(failed, (UINT16) (WIMOD_LINKSTATS_TX_WINDOW / 2));
+}
+
+void WiMODLinkStats::addPeerRx(UINT32 peerId, UINT32 now)
+{
+    TWiMODLinkStats_Peer* peer   = NULL;
+    TWiMODLinkStats_Peer* oldest = &peers[0];
+    UINT32                interval;
+    UINT8                 i;
+
+    for (i = 0; i < WIMOD_LINKSTATS_NUM_PEERS; i++) {
+        if ((peers[i].RxCount > 0) && (peers[i].Id == peerId)) {
+            peer = &peers[i];
+            break;
+        }
+        if ((peers[i].RxCount == 0)
+                || ((oldest->RxCount > 0) && ((now - peers[i].LastRxTime) > (now - oldest->LastRxTime)))) {
+            oldest = &peers[i];
+        }
+    }
+
+    // unknown peer replaces the least recently heard one
+    if (peer == NULL) {
+        peer = oldest;
+        memset(peer, 0x00, sizeof(TWiMODLinkStats_Peer));
+        peer->Id = peerId;
+    }
+
+    if (peer->RxCount > 0) {
+        // back to back frames (bursts, retransmissions) must not make every
+        // regular interval look like a gap
+        interval = MAX(now - peer->LastRxTime, (UINT32) WIMOD_LINKSTATS_MIN_INTERVAL);
+        if (peer->RxCount == 1) {
+            peer->IntervalEwma = interval;
+        } else if (interval > WIMOD_LINKSTATS_GAP_FACTOR * peer->IntervalEwma) {
+            if (peer->GapsInRow >= WIMOD_LINKSTATS_GAP_RESYNC) {
+                // only gaps in a row: the peer sends at a lower rate now
+                peer->IntervalEwma = interval;
+                peer->GapsInRow    = 0;
+            } else {
+                // a gap must not inflate the expected interval
+                peer->GapsInRow++;
+                if (peer->Gaps < 0xFFFF) {
+                    peer->Gaps++;
+                }
+                if (totalGaps < 0xFFFF) {
+                    totalGaps++;
+                }
+            }
+        } else {
+            peer->GapsInRow     = 0;
+            peer->IntervalEwma += ((INT32) (interval - peer->IntervalEwma)) >> WIMOD_LINKSTATS_EWMA_SHIFT;
+        }
+    }
+
+    peer->LastRxTime = now;
+    if (peer->RxCount < 0xFFFF) {
+        peer->RxCount++;
+    }
+}
+
+void WiMODLinkStats::summarize(const TWiMODLinkStats_Bucket& bucket, TWiMODLinkStats_Summary* summary)
+{
+    UINT16 total = 0;
+    UINT16 sum   = 0;
+    UINT8  i;
+
+    memset(summary, 0x00, sizeof(TWiMODLinkStats_Summary));
+    summary->RxCount = bucket.RxCount;
+
+    if (bucket.TxAttempts > 0) {
+        summary->LossPercent = (UINT8) (((UINT32) bucket.TxFailed * 100) / bucket.TxAttempts);
+    }
+    if (bucket.RxCount == 0) {
+        return;
+    }
+
+    summary->Rssi = bucket.RssiEwma / 16;
+    summary->Snr  = (INT8) (bucket.SnrEwma / 16);
+
+    for (i = 0; i < WIMOD_LINKSTATS_HIST_BINS; i++) {
+        total += bucket.SnrHist[i];
+    }
+    for (i = 0; i < WIMOD_LINKSTATS_HIST_BINS; i++) {
+        sum += bucket.SnrHist[i];
+        if (sum * 10 >= total) {
+            break;
+        }
+    }
+    summary->SnrLow = (INT8) (WIMOD_LINKSTATS_SNR_BIN_MIN + i * WIMOD_LINKSTATS_SNR_BIN_WIDTH);
+}
+//! @endcond
+
+//------------------------------------------------------------------------------
+// EOF
+//------------------------------------------------------------------------------
@@ -0,0 +1,172 @@
+//------------------------------------------------------------------------------
+//! @file LinkStats.h
+//! @ingroup Utils
+//! <!------------------------------------------------------------------------->
+//! @brief Declarations for a fixed memory link quality statistics store
+//! @version 0.1
+//! <!------------------------------------------------------------------------->
+//!
+//! Collects the receiver infos (RSSI, SNR, channel, data rate) and the TX
+//! infos (retransmission counter) of the LoRaWAN, RadioLink, SensorApp and
+//! RLT indications. All values are kept in fixed size tables:
+//!
+//! - per channel / per data rate / per source: small RSSI and SNR histograms,
+//!   EWMA values and a (decaying) tx attempt / failure counter
+//! - per peer: rx interval EWMA and a gap counter
+//!
+//! Every update is O(1); nothing is allocated.
+//!
+//------------------------------------------------------------------------------
+
+
+#ifndef ARDUINO_WIMOD_LINKSTATS_H_
+#define ARDUINO_WIMOD_LINKSTATS_H_
+
+//------------------------------------------------------------------------------
+//
+// Section Includes Files
+//
+//------------------------------------------------------------------------------
+
+#include "utils/WMDefs.h"
+#include "SAP/WiMOD_SAP_LORAWAN_IDs.h"
+#include "SAP/WiMOD_SAP_RadioLink_IDs.h"
+#include "SAP/WiMOD_SAP_SensorApp_IDs.h"
+#include "SAP/WiMOD_SAP_RLT_IDs.h"
+
+//------------------------------------------------------------------------------
+//
+// Section defines
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+#define WIMOD_LINKSTATS_NUM_CHANNELS                16
+#define WIMOD_LINKSTATS_NUM_DATARATES               8
+#define WIMOD_LINKSTATS_NUM_PEERS                   8
+
+#define WIMOD_LINKSTATS_HIST_BINS                   8
+#define WIMOD_LINKSTATS_SNR_BIN_MIN                 (-20)                       // dB; lower edge of bin 0
+#define WIMOD_LINKSTATS_SNR_BIN_WIDTH               4                           // dB
+#define WIMOD_LINKSTATS_RSSI_BIN_MIN                (-136)                      // dBm; lower edge of bin 0
+#define WIMOD_LINKSTATS_RSSI_BIN_WIDTH              10                          // dBm
+
+#define WIMOD_LINKSTATS_EWMA_SHIFT                  3                           // alpha = 1/8
+#define WIMOD_LINKSTATS_TX_WINDOW                   1024                        // tx counters are halved when reached
+#define WIMOD_LINKSTATS_GAP_FACTOR                  3                           // gap if no rx for 3 x avg. interval
+#define WIMOD_LINKSTATS_MIN_INTERVAL                100                         // ms; floor of the avg. interval (bursts)
+#define WIMOD_LINKSTATS_GAP_RESYNC                  3                           // gaps in a row after which the avg. interval is re-seeded
+
+#define WIMOD_LINKSTATS_NWK_PEER                    0xFFFFFFFF                  // peer id used for LoRaWAN downlinks
+//! @endcond
+
+/**
+ * @brief Source of a statistic sample
+ */
+typedef enum TWiMODLinkStats_Source
+{
+    LinkStats_Source_LoRaWAN = 0,                                               /*!< LoRaWAN RX / ACK / TX indications */
+    LinkStats_Source_RadioLink,                                                 /*!< RadioLink RX U-Data / C-Data */
+    LinkStats_Source_SensorApp,                                                 /*!< SensorApp data indications       */
+    LinkStats_Source_RLT,                                                       /*!< radio link test status */
+    LinkStats_Source_Count,
+} TWiMODLinkStats_Source;
+
+/**
+ * @brief Statistic bucket (one per channel, data rate and source)
+ */
+typedef struct TWiMODLinkStats_Bucket
+{
+    UINT16      RxCount;                                                        /*!< number of rx samples (saturating) */
+    INT16       RssiEwma;                                                       /*!< RSSI EWMA in 1/16 dBm */
+    INT16       SnrEwma;                                                        /*!< SNR EWMA in 1/16 dB */
+    UINT8       RssiHist[WIMOD_LINKSTATS_HIST_BINS];                            /*!< RSSI histogram */
+    UINT8       SnrHist[WIMOD_LINKSTATS_HIST_BINS];                             /*!< SNR histogram */
+    UINT16      TxAttempts;                                                     /*!< (decayed) number of rf transmissions */
+    UINT16      TxFailed;                                                       /*!< (decayed) number of lost transmissions */
+} TWiMODLinkStats_Bucket;
+
+/**
+ * @brief Per peer rx timing
+ */
+typedef struct TWiMODLinkStats_Peer
+{
+    UINT32      Id;                                                             /*!< group << 16 | device address (or WIMOD_LINKSTATS_NWK_PEER) */
+    UINT32      LastRxTime;                                                     /*!< millis() of the last rx */
+    UINT32      IntervalEwma;                                                   /*!< avg. rx interval in ms */
+    UINT16      RxCount;                                                        /*!< number of rx samples (saturating) */
+    UINT16      Gaps;                                                           /*!< detected gaps (saturating) */
+    UINT8       GapsInRow;                                                      /*!< gaps since the last regular interval */
+} TWiMODLinkStats_Peer;
+
+/**
+ * @brief Condensed view of a bucket
+ */
+typedef struct TWiMODLinkStats_Summary
+{
+    UINT16      RxCount;                                                        /*!< number of rx samples */
+    INT16       Rssi;                                                           /*!< RSSI EWMA in dBm */
+    INT8        Snr;                                                            /*!< SNR EWMA in dB */
+    INT8        SnrLow;                                                         /*!< lower edge of the 10% SNR percentile bin in dB */
+    UINT8       LossPercent;                                                    /*!< lost transmissions in percent */
+} TWiMODLinkStats_Summary;
+
+
+//------------------------------------------------------------------------------
+//
+// Section class
+//
+//------------------------------------------------------------------------------
+
+/**
+ * @brief Fixed memory link quality statistics store
+ *
+ * The Process* functions expect the converted indication structures and are
+ * meant to be called from the registered callbacks; the Get* functions can
+ * be used by the application scheduler at any time.
+ */
+class WiMODLinkStats {
+public:
+    WiMODLinkStats(void);
+    ~WiMODLinkStats(void);
+
+    void        Reset(void);
+
+    void        ProcessLoRaWanRx(const TWiMODLORAWAN_RX_Data& rxData);
+    void        ProcessLoRaWanAck(const TWiMODLORAWAN_RX_ACK_Data& ackData);
+    void        ProcessLoRaWanTxInd(const TWiMODLORAWAN_TxIndData& txInd, bool confirmed);
+    void        ProcessRadioLinkRx(const TWiMODLR_RadioLink_Msg& rxMsg);
+    void        ProcessSensorData(const TWiMODLR_SensorApp_SensorData& sensorData);
+    void        ProcessRltStatus(const TWiMODLR_RLT_Status& rltStatus);
+
+    bool        GetChannelSummary(UINT8 channel, TWiMODLinkStats_Summary* summary);
+    bool        GetDataRateSummary(UINT8 dataRate, TWiMODLinkStats_Summary* summary);
+    bool        GetSourceSummary(TWiMODLinkStats_Source source, TWiMODLinkStats_Summary* summary);
+    const TWiMODLinkStats_Peer* GetPeer(UINT32 peerId);
+
+    INT16       GetBestChannel(UINT16 minSamples = 4);
+    bool        IsPeerOverdue(UINT32 peerId, UINT32 now);
+    UINT16      GetTotalGaps(void);
+
+protected:
+    //! @cond Doxygen_Suppress
+    void        addRx(TWiMODLinkStats_Bucket* bucket, INT16 rssi, INT8 snr);
+    void        addTx(TWiMODLinkStats_Bucket* bucket, UINT16 attempts, UINT16 failed);
+    void        addPeerRx(UINT32 peerId, UINT32 now);
+    void        summarize(const TWiMODLinkStats_Bucket& bucket, TWiMODLinkStats_Summary* summary);
+    //! @endcond
+private:
+    //! @cond Doxygen_Suppress
+    TWiMODLinkStats_Bucket  channels[WIMOD_LINKSTATS_NUM_CHANNELS];
+    TWiMODLinkStats_Bucket  dataRates[WIMOD_LINKSTATS_NUM_DATARATES];
+    TWiMODLinkStats_Bucket  sources[LinkStats_Source_Count];
+    TWiMODLinkStats_Peer    peers[WIMOD_LINKSTATS_NUM_PEERS];
+
+    TWiMODLR_RLT_Status     lastRlt;
+    bool                    rltValid;
+    UINT16                  totalGaps;
+    //! @endcond
+};
+
+
+#endif /* ARDUINO_WIMOD_LINKSTATS_H_ */
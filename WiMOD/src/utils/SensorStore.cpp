@@ -0,0 +1,386 @@
+//------------------------------------------------------------------------------
+//! @file SensorStore.cpp
+//! @ingroup Utils
+//! <!------------------------------------------------------------------------->
+//! @brief Multi node SensorApp time series store
+//! @version 0.1
+//! <!------------------------------------------------------------------------->
+//!
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+//
+// Section Includes Files
+//
+//------------------------------------------------------------------------------
+
+#include "SensorStore.h"
+
+#include "Arduino.h"
+#include <string.h>
+
+//------------------------------------------------------------------------------
+//
+// Section local functions
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+#define SENSORSTORE_DEPTH_MASK      (WIMOD_SENSORSTORE_DEPTH - 1)
+
+#if (WIMOD_SENSORSTORE_DEPTH & SENSORSTORE_DEPTH_MASK) || (WIMOD_SENSORSTORE_DEPTH > 128)
+#error "WIMOD_SENSORSTORE_DEPTH must be a power of 2 <= 128"
+#endif
+
+#if (WIMOD_SENSORSTORE_MAX_NODES * 2 > WIMOD_SENSORSTORE_TABLE_SIZE)
+#error "WIMOD_SENSORSTORE_MAX_NODES too large for the hash table"
+#endif
+
+// min / max / sum over one contiguous segment; no branches but min / max
+// so the loop can be vectorized
+template <typename T>
+static void sensorStoreScan(const T* values, UINT8 n, INT32* min, INT32* max, INT32* sum)
+{
+    INT32 lo  = *min;
+    INT32 hi  = *max;
+    INT32 acc = 0;
+    UINT8 i;
+
+    for (i = 0; i < n; i++) {
+        INT32 v = values[i];
+        lo   = (v < lo) ? v : lo;
+        hi   = (v > hi) ? v : hi;
+        acc += v;
+    }
+    *min  = lo;
+    *max  = hi;
+    *sum += acc;
+}
+
+template <typename T>
+static void sensorStoreRing(const T* ring, UINT8 head, UINT8 n, INT32* min, INT32* max, INT32* sum)
+{
+    UINT8 start = (head - n) & SENSORSTORE_DEPTH_MASK;
+
+    // newest n samples: one segment, or two if they wrap around
+    if ((UINT16) start + n <= WIMOD_SENSORSTORE_DEPTH) {
+        sensorStoreScan(ring + start, n, min, max, sum);
+    } else {
+        sensorStoreScan(ring + start, WIMOD_SENSORSTORE_DEPTH - start, min, max, sum);
+        sensorStoreScan(ring, start + n - WIMOD_SENSORSTORE_DEPTH, min, max, sum);
+    }
+}
+
+static UINT32 sensorStoreKey(UINT8 group, UINT16 device)
+{
+    return ((UINT32) group << 16) | device;
+}
+//! @endcond
+
+//------------------------------------------------------------------------------
+//
+// Section public functions
+//
+//------------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Constructor
+ */
+WiMODSensorStore::WiMODSensorStore(void)
+{
+    linkTimeout  = 0;
+    linkCallback = NULL;
+    Reset();
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Destructor
+ */
+WiMODSensorStore::~WiMODSensorStore(void)
+{
+
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Forgets all nodes and samples
+ */
+void WiMODSensorStore::Reset(void)
+{
+    memset(table, WIMOD_SENSORSTORE_NO_NODE, sizeof(table));
+    memset(keys, 0x00, sizeof(keys));
+    memset(lastRx, 0x00, sizeof(lastRx));
+    memset(rxTotal, 0x00, sizeof(rxTotal));
+    memset(head, 0x00, sizeof(head));
+    memset(count, 0x00, sizeof(count));
+    memset(inputs, 0x00, sizeof(inputs));
+    memset(online, 0x00, sizeof(online));
+    numNodes = 0;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Sets the link timeout
+ *
+ * Use the LinkTimeout of the SensorApp config (GetSensorAppConfig()) to
+ * follow the setting of the receiver.
+ *
+ * @param   timeoutMs   time without data until a node is lost [ms]; 0 = off
+ */
+void WiMODSensorStore::SetLinkTimeout(UINT32 timeoutMs)
+{
+    linkTimeout = timeoutMs;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Registers a callback for 'link lost / back' events
+ *
+ * @param   cb          called with online = false when a node exceeds the link
+ *                      timeout and with online = true on its next sample (and
+ *                      on the first sample of a new node)
+ */
+void WiMODSensorStore::RegisterLinkClient(TSensorStoreLinkCallback cb)
+{
+    linkCallback = cb;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Adds a SensorApp data indication
+ *
+ * @param   sensorData  converted sensor data indication
+ *
+ * @retval true     if the sample has been stored
+ * @retval false    if the node is new and the store is full
+ */
+bool WiMODSensorStore::ProcessSensorData(const TWiMODLR_SensorApp_SensorData& sensorData)
+{
+    UINT32 key  = sensorStoreKey(sensorData.SourceGroupAddress, sensorData.SourceDevAddress);
+    UINT8  slot = slotOf(key);
+    UINT8  node = table[slot];
+    UINT8  pos;
+
+    if (node == WIMOD_SENSORSTORE_NO_NODE) {
+        if (numNodes >= WIMOD_SENSORSTORE_MAX_NODES) {
+            return false;
+        }
+        node        = numNodes++;
+        table[slot] = node;
+        keys[node]  = key;
+    }
+
+    pos = head[node];
+    voltage[node][pos]     = sensorData.Voltage;
+    adcValue[node][pos]    = sensorData.AdcValue;
+    temperature[node][pos] = (INT8) sensorData.Temperature;
+    rssi[node][pos]        = sensorData.OptionalInfoAvaiable ? sensorData.RSSI : 0;
+    snr[node][pos]         = sensorData.OptionalInfoAvaiable ? sensorData.SNR : 0;
+
+    head[node] = (pos + 1) & SENSORSTORE_DEPTH_MASK;
+    if (count[node] < WIMOD_SENSORSTORE_DEPTH) {
+        count[node]++;
+    }
+    inputs[node] = sensorData.DigitalInputs;
+    lastRx[node] = millis();
+    rxTotal[node]++;
+
+    if (!online[node]) {
+        online[node] = true;
+        if (linkCallback) {
+            linkCallback(sensorData.SourceGroupAddress, sensorData.SourceDevAddress, true);
+        }
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Checks the link timeout of all nodes
+ *
+ * Call this from the main loop.
+ */
+void WiMODSensorStore::Process(void)
+{
+    UINT32 now = millis();
+    UINT8  i;
+
+    if (linkTimeout == 0) {
+        return;
+    }
+    for (i = 0; i < numNodes; i++) {
+        if (online[i] && (now - lastRx[i] > linkTimeout)) {
+            online[i] = false;
+            if (linkCallback) {
+                linkCallback((UINT8) (keys[i] >> 16), (UINT16) keys[i], false);
+            }
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the number of known nodes
+ *
+ * Nodes are numbered 0 .. GetNumNodes() - 1 in the order of their first sample.
+ */
+UINT8 WiMODSensorStore::GetNumNodes(void)
+{
+    return numNodes;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Looks up a node
+ *
+ * @param   group       source group address
+ * @param   device      source device address
+ *
+ * @retval  node index, or -1 if unknown
+ */
+INT16 WiMODSensorStore::FindNode(UINT8 group, UINT16 device)
+{
+    UINT8 node = table[slotOf(sensorStoreKey(group, device))];
+
+    if (node == WIMOD_SENSORSTORE_NO_NODE) {
+        return -1;
+    }
+    return node;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the state of a node
+ *
+ * @param   node        node index
+ * @param   info        pointer for the result
+ *
+ * @retval true     if the node exists
+ */
+bool WiMODSensorStore::GetNodeInfo(UINT8 node, TWiMODSensorStore_NodeInfo* info)
+{
+    if (node >= numNodes || !info) {
+        return false;
+    }
+    info->GroupAddress  = (UINT8) (keys[node] >> 16);
+    info->DeviceAddress = (UINT16) keys[node];
+    info->Count         = count[node];
+    info->RxTotal       = rxTotal[node];
+    info->LastRxTime    = lastRx[node];
+    info->DigitalInputs = inputs[node];
+    info->Online        = online[node];
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Min / max / average of the newest samples of a node
+ *
+ * @param   node        node index
+ * @param   field       value to evaluate
+ * @param   lastN       number of newest samples; 0 = all stored samples
+ * @param   summary     pointer for the result
+ *
+ * @retval true     if the node has at least one sample
+ */
+bool WiMODSensorStore::GetSummary(UINT8 node, TWiMODSensorStore_Field field, UINT8 lastN,
+                                  TWiMODSensorStore_Summary* summary)
+{
+    INT32 min = 0x7FFFFFFF;
+    INT32 max = -0x7FFFFFFF - 1;
+    INT32 sum = 0;
+    UINT8 n;
+
+    if (node >= numNodes || !summary || count[node] == 0) {
+        return false;
+    }
+
+    n = count[node];
+    if (lastN && lastN < n) {
+        n = lastN;
+    }
+
+    switch (field) {
+        case SensorStore_Voltage:
+            sensorStoreRing(voltage[node], head[node], n, &min, &max, &sum);
+            break;
+        case SensorStore_AdcValue:
+            sensorStoreRing(adcValue[node], head[node], n, &min, &max, &sum);
+            break;
+        case SensorStore_Temperature:
+            sensorStoreRing(temperature[node], head[node], n, &min, &max, &sum);
+            break;
+        case SensorStore_Rssi:
+            sensorStoreRing(rssi[node], head[node], n, &min, &max, &sum);
+            break;
+        case SensorStore_Snr:
+            sensorStoreRing(snr[node], head[node], n, &min, &max, &sum);
+            break;
+        default:
+            return false;
+    }
+
+    summary->Count = n;
+    summary->Min   = min;
+    summary->Max   = max;
+    summary->Avg   = sum / n;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns a single sample of a node
+ *
+ * @param   node        node index
+ * @param   field       value to return
+ * @param   age         0 = newest sample, 1 = the one before, ...
+ * @param   value       pointer for the result
+ *
+ * @retval true     if the sample exists
+ */
+bool WiMODSensorStore::GetValue(UINT8 node, TWiMODSensorStore_Field field, UINT8 age, INT32* value)
+{
+    UINT8 pos;
+
+    if (node >= numNodes || !value || age >= count[node]) {
+        return false;
+    }
+
+    pos = (head[node] - 1 - age) & SENSORSTORE_DEPTH_MASK;
+    switch (field) {
+        case SensorStore_Voltage:       *value = voltage[node][pos];        break;
+        case SensorStore_AdcValue:      *value = adcValue[node][pos];       break;
+        case SensorStore_Temperature:   *value = temperature[node][pos];    break;
+        case SensorStore_Rssi:          *value = rssi[node][pos];           break;
+        case SensorStore_Snr:           *value = snr[node][pos];            break;
+        default:
+            return false;
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+//
+// Section protected functions
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+// slot of the key, or the free slot where it belongs (linear probing; the
+// table is at most half full and nodes are never removed one by one)
+UINT8 WiMODSensorStore::slotOf(UINT32 key)
+{
+    UINT8 slot = (UINT8) ((UINT32) (key * 2654435761UL) >> (32 - WIMOD_SENSORSTORE_TABLE_BITS));
+
+    while (table[slot] != WIMOD_SENSORSTORE_NO_NODE && keys[table[slot]] != key) {
+        slot = (slot + 1) & (WIMOD_SENSORSTORE_TABLE_SIZE - 1);
+    }
+    return slot;
+}
+//! @endcond
+
+//------------------------------------------------------------------------------
+// EOF
+//------------------------------------------------------------------------------
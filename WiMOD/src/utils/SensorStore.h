@@ -0,0 +1,171 @@
+//------------------------------------------------------------------------------
+//! @file SensorStore.h
+//! @ingroup Utils
+//! <!------------------------------------------------------------------------->
+//! @brief Declarations for a multi node SensorApp time series store
+//! @version 0.1
+//! <!------------------------------------------------------------------------->
+//!
+//! Keeps the recent history of many SensorApp transmitters. Nodes are found
+//! by (SourceGroupAddress, SourceDevAddress) through an open addressing
+//! hash table (linear probing). Every node owns a fixed size ring of
+//! samples, stored as one array per value (structure of arrays), so a
+//! min / max / avg query is a plain loop over a contiguous array that the
+//! compiler can vectorize.
+//!
+//! - ingest: hash lookup + one store per value, O(1)
+//! - query:  O(samples) over the selected value only
+//!
+//! A node that sends nothing for the link timeout (the LinkTimeout of the
+//! SensorApp config) is reported as lost, and as back on its next sample.
+//!
+//------------------------------------------------------------------------------
+
+
+#ifndef ARDUINO_WIMOD_SENSORSTORE_H_
+#define ARDUINO_WIMOD_SENSORSTORE_H_
+
+//------------------------------------------------------------------------------
+//
+// Section Includes Files
+//
+//------------------------------------------------------------------------------
+
+#include "utils/WMDefs.h"
+#include "SAP/WiMOD_SAP_SensorApp_IDs.h"
+
+#ifdef WIMOD_USE_CPP11
+#include <functional>
+#endif
+
+//------------------------------------------------------------------------------
+//
+// Section defines
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+#ifndef WIMOD_SENSORSTORE_MAX_NODES
+#define WIMOD_SENSORSTORE_MAX_NODES                 32
+#endif
+
+#ifndef WIMOD_SENSORSTORE_DEPTH
+#define WIMOD_SENSORSTORE_DEPTH                     32                          // samples per node; power of 2
+#endif
+
+#define WIMOD_SENSORSTORE_TABLE_BITS                6                           // 64 slots, load <= 0.5
+#define WIMOD_SENSORSTORE_TABLE_SIZE                (1 << WIMOD_SENSORSTORE_TABLE_BITS)
+#define WIMOD_SENSORSTORE_NO_NODE                   0xFF
+//! @endcond
+
+/**
+ * @brief Value of a sample
+ */
+typedef enum TWiMODSensorStore_Field
+{
+    SensorStore_Voltage = 0,                                                    /*!< supply voltage [mV] */
+    SensorStore_AdcValue,                                                       /*!< ADC value */
+    SensorStore_Temperature,                                                    /*!< temperature [degC] */
+    SensorStore_Rssi,                                                           /*!< RSSI [dBm] */
+    SensorStore_Snr,                                                            /*!< SNR [dB] */
+} TWiMODSensorStore_Field;
+
+/**
+ * @brief Result of a query
+ */
+typedef struct TWiMODSensorStore_Summary
+{
+    UINT8       Count;                                                          /*!< samples used */
+    INT32       Min;                                                            /*!< smallest value */
+    INT32       Max;                                                            /*!< largest value */
+    INT32       Avg;                                                            /*!< mean (rounded toward 0) */
+} TWiMODSensorStore_Summary;
+
+/**
+ * @brief State of a node
+ */
+typedef struct TWiMODSensorStore_NodeInfo
+{
+    UINT8       GroupAddress;                                                   /*!< source group address */
+    UINT16      DeviceAddress;                                                  /*!< source device address */
+    UINT8       Count;                                                          /*!< samples in the ring */
+    UINT32      RxTotal;                                                        /*!< samples received */
+    UINT32      LastRxTime;                                                     /*!< millis() of the last sample */
+    UINT8       DigitalInputs;                                                  /*!< last digital inputs */
+    bool        Online;                                                         /*!< within the link timeout */
+} TWiMODSensorStore_NodeInfo;
+
+
+// C++11 check
+#ifdef WIMOD_USE_CPP11
+    /** Type definition for a 'link lost / back' callback */
+    typedef std::function<void (UINT8 group, UINT16 device, bool online)> TSensorStoreLinkCallback;
+#else
+    /** Type definition for a 'link lost / back' callback function */
+    typedef void (*TSensorStoreLinkCallback)(UINT8 group, UINT16 device, bool online);
+#endif
+
+
+//------------------------------------------------------------------------------
+//
+// Section class
+//
+//------------------------------------------------------------------------------
+
+/**
+ * @brief Multi node SensorApp time series store
+ *
+ * Feed the converted SensorApp data indications into ProcessSensorData()
+ * and call Process() from the main loop for the link timeout.
+ */
+class WiMODSensorStore {
+public:
+    WiMODSensorStore(void);
+    ~WiMODSensorStore(void);
+
+    void        Reset(void);
+    void        SetLinkTimeout(UINT32 timeoutMs);
+    void        RegisterLinkClient(TSensorStoreLinkCallback cb);
+
+    bool        ProcessSensorData(const TWiMODLR_SensorApp_SensorData& sensorData);
+    void        Process(void);
+
+    UINT8       GetNumNodes(void);
+    INT16       FindNode(UINT8 group, UINT16 device);
+    bool        GetNodeInfo(UINT8 node, TWiMODSensorStore_NodeInfo* info);
+    bool        GetSummary(UINT8 node, TWiMODSensorStore_Field field, UINT8 lastN,
+                           TWiMODSensorStore_Summary* summary);
+    bool        GetValue(UINT8 node, TWiMODSensorStore_Field field, UINT8 age, INT32* value);
+
+protected:
+    //! @cond Doxygen_Suppress
+    UINT8       slotOf(UINT32 key);
+    //! @endcond
+private:
+    //! @cond Doxygen_Suppress
+    UINT8                   table[WIMOD_SENSORSTORE_TABLE_SIZE];                // node index or NO_NODE
+    UINT8                   numNodes;
+
+    // per node
+    UINT32                  keys[WIMOD_SENSORSTORE_MAX_NODES];                  // group << 16 | device
+    UINT32                  lastRx[WIMOD_SENSORSTORE_MAX_NODES];
+    UINT32                  rxTotal[WIMOD_SENSORSTORE_MAX_NODES];
+    UINT8                   head[WIMOD_SENSORSTORE_MAX_NODES];                  // next write position
+    UINT8                   count[WIMOD_SENSORSTORE_MAX_NODES];
+    UINT8                   inputs[WIMOD_SENSORSTORE_MAX_NODES];
+    bool                    online[WIMOD_SENSORSTORE_MAX_NODES];
+
+    // per node and sample
+    UINT16                  voltage[WIMOD_SENSORSTORE_MAX_NODES][WIMOD_SENSORSTORE_DEPTH];
+    UINT16                  adcValue[WIMOD_SENSORSTORE_MAX_NODES][WIMOD_SENSORSTORE_DEPTH];
+    INT8                    temperature[WIMOD_SENSORSTORE_MAX_NODES][WIMOD_SENSORSTORE_DEPTH];
+    INT16                   rssi[WIMOD_SENSORSTORE_MAX_NODES][WIMOD_SENSORSTORE_DEPTH];
+    INT8                    snr[WIMOD_SENSORSTORE_MAX_NODES][WIMOD_SENSORSTORE_DEPTH];
+
+    UINT32                  linkTimeout;
+    TSensorStoreLinkCallback linkCallback;
+    //! @endcond
+};
+
+
+#endif /* ARDUINO_WIMOD_SENSORSTORE_H_ */
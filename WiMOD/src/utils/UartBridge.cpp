@@ -0,0 +1,209 @@
+//------------------------------------------------------------------------------
+//! @file UartBridge.cpp
+//! @ingroup Utils
+//! <!------------------------------------------------------------------------->
+//! @brief Transparent full duplex UART bridge
+//! @version 0.1
+//! <!------------------------------------------------------------------------->
+//!
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+//
+// Section Includes Files
+//
+//------------------------------------------------------------------------------
+
+#include "UartBridge.h"
+
+#include <string.h>
+
+//------------------------------------------------------------------------------
+//
+// Section local functions
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+#define UARTBRIDGE_MASK             (WIMOD_UARTBRIDGE_BUFFER_SIZE - 1)
+
+#if (WIMOD_UARTBRIDGE_BUFFER_SIZE & UARTBRIDGE_MASK) || (WIMOD_UARTBRIDGE_BUFFER_SIZE > 0x8000)
+#error "WIMOD_UARTBRIDGE_BUFFER_SIZE must be a power of 2 <= 32768"
+#endif
+//! @endcond
+
+//------------------------------------------------------------------------------
+//
+// Section public functions
+//
+//------------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Constructor
+ *
+ * @param   pc          interface to the PC (e.g. SerialUSB)
+ * @param   wimod       interface to the WiMOD module
+ */
+WiMODUartBridge::WiMODUartBridge(Stream& pc, Stream& wimod)
+{
+    src[UartBridge_PcToWiMOD] = &pc;
+    dst[UartBridge_PcToWiMOD] = &wimod;
+    src[UartBridge_WiMODToPc] = &wimod;
+    dst[UartBridge_WiMODToPc] = &pc;
+
+    memset(head, 0x00, sizeof(head));
+    memset(tail, 0x00, sizeof(tail));
+    memset(txKnown, 0x00, sizeof(txKnown));
+    ResetStats();
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Destructor
+ */
+WiMODUartBridge::~WiMODUartBridge(void)
+{
+
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Moves data in both directions
+ *
+ * Call this from loop() as often as possible; it never blocks on a full
+ * TX driver buffer if the core supports availableForWrite().
+ */
+void WiMODUartBridge::Process(void)
+{
+    UINT8 dir;
+
+    // empty the RX drivers first, they are the buffers that overflow
+    for (dir = 0; dir < UartBridge_NumDirs; dir++) {
+        fill(dir);
+    }
+    for (dir = 0; dir < UartBridge_NumDirs; dir++) {
+        drain(dir);
+    }
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the counters of one direction
+ *
+ * @param   dir         direction
+ * @param   stats       pointer for the result
+ */
+void WiMODUartBridge::GetStats(TWiMODUartBridge_Dir dir, TWiMODUartBridge_Stats* stats)
+{
+    if (stats && dir < UartBridge_NumDirs) {
+        *stats      = this->stats[dir];
+        stats->Fill = (UINT16) (head[dir] - tail[dir]);
+    }
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Returns the average throughput of one direction since the last reset
+ *
+ * @param   dir         direction
+ *
+ * @retval  bytes per second
+ */
+UINT32 WiMODUartBridge::GetThroughput(TWiMODUartBridge_Dir dir)
+{
+    UINT32 elapsed = millis() - statsTime;
+
+    if (dir >= UartBridge_NumDirs || elapsed == 0) {
+        return 0;
+    }
+    return (UINT32) ((UINT64) stats[dir].TxBytes * 1000 / elapsed);
+}
+
+//-----------------------------------------------------------------------------
+/**
+ * @brief Clears the counters
+ */
+void WiMODUartBridge::ResetStats(void)
+{
+    memset(stats, 0x00, sizeof(stats));
+    statsTime = millis();
+}
+
+//------------------------------------------------------------------------------
+//
+// Section protected functions
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+// everything the RX driver holds goes into the ring, in contiguous chunks
+void WiMODUartBridge::fill(UINT8 dir)
+{
+    Stream* port  = src[dir];
+    int     avail = port->available();
+
+    while (avail > 0) {
+        UINT32 used  = head[dir] - tail[dir];
+        UINT32 space = WIMOD_UARTBRIDGE_BUFFER_SIZE - used;
+        size_t n;
+
+        if (space == 0) {
+            // the destination is behind: drop, the driver buffer must be emptied anyway
+            UINT8 scratch[WIMOD_UARTBRIDGE_CHUNK];
+
+            n = port->readBytes(scratch, MIN((UINT32) avail, (UINT32) sizeof(scratch)));
+            stats[dir].Overruns += n;
+        } else {
+            UINT32 idx   = head[dir] & UARTBRIDGE_MASK;
+            UINT32 chunk = MIN((UINT32) avail, MIN(space, (UINT32) WIMOD_UARTBRIDGE_BUFFER_SIZE - idx));
+
+            n = port->readBytes(&ring[dir][idx], chunk);
+            head[dir]          += n;
+            stats[dir].RxBytes += n;
+            if (used + n > stats[dir].MaxFill) {
+                stats[dir].MaxFill = (UINT16) (used + n);
+            }
+        }
+        if (n == 0) {
+            break;
+        }
+        avail -= n;
+    }
+}
+
+// write what the TX driver takes without blocking
+void WiMODUartBridge::drain(UINT8 dir)
+{
+    Stream* port = dst[dir];
+
+    while (head[dir] != tail[dir]) {
+        UINT32 idx   = tail[dir] & UARTBRIDGE_MASK;
+        UINT32 chunk = MIN(head[dir] - tail[dir], (UINT32) WIMOD_UARTBRIDGE_BUFFER_SIZE - idx);
+        int    room  = port->availableForWrite();
+        size_t n;
+
+        if (room > 0) {
+            txKnown[dir] = true;
+            chunk = MIN(chunk, (UINT32) room);
+        } else if (txKnown[dir]) {
+            // TX driver full, try again with the next Process()
+            break;
+        } else {
+            // availableForWrite() not implemented: small blocking writes
+            chunk = MIN(chunk, (UINT32) WIMOD_UARTBRIDGE_CHUNK);
+        }
+
+        n = port->write(&ring[dir][idx], chunk);
+        tail[dir]          += n;
+        stats[dir].TxBytes += n;
+        if (n < chunk) {
+            break;
+        }
+    }
+}
+//! @endcond
+
+//------------------------------------------------------------------------------
+// EOF
+//------------------------------------------------------------------------------
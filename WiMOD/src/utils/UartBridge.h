@@ -0,0 +1,122 @@
+//------------------------------------------------------------------------------
+//! @file UartBridge.h
+//! @ingroup Utils
+//! <!------------------------------------------------------------------------->
+//! @brief Declarations for a transparent full duplex UART bridge
+//! @version 0.1
+//! <!------------------------------------------------------------------------->
+//!
+//! Connects the PC interface with the WiMOD interface (PC-Tools). The cores
+//! receive by RX interrupt into small driver buffers (64 .. 128 bytes);
+//! bytes are lost when these are not emptied in time, e.g. during a
+//! delay() or while a blocking write() waits for the other port.
+//!
+//! The bridge therefore:
+//!
+//! - moves everything the drivers have received into one large ring buffer
+//!   per direction, in contiguous chunks (readBytes() into the ring)
+//! - writes only what the TX driver accepts without blocking
+//!   (availableForWrite()), so a slow direction never stalls the other one
+//! - needs Process() to be called in a tight loop (no delay())
+//!
+//! Counters per direction: bytes received / sent, bytes lost because the
+//! ring was full and the peak ring fill level.
+//!
+//------------------------------------------------------------------------------
+
+
+#ifndef ARDUINO_WIMOD_UARTBRIDGE_H_
+#define ARDUINO_WIMOD_UARTBRIDGE_H_
+
+//------------------------------------------------------------------------------
+//
+// Section Includes Files
+//
+//------------------------------------------------------------------------------
+
+#include "utils/WMDefs.h"
+
+#include "Arduino.h"
+
+//------------------------------------------------------------------------------
+//
+// Section defines
+//
+//------------------------------------------------------------------------------
+
+//! @cond Doxygen_Suppress
+#ifndef WIMOD_UARTBRIDGE_BUFFER_SIZE
+#define WIMOD_UARTBRIDGE_BUFFER_SIZE                1024                        // per direction; power of 2
+#endif
+
+#define WIMOD_UARTBRIDGE_CHUNK                      64                          // max. blocking write if availableForWrite() is not supported
+//! @endcond
+
+/**
+ * @brief Direction of the bridge
+ */
+typedef enum TWiMODUartBridge_Dir
+{
+    UartBridge_PcToWiMOD = 0,                                                   /*!< PC interface -> WiMOD interface */
+    UartBridge_WiMODToPc,                                                       /*!< WiMOD interface -> PC interface */
+    UartBridge_NumDirs,                                                         /*!< number of directions */
+} TWiMODUartBridge_Dir;
+
+/**
+ * @brief Counters of one direction
+ */
+typedef struct TWiMODUartBridge_Stats
+{
+    UINT32      RxBytes;                                                        /*!< bytes read from the source port */
+    UINT32      TxBytes;                                                        /*!< bytes written to the destination port */
+    UINT32      Overruns;                                                       /*!< bytes lost, ring buffer full */
+    UINT16      MaxFill;                                                        /*!< peak ring buffer fill level */
+    UINT16      Fill;                                                           /*!< current ring buffer fill level */
+} TWiMODUartBridge_Stats;
+
+
+//------------------------------------------------------------------------------
+//
+// Section class
+//
+//------------------------------------------------------------------------------
+
+/**
+ * @brief Transparent full duplex UART bridge
+ *
+ * Open both ports (begin()) and call Process() from loop() without any
+ * delay().
+ */
+class WiMODUartBridge {
+public:
+    WiMODUartBridge(Stream& pc, Stream& wimod);
+    ~WiMODUartBridge(void);
+
+    void        Process(void);
+
+    void        GetStats(TWiMODUartBridge_Dir dir, TWiMODUartBridge_Stats* stats);
+    UINT32      GetThroughput(TWiMODUartBridge_Dir dir);
+    void        ResetStats(void);
+
+protected:
+    //! @cond Doxygen_Suppress
+    void        fill(UINT8 dir);
+    void        drain(UINT8 dir);
+    //! @endcond
+private:
+    //! @cond Doxygen_Suppress
+    Stream*                 src[UartBridge_NumDirs];
+    Stream*                 dst[UartBridge_NumDirs];
+
+    UINT8                   ring[UartBridge_NumDirs][WIMOD_UARTBRIDGE_BUFFER_SIZE];
+    UINT32                  head[UartBridge_NumDirs];                           // free running write index
+    UINT32                  tail[UartBridge_NumDirs];                           // free running read index
+    bool                    txKnown[UartBridge_NumDirs];                        // dst reported availableForWrite() > 0
+
+    UINT32                  statsTime;                                          // millis() of the stats reset
+    TWiMODUartBridge_Stats  stats[UartBridge_NumDirs];
+    //! @endcond
+};
+
+
+#endif /* ARDUINO_WIMOD_UARTBRIDGE_H_ */
@@ -0,0 +1,242 @@
+#include "FastWiFi.h"
+
+#include <Preferences.h>
+#include <string.h>
+
+FastWiFi* FastWiFi::instance = NULL;
+
+FastWiFi::FastWiFi(const char* ssid, const char* password, const char* hostname)
+  : ssid(ssid), password(password), hostname(hostname), useStatic(true), state(FWIFI_IDLE),
+    cacheValid(false), staticConnects(0), begun(0), phaseStart(0), evAssociated(0), evGotIp(0), evDisconnected(false), evReason(0) {
+  memset(&cache, 0, sizeof(cache));
+  memset(&time, 0, sizeof(time));
+}
+
+void FastWiFi::onEvent(arduino_event_id_t event, arduino_event_info_t info) {
+  FastWiFi* w = instance;
+
+  if (w == NULL) {
+    return;
+  }
+  switch (event) {
+    case ARDUINO_EVENT_WIFI_STA_CONNECTED:
+      w->evAssociated = millis();
+      break;
+    case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+      w->evGotIp = millis();
+      break;
+    case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+      w->evReason       = info.wifi_sta_disconnected.reason;
+      w->evDisconnected = true;
+      break;
+    default:
+      break;
+  }
+}
+
+void FastWiFi::begin() {
+  if (instance == NULL) {
+    WiFi.onEvent(onEvent);
+  }
+  instance = this;
+  memset(&time, 0, sizeof(time));
+  begun = millis();
+  loadCache();
+
+  WiFi.persistent(false);        // the cache is ours, no flash write per connect
+  if (hostname) {
+    WiFi.setHostname(hostname);  // before the STA starts
+  }
+  WiFi.mode(WIFI_STA);
+  WiFi.setAutoReconnect(false);  // would restart the attempt in the middle of a scan
+  time.startMs = millis() - begun;
+
+  if (cacheValid) {
+    state = FWIFI_FAST;
+    join(cache.bssid, cache.channel, useStatic && cache.ip != 0 && staticConnects < FWIFI_DHCP_EVERY);
+  } else {
+    startScan();
+  }
+}
+
+void FastWiFi::join(const uint8_t* bssid, uint8_t channel, bool staticIp) {
+  evAssociated   = 0;
+  evGotIp        = 0;
+  evDisconnected = false;
+  time.staticIp  = staticIp;
+  if (staticIp) {
+    WiFi.config(IPAddress(cache.ip), IPAddress(cache.gateway), IPAddress(cache.mask), IPAddress(cache.dns));
+  } else {
+    WiFi.config(IPAddress(), IPAddress(), IPAddress());   // back to DHCP
+  }
+  phaseStart = millis();
+  WiFi.begin(ssid, password, channel, bssid, true);
+}
+
+void FastWiFi::startScan() {
+  WiFi.disconnect();   // a scan fails while a connect is going on
+  state      = FWIFI_SCAN;
+  phaseStart = millis();
+  time.scans++;
+  WiFi.scanNetworks(true, false, false, FWIFI_SCAN_MS_PER_CH);
+}
+
+// strongest AP with our SSID; none found: scan again
+void FastWiFi::scanDone(int16_t n) {
+  uint8_t bssid[6];
+  uint8_t channel;
+  int16_t best = -1;
+
+  time.scanMs += millis() - phaseStart;
+  for (int16_t i = 0; i < n; i++) {
+    if (WiFi.SSID(i) == ssid && (best < 0 || WiFi.RSSI(i) > WiFi.RSSI(best))) {
+      best = i;
+    }
+  }
+  if (best < 0) {
+    WiFi.scanDelete();
+    startScan();
+    return;
+  }
+  memcpy(bssid, WiFi.BSSID(best), sizeof(bssid));
+  channel = WiFi.channel(best);
+  WiFi.scanDelete();
+
+  state = FWIFI_JOIN;
+  join(bssid, channel, false);
+}
+
+void FastWiFi::process() {
+  uint32_t now = millis();
+
+  switch (state) {
+    case FWIFI_FAST:
+    case FWIFI_JOIN:
+      if (WiFi.status() == WL_CONNECTED) {
+        connectedNow();
+      } else if (state == FWIFI_FAST
+                 && (evDisconnected || now - phaseStart > (time.staticIp ? FWIFI_FAST_TIMEOUT : FWIFI_JOIN_TIMEOUT))) {
+        // AP gone, moved to another channel or no DHCP answer
+        time.fastMs     = now - phaseStart;
+        time.lastReason = evReason;
+        startScan();
+      } else if (state == FWIFI_JOIN && now - phaseStart > FWIFI_JOIN_TIMEOUT) {
+        time.lastReason = evReason;
+        startScan();
+      }
+      break;
+
+    case FWIFI_SCAN: {
+      int16_t n = WiFi.scanComplete();
+
+      if (n == WIFI_SCAN_RUNNING) {
+        break;
+      }
+      if (n < 0) {
+        startScan();
+      } else {
+        scanDone(n);
+      }
+      break;
+    }
+
+    default:
+      break;
+  }
+}
+
+bool FastWiFi::connect(uint32_t timeoutMs) {
+  begin();
+  while (!connected() && (timeoutMs == 0 || millis() - begun < timeoutMs)) {
+    process();
+    delay(5);
+  }
+  return connected();
+}
+
+void FastWiFi::connectedNow() {
+  uint32_t now   = millis();
+  uint32_t assoc = evAssociated ? evAssociated : now;
+  uint32_t gotIp = evGotIp ? evGotIp : now;
+
+  time.fast    = state == FWIFI_FAST;
+  time.authMs  = (int32_t) (assoc - phaseStart) > 0 ? assoc - phaseStart : 0;
+  time.dhcpMs  = time.staticIp || (int32_t) (gotIp - assoc) < 0 ? 0 : gotIp - assoc;
+  time.totalMs = now - begun;
+  state = FWIFI_CONNECTED;
+  WiFi.setAutoReconnect(true);
+
+  saveCache(time.staticIp ? staticConnects + 1 : 0);
+}
+
+void FastWiFi::loadCache() {
+  Preferences prefs;
+
+  cacheValid     = false;
+  staticConnects = 0;
+  if (!prefs.begin("fastwifi", true)) {
+    return;
+  }
+  cacheValid = prefs.getBytes("cache", &cache, sizeof(cache)) == sizeof(cache)
+               && cache.version == FWIFI_CACHE_VERSION && strncmp(cache.ssid, ssid, sizeof(cache.ssid)) == 0
+               && cache.channel != 0;
+  staticConnects = prefs.getUShort("connects", 0);
+  prefs.end();
+}
+
+// the AP / lease only if something changed; the counter is a single small
+// NVS entry, it survives a power cycle unlike RTC memory
+void FastWiFi::saveCache(uint16_t connects) {
+  FastWiFiCache c;
+  Preferences prefs;
+
+  memset(&c, 0, sizeof(c));
+  c.version = FWIFI_CACHE_VERSION;
+  strncpy(c.ssid, ssid, sizeof(c.ssid) - 1);
+  memcpy(c.bssid, WiFi.BSSID(), sizeof(c.bssid));
+  c.channel = WiFi.channel();
+  c.ip      = (uint32_t) WiFi.localIP();
+  c.gateway = (uint32_t) WiFi.gatewayIP();
+  c.mask    = (uint32_t) WiFi.subnetMask();
+  c.dns     = (uint32_t) WiFi.dnsIP(0);
+
+  bool changed = !cacheValid || memcmp(&c, &cache, sizeof(c)) != 0;
+
+  if (!changed && connects == staticConnects) {
+    return;
+  }
+  if (prefs.begin("fastwifi", false)) {
+    if (changed) {
+      prefs.putBytes("cache", &c, sizeof(c));
+    }
+    if (connects != staticConnects) {
+      prefs.putUShort("connects", connects);
+    }
+    prefs.end();
+  }
+  cache          = c;
+  cacheValid     = true;
+  staticConnects = connects;
+}
+
+void FastWiFi::forget() {
+  Preferences prefs;
+
+  if (prefs.begin("fastwifi", false)) {
+    prefs.remove("cache");
+    prefs.remove("connects");
+    prefs.end();
+  }
+  cacheValid = false;
+}
+
+void FastWiFi::printTiming(Stream& out) const {
+  out.printf("wifi: %s in %lu ms (start %lu, fast %lu, scan %lu x%u, auth %lu, dhcp %lu ms)%s",
+             time.fast ? "cached AP" : "scanned AP", (unsigned long) time.totalMs, (unsigned long) time.startMs,
+             (unsigned long) time.fastMs, (unsigned long) time.scanMs, time.scans, (unsigned long) time.authMs,
+             (unsigned long) time.dhcpMs, time.staticIp ? " static IP" : "");
+  if (time.lastReason) {
+    out.printf(", last disconnect reason %u", time.lastReason);
+  }
+  out.printf("\n");
+}
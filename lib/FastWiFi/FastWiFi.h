@@ -0,0 +1,120 @@
+// Fast Wi-Fi (re)connect with a cached AP and IP lease
+//
+// A plain WiFi.begin(ssid, pass) scans all channels and then asks DHCP,
+// 1.5 .. 4 s on every boot. After the first connect the BSSID, channel and
+// lease of the AP are cached in NVS, the next connect goes straight to that
+// AP on its channel with the lease as a static IP (typically 150 .. 400 ms):
+//
+//   begin() -> FAST: cached BSSID / channel, static IP
+//                ok -> CONNECTED (cache unchanged, connect counter written)
+//                timeout / disconnect -> SCAN
+//              SCAN: async scan, strongest AP with the SSID
+//                -> JOIN: that BSSID / channel, DHCP
+//                ok -> CONNECTED (cache written if anything changed)
+//                timeout -> SCAN again
+//
+// - the lease is not renewed while it is used as a static IP; every
+//   FWIFI_DHCP_EVERY fast connects (counted in NVS, so across deep sleep
+//   and power cycles) the fast attempt uses DHCP, with FWIFI_JOIN_TIMEOUT.
+//   Safest is a DHCP reservation for the node
+// - the time of each phase is measured from the Wi-Fi events: start,
+//   failed fast attempt, scan, auth (association + 4-way handshake), DHCP
+// - after CONNECTED a lost connection is left to the Wi-Fi auto reconnect
+//   (same AP and addressing)
+//
+// process() never blocks; connect() is the blocking variant for setup().
+// One instance per sketch (Wi-Fi events are global).
+
+#ifndef FAST_WIFI_H
+#define FAST_WIFI_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+#define FWIFI_FAST_TIMEOUT    1500    // ms, cached AP and lease
+#define FWIFI_JOIN_TIMEOUT    8000    // ms, with DHCP
+#define FWIFI_SCAN_MS_PER_CH  120
+#ifndef FWIFI_DHCP_EVERY
+#define FWIFI_DHCP_EVERY      100     // fast connects between two DHCP leases
+#endif
+#define FWIFI_CACHE_VERSION   1
+
+// cached in NVS (namespace "fastwifi", key "cache"; the counter of fast
+// connects with the lease is a key of its own, "connects")
+typedef struct FastWiFiCache {
+  uint8_t  version;
+  char     ssid[33];
+  uint8_t  bssid[6];
+  uint8_t  channel;
+  uint32_t ip;            // last lease, 0: none
+  uint32_t gateway;
+  uint32_t mask;
+  uint32_t dns;
+} FastWiFiCache;
+
+// last connect, ms
+typedef struct FastWiFiTiming {
+  bool     fast;          // connected on the cached AP
+  bool     staticIp;      // with the cached lease
+  uint8_t  scans;
+  uint8_t  lastReason;    // last disconnect reason (WIFI_REASON_*), 0: none
+  uint32_t startMs;       // WiFi.mode(), radio start
+  uint32_t fastMs;        // failed fast attempt
+  uint32_t scanMs;
+  uint32_t authMs;        // connect to associated
+  uint32_t dhcpMs;        // associated to IP, 0 with a static IP
+  uint32_t totalMs;
+} FastWiFiTiming;
+
+class FastWiFi {
+public:
+  FastWiFi(const char* ssid, const char* password, const char* hostname = NULL);
+
+  // cached lease as static IP on the fast path (default on)
+  void setStaticIp(bool use) { useStatic = use; }
+
+  // starts connecting; process() does the rest
+  void begin();
+  void process();
+  // begin() and process() until connected or timeoutMs (0: no timeout)
+  bool connect(uint32_t timeoutMs = 0);
+
+  bool connected() const { return state == FWIFI_CONNECTED && WiFi.status() == WL_CONNECTED; }
+  const FastWiFiTiming& timing() const { return time; }
+  void printTiming(Stream& out) const;
+  // next connect scans
+  void forget();
+
+private:
+  enum State { FWIFI_IDLE, FWIFI_FAST, FWIFI_SCAN, FWIFI_JOIN, FWIFI_CONNECTED };
+
+  static void onEvent(arduino_event_id_t event, arduino_event_info_t info);
+  void join(const uint8_t* bssid, uint8_t channel, bool staticIp);
+  void startScan();
+  void scanDone(int16_t n);
+  void connectedNow();
+  void loadCache();
+  void saveCache(uint16_t connects);
+
+  static FastWiFi* instance;
+
+  const char*     ssid;
+  const char*     password;
+  const char*     hostname;
+  bool            useStatic;
+  State           state;
+  FastWiFiCache   cache;
+  bool            cacheValid;
+  uint16_t        staticConnects; // fast connects with the lease since the last DHCP
+  FastWiFiTiming  time;
+  uint32_t        begun;          // millis() of begin()
+  uint32_t        phaseStart;
+
+  // set from the Wi-Fi event task
+  volatile uint32_t evAssociated;
+  volatile uint32_t evGotIp;
+  volatile bool     evDisconnected;
+  volatile uint8_t  evReason;
+};
+
+#endif
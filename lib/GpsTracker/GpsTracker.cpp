@@ -0,0 +1,331 @@
+#include "GpsTracker.h"
+
+#include <math.h>
+
+#define CM_PER_1E7_DEG_X10000   11132   // 1e-7 deg latitude = 1.1132 cm
+#define TTN_SCALE               16777215LL
+
+static int32_t rawToFixed(const RawDegrees& raw) {
+  int32_t v = (int32_t) raw.deg * 10000000L + (int32_t) ((raw.billionths + 50) / 100);
+  return raw.negative ? -v : v;
+}
+
+static uint32_t encodeLat(int32_t lat) {
+  return (uint32_t) (((int64_t) lat + 900000000LL) * TTN_SCALE / 1800000000LL);
+}
+
+static uint32_t encodeLon(int32_t lon) {
+  return (uint32_t) (((int64_t) lon + 1800000000LL) * TTN_SCALE / 3600000000LL);
+}
+
+static uint16_t courseDiff(uint16_t a, uint16_t b) {
+  uint16_t d = (a > b) ? a - b : b - a;
+  return (d > 18000) ? 36000 - d : d;
+}
+
+static int64_t sq(int64_t v) {
+  return v * v;
+}
+
+static void put16(uint8_t* p, uint16_t v) {
+  p[0] = v >> 8;
+  p[1] = v & 0xFF;
+}
+
+static void put24(uint8_t* p, uint32_t v) {
+  p[0] = (v >> 16) & 0xFF;
+  p[1] = (v >> 8) & 0xFF;
+  p[2] = v & 0xFF;
+}
+
+//------------------------------------------------------------------------------
+// GpsRingBuffer
+
+GpsRingBuffer::GpsRingBuffer() : head(0), tail(0), lost(0) {
+}
+
+// moves everything the UART driver has buffered into the ring, in as few
+// readBytes() calls as possible; returns the number of bytes stored
+size_t GpsRingBuffer::fill(Stream& serial) {
+  uint8_t scratch[32];
+  size_t  total = 0;
+  int     avail = serial.available();
+
+  while (avail > 0) {
+    uint32_t space = GPS_RING_SIZE - size();
+    size_t   n;
+
+    if (space == 0) {
+      // parser is behind: drop the new bytes, the old ones are closer to a complete sentence
+      n = serial.readBytes(scratch, min(avail, (int) sizeof(scratch)));
+      lost += n;
+    } else {
+      uint32_t idx   = head & (GPS_RING_SIZE - 1);
+      uint32_t chunk = min((uint32_t) avail, min(space, GPS_RING_SIZE - idx));
+      n = serial.readBytes(&buf[idx], chunk);
+      head  += n;
+      total += n;
+    }
+    if (n == 0) {
+      break;
+    }
+    avail -= n;
+  }
+  return total;
+}
+
+bool GpsRingBuffer::pop(uint8_t& c) {
+  if (head == tail) {
+    return false;
+  }
+  c = buf[tail & (GPS_RING_SIZE - 1)];
+  tail++;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// GpsTracker
+
+GpsTracker::GpsTracker(Stream& serial) : serial(serial) {
+  memset(&stat, 0, sizeof(stat));
+  fixValid    = false;
+  moving      = false;
+  queuedValid = false;
+  flush       = false;
+  moveCount   = 0;
+  stillCount  = 0;
+  first       = 0;
+  count       = 0;
+  inBatch     = 0;
+
+  setGating(250, 5);
+  setMotion(25, 200, 15, 50);
+  setSpacing(50, 30, 600000UL);
+  setBatching(51, 120000UL);
+}
+
+void GpsTracker::setGating(uint16_t maxHdop, uint8_t minSats, uint32_t maxAgeMs) {
+  this->maxHdop = maxHdop;
+  this->minSats = minSats;
+  this->maxAge  = maxAgeMs;
+}
+
+void GpsTracker::setMotion(uint16_t moveMeters, uint16_t moveSpeed, uint16_t stillMeters, uint16_t stillSpeed,
+                           uint8_t confirm, uint8_t stillFixes) {
+  this->moveMeters  = moveMeters;
+  this->moveSpeed   = moveSpeed;
+  this->stillMeters = stillMeters;
+  this->stillSpeed  = stillSpeed;
+  this->confirm     = confirm;
+  this->stillFixes  = stillFixes;
+}
+
+void GpsTracker::setSpacing(uint16_t minMeters, uint8_t turnDeg, uint32_t heartbeatMs) {
+  this->minMeters = minMeters;
+  this->turnDeg   = turnDeg;
+  this->heartbeat = heartbeatMs;
+}
+
+void GpsTracker::setBatching(uint8_t maxBytes, uint32_t timeoutMs) {
+  this->maxBytes = maxBytes;
+  this->timeout  = timeoutMs;
+}
+
+// call from loop(); cheap if nothing arrived
+void GpsTracker::process(uint32_t now) {
+  uint8_t c;
+
+  ring.fill(serial);
+  stat.overruns = ring.overruns();
+
+  while (ring.pop(c)) {
+    // GGA carries HDOP + sats: one fix per second even if RMC is enabled too
+    if (gps.encode(c) && gps.location.isUpdated() && gps.hdop.isUpdated()) {
+      handleFix(now);
+    }
+  }
+}
+
+void GpsTracker::handleFix(uint32_t now) {
+  GpsFix f;
+
+  stat.fixes++;
+  f.lat    = rawToFixed(gps.location.rawLat());
+  f.lon    = rawToFixed(gps.location.rawLng());
+  f.hdop   = (uint16_t) min(gps.hdop.value(), (int32_t) 0xFFFF);
+  f.sats   = (uint8_t) min(gps.satellites.value(), (uint32_t) 0xFF);
+  f.alt    = gps.altitude.value();
+  f.speed  = (uint16_t) min((uint32_t) (gps.speed.value() * 5144L / 10000L), (uint32_t) 0xFFFF); // 1/100 kn -> cm/s
+  f.course = (uint16_t) gps.course.value();
+  f.time   = now;
+
+  if (!gps.location.isValid() || (gps.location.age() > maxAge)
+      || (f.hdop > maxHdop) || (f.sats < minSats)) {
+    stat.rejected++;
+    return;
+  }
+
+  fix      = f;
+  fixValid = true;
+  updateMotion(now);
+}
+
+void GpsTracker::updateMotion(uint32_t now) {
+  if (!queuedValid) {
+    // first good fix after boot
+    anchor = fix;
+    queuePoint(fix);
+    return;
+  }
+
+  if (!moving) {
+    bool away = (distanceSq(anchor, fix) > sq((int64_t) moveMeters * 100)) || (fix.speed > moveSpeed);
+
+    moveCount = away ? moveCount + 1 : 0;
+    if (moveCount >= confirm) {
+      moving     = true;
+      stillCount = 0;
+      queuePoint(fix);
+    } else if (now - lastQueued.time >= heartbeat) {
+      queuePoint(fix);
+    }
+    return;
+  }
+
+  if ((fix.speed < stillSpeed)
+      && ((stillCount == 0) || (distanceSq(stillRef, fix) < sq((int64_t) stillMeters * 100)))) {
+    if (stillCount == 0) {
+      stillRef = fix;
+    }
+    stillCount++;
+  } else {
+    stillCount = 0;
+  }
+
+  if (stillCount >= stillFixes) {
+    // stopped: send the end of the track right away
+    moving    = false;
+    moveCount = 0;
+    anchor    = fix;
+    queuePoint(fix);
+    flush     = true;
+    return;
+  }
+
+  int64_t d2   = distanceSq(lastQueued, fix);
+  bool    turn = (fix.speed > stillSpeed)
+                 && (courseDiff(lastQueued.course, fix.course) > (uint16_t) turnDeg * 100)
+                 && (d2 >= sq((int64_t) minMeters * 25));
+
+  if ((d2 >= sq((int64_t) minMeters * 100)) || turn || (now - lastQueued.time >= heartbeat)) {
+    queuePoint(fix);
+  }
+}
+
+void GpsTracker::queuePoint(const GpsFix& p) {
+  if (count == GPS_QUEUE_SIZE) {
+    stat.dropped++;
+    if (inBatch != 0) {
+      // oldest points are part of the batch in flight
+      return;
+    }
+    first = (first + 1) % GPS_QUEUE_SIZE;
+    count--;
+  }
+  queue[(first + count) % GPS_QUEUE_SIZE] = p;
+  count++;
+  lastQueued  = p;
+  queuedValid = true;
+  stat.queued++;
+}
+
+// squared distance in cm^2 (equirectangular, good enough for a few km)
+int64_t GpsTracker::distanceSq(const GpsFix& a, const GpsFix& b) const {
+  float   cosLat = cosf((float) a.lat * (float) (M_PI / 180.0 / 1e7));
+  int64_t dy     = (int64_t) (b.lat - a.lat) * CM_PER_1E7_DEG_X10000 / 10000;
+  int64_t dx     = (int64_t) ((float) ((int64_t) (b.lon - a.lon) * CM_PER_1E7_DEG_X10000 / 10000) * cosLat);
+
+  return dx * dx + dy * dy;
+}
+
+uint8_t GpsTracker::pointsPerBatch() const {
+  if (maxBytes < GPS_BATCH_HEADER + GPS_BATCH_FIRST) {
+    return 1;
+  }
+  return min(1 + (maxBytes - GPS_BATCH_HEADER - GPS_BATCH_FIRST) / GPS_BATCH_DELTA, GPS_QUEUE_SIZE);
+}
+
+// true if a full batch is queued, the node stopped or the oldest point waited too long
+bool GpsTracker::batchReady(uint32_t now) const {
+  if (count == 0) {
+    return false;
+  }
+  return (count >= pointsPerBatch()) || flush || (now - queue[first].time >= timeout);
+}
+
+// packs the oldest queued points; they stay queued until confirmBatch()
+uint8_t GpsTracker::buildBatch(uint8_t* dst, uint8_t maxLen, uint32_t now) {
+  uint8_t  limit = min(maxLen, maxBytes);
+  uint8_t  len;
+  uint8_t  n;
+  uint32_t prevLat, prevLon;
+
+  inBatch = 0;
+  if ((count == 0) || (limit < GPS_BATCH_HEADER + GPS_BATCH_FIRST)) {
+    return 0;
+  }
+
+  const GpsFix* p = &queue[first];
+  prevLat = encodeLat(p->lat);
+  prevLon = encodeLon(p->lon);
+  put24(&dst[2], prevLat);
+  put24(&dst[5], prevLon);
+  put16(&dst[8], (uint16_t) (int16_t) (p->alt / 100));
+  dst[10] = (uint8_t) min(p->hdop / 10, 255);
+  dst[11] = p->sats;
+  len = GPS_BATCH_HEADER + GPS_BATCH_FIRST;
+  n   = 1;
+
+  while ((n < count) && (len + GPS_BATCH_DELTA <= limit)) {
+    const GpsFix* q   = &queue[(first + n) % GPS_QUEUE_SIZE];
+    uint32_t      lat = encodeLat(q->lat);
+    uint32_t      lon = encodeLon(q->lon);
+    int32_t       dLat = (int32_t) (lat - prevLat);
+    int32_t       dLon = (int32_t) (lon - prevLon);
+    uint32_t      dt   = (q->time - p->time + 500) / 1000;
+
+    // doesn't fit a delta: starts the next batch
+    if ((dLat < INT16_MIN) || (dLat > INT16_MAX) || (dLon < INT16_MIN) || (dLon > INT16_MAX) || (dt > 255)) {
+      break;
+    }
+    put16(&dst[len], (uint16_t) (int16_t) dLat);
+    put16(&dst[len + 2], (uint16_t) (int16_t) dLon);
+    dst[len + 4] = (uint8_t) dt;
+    dst[len + 5] = (uint8_t) min(q->hdop / 10, 255);
+    len += GPS_BATCH_DELTA;
+
+    prevLat = lat;
+    prevLon = lon;
+    p = q;
+    n++;
+  }
+
+  dst[0]  = n;
+  dst[1]  = (uint8_t) min((now - p->time) / 1000, (uint32_t) 255);
+  inBatch = n;
+  return len;
+}
+
+// call after the uplink with the last built batch has been accepted
+void GpsTracker::confirmBatch() {
+  if (inBatch == 0) {
+    return;
+  }
+  first    = (first + inBatch) % GPS_QUEUE_SIZE;
+  count   -= inBatch;
+  inBatch  = 0;
+  stat.batches++;
+  if (count == 0) {
+    flush = false;
+  }
+}
@@ -0,0 +1,139 @@
+// GPS ingestion for mobile LoRaWAN nodes (coverage mapping)
+//
+// - NMEA is bulk read from the serial port into a ring buffer and parsed by
+//   TinyGPS++ from there (no per byte Serial.read() loop in the sketch)
+// - fixes are kept in fixed point (1e-7 deg, cm/s, 1/100 HDOP); fixes with
+//   a bad HDOP / too few satellites are dropped
+// - a moving / stationary detector with hysteresis decides which fixes are
+//   worth sending: while moving a point is queued every minSpacing meters or
+//   on a turn, while stationary only a heartbeat point
+// - queued points are packed into one uplink (batch):
+//
+//   | count | age of last point [s] | lat (24 bit) | lon (24 bit) | alt [m] (16 bit) | hdop x10 | sats |
+//   | dlat (16 bit) | dlon (16 bit) | dt [s] | hdop x10 |  ... (count - 1 times)
+//
+//   lat/lon use the TTN Mapper encoding ((lat + 90) / 180 * 0xFFFFFF,
+//   (lon + 180) / 360 * 0xFFFFFF); the deltas are in the same units. All
+//   values big endian.
+
+#ifndef GPS_TRACKER_H
+#define GPS_TRACKER_H
+
+#include <Arduino.h>
+#include <TinyGPS++.h>
+
+#ifndef GPS_RING_SIZE
+#define GPS_RING_SIZE         512   // power of two
+#endif
+#define GPS_QUEUE_SIZE        32    // queued points
+#define GPS_BATCH_HEADER      2
+#define GPS_BATCH_FIRST       10
+#define GPS_BATCH_DELTA       6
+
+// one gated fix
+typedef struct GpsFix {
+  int32_t  lat;       // 1e-7 deg
+  int32_t  lon;       // 1e-7 deg
+  int32_t  alt;       // cm
+  uint16_t hdop;      // 1/100
+  uint8_t  sats;
+  uint16_t speed;     // cm/s
+  uint16_t course;    // 1/100 deg
+  uint32_t time;      // millis()
+} GpsFix;
+
+typedef struct GpsTrackerStats {
+  uint32_t fixes;         // fixes from the receiver
+  uint32_t rejected;      // dropped by HDOP / sats / age gate
+  uint32_t queued;        // points queued for uplink
+  uint32_t dropped;       // points lost because the queue was full
+  uint32_t batches;       // batches confirmed as sent
+  uint32_t overruns;      // bytes lost because the ring buffer was full
+} GpsTrackerStats;
+
+// byte ring buffer filled in chunks from a Stream
+class GpsRingBuffer {
+public:
+  GpsRingBuffer();
+  size_t fill(Stream& serial);
+  bool pop(uint8_t& c);
+  size_t size() const { return head - tail; }
+  uint32_t overruns() const { return lost; }
+
+private:
+  uint8_t  buf[GPS_RING_SIZE];
+  uint32_t head;
+  uint32_t tail;
+  uint32_t lost;
+};
+
+class GpsTracker {
+public:
+  GpsTracker(Stream& serial);
+
+  // gate: max HDOP in 1/100 (e.g. 250 = 2.5), min satellites, max fix age
+  void setGating(uint16_t maxHdop, uint8_t minSats, uint32_t maxAgeMs = 2000);
+  // moving if > moveMeters from the anchor or > moveSpeed cm/s for confirm fixes,
+  // stationary if < stillSpeed cm/s and within stillMeters for stillFixes fixes
+  void setMotion(uint16_t moveMeters, uint16_t moveSpeed, uint16_t stillMeters, uint16_t stillSpeed,
+                 uint8_t confirm = 2, uint8_t stillFixes = 10);
+  // queue a point every minMeters, on turns > turnDeg (after minMeters / 4),
+  // and at least every heartbeatMs
+  void setSpacing(uint16_t minMeters, uint8_t turnDeg, uint32_t heartbeatMs);
+  // max. uplink size and max. time a point may wait for its batch
+  void setBatching(uint8_t maxBytes, uint32_t timeoutMs);
+
+  void process(uint32_t now);
+
+  bool hasFix() const { return fixValid; }
+  const GpsFix& lastFix() const { return fix; }
+  bool isMoving() const { return moving; }
+  uint8_t pendingPoints() const { return count; }
+  const GpsTrackerStats& stats() const { return stat; }
+
+  bool batchReady(uint32_t now) const;
+  uint8_t buildBatch(uint8_t* dst, uint8_t maxLen, uint32_t now);
+  void confirmBatch();
+
+private:
+  void handleFix(uint32_t now);
+  void updateMotion(uint32_t now);
+  void queuePoint(const GpsFix& p);
+  uint8_t pointsPerBatch() const;
+  int64_t distanceSq(const GpsFix& a, const GpsFix& b) const;
+
+  Stream&       serial;
+  GpsRingBuffer ring;
+  TinyGPSPlus   gps;
+
+  GpsFix   fix;
+  GpsFix   anchor;          // position where the node stopped
+  GpsFix   stillRef;        // first fix of the current slow streak
+  GpsFix   lastQueued;
+  bool     fixValid;
+  bool     moving;
+  bool     queuedValid;
+  bool     flush;           // send pending points without waiting (stop)
+  uint8_t  moveCount;
+  uint8_t  stillCount;
+
+  GpsFix   queue[GPS_QUEUE_SIZE];
+  uint8_t  first;
+  uint8_t  count;
+  uint8_t  inBatch;         // points in the last built batch
+
+  uint16_t maxHdop;
+  uint8_t  minSats;
+  uint32_t maxAge;
+  uint16_t moveMeters, moveSpeed, stillMeters, stillSpeed;
+  uint8_t  confirm, stillFixes;
+  uint16_t minMeters;
+  uint8_t  turnDeg;
+  uint32_t heartbeat;
+  uint8_t  maxBytes;
+  uint32_t timeout;
+
+  GpsTrackerStats stat;
+};
+
+#endif
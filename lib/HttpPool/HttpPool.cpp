@@ -0,0 +1,439 @@
+#include "HttpPool.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+HttpPool::HttpPool() : numTargets(0), connectMs(1000), responseMs(2000), idleMs(2000) {
+}
+
+int8_t HttpPool::addTarget(WiFiClient& client, IPAddress ip, uint16_t port) {
+  if (numTargets >= HTTPP_MAX_TARGETS) {
+    return -1;
+  }
+  Target& t = targets[numTargets];
+
+  memset(&t.stat, 0, sizeof(t.stat));
+  memset(&t.hist, 0, sizeof(t.hist));
+  t.client = &client;
+  t.ip     = ip;
+  t.port   = port;
+  t.first  = 0;
+  t.count  = 0;
+  t.sent   = 0;
+  t.open   = false;
+  t.uses   = 0;
+  t.serial = false;
+  t.lastIo = 0;
+  resetParser(t);
+  return numTargets++;
+}
+
+void HttpPool::setTimeouts(uint16_t connect, uint16_t response, uint16_t idle) {
+  connectMs  = connect;
+  responseMs = response;
+  idleMs     = idle;
+}
+
+bool HttpPool::request(int8_t target, const char* path, bool idempotent, HttpCallback cb, void* ctx) {
+  if (target < 0 || target >= numTargets) {
+    return false;
+  }
+  Target& t = targets[target];
+
+  if (t.count >= HTTPP_QUEUE || strlen(path) >= HTTPP_MAX_PATH) {
+    t.stat.refused++;
+    return false;
+  }
+  Request& r = t.queue[(t.first + t.count) % HTTPP_QUEUE];
+
+  strcpy(r.path, path);
+  r.idempotent = idempotent;
+  r.attempts   = 0;
+  r.cb         = cb;
+  r.ctx        = ctx;
+  r.queued     = micros();
+  t.count++;
+  t.stat.requests++;
+  return true;
+}
+
+uint8_t HttpPool::pending(int8_t target) const {
+  return (target >= 0 && target < numTargets) ? targets[target].count : 0;
+}
+
+void HttpPool::process() {
+  for (uint8_t i = 0; i < numTargets; i++) {
+    processTarget(targets[i]);
+  }
+}
+
+void HttpPool::processTarget(Target& t) {
+  uint8_t buf[HTTPP_READ_CHUNK];
+  int     n;
+
+  // responses
+  while (t.sent > 0 && (n = t.client->available()) > 0) {
+    n = t.client->read(buf, min(n, (int) sizeof(buf)));
+    if (n <= 0) {
+      break;
+    }
+    t.lastIo = millis();
+    for (int i = 0; i < n && t.sent > 0; i++) {
+      feed(t, buf[i]);
+      if (t.state == PARSE_DONE) {
+        bool close = t.close;
+
+        t.serial = close;
+        complete(t, t.status);
+        if (close) {
+          // the rest of the pipeline goes out again on a new connection
+          connectionLost(t, HTTPP_ERR_LOST);
+          break;
+        }
+      } else if (t.state == PARSE_ERROR) {
+        complete(t, HTTPP_ERR_PROTOCOL);
+        connectionLost(t, HTTPP_ERR_LOST);
+        break;
+      }
+    }
+  }
+
+  // closed by the server (keep-alive timeout, reset)
+  if (t.open && !t.client->connected() && t.client->available() <= 0) {
+    if (t.sent > 0 && t.state == PARSE_BODY_CLOSE) {
+      t.serial = true;
+      complete(t, t.status);
+    }
+    connectionLost(t, HTTPP_ERR_LOST);
+  }
+
+  if (t.sent > 0 && millis() - t.lastIo > responseMs) {
+    connectionLost(t, HTTPP_ERR_TIMEOUT);
+  }
+
+  if (t.open && t.sent == 0 && idleMs > 0 && millis() - t.lastIo > idleMs) {
+    disconnect(t);
+  }
+
+  while (canSend(t)) {
+    if (!t.open && !connect(t)) {
+      // fail what is queued instead of blocking every process() call in
+      // connect(); the caller decides when to try again
+      while (t.count > 0) {
+        complete(t, HTTPP_ERR_CONNECT);
+      }
+      return;
+    }
+    if (!send(t)) {
+      connectionLost(t, HTTPP_ERR_LOST);
+      return;
+    }
+  }
+}
+
+bool HttpPool::connect(Target& t) {
+  if (WiFi.status() != WL_CONNECTED || !t.client->connect(t.ip, t.port, connectMs)) {
+    t.client->stop();
+    return false;
+  }
+  t.client->setNoDelay(true);
+  t.open   = true;
+  t.uses   = 0;
+  t.lastIo = millis();
+  t.stat.connects++;
+  resetParser(t);
+  return true;
+}
+
+void HttpPool::disconnect(Target& t) {
+  t.client->stop();
+  t.open = false;
+}
+
+// drops the connection; requests in flight are sent again if idempotent and
+// not out of attempts, else they fail with error (a non-idempotent request
+// may or may not have been carried out)
+void HttpPool::connectionLost(Target& t, int16_t error) {
+  Request failed[HTTPP_PIPELINE];
+  uint8_t numFailed = 0;
+  uint8_t kept      = 0;
+
+  disconnect(t);
+  resetParser(t);
+
+  for (uint8_t i = 0; i < t.count; i++) {
+    Request& r = t.queue[(t.first + i) % HTTPP_QUEUE];
+
+    if (i < t.sent && (!r.idempotent || r.attempts >= HTTPP_MAX_ATTEMPTS)) {
+      failed[numFailed++] = r;
+      continue;
+    }
+    if (kept != i) {
+      t.queue[(t.first + kept) % HTTPP_QUEUE] = r;
+    }
+    kept++;
+  }
+  t.count = kept;
+  t.sent  = 0;
+
+  for (uint8_t i = 0; i < numFailed; i++) {
+    HttpResult res;
+
+    res.status    = error;
+    res.body      = "";
+    res.bodyLen   = 0;
+    res.latencyUs = micros() - failed[i].queued;
+    res.attempts  = failed[i].attempts;
+    t.stat.failed++;
+    if (failed[i].cb) {
+      failed[i].cb(failed[i].ctx, res);
+    }
+  }
+}
+
+bool HttpPool::canSend(const Target& t) const {
+  if (t.count <= t.sent) {
+    return false;
+  }
+  if (t.sent == 0) {
+    return true;
+  }
+  // pipeline idempotent requests only
+  return t.sent < HTTPP_PIPELINE && !t.close && !t.serial &&
+         t.queue[t.first].idempotent && t.queue[(t.first + t.sent) % HTTPP_QUEUE].idempotent;
+}
+
+bool HttpPool::send(Target& t) {
+  Request& r = t.queue[(t.first + t.sent) % HTTPP_QUEUE];
+  char     msg[HTTPP_MAX_PATH + 48];
+  int      len;
+
+  // HTTP/1.1: keep-alive unless the server says otherwise
+  len = snprintf(msg, sizeof(msg), "GET %s HTTP/1.1\r\nHost: %u.%u.%u.%u\r\n\r\n", r.path,
+                 t.ip[0], t.ip[1], t.ip[2], t.ip[3]);
+  if (t.client->write((const uint8_t*) msg, len) != (size_t) len) {
+    return false;
+  }
+  if (t.uses > 0) {
+    t.stat.reused++;
+  }
+  if (t.sent > 0) {
+    t.stat.pipelined++;
+  }
+  if (r.attempts > 0) {
+    t.stat.retried++;
+  }
+  r.attempts++;
+  t.uses++;
+  t.sent++;
+  t.lastIo = millis();
+  return true;
+}
+
+void HttpPool::feed(Target& t, uint8_t c) {
+  switch (t.state) {
+    case PARSE_BODY:
+    case PARSE_CHUNK_DATA:
+      if (t.bodyLen < HTTPP_MAX_BODY - 1) {
+        t.body[t.bodyLen++] = c;
+      }
+      if (--t.remaining <= 0) {
+        t.state = (t.state == PARSE_BODY) ? PARSE_DONE : PARSE_CHUNK_END;
+      }
+      break;
+
+    case PARSE_BODY_CLOSE:
+      if (t.bodyLen < HTTPP_MAX_BODY - 1) {
+        t.body[t.bodyLen++] = c;
+      }
+      break;
+
+    case PARSE_DONE:
+    case PARSE_ERROR:
+      break;
+
+    default:
+      // line based states
+      if (c == '\r') {
+        break;
+      }
+      if (c != '\n') {
+        if (t.lineLen < HTTPP_MAX_LINE - 1) {
+          t.line[t.lineLen++] = c;
+        }
+        break;
+      }
+      t.line[t.lineLen] = 0;
+      t.lineLen = 0;
+      headerLine(t);
+      break;
+  }
+}
+
+void HttpPool::headerLine(Target& t) {
+  const char* value;
+
+  switch (t.state) {
+    case PARSE_STATUS:
+      if (strncmp(t.line, "HTTP/1.", 7) != 0 || strlen(t.line) < 12) {
+        t.state = PARSE_ERROR;
+        break;
+      }
+      t.close  = t.line[7] == '0';
+      t.status = atoi(t.line + 9);
+      t.state  = PARSE_HEADER;
+      break;
+
+    case PARSE_HEADER:
+      if (t.line[0] == 0) {
+        if (t.status < 200) {
+          t.state = PARSE_STATUS;         // 100 Continue and friends
+        } else if (t.status == 204 || t.status == 304) {
+          t.state = PARSE_DONE;
+        } else if (t.chunked) {
+          t.state = PARSE_CHUNK_SIZE;
+        } else if (t.remaining >= 0) {
+          t.state = t.remaining > 0 ? PARSE_BODY : PARSE_DONE;
+        } else {
+          t.state = PARSE_BODY_CLOSE;
+          t.close = true;
+        }
+        break;
+      }
+      for (char* p = t.line; *p; p++) {
+        *p = tolower(*p);
+      }
+      value = strchr(t.line, ':');
+      if (value == NULL) {
+        break;
+      }
+      value++;
+      if (strncmp(t.line, "content-length:", 15) == 0) {
+        t.remaining = atol(value);
+      } else if (strncmp(t.line, "transfer-encoding:", 18) == 0) {
+        t.chunked = strstr(value, "chunked") != NULL;
+      } else if (strncmp(t.line, "connection:", 11) == 0) {
+        if (strstr(value, "close")) {
+          t.close = true;
+        } else if (strstr(value, "keep-alive")) {
+          t.close = false;
+        }
+      }
+      break;
+
+    case PARSE_CHUNK_SIZE:
+      t.remaining = strtol(t.line, NULL, 16);
+      t.state = t.remaining > 0 ? PARSE_CHUNK_DATA : PARSE_TRAILER;
+      break;
+
+    case PARSE_CHUNK_END:
+      t.state = PARSE_CHUNK_SIZE;
+      break;
+
+    case PARSE_TRAILER:
+      if (t.line[0] == 0) {
+        t.state = PARSE_DONE;
+      }
+      break;
+
+    default:
+      break;
+  }
+}
+
+void HttpPool::resetParser(Target& t) {
+  t.state     = PARSE_STATUS;
+  t.lineLen   = 0;
+  t.status    = 0;
+  t.remaining = -1;
+  t.chunked   = false;
+  t.close     = false;
+  t.bodyLen   = 0;
+}
+
+// finishes the oldest request (response or error)
+void HttpPool::complete(Target& t, int16_t status) {
+  Request    r = t.queue[t.first];
+  HttpResult res;
+
+  t.first = (t.first + 1) % HTTPP_QUEUE;
+  t.count--;
+  if (t.sent > 0) {
+    t.sent--;
+  }
+
+  t.body[t.bodyLen] = 0;
+  res.status    = status;
+  res.body      = status > 0 ? t.body : "";
+  res.bodyLen   = status > 0 ? t.bodyLen : 0;
+  res.latencyUs = micros() - r.queued;
+  res.attempts  = r.attempts;
+  if (status > 0) {
+    t.stat.completed++;
+    addSample(t.hist, res.latencyUs);
+  } else {
+    t.stat.failed++;
+  }
+  if (r.cb) {
+    r.cb(r.ctx, res);
+  }
+
+  // the connection stays, read the next response
+  bool close = t.close;
+  resetParser(t);
+  t.close = close;
+}
+
+uint32_t HttpPool::percentile(const HttpPoolHist& h, uint8_t pct) {
+  uint32_t need = ((uint64_t) h.count * pct + 99) / 100;
+  uint32_t sum  = 0;
+
+  if (h.count == 0) {
+    return 0;
+  }
+  for (uint8_t i = 0; i < HTTPP_HIST_BINS - 1; i++) {
+    sum += h.bins[i];
+    if (sum >= need) {
+      return 1UL << i;
+    }
+  }
+  return h.maxUs;
+}
+
+void HttpPool::printStats(Stream& out) const {
+  for (uint8_t i = 0; i < numTargets; i++) {
+    const Target& t = targets[i];
+
+    out.printf("%u.%u.%u.%u:%u req=%lu done=%lu failed=%lu refused=%lu connects=%lu reused=%lu pipelined=%lu retried=%lu\n",
+               t.ip[0], t.ip[1], t.ip[2], t.ip[3], t.port,
+               (unsigned long) t.stat.requests, (unsigned long) t.stat.completed,
+               (unsigned long) t.stat.failed, (unsigned long) t.stat.refused,
+               (unsigned long) t.stat.connects, (unsigned long) t.stat.reused,
+               (unsigned long) t.stat.pipelined, (unsigned long) t.stat.retried);
+    out.printf("  latency: n=%lu p50<%lu p99<%lu max=%lu us |", (unsigned long) t.hist.count,
+               (unsigned long) percentile(t.hist, 50), (unsigned long) percentile(t.hist, 99),
+               (unsigned long) t.hist.maxUs);
+    for (uint8_t b = 0; b < HTTPP_HIST_BINS; b++) {
+      out.printf(" %lu", (unsigned long) t.hist.bins[b]);
+    }
+    out.println();
+  }
+}
+
+void HttpPool::resetStats() {
+  for (uint8_t i = 0; i < numTargets; i++) {
+    memset(&targets[i].stat, 0, sizeof(targets[i].stat));
+    memset(&targets[i].hist, 0, sizeof(targets[i].hist));
+  }
+}
+
+void HttpPool::addSample(HttpPoolHist& h, uint32_t us) {
+  uint8_t bin = us ? 32 - __builtin_clz(us) : 0;
+
+  h.bins[min(bin, (uint8_t) (HTTPP_HIST_BINS - 1))]++;
+  h.count++;
+  if (us > h.maxUs) {
+    h.maxUs = us;
+  }
+}
@@ -0,0 +1,175 @@
+// Keep-alive HTTP/1.1 client pool (ESP32), e.g. for Tasmota /cm?cmnd=...
+//
+// - one persistent connection per target (IP, port); request() only queues
+//   the GET, process() connects, writes and parses the responses and calls
+//   the completion callback (from process(), i.e. in loop() context)
+// - idempotent requests (Power ON / OFF, status queries) are pipelined, up
+//   to HTTPP_PIPELINE on the wire; a non-idempotent one (Power TOGGLE) is
+//   only sent on its own and never sent twice; a server that answers with
+//   "Connection: close" gets one request per connection until it keeps a
+//   connection open again
+// - a connection the server closed (keep-alive timeout, "Connection:
+//   close", reset) is reopened transparently; idempotent requests that were
+//   in flight are sent again, at most HTTPP_MAX_ATTEMPTS times
+// - connections idle for longer than idleMs are closed before the server
+//   times them out, so a request does not hit a half closed socket
+// - responses: Content-Length, chunked or body until close; the body is
+//   kept up to HTTPP_MAX_BODY - 1 bytes
+// - latency per target (power of 2 bins in us): request() to the end of
+//   the response, i.e. including the wait in the queue and a reconnect
+//
+// WiFiClient::connect() blocks until the TCP handshake is done (or
+// connectMs), on the LAN usually a few ms; everything else is non-blocking.
+
+#ifndef HTTP_POOL_H
+#define HTTP_POOL_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+#ifndef HTTPP_MAX_TARGETS
+#define HTTPP_MAX_TARGETS     4
+#endif
+#ifndef HTTPP_QUEUE
+#define HTTPP_QUEUE           8     // requests per target
+#endif
+#define HTTPP_PIPELINE        4
+#define HTTPP_MAX_ATTEMPTS    3
+#define HTTPP_MAX_PATH        64
+#ifndef HTTPP_MAX_BODY
+#define HTTPP_MAX_BODY        128
+#endif
+#define HTTPP_MAX_LINE        96    // status / header line, longer ones are cut
+#define HTTPP_READ_CHUNK      64
+#define HTTPP_HIST_BINS       24    // 1 us .. 2^23 us (~8 s), last bin open
+
+// HttpResult.status < 0
+#define HTTPP_ERR_CONNECT     (-1)  // connect failed
+#define HTTPP_ERR_TIMEOUT     (-2)  // no (complete) response within responseMs
+#define HTTPP_ERR_LOST        (-3)  // connection lost and the request not repeated
+#define HTTPP_ERR_PROTOCOL    (-4)  // not an HTTP/1.x response
+
+typedef struct HttpResult {
+  int16_t     status;     // HTTP status code or HTTPP_ERR_*
+  const char* body;       // NUL terminated, valid during the callback
+  uint16_t    bodyLen;    // stored bytes
+  uint32_t    latencyUs;  // request() to completion
+  uint8_t     attempts;   // times the request was written
+} HttpResult;
+
+typedef void (*HttpCallback)(void* ctx, const HttpResult& result);
+
+typedef struct HttpPoolHist {
+  uint32_t bins[HTTPP_HIST_BINS];
+  uint32_t count;
+  uint32_t maxUs;
+} HttpPoolHist;
+
+typedef struct HttpPoolStats {
+  uint32_t requests;      // accepted by request()
+  uint32_t refused;       // queue full
+  uint32_t completed;     // responses (any status)
+  uint32_t failed;        // HTTPP_ERR_*
+  uint32_t connects;      // TCP connections opened
+  uint32_t reused;        // requests written on an open connection
+  uint32_t pipelined;     // requests written while others were in flight
+  uint32_t retried;       // requests written again after a lost connection
+} HttpPoolStats;
+
+class HttpPool {
+public:
+  HttpPool();
+
+  // client stays owned by the caller, one per target; returns the target
+  // index or -1 if HTTPP_MAX_TARGETS are in use
+  int8_t addTarget(WiFiClient& client, IPAddress ip, uint16_t port = 80);
+  // idleMs 0: keep idle connections until the server closes them (fine
+  // for idempotent requests, they are repeated if the socket was stale)
+  void setTimeouts(uint16_t connectMs, uint16_t responseMs, uint16_t idleMs);
+
+  // queues GET path (copied); false if the queue of the target is full or
+  // the path is too long
+  bool request(int8_t target, const char* path, bool idempotent, HttpCallback cb, void* ctx = NULL);
+  // requests queued or in flight
+  uint8_t pending(int8_t target) const;
+
+  void process();
+
+  const HttpPoolStats& stats(int8_t target) const { return targets[target].stat; }
+  const HttpPoolHist& latency(int8_t target) const { return targets[target].hist; }
+  // upper bound of the bin holding the pct percentile [us]
+  static uint32_t percentile(const HttpPoolHist& h, uint8_t pct);
+  void printStats(Stream& out) const;
+  void resetStats();
+
+private:
+  typedef enum ParseState {
+    PARSE_STATUS,
+    PARSE_HEADER,
+    PARSE_BODY,           // Content-Length
+    PARSE_BODY_CLOSE,     // until the server closes
+    PARSE_CHUNK_SIZE,
+    PARSE_CHUNK_DATA,
+    PARSE_CHUNK_END,
+    PARSE_TRAILER,
+    PARSE_DONE,
+    PARSE_ERROR
+  } ParseState;
+
+  typedef struct Request {
+    char         path[HTTPP_MAX_PATH];
+    bool         idempotent;
+    uint8_t      attempts;
+    HttpCallback cb;
+    void*        ctx;
+    uint32_t     queued;    // micros()
+  } Request;
+
+  typedef struct Target {
+    WiFiClient*   client;
+    IPAddress     ip;
+    uint16_t      port;
+    Request       queue[HTTPP_QUEUE];
+    uint8_t       first;
+    uint8_t       count;
+    uint8_t       sent;       // queue[first ..] written, awaiting responses
+    bool          open;       // connection we opened and did not close
+    uint16_t      uses;       // requests written on this connection
+    bool          serial;     // server closes after each response: no pipelining
+    uint32_t      lastIo;     // millis() of the last write / read
+
+    // response of queue[first]
+    ParseState    state;
+    char          line[HTTPP_MAX_LINE];
+    uint8_t       lineLen;
+    int16_t       status;
+    int32_t       remaining;  // Content-Length or chunk bytes left, -1 unknown
+    bool          chunked;
+    bool          close;      // "Connection: close" or HTTP/1.0
+    char          body[HTTPP_MAX_BODY];
+    uint16_t      bodyLen;
+
+    HttpPoolStats stat;
+    HttpPoolHist  hist;
+  } Target;
+
+  void processTarget(Target& t);
+  bool connect(Target& t);
+  void disconnect(Target& t);
+  void connectionLost(Target& t, int16_t error);
+  bool canSend(const Target& t) const;
+  bool send(Target& t);
+  void feed(Target& t, uint8_t c);
+  void headerLine(Target& t);
+  void resetParser(Target& t);
+  void complete(Target& t, int16_t status);
+  static void addSample(HttpPoolHist& h, uint32_t us);
+
+  Target   targets[HTTPP_MAX_TARGETS];
+  uint8_t  numTargets;
+  uint16_t connectMs;
+  uint16_t responseMs;
+  uint16_t idleMs;
+};
+
+#endif
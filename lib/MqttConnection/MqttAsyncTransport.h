@@ -0,0 +1,26 @@
+// MqttConnection transport for AsyncMqttClient (connect does not block)
+
+#ifndef MQTT_ASYNC_TRANSPORT_H
+#define MQTT_ASYNC_TRANSPORT_H
+
+#include <AsyncMqttClient.h>
+#include "MqttConnection.h"
+
+class MqttAsyncTransport : public MqttTransport {
+public:
+  // server, client id etc. are set on the client; qos of all publishes
+  MqttAsyncTransport(AsyncMqttClient& client, uint8_t qos = 0) : client(client), qos(qos) {}
+
+  bool connect() { client.connect(); return true; }
+  bool connected() { return client.connected(); }
+  void disconnect() { client.disconnect(true); }
+  bool publish(const char* topic, const uint8_t* data, uint16_t len, bool retain) {
+    return client.publish(topic, qos, retain, (const char*) data, len) != 0;
+  }
+
+private:
+  AsyncMqttClient& client;
+  uint8_t          qos;
+};
+
+#endif
@@ -0,0 +1,179 @@
+#include "MqttConnection.h"
+
+#include <WiFi.h>
+#include <string.h>
+
+//------------------------------------------------------------------------------
+// MqttRamSpool
+
+MqttRamSpool::MqttRamSpool() : first(0), count(0) {
+}
+
+bool MqttRamSpool::push(const MqttRecord& rec) {
+  bool kept = true;
+
+  if (count == MQTTC_RAM_SPOOL) {
+    first = (first + 1) % MQTTC_RAM_SPOOL;
+    count--;
+    kept = false;
+  }
+  ring[(first + count) % MQTTC_RAM_SPOOL] = rec;
+  count++;
+  return kept;
+}
+
+bool MqttRamSpool::peek(MqttRecord& rec) {
+  if (count == 0) {
+    return false;
+  }
+  rec = ring[first];
+  return true;
+}
+
+void MqttRamSpool::pop() {
+  if (count > 0) {
+    first = (first + 1) % MQTTC_RAM_SPOOL;
+    count--;
+  }
+}
+
+//------------------------------------------------------------------------------
+// MqttConnection
+
+MqttConnection::MqttConnection(MqttTransport& transport, MqttSpool& spool)
+  : transport(transport), spool(spool), numTopics(0), st(MqttConn_Waiting),
+    minBackoff(1000), maxBackoff(60000), connectTimeout(10000), failures(0),
+    nextAttempt(0), attemptStart(0), replayBatch(5), replayMs(100), appendAge(false), lastReplay(0) {
+  memset(&stat, 0, sizeof(stat));
+}
+
+void MqttConnection::setBackoff(uint32_t minMs, uint32_t maxMs, uint32_t connectTimeoutMs) {
+  minBackoff     = minMs;
+  maxBackoff     = max(minMs, maxMs);
+  connectTimeout = connectTimeoutMs;
+}
+
+void MqttConnection::setReplay(uint8_t batch, uint16_t intervalMs, bool age) {
+  replayBatch = max(batch, (uint8_t) 1);
+  replayMs    = intervalMs;
+  appendAge   = age;
+}
+
+int8_t MqttConnection::addTopic(const char* topic) {
+  if (numTopics >= MQTTC_MAX_TOPICS) {
+    return -1;
+  }
+  topics[numTopics] = topic;
+  return numTopics++;
+}
+
+bool MqttConnection::publish(uint8_t topic, const uint8_t* data, uint8_t len) {
+  MqttRecord rec;
+
+  if (topic >= numTopics || len > MQTTC_MAX_PAYLOAD) {
+    stat.oversize++;
+    return false;
+  }
+  rec.time  = millis();
+  rec.topic = topic;
+  rec.len   = len;
+  memcpy(rec.data, data, len);
+
+  // direct only if nothing older is waiting
+  if (st == MqttConn_Connected && spool.size() == 0 && send(rec, rec.time, false)) {
+    stat.published++;
+    return true;
+  }
+  if (!spool.push(rec)) {
+    stat.lost++;
+  }
+  stat.spooled++;
+  stat.maxSpool = max(stat.maxSpool, spool.size());
+  return true;
+}
+
+void MqttConnection::process(uint32_t now) {
+  switch (st) {
+    case MqttConn_Waiting:
+      if ((int32_t) (now - nextAttempt) < 0 || WiFi.status() != WL_CONNECTED) {
+        break;
+      }
+      stat.attempts++;
+      attemptStart = now;
+      if (transport.connect()) {
+        st = MqttConn_Connecting;
+      } else {
+        scheduleRetry(now);
+      }
+      break;
+
+    case MqttConn_Connecting:
+      transport.loop();
+      if (transport.connected()) {
+        st         = MqttConn_Connected;
+        failures   = 0;
+        lastReplay = now - replayMs;
+        stat.connects++;
+      } else if (now - attemptStart >= connectTimeout) {
+        transport.disconnect();
+        scheduleRetry(now);
+      }
+      break;
+
+    case MqttConn_Connected:
+      transport.loop();
+      if (!transport.connected()) {
+        scheduleRetry(now);
+        break;
+      }
+      replay(now);
+      break;
+  }
+}
+
+// equal jitter: half of the window fixed, half random
+void MqttConnection::scheduleRetry(uint32_t now) {
+  uint32_t window = minBackoff;
+
+  for (uint8_t i = 0; i < failures && window < maxBackoff; i++) {
+    window <<= 1;
+  }
+  window = min(window, maxBackoff);
+  if (failures < 31) {
+    failures++;
+  }
+  nextAttempt = now + window / 2 + random(window / 2 + 1);
+  st = MqttConn_Waiting;
+}
+
+void MqttConnection::replay(uint32_t now) {
+  MqttRecord rec;
+
+  if (spool.size() == 0 || now - lastReplay < replayMs) {
+    return;
+  }
+  lastReplay = now;
+  for (uint8_t i = 0; i < replayBatch && spool.peek(rec); i++) {
+    if (!send(rec, now, true)) {
+      break;    // client busy, next batch
+    }
+    spool.pop();
+    stat.replayed++;
+  }
+}
+
+bool MqttConnection::send(const MqttRecord& rec, uint32_t now, bool replayed) {
+  uint8_t  buf[MQTTC_MAX_PAYLOAD + MQTTC_AGE_LEN];
+  uint16_t len = rec.len;
+
+  memcpy(buf, rec.data, rec.len);
+  if (replayed && appendAge) {
+    uint32_t age = now - rec.time;
+
+    buf[len++] = (age >> 24) & 0xFF;
+    buf[len++] = (age >> 16) & 0xFF;
+    buf[len++] = (age >> 8) & 0xFF;
+    buf[len++] = age & 0xFF;
+  }
+  return transport.publish(topics[rec.topic], buf, len, false);
+}
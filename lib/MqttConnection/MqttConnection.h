@@ -0,0 +1,147 @@
+// Non-blocking MQTT connection manager with offline spooling (ESP32)
+//
+// - connecting is a state machine driven by process(): an attempt is only
+//   started while Wi-Fi is up, a failed attempt or a lost connection waits
+//   an exponential backoff with jitter (min .. max) before the next one
+// - publish() never waits for the broker: while offline (or while older
+//   readings are still spooled, to keep the order) the reading goes into a
+//   bounded spool, RAM (MqttRamSpool) or flash (MqttFileSpool)
+// - after a reconnect the spool is replayed in batches of replayBatch
+//   readings every replayMs, so the backlog does not flood the client or
+//   the broker; optionally the age of the reading [ms] is appended to the
+//   payload of replayed messages (4 bytes, big endian)
+// - a full spool drops its oldest reading (counted as lost)
+//
+// The client is wrapped by a transport: MqttAsyncTransport.h
+// (AsyncMqttClient, connect is non-blocking) or MqttPubSubTransport.h
+// (PubSubClient, connect blocks loop() for the TCP / MQTT handshake, with
+// an unreachable broker for the whole TCP connect timeout). Use
+// MqttAsyncTransport where loop() must not stall.
+
+#ifndef MQTT_CONNECTION_H
+#define MQTT_CONNECTION_H
+
+#include <Arduino.h>
+
+#ifndef MQTTC_MAX_PAYLOAD
+#define MQTTC_MAX_PAYLOAD     64    // bytes per reading (or telemetry batch)
+#endif
+#ifndef MQTTC_RAM_SPOOL
+#define MQTTC_RAM_SPOOL       64    // readings
+#endif
+#define MQTTC_MAX_TOPICS      8
+#define MQTTC_AGE_LEN         4
+
+// one spooled reading
+typedef struct MqttRecord {
+  uint32_t time;        // millis() of the reading
+  uint8_t  topic;       // index from addTopic()
+  uint8_t  len;
+  uint8_t  data[MQTTC_MAX_PAYLOAD];
+} MqttRecord;
+
+// client wrapper
+class MqttTransport {
+public:
+  virtual ~MqttTransport() {}
+  // starts a connection attempt; false if it failed right away
+  virtual bool connect() = 0;
+  virtual bool connected() = 0;
+  virtual void disconnect() = 0;
+  // false if the client did not take the message
+  virtual bool publish(const char* topic, const uint8_t* data, uint16_t len, bool retain) = 0;
+  virtual void loop() {}
+};
+
+// FIFO of readings
+class MqttSpool {
+public:
+  virtual ~MqttSpool() {}
+  // false if the oldest reading had to be dropped
+  virtual bool push(const MqttRecord& rec) = 0;
+  virtual bool peek(MqttRecord& rec) = 0;
+  virtual void pop() = 0;
+  virtual uint16_t size() = 0;
+};
+
+class MqttRamSpool : public MqttSpool {
+public:
+  MqttRamSpool();
+  bool push(const MqttRecord& rec);
+  bool peek(MqttRecord& rec);
+  void pop();
+  uint16_t size() { return count; }
+
+private:
+  MqttRecord ring[MQTTC_RAM_SPOOL];
+  uint16_t   first;
+  uint16_t   count;
+};
+
+typedef enum MqttConnState {
+  MqttConn_Waiting = 0,   // backoff / no Wi-Fi
+  MqttConn_Connecting,
+  MqttConn_Connected,
+} MqttConnState;
+
+typedef struct MqttConnStats {
+  uint32_t published;   // sent right away
+  uint32_t spooled;     // readings put into the spool
+  uint32_t replayed;    // spooled readings sent
+  uint32_t lost;        // dropped by a full spool
+  uint32_t oversize;    // payload > MQTTC_MAX_PAYLOAD
+  uint32_t attempts;    // connection attempts
+  uint32_t connects;    // successful connects
+  uint16_t maxSpool;    // peak spool size
+} MqttConnStats;
+
+class MqttConnection {
+public:
+  MqttConnection(MqttTransport& transport, MqttSpool& spool);
+
+  // backoff between attempts, timeout of one attempt
+  void setBackoff(uint32_t minMs, uint32_t maxMs, uint32_t connectTimeoutMs = 10000);
+  // replay: readings per batch, pause between batches, append the age
+  void setReplay(uint8_t batch, uint16_t intervalMs, bool appendAge = false);
+
+  // topic is kept as pointer; returns the index for publish(), -1 if full
+  int8_t addTopic(const char* topic);
+
+  // never blocks; false only if the reading cannot be taken at all
+  bool publish(uint8_t topic, const uint8_t* data, uint8_t len);
+
+  void process(uint32_t now);
+
+  MqttConnState state() const { return st; }
+  bool connected() const { return st == MqttConn_Connected; }
+  uint16_t backlog() { return spool.size(); }
+  const MqttConnStats& stats() const { return stat; }
+
+private:
+  void scheduleRetry(uint32_t now);
+  void replay(uint32_t now);
+  bool send(const MqttRecord& rec, uint32_t now, bool replayed);
+
+  MqttTransport& transport;
+  MqttSpool&     spool;
+
+  const char* topics[MQTTC_MAX_TOPICS];
+  uint8_t     numTopics;
+
+  MqttConnState st;
+  uint32_t minBackoff;
+  uint32_t maxBackoff;
+  uint32_t connectTimeout;
+  uint8_t  failures;      // attempts in a row without success
+  uint32_t nextAttempt;
+  uint32_t attemptStart;
+
+  uint8_t  replayBatch;
+  uint16_t replayMs;
+  bool     appendAge;
+  uint32_t lastReplay;
+
+  MqttConnStats stat;
+};
+
+#endif
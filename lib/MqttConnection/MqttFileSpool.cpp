@@ -0,0 +1,117 @@
+#include "MqttFileSpool.h"
+
+static void put16(uint8_t* p, uint16_t v) {
+  p[0] = v >> 8;
+  p[1] = v & 0xFF;
+}
+
+static uint16_t get16(const uint8_t* p) {
+  return ((uint16_t) p[0] << 8) | p[1];
+}
+
+MqttFileSpool::MqttFileSpool(fs::FS& fs, const char* path, uint16_t capacity)
+  : fs(fs), path(path), ok(false), capacity(capacity), first(0), count(0), headValid(false) {
+}
+
+bool MqttFileSpool::begin() {
+  uint8_t hdr[MQTTC_SPOOL_HEADER];
+
+  first = 0;
+  count = 0;
+  headValid = false;
+
+  if (fs.exists(path)) {
+    file = fs.open(path, "r+");
+    if (file && file.read(hdr, sizeof(hdr)) == sizeof(hdr)) {
+      uint32_t magic = ((uint32_t) get16(hdr) << 16) | get16(hdr + 2);
+
+      if (magic == MQTTC_SPOOL_MAGIC && get16(hdr + 8) == capacity &&
+          get16(hdr + 10) == sizeof(MqttRecord) &&
+          get16(hdr + 4) < capacity && get16(hdr + 6) <= capacity) {
+        first = get16(hdr + 4);
+        count = get16(hdr + 6);
+        ok = true;
+        return true;
+      }
+    }
+    // other layout or broken: start over
+    if (file) {
+      file.close();
+    }
+  }
+
+  file = fs.open(path, "w+");
+  ok = file && writeHeader();
+  return ok;
+}
+
+bool MqttFileSpool::push(const MqttRecord& rec) {
+  bool kept = true;
+
+  if (!ok) {
+    return false;
+  }
+  if (count == capacity) {
+    first = (first + 1) % capacity;
+    count--;
+    headValid = false;
+    kept = false;
+  }
+  if (!writeSlot((first + count) % capacity, rec)) {
+    return false;
+  }
+  count++;
+  writeHeader();
+  return kept;
+}
+
+bool MqttFileSpool::peek(MqttRecord& rec) {
+  if (!ok || count == 0) {
+    return false;
+  }
+  if (!headValid) {
+    headValid = readSlot(first, head);
+    if (!headValid) {
+      return false;
+    }
+  }
+  rec = head;
+  return true;
+}
+
+void MqttFileSpool::pop() {
+  if (!ok || count == 0) {
+    return;
+  }
+  first = (first + 1) % capacity;
+  count--;
+  headValid = false;
+  writeHeader();
+}
+
+bool MqttFileSpool::writeHeader() {
+  uint8_t hdr[MQTTC_SPOOL_HEADER];
+
+  put16(hdr, MQTTC_SPOOL_MAGIC >> 16);
+  put16(hdr + 2, MQTTC_SPOOL_MAGIC & 0xFFFF);
+  put16(hdr + 4, first);
+  put16(hdr + 6, count);
+  put16(hdr + 8, capacity);
+  put16(hdr + 10, sizeof(MqttRecord));
+  if (!file.seek(0) || file.write(hdr, sizeof(hdr)) != sizeof(hdr)) {
+    return false;
+  }
+  file.flush();
+  return true;
+}
+
+bool MqttFileSpool::readSlot(uint16_t slot, MqttRecord& rec) {
+  return file.seek(MQTTC_SPOOL_HEADER + (uint32_t) slot * sizeof(MqttRecord)) &&
+         file.read((uint8_t*) &rec, sizeof(rec)) == sizeof(rec) &&
+         rec.len <= MQTTC_MAX_PAYLOAD;
+}
+
+bool MqttFileSpool::writeSlot(uint16_t slot, const MqttRecord& rec) {
+  return file.seek(MQTTC_SPOOL_HEADER + (uint32_t) slot * sizeof(MqttRecord)) &&
+         file.write((const uint8_t*) &rec, sizeof(rec)) == sizeof(rec);
+}
@@ -0,0 +1,52 @@
+// Flash spool for MqttConnection
+//
+// A fixed size ring of MqttRecord slots in one file (LittleFS / SPIFFS):
+//
+//   | magic (32 bit) | first (16 bit) | count (16 bit) | capacity (16 bit) | slot size (16 bit) |
+//   | slot 0 | slot 1 | ... | slot capacity - 1 |
+//
+// The header is rewritten on every push / pop, so the spool survives a
+// reset or deep sleep; begin() picks up the readings of the last run if the
+// capacity and the slot size (MQTTC_MAX_PAYLOAD) did not change (their
+// millis() time stamps, and so the replay age, refer to the last run).
+
+#ifndef MQTT_FILE_SPOOL_H
+#define MQTT_FILE_SPOOL_H
+
+#include <FS.h>
+#include "MqttConnection.h"
+
+#define MQTTC_SPOOL_MAGIC     0x4D515331UL   // "MQS1"
+#define MQTTC_SPOOL_HEADER    12
+
+class MqttFileSpool : public MqttSpool {
+public:
+  // call fs.begin() first; path and fs must stay valid
+  MqttFileSpool(fs::FS& fs, const char* path, uint16_t capacity);
+
+  // false if the file cannot be opened; the spool then refuses nothing
+  // but keeps nothing either (counted as lost by MqttConnection)
+  bool begin();
+
+  bool push(const MqttRecord& rec);
+  bool peek(MqttRecord& rec);
+  void pop();
+  uint16_t size() { return count; }
+
+private:
+  bool writeHeader();
+  bool readSlot(uint16_t slot, MqttRecord& rec);
+  bool writeSlot(uint16_t slot, const MqttRecord& rec);
+
+  fs::FS&     fs;
+  const char* path;
+  File        file;
+  bool        ok;
+  uint16_t    capacity;
+  uint16_t    first;
+  uint16_t    count;
+  MqttRecord  head;       // cached oldest record
+  bool        headValid;
+};
+
+#endif
@@ -0,0 +1,36 @@
+// MqttConnection transport for PubSubClient
+//
+// PubSubClient::connect() blocks loop() for the TCP and MQTT handshake.
+// setSocketTimeout() only bounds the MQTT part: with an unreachable broker
+// the TCP connect blocks for its own timeout, on every attempt of the
+// backoff. MqttConnection only calls it while Wi-Fi is up. For a loop()
+// that must not stall use MqttAsyncTransport.
+
+#ifndef MQTT_PUBSUB_TRANSPORT_H
+#define MQTT_PUBSUB_TRANSPORT_H
+
+#include <PubSubClient.h>
+#include "MqttConnection.h"
+
+class MqttPubSubTransport : public MqttTransport {
+public:
+  // server is set on the client; user / password may be NULL
+  MqttPubSubTransport(PubSubClient& client, const char* clientId, const char* user = NULL, const char* pass = NULL)
+    : client(client), clientId(clientId), user(user), pass(pass) {}
+
+  bool connect() { return client.connect(clientId, user, pass); }
+  bool connected() { return client.connected(); }
+  void disconnect() { client.disconnect(); }
+  bool publish(const char* topic, const uint8_t* data, uint16_t len, bool retain) {
+    return client.publish(topic, data, len, retain);
+  }
+  void loop() { client.loop(); }
+
+private:
+  PubSubClient& client;
+  const char*   clientId;
+  const char*   user;
+  const char*   pass;
+};
+
+#endif
@@ -0,0 +1,236 @@
+#include "MqttGateway.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define KEY_LORAWAN       (1UL << 24)
+#define KEY_RADIOLINK     (2UL << 24)
+
+static int8_t clampRssi(int16_t rssi) {
+  return (rssi < -128) ? -128 : (rssi > 127) ? 127 : (int8_t) rssi;
+}
+
+MqttGateway::MqttGateway(AsyncMqttClient& mqtt)
+  : mqtt(mqtt), prefix("wimod"), flushMs(200), qos(0), flushAll(false), first(0), count(0), queued(0) {
+  memset(topics, 0, sizeof(topics));
+  memset(&stat, 0, sizeof(stat));
+}
+
+void MqttGateway::begin(const char* topicPrefix, uint16_t flushInterval, uint8_t publishQos) {
+  prefix  = topicPrefix;
+  flushMs = flushInterval;
+  qos     = publishQos;
+}
+
+bool MqttGateway::pushLoRaWan(const TWiMODLORAWAN_RX_Data& rxData) {
+  int8_t rssi = rxData.OptionalInfoAvaiable ? rxData.RSSI : 0;
+  int8_t snr  = rxData.OptionalInfoAvaiable ? rxData.SNR : 0;
+
+  return push(KEY_LORAWAN, rxData.Port, rssi, snr, rxData.Payload, rxData.Length);
+}
+
+bool MqttGateway::pushRadioLink(const TWiMODLR_RadioLink_Msg& rxMsg) {
+  uint32_t key  = KEY_RADIOLINK | ((uint32_t) rxMsg.SourceGroupAddress << 16) | rxMsg.SourceDeviceAddress;
+  int8_t   rssi = rxMsg.OptionalInfoAvaiable ? clampRssi(rxMsg.RSSI) : 0;
+  int8_t   snr  = rxMsg.OptionalInfoAvaiable ? rxMsg.SNR : 0;
+
+  return push(key, 0, rssi, snr, rxMsg.Payload, rxMsg.Length);
+}
+
+void MqttGateway::process(uint32_t now) {
+  uint8_t seen = 0;   // topics whose oldest frame has been checked
+
+  if (!mqtt.connected() || queued == 0) {
+    return;
+  }
+
+  // the first unsent slot of a topic is its oldest frame
+  for (uint8_t i = 0; i < count; i++) {
+    Slot&   slot = slots[(first + i) % MQTTGW_SLOTS];
+    Topic*  topic;
+    uint8_t idx;
+
+    if (slot.sent) {
+      continue;
+    }
+    topic = findTopic(slot.key, false);
+    idx   = topic - topics;
+    if (seen & (1 << idx)) {
+      continue;
+    }
+    seen |= 1 << idx;
+
+    if (flushAll || now - slot.time >= flushMs ||
+        topic->bytes + MQTTGW_BATCH_HEADER > MQTTGW_MAX_BATCH - MQTTGW_FRAME_HEADER - MQTTGW_MAX_FRAME) {
+      if (!publishTopic(*topic, now)) {
+        break;    // client queue full, retry with the next process()
+      }
+    }
+  }
+  compact();
+}
+
+void MqttGateway::flush(uint32_t now) {
+  uint8_t before;
+
+  flushAll = true;
+  do {
+    before = queued;
+    process(now);
+  } while (queued > 0 && queued < before);
+  flushAll = false;
+}
+
+bool MqttGateway::push(uint32_t key, uint8_t port, int8_t rssi, int8_t snr, const uint8_t* data, uint8_t len) {
+  Topic* topic;
+  Slot*  slot;
+
+  stat.received++;
+  if (len > MQTTGW_MAX_FRAME) {
+    stat.oversize++;
+    return false;
+  }
+  topic = findTopic(key, true);
+  if (!topic) {
+    stat.noTopic++;
+    return false;
+  }
+  if (count == MQTTGW_SLOTS) {
+    dropOldest();
+  }
+
+  slot = &slots[(first + count) % MQTTGW_SLOTS];
+  slot->key  = key;
+  slot->time = millis();
+  slot->port = port;
+  slot->rssi = rssi;
+  slot->snr  = snr;
+  slot->len  = len;
+  slot->sent = false;
+  memcpy(slot->data, data, len);
+  count++;
+  queued++;
+
+  topic->key     = key;
+  topic->frames += 1;
+  topic->bytes  += MQTTGW_FRAME_HEADER + len;
+  if (queued > stat.maxFill) {
+    stat.maxFill = queued;
+  }
+  return true;
+}
+
+MqttGateway::Topic* MqttGateway::findTopic(uint32_t key, bool create) {
+  Topic* free = NULL;
+
+  for (uint8_t i = 0; i < MQTTGW_MAX_TOPICS; i++) {
+    if (topics[i].frames == 0) {
+      if (!free) {
+        free = &topics[i];
+      }
+    } else if (topics[i].key == key) {
+      return &topics[i];
+    }
+  }
+  if (create && free) {
+    free->key    = key;
+    free->frames = 0;
+    free->bytes  = 0;
+    return free;
+  }
+  return NULL;
+}
+
+// ring full: the oldest frame goes (compact() keeps the first slot unsent)
+void MqttGateway::dropOldest() {
+  release(slots[first]);
+  first = (first + 1) % MQTTGW_SLOTS;
+  count--;
+  stat.dropped++;
+  compact();
+}
+
+void MqttGateway::release(Slot& slot) {
+  Topic* topic = findTopic(slot.key, false);
+
+  if (topic) {
+    topic->frames -= 1;
+    topic->bytes  -= MQTTGW_FRAME_HEADER + slot.len;
+  }
+  slot.sent = true;
+  queued--;
+}
+
+void MqttGateway::compact() {
+  while (count > 0 && slots[first].sent) {
+    first = (first + 1) % MQTTGW_SLOTS;
+    count--;
+  }
+}
+
+bool MqttGateway::publishTopic(Topic& topic, uint32_t now) {
+  char     name[MQTTGW_TOPIC_LEN];
+  uint8_t  used[MQTTGW_SLOTS];
+  uint8_t  n    = 0;
+  uint16_t pos  = MQTTGW_BATCH_HEADER;
+  uint32_t base = 0;
+  uint32_t key  = topic.key;
+
+  for (uint8_t i = 0; i < count; i++) {
+    uint8_t  idx  = (first + i) % MQTTGW_SLOTS;
+    Slot&    slot = slots[idx];
+    uint32_t dt;
+
+    if (slot.sent || slot.key != key) {
+      continue;
+    }
+    if (n == 0) {
+      base = slot.time;
+    }
+    dt = slot.time - base;
+    if (pos + MQTTGW_FRAME_HEADER + slot.len > MQTTGW_MAX_BATCH || dt > 0xFFFF || n == 0xFF) {
+      break;    // rest goes with the next batch
+    }
+    batch[pos++] = dt >> 8;
+    batch[pos++] = dt & 0xFF;
+    batch[pos++] = slot.port;
+    batch[pos++] = (uint8_t) slot.rssi;
+    batch[pos++] = (uint8_t) slot.snr;
+    batch[pos++] = slot.len;
+    memcpy(&batch[pos], slot.data, slot.len);
+    pos += slot.len;
+    used[n++] = idx;
+  }
+  if (n == 0) {
+    return true;
+  }
+
+  uint32_t age = now - base;
+  batch[0] = MQTTGW_VERSION;
+  batch[1] = n;
+  batch[2] = (age >> 24) & 0xFF;
+  batch[3] = (age >> 16) & 0xFF;
+  batch[4] = (age >> 8) & 0xFF;
+  batch[5] = age & 0xFF;
+
+  topicName(key, name);
+  if (mqtt.publish(name, qos, false, (const char*) batch, pos) == 0) {
+    stat.failed++;
+    return false;
+  }
+  for (uint8_t i = 0; i < n; i++) {
+    release(slots[used[i]]);
+  }
+  stat.published += n;
+  stat.batches++;
+  return true;
+}
+
+void MqttGateway::topicName(uint32_t key, char* name) const {
+  if (key == KEY_LORAWAN) {
+    snprintf(name, MQTTGW_TOPIC_LEN, "%s/lorawan", prefix);
+  } else {
+    snprintf(name, MQTTGW_TOPIC_LEN, "%s/radiolink/%02X-%04X", prefix,
+             (unsigned) ((key >> 16) & 0xFF), (unsigned) (key & 0xFFFF));
+  }
+}
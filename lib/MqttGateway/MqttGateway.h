@@ -0,0 +1,121 @@
+// On-node radio -> MQTT gateway (ESP32 with WiMOD module and Wi-Fi)
+//
+// - the radio RX callbacks (LoRaWAN RxUData / RxCData, RadioLink U-Data /
+//   C-Data) hand their frame to push...(): it is copied into a slot ring
+//   together with port, RSSI / SNR and the receive time; no network I/O,
+//   no allocation, so the RX path never blocks
+// - process() (from loop(), same task as wimod.Process()) publishes the
+//   frames batched per topic:
+//     <prefix>/lorawan                      all LoRaWAN frames
+//     <prefix>/radiolink/<group>-<device>   RadioLink frames per sender (hex)
+//   a topic is flushed when its oldest frame is flushMs old or its batch is
+//   full
+// - while the broker is unreachable the frames stay in the ring; when it
+//   is full the oldest frame is dropped
+//
+// Batch payload (big endian):
+//
+//   | version (1) | count | age of the first frame at publish [ms] (32 bit) |
+//   | dt [ms] (16 bit) | port | rssi | snr | len | payload ... |  (count times)
+//
+//   dt is the receive time relative to the first frame. The receiver gets
+//   the absolute receive time as (arrival - age + dt), no clock needed on
+//   the node. rssi / snr are signed, 0 = not reported. port is 0 for
+//   RadioLink.
+
+#ifndef MQTT_GATEWAY_H
+#define MQTT_GATEWAY_H
+
+#include <Arduino.h>
+#include <AsyncMqttClient.h>
+#include <SAP/WiMOD_SAP_LORAWAN_IDs.h>
+#include <SAP/WiMOD_SAP_RadioLink_IDs.h>
+
+#ifndef MQTTGW_SLOTS
+#define MQTTGW_SLOTS          32    // buffered frames
+#endif
+#ifndef MQTTGW_MAX_FRAME
+#define MQTTGW_MAX_FRAME      WiMODLORAWAN_APP_PAYLOAD_LEN
+#endif
+#ifndef MQTTGW_MAX_BATCH
+#define MQTTGW_MAX_BATCH      512   // bytes per publish
+#endif
+#define MQTTGW_MAX_TOPICS     8     // topics with pending frames
+#define MQTTGW_TOPIC_LEN      64
+#define MQTTGW_VERSION        1
+#define MQTTGW_BATCH_HEADER   6
+#define MQTTGW_FRAME_HEADER   6
+
+typedef struct MqttGatewayStats {
+  uint32_t received;      // frames pushed
+  uint32_t published;     // frames published
+  uint32_t batches;       // publishes
+  uint32_t dropped;       // oldest frames dropped, ring full
+  uint32_t oversize;      // frames longer than MQTTGW_MAX_FRAME
+  uint32_t noTopic;       // frames dropped, too many topics pending
+  uint32_t failed;        // publish() refused, retried later
+  uint8_t  maxFill;       // peak number of buffered frames
+} MqttGatewayStats;
+
+class MqttGateway {
+public:
+  MqttGateway(AsyncMqttClient& mqtt);
+
+  // topic prefix (kept as pointer), flush interval, QoS of the publishes
+  void begin(const char* prefix, uint16_t flushMs = 200, uint8_t qos = 0);
+
+  // RX path: copy only
+  bool pushLoRaWan(const TWiMODLORAWAN_RX_Data& rxData);
+  bool pushRadioLink(const TWiMODLR_RadioLink_Msg& rxMsg);
+
+  // loop(): publishes due batches
+  void process(uint32_t now);
+  // publish everything buffered now (e.g. before deep sleep)
+  void flush(uint32_t now);
+
+  uint8_t pending() const { return queued; }
+  const MqttGatewayStats& stats() const { return stat; }
+
+private:
+  typedef struct Slot {
+    uint32_t key;         // topic key
+    uint32_t time;        // millis() of reception
+    uint8_t  port;
+    int8_t   rssi;
+    int8_t   snr;
+    uint8_t  len;
+    bool     sent;        // published, waiting for the tail to pass
+    uint8_t  data[MQTTGW_MAX_FRAME];
+  } Slot;
+
+  typedef struct Topic {
+    uint32_t key;
+    uint8_t  frames;      // pending frames
+    uint16_t bytes;       // pending batch bytes without header
+  } Topic;
+
+  bool push(uint32_t key, uint8_t port, int8_t rssi, int8_t snr, const uint8_t* data, uint8_t len);
+  Topic* findTopic(uint32_t key, bool create);
+  void dropOldest();
+  void release(Slot& slot);
+  void compact();
+  bool publishTopic(Topic& topic, uint32_t now);
+  void topicName(uint32_t key, char* name) const;
+
+  AsyncMqttClient& mqtt;
+  const char* prefix;
+  uint16_t    flushMs;
+  uint8_t     qos;
+  bool        flushAll;
+
+  Slot     slots[MQTTGW_SLOTS];
+  uint8_t  first;         // oldest slot
+  uint8_t  count;         // slots from first, incl. sent ones
+  uint8_t  queued;        // not yet published
+  Topic    topics[MQTTGW_MAX_TOPICS];
+  uint8_t  batch[MQTTGW_MAX_BATCH];
+
+  MqttGatewayStats stat;
+};
+
+#endif
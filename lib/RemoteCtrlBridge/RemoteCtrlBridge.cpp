@@ -0,0 +1,216 @@
+#include "RemoteCtrlBridge.h"
+
+#include <string.h>
+
+RemoteCtrlBridge* RemoteCtrlBridge::instance = NULL;
+
+static uint32_t sourceKey(uint8_t group, uint16_t device) {
+  return ((uint32_t) group << 16) | device;
+}
+
+RemoteCtrlBridge::RemoteCtrlBridge(WiMODLRBASE_PLUS& wimod, AsyncMqttClient& mqtt)
+  : wimod(wimod), mqtt(mqtt), routes(NULL), numSources(0), holdOff(0), nextPending(0), lastProcess(0) {
+  mux = portMUX_INITIALIZER_UNLOCKED;
+  memset(pending, 0, sizeof(pending));
+  resetStats();
+}
+
+bool RemoteCtrlBridge::begin(const RemoteCtrlRoute* table, uint8_t count, uint16_t holdOffMs) {
+  routes     = table;
+  numSources = 0;
+  holdOff    = holdOffMs;
+
+  // compile: one Source per address, sorted by key, route index per bit
+  for (uint8_t i = 0; i < count; i++) {
+    uint32_t key = sourceKey(table[i].group, table[i].device);
+    Source*  src = findSource(key);
+
+    if (table[i].button >= RCB_BUTTONS) {
+      return false;
+    }
+    if (!src) {
+      uint8_t pos = numSources;
+
+      if (numSources >= RCB_MAX_SOURCES) {
+        return false;
+      }
+      while (pos > 0 && sources[pos - 1].key > key) {
+        sources[pos] = sources[pos - 1];
+        pos--;
+      }
+      src = &sources[pos];
+      memset(src, 0, sizeof(Source));
+      memset(src->route, RCB_NO_ROUTE, sizeof(src->route));
+      src->key = key;
+      numSources++;
+    }
+    if (src->route[table[i].button] != RCB_NO_ROUTE) {
+      return false;
+    }
+    src->route[table[i].button] = i;
+  }
+
+  instance = this;
+  wimod.RegisterBtnPressedClient(btnPressedInd);
+  mqtt.onPublish([this](uint16_t packetId) { onPublish(packetId); });
+  lastProcess = micros();
+  return true;
+}
+
+void RemoteCtrlBridge::process() {
+  uint32_t now = micros();
+
+  addSample(gap, now - lastProcess);
+  lastProcess = now;
+  wimod.Process();
+}
+
+uint32_t RemoteCtrlBridge::percentile(const RemoteCtrlHist& h, uint8_t pct) {
+  uint32_t need = ((uint64_t) h.count * pct + 99) / 100;
+  uint32_t sum  = 0;
+
+  if (h.count == 0) {
+    return 0;
+  }
+  for (uint8_t i = 0; i < RCB_HIST_BINS - 1; i++) {
+    sum += h.bins[i];
+    if (sum >= need) {
+      return 1UL << i;
+    }
+  }
+  return h.maxUs;
+}
+
+void RemoteCtrlBridge::printStats(Stream& out) const {
+  out.printf("presses=%lu published=%lu acked=%lu unrouted=%lu dup=%lu offline=%lu failed=%lu\n",
+             (unsigned long) stat.presses, (unsigned long) stat.published, (unsigned long) stat.acked,
+             (unsigned long) stat.unrouted, (unsigned long) stat.duplicates,
+             (unsigned long) stat.offline, (unsigned long) stat.failed);
+  printHist(out, "gap", gap);
+  printHist(out, "dispatch", dispatch);
+  printHist(out, "ack", ack);
+}
+
+void RemoteCtrlBridge::resetStats() {
+  memset(&gap, 0, sizeof(gap));
+  memset(&dispatch, 0, sizeof(dispatch));
+  portENTER_CRITICAL(&mux);
+  memset(&ack, 0, sizeof(ack));
+  memset(&stat, 0, sizeof(stat));
+  portEXIT_CRITICAL(&mux);
+}
+
+void RemoteCtrlBridge::btnPressedInd(TWiMODLR_HCIMessage& rxMsg) {
+  if (instance) {
+    instance->onBtnPressed(rxMsg);
+  }
+}
+
+// called from wimod.Process(): publish right here, not in the next loop()
+void RemoteCtrlBridge::onBtnPressed(TWiMODLR_HCIMessage& rxMsg) {
+  TWiMODLR_RemoteCtrl_BtnPressed btn;
+  uint32_t start = micros();
+  uint32_t now   = millis();
+  Source*  src;
+
+  if (!wimod.convert(rxMsg, &btn)) {
+    return;
+  }
+  stat.presses++;
+
+  src = findSource(sourceKey(btn.SourceGroupAddress, btn.SourceDeviceAddress));
+  for (uint8_t bit = 0; bit < RCB_BUTTONS; bit++) {
+    const RemoteCtrlRoute* route;
+    uint16_t packetId;
+
+    if (!(btn.ButtonBitmap & (1 << bit))) {
+      continue;
+    }
+    if (!src || src->route[bit] == RCB_NO_ROUTE) {
+      stat.unrouted++;
+      continue;
+    }
+    if (src->lastPress[bit] && now - src->lastPress[bit] < holdOff) {
+      stat.duplicates++;
+      continue;
+    }
+    src->lastPress[bit] = now ? now : 1;
+
+    if (!mqtt.connected()) {
+      stat.offline++;
+      continue;
+    }
+    route    = &routes[src->route[bit]];
+    packetId = mqtt.publish(route->topic, route->qos, false, route->payload);
+    if (packetId == 0) {
+      stat.failed++;
+      continue;
+    }
+    stat.published++;
+    addSample(dispatch, micros() - start);
+
+    // QoS 0 publishes return 1 and never get a PUBACK
+    if (route->qos > 0) {
+      portENTER_CRITICAL(&mux);
+      pending[nextPending].packetId = packetId;
+      pending[nextPending].start    = start;
+      nextPending = (nextPending + 1) % RCB_PENDING_ACKS;
+      portEXIT_CRITICAL(&mux);
+    }
+  }
+}
+
+// AsyncTCP task
+void RemoteCtrlBridge::onPublish(uint16_t packetId) {
+  uint32_t now = micros();
+
+  portENTER_CRITICAL(&mux);
+  for (uint8_t i = 0; i < RCB_PENDING_ACKS; i++) {
+    if (pending[i].packetId == packetId) {
+      pending[i].packetId = 0;
+      addSample(ack, now - pending[i].start);
+      stat.acked++;
+      break;
+    }
+  }
+  portEXIT_CRITICAL(&mux);
+}
+
+RemoteCtrlBridge::Source* RemoteCtrlBridge::findSource(uint32_t key) {
+  int16_t lo = 0;
+  int16_t hi = (int16_t) numSources - 1;
+
+  while (lo <= hi) {
+    int16_t mid = (lo + hi) / 2;
+
+    if (sources[mid].key == key) {
+      return &sources[mid];
+    }
+    if (sources[mid].key < key) {
+      lo = mid + 1;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  return NULL;
+}
+
+// bin i holds [2^(i-1), 2^i) us, bin 0 everything below 1 us
+void RemoteCtrlBridge::addSample(RemoteCtrlHist& h, uint32_t us) {
+  uint8_t bin = us ? 32 - __builtin_clz(us) : 0;
+
+  h.bins[min(bin, (uint8_t) (RCB_HIST_BINS - 1))]++;
+  h.count++;
+  if (us > h.maxUs) {
+    h.maxUs = us;
+  }
+}
+
+void RemoteCtrlBridge::printHist(Stream& out, const char* name, const RemoteCtrlHist& h) {
+  out.printf("%s: n=%lu p50<%lu p99<%lu max=%lu us |", name, (unsigned long) h.count,
+             (unsigned long) percentile(h, 50), (unsigned long) percentile(h, 99), (unsigned long) h.maxUs);
+  for (uint8_t i = 0; i < RCB_HIST_BINS; i++) {
+    out.printf(" %lu", (unsigned long) h.bins[i]);
+  }
+  out.println();
+}
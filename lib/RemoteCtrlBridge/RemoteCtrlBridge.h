@@ -0,0 +1,125 @@
+// RemoteCtrl button -> MQTT bridge (WiMOD LR-BASE PLUS firmware)
+//
+// - routes map (source group, source device, button bit) to an MQTT topic
+//   and payload; the table is a const array in flash, begin() compiles it
+//   into a sorted source index with one route slot per button bit, so a
+//   press is resolved with a binary search and a table read
+// - the publish is done in the BtnPressed indication callback itself, i.e.
+//   within the wimod.Process() call that decodes the HCI frame; call
+//   process() (which calls wimod.Process()) as often as possible and keep
+//   loop() free of delay()
+// - the same button reported again within the hold off time (RadioLink
+//   retransmissions) is published once
+// - latency histograms (power of 2 bins in us):
+//   - gap:       time between two process() calls, the worst case time a
+//                frame waits in the UART buffer
+//   - dispatch:  indication callback to publish() returned
+//   - ack:       indication callback to PUBACK from the broker (QoS 1)
+//   the time between the button press and the indication (airtime of the
+//   RemoteCtrl frame) is not visible to the host and not included
+
+#ifndef REMOTECTRL_BRIDGE_H
+#define REMOTECTRL_BRIDGE_H
+
+#include <Arduino.h>
+#include <AsyncMqttClient.h>
+#include <WiMODLR_BASE_PLUS.h>
+
+#ifndef RCB_MAX_SOURCES
+#define RCB_MAX_SOURCES       16
+#endif
+#define RCB_BUTTONS           8
+#define RCB_HIST_BINS         20    // 1 us .. 2^19 us (~0.5 s), last bin open
+#define RCB_PENDING_ACKS      8
+#define RCB_NO_ROUTE          0xFF
+
+// one entry of the route table
+typedef struct RemoteCtrlRoute {
+  uint8_t     group;      // source group address
+  uint16_t    device;     // source device address
+  uint8_t     button;     // bit of ButtonBitmap (0..7)
+  const char* topic;
+  const char* payload;
+  uint8_t     qos;        // 1 for ack latency
+} RemoteCtrlRoute;
+
+typedef struct RemoteCtrlHist {
+  uint32_t bins[RCB_HIST_BINS];
+  uint32_t count;
+  uint32_t maxUs;
+} RemoteCtrlHist;
+
+typedef struct RemoteCtrlBridgeStats {
+  uint32_t presses;       // BtnPressed indications
+  uint32_t published;     // publish() accepted by the client
+  uint32_t acked;         // PUBACKs matched
+  uint32_t unrouted;      // pressed bits without a route
+  uint32_t duplicates;    // suppressed by the hold off time
+  uint32_t offline;       // dropped, broker not connected
+  uint32_t failed;        // publish() refused
+} RemoteCtrlBridgeStats;
+
+class RemoteCtrlBridge {
+public:
+  RemoteCtrlBridge(WiMODLRBASE_PLUS& wimod, AsyncMqttClient& mqtt);
+
+  // routes must stay valid (static const table); returns false if the
+  // table has more sources than RCB_MAX_SOURCES, a bad button bit or a
+  // (source, button) routed twice
+  bool begin(const RemoteCtrlRoute* routes, uint8_t count, uint16_t holdOffMs = 250);
+
+  // runs wimod.Process(); presses are published from inside this call
+  void process();
+
+  const RemoteCtrlBridgeStats& stats() const { return stat; }
+  const RemoteCtrlHist& gapHist() const { return gap; }
+  const RemoteCtrlHist& dispatchHist() const { return dispatch; }
+  const RemoteCtrlHist& ackHist() const { return ack; }
+  // upper bound of the bin holding the pct percentile [us]
+  static uint32_t percentile(const RemoteCtrlHist& h, uint8_t pct);
+  void printStats(Stream& out) const;
+  void resetStats();
+
+private:
+  typedef struct Source {
+    uint32_t key;                       // group << 16 | device
+    uint8_t  route[RCB_BUTTONS];        // index into routes or RCB_NO_ROUTE
+    uint32_t lastPress[RCB_BUTTONS];    // millis()
+  } Source;
+
+  typedef struct PendingAck {
+    uint16_t packetId;
+    uint32_t start;                     // micros() of the indication
+  } PendingAck;
+
+  // the WiMOD callbacks are plain function pointers (no WIMOD_USE_CPP11),
+  // so there is one bridge instance
+  static void btnPressedInd(TWiMODLR_HCIMessage& rxMsg);
+  static RemoteCtrlBridge* instance;
+
+  void onBtnPressed(TWiMODLR_HCIMessage& rxMsg);
+  void onPublish(uint16_t packetId);
+  Source* findSource(uint32_t key);
+  static void addSample(RemoteCtrlHist& h, uint32_t us);
+  static void printHist(Stream& out, const char* name, const RemoteCtrlHist& h);
+
+  WiMODLRBASE_PLUS& wimod;
+  AsyncMqttClient&  mqtt;
+
+  const RemoteCtrlRoute* routes;
+  Source   sources[RCB_MAX_SOURCES];
+  uint8_t  numSources;
+  uint16_t holdOff;
+
+  PendingAck   pending[RCB_PENDING_ACKS];   // shared with the AsyncTCP task
+  uint8_t      nextPending;
+  portMUX_TYPE mux;
+  uint32_t     lastProcess;               // micros()
+
+  RemoteCtrlHist        gap;
+  RemoteCtrlHist        dispatch;
+  RemoteCtrlHist        ack;
+  RemoteCtrlBridgeStats stat;
+};
+
+#endif
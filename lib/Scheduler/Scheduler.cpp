@@ -0,0 +1,258 @@
+#include "Scheduler.h"
+
+#include <string.h>
+
+SchedTask::SchedTask(const char* name, SchedFunction fn, void* ctx)
+  : taskName(name), fn(fn), ctx(ctx), due(0), period(0), budgetUs(0),
+    next(NULL), prev(NULL), slot(NULL), link(NULL), listed(false) {
+  memset(&stat, 0, sizeof(stat));
+}
+
+Scheduler::Scheduler() : ready(NULL), tasks(NULL), tick(0), clock(0), lastMicros(0), lastRun(0), started(false),
+  current(NULL), retimed(false), busy(0), windowStart(0), lastLoad(0), maxLoad(0), maxGap(0) {
+  memset(wheel, 0, sizeof(wheel));
+}
+
+void Scheduler::begin() {
+  memset(wheel, 0, sizeof(wheel));
+  ready       = NULL;
+  tick        = 0;
+  clock       = 0;
+  lastMicros  = micros();
+  started     = false;
+  busy        = 0;
+  windowStart = 0;
+}
+
+uint64_t Scheduler::clockUs() {
+  uint32_t m = micros();
+
+  clock += (uint32_t) (m - lastMicros);
+  lastMicros = m;
+  return clock;
+}
+
+uint32_t Scheduler::now() {
+  return (uint32_t) (clockUs() / 1000);
+}
+
+void Scheduler::every(SchedTask& task, uint32_t periodMs, uint32_t phaseMs, uint32_t budgetUs) {
+  uint32_t n = now();
+
+  cancel(task);
+  task.period   = max(periodMs, (uint32_t) 1);
+  task.budgetUs = budgetUs;
+  task.due      = n - n % task.period + phaseMs % task.period;
+  if ((int32_t) (task.due - n) < 0) {
+    task.due += task.period;
+  }
+  insert(task);
+}
+
+void Scheduler::after(SchedTask& task, uint32_t delayMs, uint32_t budgetUs) {
+  cancel(task);
+  task.period   = 0;
+  task.budgetUs = budgetUs;
+  // at least the next ms, a task re-arming itself with 0 must not keep
+  // run() from returning
+  task.due      = now() + max(delayMs, (uint32_t) 1);
+  insert(task);
+}
+
+void Scheduler::cancel(SchedTask& task) {
+  if (&task == current) {
+    retimed = true;
+  }
+  unlink(task);
+}
+
+uint32_t Scheduler::run() {
+  uint32_t start = micros();
+  uint32_t nowMs;
+
+  if (started && start - lastRun > maxGap) {
+    maxGap = start - lastRun;
+  }
+  started = true;
+  lastRun = start;
+
+  advance(now());
+
+  nowMs = (uint32_t) (clock / 1000);
+  if (nowMs - windowStart >= SCHED_LOAD_WINDOW) {
+    // busy us per elapsed ms = 0.1 % units
+    lastLoad    = min(busy / (nowMs - windowStart), (uint32_t) 1000);
+    maxLoad     = max(maxLoad, lastLoad);
+    busy        = 0;
+    windowStart = nowMs;
+  }
+
+  // next level 0 timer or cascade, whichever comes first
+  for (uint32_t i = 1; i <= SCHED_WHEEL_SIZE; i++) {
+    if (wheel[0][(tick + i) & SCHED_WHEEL_MASK] || ((tick + i) & SCHED_WHEEL_MASK) == 0) {
+      return i;
+    }
+  }
+  return SCHED_WHEEL_SIZE;
+}
+
+void Scheduler::advance(uint32_t to) {
+  while (ready) {
+    SchedTask* t = ready;
+
+    unlink(*t);
+    execute(*t);
+  }
+
+  while ((int32_t) (to - tick) > 0) {
+    tick++;
+    if ((tick & ((1UL << (2 * SCHED_WHEEL_BITS)) - 1)) == 0) {
+      cascade(2, tick);
+    }
+    if ((tick & SCHED_WHEEL_MASK) == 0) {
+      cascade(1, tick);
+    }
+
+    SchedTask** slot = &wheel[0][tick & SCHED_WHEEL_MASK];
+
+    while (*slot) {
+      SchedTask* t = *slot;
+
+      unlink(*t);
+      push(&ready, *t);
+    }
+    while (ready) {
+      SchedTask* t = ready;
+
+      unlink(*t);
+      execute(*t);
+    }
+  }
+}
+
+// re-files the timers of the level slot that comes round at ms "at"
+void Scheduler::cascade(uint8_t level, uint32_t at) {
+  SchedTask** slot = &wheel[level][(at >> (level * SCHED_WHEEL_BITS)) & SCHED_WHEEL_MASK];
+  SchedTask*  list = *slot;
+
+  *slot = NULL;
+  while (list) {
+    SchedTask* t = list;
+
+    list    = t->next;
+    t->slot = NULL;
+    insert(*t);
+  }
+}
+
+void Scheduler::insert(SchedTask& task) {
+  int32_t delta = (int32_t) (task.due - tick);
+
+  track(task);
+  if (delta <= 0) {
+    push(&ready, task);
+  } else if (delta < SCHED_WHEEL_SIZE) {
+    push(&wheel[0][task.due & SCHED_WHEEL_MASK], task);
+  } else if (delta < (1L << (2 * SCHED_WHEEL_BITS))) {
+    push(&wheel[1][(task.due >> SCHED_WHEEL_BITS) & SCHED_WHEEL_MASK], task);
+  } else if (delta < (1L << (3 * SCHED_WHEEL_BITS))) {
+    push(&wheel[2][(task.due >> (2 * SCHED_WHEEL_BITS)) & SCHED_WHEEL_MASK], task);
+  } else {
+    // parked in the slot that comes round last, re-filed from there
+    push(&wheel[2][((tick >> (2 * SCHED_WHEEL_BITS)) - 1) & SCHED_WHEEL_MASK], task);
+  }
+}
+
+void Scheduler::unlink(SchedTask& task) {
+  if (task.slot == NULL) {
+    return;
+  }
+  if (task.prev) {
+    task.prev->next = task.next;
+  } else {
+    *task.slot = task.next;
+  }
+  if (task.next) {
+    task.next->prev = task.prev;
+  }
+  task.next = NULL;
+  task.prev = NULL;
+  task.slot = NULL;
+}
+
+void Scheduler::push(SchedTask** list, SchedTask& task) {
+  task.prev = NULL;
+  task.next = *list;
+  if (*list) {
+    (*list)->prev = &task;
+  }
+  *list     = &task;
+  task.slot = list;
+}
+
+void Scheduler::execute(SchedTask& task) {
+  uint64_t start = clockUs();
+  uint32_t nowMs = (uint32_t) (start / 1000);
+  uint32_t late  = (nowMs - task.due) * 1000 + (uint32_t) (start % 1000);
+  uint32_t runUs;
+
+  current = &task;
+  retimed = false;
+  task.fn(task.ctx);
+  current = NULL;
+  runUs = (uint32_t) (clockUs() - start);
+
+  task.stat.runs++;
+  task.stat.totalLateUs += late;
+  task.stat.totalRunUs  += runUs;
+  task.stat.maxLateUs = max(task.stat.maxLateUs, late);
+  task.stat.maxRunUs  = max(task.stat.maxRunUs, runUs);
+  if (task.budgetUs && runUs > task.budgetUs) {
+    task.stat.overruns++;
+  }
+  busy += runUs;
+
+  // periodic and not re-timed / cancelled by its function: next phase point
+  if (task.period && !retimed) {
+    task.due += task.period;
+    nowMs = now();
+    if ((int32_t) (task.due - nowMs) < 0) {
+      uint32_t missed = (nowMs - task.due) / task.period + 1;
+
+      task.stat.skipped += missed;
+      task.due += missed * task.period;
+    }
+    insert(task);
+  }
+}
+
+void Scheduler::track(SchedTask& task) {
+  if (!task.listed) {
+    task.link   = tasks;
+    tasks       = &task;
+    task.listed = true;
+  }
+}
+
+void Scheduler::printStats(Stream& out) const {
+  out.printf("sched: load=%u.%u%% peak=%u.%u%% max gap=%lu us\n", lastLoad / 10, lastLoad % 10,
+             maxLoad / 10, maxLoad % 10, (unsigned long) maxGap);
+  for (const SchedTask* t = tasks; t; t = t->link) {
+    const SchedTaskStats& s = t->stat;
+
+    out.printf("  %s: period=%lu runs=%lu skipped=%lu late avg=%lu max=%lu us, run avg=%lu max=%lu us, overruns=%lu\n",
+               t->taskName, (unsigned long) t->period, (unsigned long) s.runs, (unsigned long) s.skipped,
+               (unsigned long) (s.runs ? s.totalLateUs / s.runs : 0), (unsigned long) s.maxLateUs,
+               (unsigned long) (s.runs ? s.totalRunUs / s.runs : 0), (unsigned long) s.maxRunUs,
+               (unsigned long) s.overruns);
+  }
+}
+
+void Scheduler::resetStats() {
+  for (SchedTask* t = tasks; t; t = t->link) {
+    memset(&t->stat, 0, sizeof(t->stat));
+  }
+  lastLoad = 0;
+  maxLoad  = 0;
+  maxGap   = 0;
+}
@@ -0,0 +1,125 @@
+// Cooperative scheduler for the sketches (periodic and one shot tasks)
+//
+// - tasks are run from run(), called from loop() next to the network
+//   process() calls; a task must not block (read what is there, start a
+//   conversion and come back with after())
+// - periodic tasks run at a fixed phase: at phase + k * period ms on the
+//   scheduler clock (0 at begin()), independent of how late the previous
+//   run was; periods missed completely are skipped (and counted), never
+//   run back to back
+// - timers are kept in a hierarchical timer wheel, 3 levels of 64 slots
+//   (1 ms, 64 ms, 4096 ms): start / cancel are O(1), run() costs O(1) per
+//   elapsed ms plus a cascade every 64 ms; timers further out than ~262 s
+//   are parked in the last level and re-filed when it comes round
+// - measured per task: lateness (jitter, start - due time), run time,
+//   runs over the task budget; per scheduler: busy time (load) and the
+//   largest gap between two run() calls, which bounds the jitter of all
+//   tasks (keep the rest of loop() short)
+//
+// The clock is micros() based, it does not wrap like millis() % period.
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+
+#define SCHED_WHEEL_BITS      6
+#define SCHED_WHEEL_SIZE      (1 << SCHED_WHEEL_BITS)
+#define SCHED_WHEEL_MASK      (SCHED_WHEEL_SIZE - 1)
+#define SCHED_LEVELS          3
+#define SCHED_LOAD_WINDOW     1000  // ms
+
+typedef void (*SchedFunction)(void* ctx);
+
+typedef struct SchedTaskStats {
+  uint32_t runs;
+  uint32_t skipped;       // periods missed completely
+  uint32_t overruns;      // run time > budget
+  uint32_t maxLateUs;
+  uint32_t maxRunUs;
+  uint64_t totalLateUs;
+  uint64_t totalRunUs;
+} SchedTaskStats;
+
+class SchedTask {
+public:
+  SchedTask(const char* name, SchedFunction fn, void* ctx = NULL);
+
+  bool active() const { return slot != NULL; }
+  const char* name() const { return taskName; }
+  const SchedTaskStats& stats() const { return stat; }
+
+private:
+  friend class Scheduler;
+
+  const char*    taskName;
+  SchedFunction  fn;
+  void*          ctx;
+  uint32_t       due;       // scheduler ms
+  uint32_t       period;    // 0: one shot
+  uint32_t       budgetUs;  // 0: none
+  SchedTask*     next;
+  SchedTask*     prev;
+  SchedTask**    slot;      // list the task is in, NULL if not scheduled
+  SchedTask*     link;      // list of all tasks ever scheduled, for the stats
+  bool           listed;
+  SchedTaskStats stat;
+};
+
+class Scheduler {
+public:
+  Scheduler();
+
+  // starts the clock; call in setup() before every() / after()
+  void begin();
+
+  // runs fn at phaseMs + k * periodMs (phaseMs < periodMs), the first time
+  // at the next such point; a running task is re-timed
+  void every(SchedTask& task, uint32_t periodMs, uint32_t phaseMs = 0, uint32_t budgetUs = 0);
+  // runs fn once, delayMs (at least 1) from now
+  void after(SchedTask& task, uint32_t delayMs, uint32_t budgetUs = 0);
+  void cancel(SchedTask& task);
+
+  // runs the due tasks; returns ms until the next timer (at most 64), e.g.
+  // for a light sleep
+  uint32_t run();
+
+  // scheduler clock [ms] since begin()
+  uint32_t now();
+
+  // busy time of the tasks in the last completed window, 0.1 % units
+  uint16_t load() const { return lastLoad; }
+  uint16_t peakLoad() const { return maxLoad; }
+  uint32_t maxGapUs() const { return maxGap; }
+  void printStats(Stream& out) const;
+  void resetStats();
+
+private:
+  void advance(uint32_t to);
+  void insert(SchedTask& task);
+  void unlink(SchedTask& task);
+  void push(SchedTask** list, SchedTask& task);
+  void cascade(uint8_t level, uint32_t at);
+  void execute(SchedTask& task);
+  void track(SchedTask& task);
+  uint64_t clockUs();
+
+  SchedTask* wheel[SCHED_LEVELS][SCHED_WHEEL_SIZE];
+  SchedTask* ready;         // due, to run in this run()
+  SchedTask* tasks;         // all tasks, for printStats()
+  uint32_t   tick;          // last ms the wheel was advanced to
+  uint64_t   clock;         // us since begin()
+  uint32_t   lastMicros;
+  uint32_t   lastRun;       // micros() of the last run() call
+  bool       started;
+  SchedTask* current;       // task being executed
+  bool       retimed;       // current re-timed or cancelled by its function
+
+  uint32_t   busy;          // us in the current window
+  uint32_t   windowStart;   // ms
+  uint16_t   lastLoad;
+  uint16_t   maxLoad;
+  uint32_t   maxGap;
+};
+
+#endif
@@ -0,0 +1,92 @@
+// Filter / hysteresis stage between a sensor task and an actuator
+//
+//   raw -> MedianFilter3 (drops single spikes) -> EmaFilter (smooths)
+//       -> Hysteresis (two thresholds + dwell time) -> actuate on change
+//
+// Hysteresis::update() returns true only when the state changes, so the
+// actuator (HTTP, MQTT) is only called on a change and not per sample.
+
+#ifndef SIGNAL_FILTER_H
+#define SIGNAL_FILTER_H
+
+#include <Arduino.h>
+
+class MedianFilter3 {
+public:
+  MedianFilter3() : n(0) {}
+
+  float update(float v) {
+    if (n == 0) {
+      s[0] = s[1] = s[2] = v;
+    }
+    s[n++ % 3] = v;
+    float lo = min(s[0], s[1]);
+    float hi = max(s[0], s[1]);
+    return max(lo, min(hi, s[2]));
+  }
+
+private:
+  float    s[3];
+  uint32_t n;
+};
+
+class EmaFilter {
+public:
+  // alpha 0..1, weight of the new sample
+  EmaFilter(float alpha) : alpha(alpha), primed(false), y(0) {}
+
+  float update(float v) {
+    y = primed ? y + alpha * (v - y) : v;
+    primed = true;
+    return y;
+  }
+  float value() const { return y; }
+
+private:
+  float alpha;
+  bool  primed;
+  float y;
+};
+
+class Hysteresis {
+public:
+  // state becomes true above high, false below low; a crossing must hold
+  // for dwellMs before the state changes
+  Hysteresis(float low, float high, uint32_t dwellMs = 0, bool initial = false)
+    : low(low), high(high), dwell(dwellMs), on(initial), pending(false), since(0), changes(0) {}
+
+  // true if the state changed
+  bool update(float v, uint32_t nowMs) {
+    bool crossed = on ? v < low : v > high;
+
+    if (!crossed) {
+      pending = false;
+      return false;
+    }
+    if (!pending) {
+      pending = true;
+      since   = nowMs;
+    }
+    if (nowMs - since < dwell) {
+      return false;
+    }
+    on      = !on;
+    pending = false;
+    changes++;
+    return true;
+  }
+
+  bool state() const { return on; }
+  uint32_t numChanges() const { return changes; }
+
+private:
+  float    low;
+  float    high;
+  uint32_t dwell;
+  bool     on;
+  bool     pending;
+  uint32_t since;
+  uint32_t changes;
+};
+
+#endif
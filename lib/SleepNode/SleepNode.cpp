@@ -0,0 +1,154 @@
+#include "SleepNode.h"
+
+#include <string.h>
+#include <time.h>
+#include <esp_sleep.h>
+#include <esp32/rtc.h>
+
+SleepNode::SleepNode(SleepNodeState& state, const SleepNodeConfig& config)
+  : st(state), cfg(config), radioStart(0), radioMs(0) {}
+
+// RTC timer: runs in deep sleep, unlike esp_timer / millis() not reset by
+// a wake, unlike gettimeofday() not stepped by NTP
+uint64_t SleepNode::rtcUs() {
+  return esp_rtc_get_time_us();
+}
+
+uint8_t SleepNode::capacity() const {
+  return constrain(cfg.batchSize, (uint8_t) 1, (uint8_t) SLEEPN_MAX_SAMPLES);
+}
+
+bool SleepNode::begin() {
+  uint64_t now   = rtcUs();
+  uint64_t start = now - (uint64_t) millis() * 1000;   // app start
+
+  radioMs = 0;
+  if (esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_TIMER || st.magic != SLEEPN_MAGIC) {
+    memset(&st, 0, sizeof(st));
+    st.magic      = SLEEPN_MAGIC;
+    st.nextWakeUs = now;
+    st.stat.wakes = 1;
+    return true;
+  }
+
+  // deep sleep ends with the wake, the ROM boot is counted as awake
+  uint32_t gap = start > st.sleepStartUs ? (uint32_t) ((start - st.sleepStartUs) / 1000) : 0;
+  uint32_t slept = gap > cfg.bootMs ? gap - cfg.bootMs : 0;
+
+  st.stat.sleepMs  += slept;
+  st.stat.chargeNc += (uint64_t) slept * cfg.sleepUa;
+  st.stat.wakes++;
+  return false;
+}
+
+void SleepNode::add(const float* values, uint8_t numFields) {
+  time_t now = time(NULL);
+
+  numFields = min(numFields, (uint8_t) SLEEPN_MAX_FIELDS);
+  if (st.count == 0) {
+    st.numFields = numFields;
+  }
+  // sends failed: the oldest sample makes room
+  if (st.count >= capacity()) {
+    memmove(&st.samples[0], &st.samples[1], (st.count - 1) * sizeof(SleepNodeSample));
+    st.count--;
+    st.stat.dropped++;
+  }
+
+  SleepNodeSample& s = st.samples[st.count++];
+
+  s.time  = now > 1600000000 ? (uint32_t) now : (uint32_t) (rtcUs() / 1000000);
+  s.rtcMs = (uint32_t) (rtcUs() / 1000);
+  memset(s.values, 0, sizeof(s.values));
+  memcpy(s.values, values, min(numFields, st.numFields) * sizeof(float));
+  st.stat.samples++;
+}
+
+bool SleepNode::sendDue() {
+  uint64_t now = rtcUs();
+
+  if (st.count == 0 || (st.failures && now < st.retryUs)) {
+    return false;
+  }
+  return st.count >= capacity() || (uint32_t) (now / 1000) - st.samples[0].rtcMs >= cfg.deadlineMs;
+}
+
+void SleepNode::sent(bool ok) {
+  if (ok) {
+    st.stat.chargeNc += (uint64_t) cfg.sendUc * 1000;
+    st.count    = 0;
+    st.failures = 0;
+    st.stat.sends++;
+    return;
+  }
+
+  uint64_t backoff = (uint64_t) cfg.periodMs << min(st.failures, (uint8_t) 16);
+
+  st.failures++;
+  st.stat.sendFailures++;
+  st.retryUs = rtcUs() + min(backoff, (uint64_t) cfg.deadlineMs) * 1000;
+}
+
+void SleepNode::radioOn() {
+  radioStart = millis();
+}
+
+void SleepNode::radioOff() {
+  radioMs += millis() - radioStart;
+}
+
+void SleepNode::sleep() {
+  uint32_t awake  = cfg.bootMs + millis();
+  uint64_t period = (uint64_t) cfg.periodMs * 1000;
+  uint64_t now;
+
+  radioMs = min(radioMs, awake);
+  st.stat.lastAwakeMs = awake;
+  st.stat.lastRadioMs = radioMs;
+  st.stat.awakeMs  += awake;
+  st.stat.radioMs  += radioMs;
+  st.stat.chargeNc += (uint64_t) (awake - radioMs) * cfg.activeMa * 1000 + (uint64_t) radioMs * cfg.radioMa * 1000;
+
+  now = rtcUs();
+  st.nextWakeUs += period;
+  if (st.nextWakeUs < now + SLEEPN_MIN_SLEEP_US) {
+    uint64_t missed = (now + SLEEPN_MIN_SLEEP_US - st.nextWakeUs) / period + 1;
+
+    st.stat.skipped += (uint32_t) missed;
+    st.nextWakeUs   += missed * period;
+  }
+  st.sleepStartUs = now;
+
+  esp_sleep_enable_timer_wakeup(st.nextWakeUs - now);
+  esp_deep_sleep_start();
+}
+
+// average over awake and sleep time of the completed wakes
+uint32_t SleepNode::averageUa() const {
+  uint64_t ms = st.stat.awakeMs + st.stat.sleepMs;
+
+  return ms ? (uint32_t) (st.stat.chargeNc / ms) : 0;
+}
+
+uint32_t SleepNode::chargePerSampleUc() const {
+  return st.stat.samples ? (uint32_t) (st.stat.chargeNc / 1000 / st.stat.samples) : 0;
+}
+
+uint32_t SleepNode::batteryLifeHours() const {
+  uint32_t ua = averageUa();
+
+  return ua ? (uint32_t) ((uint64_t) cfg.batteryMah * 1000 / ua) : 0;
+}
+
+void SleepNode::printStats(Stream& out) const {
+  const SleepNodeStats& s = st.stat;
+
+  out.printf("sleep: wakes=%lu samples=%lu queued=%u sends=%lu failed=%lu dropped=%lu skipped=%lu\n",
+             (unsigned long) s.wakes, (unsigned long) s.samples, st.count, (unsigned long) s.sends,
+             (unsigned long) s.sendFailures, (unsigned long) s.dropped, (unsigned long) s.skipped);
+  out.printf("  last wake: awake=%lu ms radio=%lu ms; total awake=%lu s radio=%lu s sleep=%lu s\n",
+             (unsigned long) s.lastAwakeMs, (unsigned long) s.lastRadioMs, (unsigned long) (s.awakeMs / 1000),
+             (unsigned long) (s.radioMs / 1000), (unsigned long) (s.sleepMs / 1000));
+  out.printf("  estimate: avg=%lu uA, %lu uC per sample, %lu h on %u mAh\n", (unsigned long) averageUa(),
+             (unsigned long) chargePerSampleUc(), (unsigned long) batteryLifeHours(), cfg.batteryMah);
+}
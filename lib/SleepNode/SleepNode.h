@@ -0,0 +1,127 @@
+// Deep sleep duty cycle for battery nodes
+//
+// The ESP32 sleeps between samples and only powers the radio to send:
+//
+//   timer wake -> setup(): begin(), sample, add()
+//     -> sendDue()? radioOn(), connect + send the batch, radioOff(), sent(ok)
+//     -> sleep() (never returns, the next wake starts in setup() again)
+//
+// - the batch, schedule and statistics are a plain struct the sketch puts
+//   in RTC slow memory (RTC_DATA_ATTR); it survives deep sleep but not a
+//   power loss, begin() starts over after any other reset. No constructor
+//   in there: a global object would be re-initialised on every wake
+// - wakes are on a fixed schedule, first wake + k * period on the RTC
+//   timer (keeps running in deep sleep, not moved by NTP); the time spent
+//   awake does not add to the period, periods missed are skipped
+// - a batch is sent when it is full or its oldest sample reaches the
+//   deadline; after a failed send the samples are kept (the oldest is
+//   dropped when the batch overflows) and the next attempt backs off,
+//   period * 2^n up to the deadline, so a missing AP / gateway does not
+//   cost a connect per wake
+// - there is no current sensor: the charge is estimated from the time in
+//   each phase (boot, awake, radio on, deep sleep) and the board currents
+//   in SleepNodeConfig, plus a fixed charge per send for a radio that
+//   transmits on its own (LoRaWAN module). Reported are the average
+//   current, the charge per sample and the battery life this gives.
+
+#ifndef SLEEP_NODE_H
+#define SLEEP_NODE_H
+
+#include <Arduino.h>
+
+#ifndef SLEEPN_MAX_SAMPLES
+#define SLEEPN_MAX_SAMPLES    16
+#endif
+#define SLEEPN_MAX_FIELDS     4
+#define SLEEPN_MIN_SLEEP_US   10000   // a wake closer than this is skipped
+#define SLEEPN_MAGIC          0x534c4e31
+
+typedef struct SleepNodeConfig {
+  uint32_t periodMs;      // sample period
+  uint8_t  batchSize;     // send at this many samples (<= SLEEPN_MAX_SAMPLES)
+  uint32_t deadlineMs;    // or when the oldest sample is this old
+  uint16_t bootMs;        // wake to setup(), not seen by millis()
+  uint16_t activeMa;      // awake, radio off
+  uint16_t radioMa;       // awake, radio on (Wi-Fi connect / TX, HCI)
+  uint16_t sleepUa;       // deep sleep, whole board incl. sensors / module
+  uint32_t sendUc;        // per send, drawn outside the awake time [uC]
+  uint16_t batteryMah;
+} SleepNodeConfig;
+
+typedef struct SleepNodeSample {
+  uint32_t time;          // unix s if the clock was set, else s of RTC time
+  uint32_t rtcMs;         // for the deadline
+  float    values[SLEEPN_MAX_FIELDS];
+} SleepNodeSample;
+
+typedef struct SleepNodeStats {
+  uint32_t wakes;
+  uint32_t samples;
+  uint32_t sends;
+  uint32_t sendFailures;
+  uint32_t dropped;       // oldest samples lost while sends failed
+  uint32_t skipped;       // wakes missed, awake for longer than a period
+  uint32_t lastAwakeMs;
+  uint32_t lastRadioMs;
+  uint64_t awakeMs;       // incl. boot
+  uint64_t radioMs;
+  uint64_t sleepMs;
+  uint64_t chargeNc;      // estimated, uA * ms
+} SleepNodeStats;
+
+// lives in RTC slow memory, see above
+typedef struct SleepNodeState {
+  uint32_t        magic;
+  uint8_t         count;
+  uint8_t         numFields;
+  uint8_t         failures;     // sends failed in a row
+  uint64_t        nextWakeUs;   // RTC time
+  uint64_t        sleepStartUs;
+  uint64_t        retryUs;      // no send attempt before
+  SleepNodeSample samples[SLEEPN_MAX_SAMPLES];
+  SleepNodeStats  stat;
+} SleepNodeState;
+
+class SleepNode {
+public:
+  SleepNode(SleepNodeState& state, const SleepNodeConfig& config);
+
+  // first thing in setup(); accounts the sleep just ended. Returns true
+  // after a cold boot (state cleared), false after a timer wake
+  bool begin();
+
+  // one reading, numFields values (the same for all samples)
+  void add(const float* values, uint8_t numFields);
+
+  // batch full or deadline reached, and not backing off
+  bool sendDue();
+  uint8_t count() const { return st.count; }
+  uint8_t numFields() const { return st.numFields; }
+  const SleepNodeSample& sample(uint8_t i) const { return st.samples[i]; }
+  // result of a send; ok clears the batch
+  void sent(bool ok);
+
+  // bracket the time the radio is powered
+  void radioOn();
+  void radioOff();
+
+  // accounts this wake and sleeps until the next period; does not return
+  void sleep();
+
+  const SleepNodeStats& stats() const { return st.stat; }
+  uint32_t averageUa() const;
+  uint32_t chargePerSampleUc() const;
+  uint32_t batteryLifeHours() const;
+  void printStats(Stream& out) const;
+
+private:
+  static uint64_t rtcUs();
+  uint8_t capacity() const;
+
+  SleepNodeState&        st;
+  const SleepNodeConfig& cfg;
+  uint32_t               radioStart;
+  uint32_t               radioMs;      // this wake
+};
+
+#endif
@@ -0,0 +1,81 @@
+#include "Telemetry.h"
+
+#include <math.h>
+#include <string.h>
+
+static void put16(uint8_t* p, uint16_t v) {
+  p[0] = v >> 8;
+  p[1] = v & 0xFF;
+}
+
+static void put32(uint8_t* p, uint32_t v) {
+  put16(p, v >> 16);
+  put16(p + 2, v & 0xFFFF);
+}
+
+TelemetryBatch::TelemetryBatch(const TelemetrySchema& schema, uint16_t deviceId, uint32_t intervalMs)
+  : schema(schema), deviceId(deviceId), capacity(TELEMETRY_MAX_SAMPLES), count(0), flags(0), baseTime(0) {
+  interval = min((intervalMs + 50) / 100, (uint32_t) 0xFFFF);
+}
+
+void TelemetryBatch::setCapacity(uint8_t samples, uint16_t maxBytes) {
+  uint16_t perSample = 2 * schema.numFields;
+  uint16_t fit = (maxBytes > TELEMETRY_HEADER && perSample > 0) ? (maxBytes - TELEMETRY_HEADER) / perSample : 0;
+
+  capacity = min(min(samples, (uint8_t) TELEMETRY_MAX_SAMPLES), (uint8_t) min(fit, (uint16_t) 0xFF));
+  capacity = max(capacity, (uint8_t) 1);
+}
+
+bool TelemetryBatch::add(const float* values, uint32_t timeSec, bool unixTime) {
+  if (full() || schema.numFields > TELEMETRY_MAX_FIELDS) {
+    return false;
+  }
+  if (count == 0) {
+    baseTime = timeSec;
+    flags    = unixTime ? TELEMETRY_FLAG_UNIX : 0;
+  }
+  for (uint8_t f = 0; f < schema.numFields; f++) {
+    raw[f][count] = toRaw(values[f], schema.fields[f]);
+  }
+  count++;
+  return true;
+}
+
+uint16_t TelemetryBatch::encode(uint8_t* buf, uint16_t bufSize) const {
+  uint16_t pos = TELEMETRY_HEADER;
+
+  if (bufSize < encodedSize()) {
+    return 0;
+  }
+  buf[0] = TELEMETRY_VERSION;
+  buf[1] = schema.id;
+  put16(buf + 2, deviceId);
+  buf[4] = flags;
+  put32(buf + 5, baseTime);
+  put16(buf + 9, interval);
+  buf[11] = count;
+
+  for (uint8_t f = 0; f < schema.numFields; f++) {
+    for (uint8_t i = 0; i < count; i++) {
+      put16(buf + pos, (uint16_t) raw[f][i]);
+      pos += 2;
+    }
+  }
+  return pos;
+}
+
+int16_t TelemetryBatch::toRaw(float value, const TelemetryField& field) {
+  float v;
+
+  if (isnan(value)) {
+    return TELEMETRY_MISSING;
+  }
+  v = roundf((value - field.offset) * field.scale);
+  if (v > 32767.0f) {
+    return 32767;
+  }
+  if (v < -32767.0f) {
+    return -32767;   // -32768 is "missing"
+  }
+  return (int16_t) v;
+}
@@ -0,0 +1,79 @@
+// Versioned compact binary telemetry (several readings per MQTT publish)
+//
+// A batch holds N readings of one schema, taken at a fixed interval. The
+// values are stored as 16 bit fixed point, raw = round((value - offset) *
+// scale), and sent column by column (all samples of field 0, then field 1,
+// ...). Batch layout, big endian:
+//
+//   | version | schema id | device id (16 bit) | flags | base time [s] (32 bit) |
+//   | interval [100 ms] (16 bit) | count N |
+//   | field 0: N x int16 | field 1: N x int16 | ...
+//
+//   flags bit 0: base time is unix time (else seconds since boot of the
+//   node, the decoder then dates the last sample with the arrival time,
+//   minus the age MqttConnection appends to a replayed batch)
+//   sample i was taken at base time + i * interval
+//   raw -32768 marks a missing value (NaN)
+//
+// The schemas live in TelemetrySchemas.h; src/gen_telemetry_decoder.py
+// reads them and generates the Node-RED function node decoder.
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <Arduino.h>
+
+#define TELEMETRY_VERSION       1
+#define TELEMETRY_HEADER        12
+#ifndef TELEMETRY_MAX_SAMPLES
+#define TELEMETRY_MAX_SAMPLES   16
+#endif
+#define TELEMETRY_MAX_FIELDS    4
+#define TELEMETRY_FLAG_UNIX     0x01
+#define TELEMETRY_MISSING       (-32768)
+
+typedef struct TelemetryField {
+  const char* name;
+  float       scale;      // raw units per unit
+  float       offset;     // subtracted before scaling
+} TelemetryField;
+
+typedef struct TelemetrySchema {
+  uint8_t               id;
+  uint8_t               numFields;
+  const TelemetryField* fields;
+} TelemetrySchema;
+
+class TelemetryBatch {
+public:
+  TelemetryBatch(const TelemetrySchema& schema, uint16_t deviceId, uint32_t intervalMs);
+
+  // max. readings per batch, limited by TELEMETRY_MAX_SAMPLES and the
+  // payload size (e.g. MQTTC_MAX_PAYLOAD)
+  void setCapacity(uint8_t samples, uint16_t maxBytes);
+
+  // one reading, schema.numFields values; time of the first reading of a
+  // batch becomes its base time (unix seconds if unixTime, else uptime)
+  bool add(const float* values, uint32_t timeSec, bool unixTime);
+
+  bool full() const { return count >= capacity; }
+  uint8_t size() const { return count; }
+  uint16_t encodedSize() const { return TELEMETRY_HEADER + 2 * schema.numFields * count; }
+  // writes the batch; returns its length, 0 if buf is too small
+  uint16_t encode(uint8_t* buf, uint16_t bufSize) const;
+  void clear() { count = 0; }
+
+private:
+  static int16_t toRaw(float value, const TelemetryField& field);
+
+  const TelemetrySchema& schema;
+  uint16_t deviceId;
+  uint16_t interval;      // 100 ms
+  uint8_t  capacity;
+  uint8_t  count;
+  uint8_t  flags;
+  uint32_t baseTime;
+  int16_t  raw[TELEMETRY_MAX_FIELDS][TELEMETRY_MAX_SAMPLES];   // column per field
+};
+
+#endif
@@ -0,0 +1,38 @@
+// Telemetry schemas of the sketches
+//
+// Ids are never reused; a changed field list gets a new id. After editing
+// run "python3 src/gen_telemetry_decoder.py" to update the Node-RED
+// decoder in src/flows.json. Keep the { "name", scale, offset } layout, the
+// generator parses it.
+
+#ifndef TELEMETRY_SCHEMAS_H
+#define TELEMETRY_SCHEMAS_H
+
+#include "Telemetry.h"
+
+// mqtt_temp: BME280 temperature, 0.01 degC
+static const TelemetryField TEMP_FIELDS[] = {
+  { "temperature", 100, 0 },
+};
+static const TelemetrySchema TEMP_SCHEMA = { 1, sizeof(TEMP_FIELDS) / sizeof(TEMP_FIELDS[0]), TEMP_FIELDS };
+
+// mqtt_room: BME280 temperature 0.01 degC, humidity 0.01 %, pressure 1 Pa
+// (offset 100000 Pa: 67233 .. 132767 Pa fit in 16 bit)
+static const TelemetryField ROOM_FIELDS[] = {
+  { "temperature", 100, 0 },
+  { "humidity", 100, 0 },
+  { "pressure", 1, 100000 },
+};
+static const TelemetrySchema ROOM_SCHEMA = { 2, sizeof(ROOM_FIELDS) / sizeof(ROOM_FIELDS[0]), ROOM_FIELDS };
+
+// sleep_room, sleep_lorawan: as ROOM_FIELDS plus TSL2561 light, 2 lux
+// (0 .. 65534 lux; NaN if the sensor is missing)
+static const TelemetryField ROOM_LUX_FIELDS[] = {
+  { "temperature", 100, 0 },
+  { "humidity", 100, 0 },
+  { "pressure", 1, 100000 },
+  { "light", 0.5, 0 },
+};
+static const TelemetrySchema ROOM_LUX_SCHEMA = { 3, sizeof(ROOM_LUX_FIELDS) / sizeof(ROOM_LUX_FIELDS[0]), ROOM_LUX_FIELDS };
+
+#endif
@@ -1,5 +1,6 @@
 #include <Arduino.h>
 #include <WiFi.h>
+#include <FastWiFi.h>
 #include <Adafruit_SSD1306.h>
 #include <Adafruit_GFX.h>
 
@@ -10,6 +11,7 @@
 
 #define OLED_RESET 0
 Adafruit_SSD1306 display(OLED_RESET);
+FastWiFi wifi(WIFI_SSID, WIFI_PASSWORD);   // cached AP + lease, scan only if that fails
 
 void setup() {
   Serial.begin(115200);
@@ -23,17 +25,11 @@ void setup() {
   display.println("Connecting...");
   display.display();
 
-  WiFi.mode(WIFI_STA);
-  WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+  Serial.println("Connecting to WiFi");
+  wifi.connect();
 
-  Serial.print("Connecting to WiFi");
-
-  while (WiFi.status() != WL_CONNECTED) {
-    delay(300);
-    Serial.print(".");
-  }
-
-  Serial.println("\nConnected!");
+  Serial.println("Connected!");
+  wifi.printTiming(Serial);
 
   
   String ip = WiFi.localIP().toString();
@@ -14,14 +14,33 @@ HardwareSerial loraSerial(2);
 #include <WiMODLoRaWAN.h> // make sure to use only the WiMODLoRaWAN.h, the WiMODLR_BASE.h must not be used for LoRaWAN firmware.
 WiMODLoRaWAN wimod(WIMOD_IF);
 
+//client side DR/power selection (ADR is off for this mobile node)
+#include <LoRaWAN/WiMODLoRaWAN_DataRatePlanner.h>
+WiMODLoRaWAN_DataRatePlanner drPlanner(wimod);
+
+//warm boot: skip reset/config/join when the module still has our config + session
+#include <Preferences.h>
+#include <LoRaWAN/WiMODLoRaWAN_WarmBoot.h>
+WiMODLoRaWAN_WarmBoot warmBoot(wimod);
+Preferences prefs;
+
+//GPS: only meaningful position changes are sent, several fixes per uplink
+#include <GpsTracker.h>
+#include <LoRaWAN/WiMODLoRaWAN_Region.h>
+#include <LoRaWAN/WiMODLoRaWAN_SplitSend.h>
+HardwareSerial gpsSerial(1);
+#define GPS_IF_RX 16
+#define GPS_IF_TX 17
+GpsTracker tracker(gpsSerial);
+WiMODLoRaWAN_SplitSender loraSender(wimod); //caches MaxPayloadSize, follows DR changes
+
 const unsigned char APPEUI[] = { 0xAB, 0xCD, 0xEF, 0x12, 0x34, 0x45, 0x67, 0x89 };
 const unsigned char APPKEY[] = { 0xAB, 0xCD, 0xEF, 0x12, 0x34, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF, 0x12, 0x34, 0x45, 0x67, 0x89 };
 
 //LoRa app
 boolean sendLora;
-unsigned long lastSent = 0;
-#define loraBytesSize 11
-byte loraBytes[loraBytesSize];
+boolean txSkipped = false; //payload limit too small for one fix, reported once
+#define GPS_PORT 0x02
 
 // Typedefs
 typedef enum TModemState {
@@ -68,7 +87,7 @@ void print_lora_config() {
   PC_IF.print("BandIndex: "); PC_IF.println(radioCfgnew.BandIndex);
 }
 
-void config_lora_radio() {
+void config_lora_radio(TWiMODLORAWAN_RadioStackConfig& radioCfg) {
   /* options
    * #define LORAWAN_STK_OPTION_ADR                  (0x01 << 0=00000001)                     Stack option ADR
    * #define LORAWAN_STK_OPTION_DUTY_CYCLE_CTRL      (0x01 << 1=00000010)                     Stack option Duty Cycle Control
@@ -78,11 +97,8 @@ void config_lora_radio() {
    * #define LORAWAN_STK_OPTION_EXT_PKT_FORMAT       (0x01 << 6=01000000)                     Stack option extended format
    * #define LORAWAN_STK_OPTION_MAC_CMD              (0x01 << 7=10000000)                     Stack option forwad MAC commands
    */
-  //print_lora_config();
-  TWiMODLORAWAN_RadioStackConfig radioCfg;
-  wimod.GetRadioStackConfig(&radioCfg);
-  TWiMODLRResultCodes res;
-  UINT8 sta;
+  //desired config only; it is written by warmBoot if the module does not have it yet
+  memset(&radioCfg, 0, sizeof(radioCfg));
   radioCfg.DataRateIndex = LoRaWAN_DataRate_EU868_LoRa_SF7_125kHz; //see TLoRaWANDataRate
   radioCfg.TXPowerLevel = 16; //from 0 to 20
   radioCfg.Options = LORAWAN_STK_OPTION_DUTY_CYCLE_CTRL; //| LORAWAN_STK_OPTION_ADR; //ADR off for non-stationary nodes=coverage mapping
@@ -90,8 +106,6 @@ void config_lora_radio() {
   radioCfg.Retransmissions = 7; //max number of retransmissions (for C-Data) to use
   radioCfg.BandIndex = LORAWAN_BAND_EU_868_RX2_SF9; //SF9BW125 is used for RX2 by TTN; alternative: LORAWAN_BAND_EU_868
   //radioCfg.HeaderMacCmdCapacity = 15;
-  // set new radio config
-  Serial.print("Radio config successful, when 100 shown: "); Serial.print(wimod.SetRadioStackConfig(&radioCfg, &res, &sta)); Serial.print(res); Serial.println(sta);
 
   /* Direct HCI instead of wimod.SetRadioStackConfig also working:
    *  Format: DataRate (DR3=SF9 DR5=SF7 ...), TXpower, options see above, PowerSaving Mode (1=on), Retransmissions, BandIndex, HeaderMacCmdCap
@@ -103,9 +117,6 @@ void config_lora_radio() {
   //05 10 02 01 07 01 0F   02 6C //SF7, ADR off
   //00 10 02 01 07 01 0F   A1 9C //SF12, ADR off
   //00 10 03 01 07 01 0F   E5 97 //SF12, ADR on*/
-  //optional: wimod.Process();
-  delay(500);
-  print_lora_config();
 }
 
 //join tx indication callback
@@ -128,6 +139,7 @@ void onJoinedNwk(TWiMODLR_HCIMessage& rxMsg) {
                 || (LORAWAN_JOIN_NWK_IND_FORMAT_STATUS_JOIN_OK_CH_INFO == joinedData.StatusFormat)){
             //Ok device is now joined to nwk (server)
             RIB.ModemState = ModemState_Connected;
+            prefs.putULong("cfghash", warmBoot.GetConfigHash()); //next boot can be a warm boot
 
             debugMsg(F("Device has joined a network.\n"));
             debugMsg(F("New Device address is: "));
@@ -149,6 +161,7 @@ void onRxData(TWiMODLR_HCIMessage& rxMsg) {
 
   // convert/copy the raw message to RX radio buffer
   if (wimod.convert(rxMsg, &radioRxMsg)) {
+  drPlanner.ProcessRxData(radioRxMsg);
 
   if (radioRxMsg.StatusFormat & LORAWAN_FORMAT_ACK_RECEIVED) { // this is an ack
     debugMsg(F("Ack-Packet received."));
@@ -172,6 +185,15 @@ void onRxData(TWiMODLR_HCIMessage& rxMsg) {
   }
 }
 
+//tx u-data indication callback
+void onTxUData(TWiMODLR_HCIMessage& rxMsg) {
+    TWiMODLORAWAN_TxIndData txInd;
+    if (wimod.convert(rxMsg, &txInd)) {
+        drPlanner.ProcessTxIndication(txInd, false);
+        loraSender.ProcessTxIndication(txInd);
+    }
+}
+
 
 void setup()
 {
@@ -179,73 +201,97 @@ void setup()
   pinMode(BUILTIN_LED, OUTPUT);
   PC_IF.begin(115200);
 
+  //GPS; 9600 baud NMEA, the UART buffer has to hold everything that arrives during the loop delay
+  gpsSerial.setRxBufferSize(1024);
+  gpsSerial.begin(9600, SERIAL_8N1, GPS_IF_RX, GPS_IF_TX);
+
   //LoRa
   WIMOD_IF.begin(WIMOD_LORAWAN_SERIAL_BAUDRATE, SERIAL_8N1, WIMOD_IF_RX, WIMOD_IF_TX); //rx tx
   wimod.begin(); // init the communication stack
-  delay(100); wimod.Reset(); delay(100); // do a software reset of the WiMOD
-  wimod.DeactivateDevice(); // deactivate device in order to get a clean start
-
-  // do a simple ping to check the local serial connection
-  debugMsg(F("Ping WiMOD: "));
-  if (wimod.Ping() != true) {
-      debugMsg(F("FAILED\n"));
-  } else {
-      debugMsg(F("OK. Starting join OTAA procedure...\n"));
-      config_lora_radio();
-  
-      //setup OTAA parameters
-      TWiMODLORAWAN_JoinParams joinParams;
-      memcpy(joinParams.AppEUI, APPEUI, 8);
-      memcpy(joinParams.AppKey, APPKEY, 16);
-      wimod.SetJoinParameter(joinParams);
-  
-      // Register callbacks for join related events
-      wimod.RegisterJoinedNwkIndicationClient(onJoinedNwk);
-      wimod.RegisterJoinTxIndicationClient(onJoinTx);
-      wimod.RegisterRxUDataIndicationClient(onRxData);
-      //wimod.RegisterRxCDataIndicationClient(onRxData);
-      //wimod.RegisterRxAckIndicationClient(onRxData);
-      //wimod.RegisterRxMacCmdIndicationClient(onRxData);
-  
-      // send join request
-      if (wimod.JoinNetwork()) {
-        RIB.ModemState = ModemState_ConnectRequestSent;
-        debugMsg(F("...waiting for nwk response...\n"));
-      } else {
-        debugMsg("Error sending join request: ");
-        debugMsg((int) wimod.GetLastResponseStatus());
-        debugMsg(F("\n"));
-      }
+
+  // Register callbacks for join related events
+  wimod.RegisterJoinedNwkIndicationClient(onJoinedNwk);
+  wimod.RegisterJoinTxIndicationClient(onJoinTx);
+  wimod.RegisterRxUDataIndicationClient(onRxData);
+  wimod.RegisterTxUDataIndicationClient(onTxUData);
+  //wimod.RegisterRxCDataIndicationClient(onRxData);
+  //wimod.RegisterRxAckIndicationClient(onRxData);
+  //wimod.RegisterRxMacCmdIndicationClient(onRxData);
+
+  //desired radio config + OTAA parameters
+  TWiMODLORAWAN_RadioStackConfig radioCfg;
+  config_lora_radio(radioCfg);
+  TWiMODLORAWAN_JoinParams joinParams;
+  memcpy(joinParams.AppEUI, APPEUI, 8);
+  memcpy(joinParams.AppKey, APPKEY, 16);
+
+  // warm boot: GetNwkStatus + GetRadioStackConfig only, if nothing changed since the last join
+  // cold boot: Reset, DeactivateDevice, Ping, SetRadioStackConfig, SetJoinParameter, JoinNetwork
+  prefs.begin("wimod", false);
+  warmBoot.SetCompareDataRate(false); // DR/TX power are managed by drPlanner
+  switch (warmBoot.Start(radioCfg, joinParams, prefs.getULong("cfghash", WIMOD_WARMBOOT_NO_HASH))) {
+    case LoRaWAN_Boot_Warm_Active:
+    case LoRaWAN_Boot_Warm_Reactivated:
+      RIB.ModemState = ModemState_Connected;
+      debugMsg(F("Warm boot, session still valid. Device address: "));
+      debugMsg((int) warmBoot.GetDeviceAddress());
+      debugMsg(F("\n"));
+      break;
+    case LoRaWAN_Boot_Cold_Joining:
+      RIB.ModemState = ModemState_ConnectRequestSent;
+      print_lora_config();
+      debugMsg(F("Cold boot. ...waiting for nwk response...\n"));
+      break;
+    default:
+      debugMsg("Error initialising WiMOD: ");
+      debugMsg((int) wimod.GetLastResponseStatus());
+      debugMsg(F("\n"));
+      break;
   }
+  debugMsg(F("Boot took [ms]: "));
+  debugMsg((int) warmBoot.GetBootDuration());
+  debugMsg(F("\n"));
+
+  drPlanner.begin(LoRaWAN_DataRate_EU868_LoRa_SF12_125kHz, LoRaWAN_DataRate_EU868_LoRa_SF7_125kHz, 2, 16); //DR range, TX power range in dBm
 }
 
 void loop()
 {
-  sendLora = true;
-  if(millis() - lastSent < 15000) sendLora = false; //send every 15 sec
+  tracker.process(millis()); //bulk read NMEA, gate fixes, detect movement
+
+  sendLora = tracker.batchReady(millis()); //full batch, node stopped or oldest point too old; nothing while parked
   if(RIB.ModemState != ModemState_Connected) sendLora = false; // check of OTAA procedure has finished
   if(sendLora) digitalWrite(BUILTIN_LED, HIGH); else digitalWrite(BUILTIN_LED, LOW);
 
   if(sendLora) {
     debugMsg(F("Sending...\n"));
 
-    // prepare TX data structure for string
-    txData.Port = 0x01;
-    txData.Length = loraBytesSize;
-	strcpy_P((char*) txData.Payload, PSTR("Hello World"));
+    // pick DR/TX power; only writes the radio config when the decision changed
+    drPlanner.PrepareUplink();
+
+    // as many queued fixes as fit the DR in use (and the module's current limit, e.g. pending MAC commands);
+    // the limit is re-read after a DR change so the batch always fits one frame: Send() must not split it,
+    // the GPS decoder does not know the split header and confirmBatch() drops all fixes of the batch
+    if (!loraSender.IsMaxPayloadValid()) loraSender.RefreshMaxPayload();
+    UINT8 maxLen = LoRaWANRegion_getMaxPayload(drPlanner.GetDataRate());
+    if (loraSender.GetMaxPayload() != 0) maxLen = min(maxLen, loraSender.GetMaxPayload());
+    txData.Port = GPS_PORT;
+    txData.Length = tracker.buildBatch(txData.Payload, maxLen, millis());
 
-	// prepare TX data structure for bytes
-    //txData.Port = 0x02;
-    //txData.Length = loraBytesSize;
-    //memcpy(txData.Payload, loraBytes, txData.Length);
-  
     // try to send a message
-    if (false == wimod.SendUData(&txData)) { // an error occurred
+    if (txData.Length == 0) {
+      if (!txSkipped) debugMsg(F("TX skipped: payload limit too small\n"));
+      txSkipped = true;
+    } else if (false == loraSender.Send(txData.Port, txData.Payload, txData.Length)) { // an error occurred
          if (LORAWAN_STATUS_CHANNEL_BLOCKED == wimod.GetLastResponseStatus()) {// we have got a duty cycle problem
              debugMsg(F("TX failed: Blocked due to DutyCycle...\n"));
          }
     } else {
-      lastSent = millis();
+      tracker.confirmBatch(); //fixes are only dropped once the module has accepted the uplink
+      txSkipped = false;
+      debugMsg(F("Sent fixes: "));
+      debugMsg((int) txData.Payload[0]);
+      debugMsg(F("\n"));
     }
   }
   // check for any pending data of the WiMOD
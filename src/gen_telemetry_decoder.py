@@ -0,0 +1,128 @@
+import json
+import re
+import sys
+
+# Generates the Node-RED decoder for the binary telemetry batches
+# (lib/Telemetry/Telemetry.h) from lib/Telemetry/TelemetrySchemas.h and
+# writes it into the decoder function node of flows.json.
+#
+# The node gets one output per field name (over all schemas, in order of
+# appearance); every output sends one msg per sample with msg.timestamp in
+# ms, so ui_chart places the samples at the time they were taken. A batch
+# without unix time that was replayed after an outage carries its age in
+# 4 trailing bytes, which moves its samples back by that age.
+#
+#   python3 src/gen_telemetry_decoder.py [flows.json] [node id]
+
+SCHEMAS = "lib/Telemetry/TelemetrySchemas.h"
+FLOWS = "src/flows.json"
+NODE_ID = "06dfe533db9d6aae"
+VERSION = 1
+AGE_LEN = 4   # MQTTC_AGE_LEN
+
+ARRAY_RE = re.compile(r"TelemetryField\s+(\w+)\[\]\s*=\s*\{(.*?)\};", re.S)
+FIELD_RE = re.compile(r"\{\s*\"(\w+)\"\s*,\s*([-\d.eE]+)\s*,\s*([-\d.eE]+)\s*\}")
+SCHEMA_RE = re.compile(r"TelemetrySchema\s+\w+\s*=\s*\{\s*(\d+)\s*,[^,]+,\s*(\w+)\s*\}")
+
+
+def parse_schemas(path):
+    with open(path) as f:
+        text = f.read()
+
+    arrays = {}
+    for name, body in ARRAY_RE.findall(text):
+        arrays[name] = [(n, float(s), float(o)) for n, s, o in FIELD_RE.findall(body)]
+
+    schemas = {}
+    for schema_id, array in SCHEMA_RE.findall(text):
+        schemas[int(schema_id)] = arrays[array]
+    return schemas
+
+
+def number(value):
+    return repr(int(value)) if value == int(value) else repr(value)
+
+
+def generate(schemas):
+    outputs = []
+    for fields in schemas.values():
+        for name, _, _ in fields:
+            if name not in outputs:
+                outputs.append(name)
+
+    lines = []
+    lines.append("// generated by src/gen_telemetry_decoder.py from lib/Telemetry/TelemetrySchemas.h, do not edit")
+    lines.append("// field: [output, scale, offset]")
+    lines.append("const schemas = {")
+    for schema_id, fields in sorted(schemas.items()):
+        entries = ", ".join("[%d, %s, %s]" % (outputs.index(n), number(s), number(o)) for n, s, o in fields)
+        lines.append("    %d: [%s]," % (schema_id, entries))
+    lines.append("};")
+    lines.append("const names = %s;" % json.dumps(outputs))
+    lines.append("")
+    lines.append("const buf = Buffer.from(msg.payload);")
+    lines.append("if (buf.length < 12 || buf[0] !== %d) {" % VERSION)
+    lines.append("    node.warn(\"telemetry: unknown version or short batch\");")
+    lines.append("    return null;")
+    lines.append("}")
+    lines.append("const fields = schemas[buf[1]];")
+    lines.append("const count = buf[11];")
+    lines.append("const size = fields ? 12 + 2 * fields.length * count : 0;")
+    lines.append("if (!fields || buf.length < size) {")
+    lines.append("    node.warn(\"telemetry: unknown schema \" + buf[1] + \" or short batch\");")
+    lines.append("    return null;")
+    lines.append("}")
+    lines.append("const device = buf.readUInt16BE(2);")
+    lines.append("const interval = buf.readUInt16BE(9) * 100;")
+    lines.append("// unix base time, else the last sample was taken now or, replayed")
+    lines.append("// from the spool, age [ms] ago (appended by MqttConnection)")
+    lines.append("const age = buf.length === size + %d ? buf.readUInt32BE(size) : 0;" % AGE_LEN)
+    lines.append("const base = (buf[4] & 1) ? buf.readUInt32BE(5) * 1000 : Date.now() - age - (count - 1) * interval;")
+    lines.append("")
+    lines.append("const result = names.map(() => null);")
+    lines.append("let pos = 12;")
+    lines.append("fields.forEach(([output, scale, offset]) => {")
+    lines.append("    const msgs = [];")
+    lines.append("    for (let i = 0; i < count; i++, pos += 2) {")
+    lines.append("        const raw = buf.readInt16BE(pos);")
+    lines.append("        if (raw === -32768) {")
+    lines.append("            continue;")
+    lines.append("        }")
+    lines.append("        msgs.push({ topic: names[output], payload: raw / scale + offset,")
+    lines.append("                    timestamp: base + i * interval, device: device });")
+    lines.append("    }")
+    lines.append("    result[output] = msgs;")
+    lines.append("});")
+    lines.append("return result;")
+    return "\n".join(lines), outputs
+
+
+def main():
+    flows_path = sys.argv[1] if len(sys.argv) > 1 else FLOWS
+    node_id = sys.argv[2] if len(sys.argv) > 2 else NODE_ID
+
+    func, outputs = generate(parse_schemas(SCHEMAS))
+
+    with open(flows_path) as f:
+        flows = json.load(f)
+
+    node = next((n for n in flows if n.get("id") == node_id), None)
+    if node is None:
+        sys.exit("node %s not found in %s" % (node_id, flows_path))
+
+    node["name"] = "telemetry decoder"
+    node["func"] = func
+    node["outputs"] = len(outputs)
+    node["outputLabels"] = outputs
+    # keep the existing wiring, add empty outputs for new fields
+    wires = node.get("wires", [])
+    node["wires"] = (wires + [[] for _ in outputs])[:len(outputs)]
+
+    with open(flows_path, "w") as f:
+        f.write(json.dumps(flows, indent=4))
+
+    print("%s: %d schemas, outputs %s" % (node_id, len(parse_schemas(SCHEMAS)), ", ".join(outputs)))
+
+
+if __name__ == "__main__":
+    main()
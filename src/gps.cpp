@@ -1,39 +1,54 @@
 #include <Arduino.h>
 #include <HardwareSerial.h>
-#include <TinyGPS++.h>
+#include <GpsTracker.h>
+#include <Scheduler.h>
 
 HardwareSerial gpsSerial(1);
-TinyGPSPlus gps;
+GpsTracker tracker(gpsSerial);  // ring buffer + TinyGPS++ + HDOP/sats gate + motion detection
+Scheduler sched;
+void printFix(void* ctx);
+SchedTask printTask("print", printFix);
+
+// prints a 1e-7 deg fixed point value
+void printDeg(int32_t v) {
+  char buf[16];
+  snprintf(buf, sizeof(buf), "%s%ld.%07ld", v < 0 ? "-" : "", labs(v) / 10000000L, labs(v) % 10000000L);
+  Serial.print(buf);
+}
 
 void setup() {
   Serial.begin(115200);
+  gpsSerial.setRxBufferSize(1024);
   gpsSerial.begin(9600, SERIAL_8N1, 16, 17);  // RX=16, TX=17
   delay(1000);
+  sched.begin();
+  sched.every(printTask, 1000);  // print once per second, on the second
 }
 
-void loop() {
-  while (gpsSerial.available() > 0) {
-    gps.encode(gpsSerial.read());
-  }
-
-  if (millis() % 1000 == 0) {  // print about once per second
-    double lat  = gps.location.lat();
-    double lng  = gps.location.lng();
-    double alt  = gps.altitude.meters();
-    uint32_t hd = gps.hdop.value();
-    uint32_t sats   = gps.satellites.value();
-    uint32_t age    = gps.location.age();
-    uint32_t failed = gps.failedChecksum();
-    uint32_t chars  = gps.charsProcessed();
+void printFix(void* ctx) {
+  (void) ctx;
+  const GpsFix& fix = tracker.lastFix();
+  const GpsTrackerStats& st = tracker.stats();
 
-    Serial.print("lat="); Serial.print(lat, 6);
-    Serial.print(" lon="); Serial.print(lng, 6);
-    Serial.print(" alt="); Serial.print(alt);
-    Serial.print(" hdop="); Serial.print(hd);
-    Serial.print(" sats="); Serial.print(sats);
-    Serial.print(" age="); Serial.print(age);
-    Serial.print(" failed="); Serial.print(failed);
-    Serial.print(" chars="); Serial.println(chars);
-    delay(5);  // avoid double-print in same ms
+  if (!tracker.hasFix()) {
+    Serial.print("no fix");
+  } else {
+    // fixed point: 1e-7 deg, cm, 1/100, cm/s
+    Serial.print("lat="); printDeg(fix.lat);
+    Serial.print(" lon="); printDeg(fix.lon);
+    Serial.print(" alt="); Serial.print(fix.alt / 100);
+    Serial.print(" hdop="); Serial.print(fix.hdop);
+    Serial.print(" sats="); Serial.print(fix.sats);
+    Serial.print(" speed="); Serial.print(fix.speed);
+    Serial.print(tracker.isMoving() ? " moving" : " stationary");
   }
+  Serial.print(" fixes="); Serial.print(st.fixes);
+  Serial.print(" rejected="); Serial.print(st.rejected);
+  Serial.print(" queued="); Serial.print(tracker.pendingPoints());
+  Serial.print(" overruns="); Serial.println(st.overruns);
+}
+
+void loop() {
+  tracker.process(millis());  // reads everything buffered in one go
+  sched.run();
 }
@@ -1,6 +1,9 @@
 #include <Arduino.h>
 #include <WiFi.h>
-#include <HTTPClient.h>
+#include <FastWiFi.h>
+#include <HttpPool.h>
+#include <Scheduler.h>
+#include <SignalFilter.h>
 #include <Wire.h>
 #include <Adafruit_Sensor.h>
 #include <Adafruit_TSL2561_U.h>
@@ -9,7 +12,12 @@
 #define WIFI_PASSWORD "WBNuyawB2a"
 
 
-const char* SOCKET_IP = "192.168.0.51";  
+const IPAddress SOCKET_IP(192, 168, 0, 51);
+const uint32_t SAMPLE_PERIOD_MS = 250;
+const uint32_t STATS_PERIOD_MS  = 60000;
+const uint32_t LUX_DWELL_MS     = 2000;   // a crossing must hold this long
+const uint32_t RETRY_MIN_MS     = 1000;   // failed command: resend backoff, doubled per failure
+const uint32_t RETRY_MAX_MS     = 60000;
 
 
 const float LUX_ON  = 100.0;  
@@ -19,15 +27,139 @@ const float LUX_OFF = 300.0;
 Adafruit_TSL2561_Unified tsl = Adafruit_TSL2561_Unified(TSL2561_ADDR_FLOAT, 12345);
 
 
+// the TSL2561 runs continuously (13 ms conversions), a sample is just a read
+// of the last result instead of the blocking getEvent()
+uint8_t luxSettle = 0;       // samples to drop after a gain change
+bool luxHighGain = false;
+uint32_t luxErrors = 0;
+float luxValue = 0;
+
+MedianFilter3 luxMedian;
+EmaFilter luxEma(0.3f);
+Hysteresis luxBright(LUX_ON, LUX_OFF, LUX_DWELL_MS, true);   // bright: socket off
+
 bool socketOn = false;
+bool socketSynced = false;   // last Power command answered
+uint32_t retryBackoff = 0;   // ms, 0: last command answered
+uint32_t retryAt = 0;        // millis() of the next resend
+
+FastWiFi wifi(WIFI_SSID, WIFI_PASSWORD);
+
+// keep-alive connection to the socket, Power ON / OFF are idempotent and
+// may be pipelined and repeated after a lost connection
+WiFiClient socketClient;
+HttpPool http;
+int8_t socketTarget;
+
+void readLux(void* ctx);
+void printStats(void* ctx);
+Scheduler sched;
+SchedTask luxTask("lux", readLux);
+SchedTask statsTask("stats", printStats);
+
+
+const char* switchPath(bool on) {
+  return on ? "/cm?cmnd=Power%20ON" : "/cm?cmnd=Power%20OFF";
+}
+
+// called from http.process(); latency is from the decision to the answer
+void onSwitched(void* ctx, const HttpResult& res) {
+  bool on = (bool) (intptr_t) ctx;
+
+  Serial.printf("Power %s: %d in %lu us (%u attempts) %s\n", on ? "ON" : "OFF", res.status,
+                (unsigned long) res.latencyUs, res.attempts, res.body);
+  // a newer decision may be queued behind this one
+  if (on == socketOn) {
+    socketSynced = res.status == 200;
+  }
+  // socket unreachable: every resend would block loop() in connect()
+  if (res.status == 200) {
+    retryBackoff = 0;
+  } else {
+    retryBackoff = retryBackoff ? min(retryBackoff * 2, RETRY_MAX_MS) : RETRY_MIN_MS;
+    retryAt      = millis() + retryBackoff;
+  }
+}
 
+void tslPowerOn() {
+  Wire.beginTransmission(TSL2561_ADDR_FLOAT);
+  Wire.write(TSL2561_COMMAND_BIT | TSL2561_REGISTER_CONTROL);
+  Wire.write(TSL2561_CONTROL_POWERON);
+  Wire.endTransmission();
+}
 
-String makeSwitchUrl(const char* ip, bool on) {
-  String url = "http://";
-  url += ip;
-  url += "/cm?cmnd=Power%20";
-  url += (on ? "ON" : "OFF");
-  return url;
+bool tslRead16(uint8_t reg, uint16_t& value) {
+  Wire.beginTransmission(TSL2561_ADDR_FLOAT);
+  Wire.write(TSL2561_COMMAND_BIT | TSL2561_WORD_BIT | reg);
+  if (Wire.endTransmission() != 0 || Wire.requestFrom(TSL2561_ADDR_FLOAT, 2) != 2) {
+    return false;
+  }
+  value = Wire.read();
+  value |= Wire.read() << 8;
+  return true;
+}
+
+// setGain() powers the sensor down again
+void tslSetGain(bool high) {
+  tsl.setGain(high ? TSL2561_GAIN_16X : TSL2561_GAIN_1X);
+  tslPowerOn();
+  luxHighGain = high;
+  luxSettle = 1;
+}
+
+void switchSocket(bool on) {
+  socketOn = on;
+  socketSynced = false;
+  Serial.print("Sending request: ");
+  Serial.println(switchPath(on));
+
+  if (!http.request(socketTarget, switchPath(on), true, onSwitched, (void*) (intptr_t) on)) {
+    Serial.println("Request queue full!");
+  }
+}
+
+// lux task: read, auto range, filter; actuate only on a state change
+void readLux(void* ctx) {
+  (void) ctx;
+  uint16_t broadband, ir;
+
+  if (!tslRead16(TSL2561_REGISTER_CHAN0_LOW, broadband) || !tslRead16(TSL2561_REGISTER_CHAN1_LOW, ir)) {
+    luxErrors++;
+    return;
+  }
+  if (luxSettle > 0) {
+    luxSettle--;
+    return;
+  }
+  // auto range without waiting: switch and use the next conversion
+  if (luxHighGain && broadband > 4000) {
+    tslSetGain(false);
+    return;
+  }
+  if (!luxHighGain && broadband < 100) {
+    tslSetGain(true);
+    return;
+  }
+
+  luxValue = luxEma.update(luxMedian.update(tsl.calculateLux(broadband, ir)));
+  if (luxBright.update(luxValue, sched.now())) {
+    Serial.print("Lux: ");
+    Serial.println(luxValue);
+    switchSocket(!luxBright.state());
+  } else if (!socketSynced && http.pending(socketTarget) == 0 && (int32_t) (millis() - retryAt) >= 0) {
+    // a failed command is sent again once its backoff is over
+    switchSocket(!luxBright.state());
+  }
+}
+
+void printStats(void* ctx) {
+  (void) ctx;
+  Serial.print("Lux: ");
+  Serial.print(luxValue);
+  Serial.print(" errors: ");
+  Serial.println(luxErrors);
+  sched.printStats(Serial);
+  http.printStats(Serial);
 }
 
 void setup() {
@@ -36,72 +168,31 @@ void setup() {
   Serial.println("Booting...");
 
   
-  WiFi.mode(WIFI_STA);
-  WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
-  Serial.print("Connecting to WiFi");
-
-  while (WiFi.status() != WL_CONNECTED) {
-    delay(500);
-    Serial.print(".");
-  }
+  Serial.println("Connecting to WiFi");
+  wifi.connect();
 
-  Serial.println();
   Serial.print("Connected! IP: ");
   Serial.println(WiFi.localIP());
+  wifi.printTiming(Serial);
 
   
   if (!tsl.begin()) {
     Serial.println("TSL2561 not found!");
     while (1);
   }
-  tsl.enableAutoRange(true);                    
   tsl.setIntegrationTime(TSL2561_INTEGRATIONTIME_13MS);  
+  tslSetGain(false);
   Serial.println("TSL2561 initialized.");
-}
 
-void loop() {
-  sensors_event_t event;
-  tsl.getEvent(&event);
+  socketTarget = http.addTarget(socketClient, SOCKET_IP);
+  http.setTimeouts(500, 1000, 0);   // stay connected, the next switch skips the handshake
 
-  if (event.light) {
-    Serial.print("Lux: ");
-    Serial.println(event.light);
-
-    bool newState = socketOn;  
-
-    
-    if (socketOn && event.light > LUX_OFF) {
-      newState = false; 
-    } else if (!socketOn && event.light < LUX_ON) {
-      newState = true;  
-    }
-
-    
-    if (newState != socketOn) {
-      socketOn = newState;
-      String url = makeSwitchUrl(SOCKET_IP, socketOn);
-      Serial.print("Sending request: ");
-      Serial.println(url);
-
-      if (WiFi.status() == WL_CONNECTED) {
-        HTTPClient http;
-        http.begin(url);
-        int httpCode = http.GET();
-        if (httpCode > 0) {
-          Serial.print("HTTP code: "); Serial.println(httpCode);
-          String payload = http.getString();
-          Serial.println("Response: " + payload);
-        } else {
-          Serial.println("HTTP request failed!");
-        }
-        http.end();
-      } else {
-        Serial.println("WiFi disconnected, cannot switch socket.");
-      }
-    }
-  } else {
-    Serial.println("Sensor error");
-  }
+  sched.begin();
+  sched.every(luxTask, SAMPLE_PERIOD_MS, 0, 1000);
+  sched.every(statsTask, STATS_PERIOD_MS, STATS_PERIOD_MS / 2);
+}
 
-  delay(1000); 
+void loop() {
+  sched.run();
+  http.process();
 }
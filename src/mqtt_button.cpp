@@ -1,4 +1,5 @@
 #include <WiFi.h>
+#include <FastWiFi.h>
 #include <AsyncTCP.h>
 #include <AsyncMqttClient.h>
 #include <avdweb_Switch.h>
@@ -13,15 +14,13 @@
 #define BUTTON_PIN 17
 Switch button = Switch(BUTTON_PIN);
 
+FastWiFi wifi(WIFI_SSID, WIFI_PASS);
 AsyncMqttClient mqttClient;
 
 void setup() {
   Serial.begin(115200);
   pinMode(LED_PIN, OUTPUT);
-  WiFi.begin(WIFI_SSID, WIFI_PASS);
-  while (WiFi.status() != WL_CONNECTED) {
-    delay(200);
-  }
+  wifi.connect();
   digitalWrite(LED_PIN , HIGH);
   mqttClient.setServer(MQTT_HOST, MQTT_PORT);
   mqttClient.connect();
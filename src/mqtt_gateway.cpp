@@ -0,0 +1,104 @@
+#include <Arduino.h>
+#include <WiFi.h>
+#include <FastWiFi.h>
+#include <AsyncTCP.h>
+#include <AsyncMqttClient.h>
+#include <HardwareSerial.h>
+#include <WiMODLoRaWAN.h>
+#include <MqttGateway.h>
+
+#define WIFI_SSID     "ADN-IOT"
+#define WIFI_PASSWORD "WBNuyawB2a"
+#define MQTT_HOST     IPAddress(192,168,0,01)
+#define MQTT_PORT     1883
+#define HOSTNAME      "adn-group33"
+
+// test without a module: fake downlinks every SIM_INTERVAL ms, e.g. against a local
+// mosquitto with: mosquitto_sub -t 'adn/group33/gw/#' -F '%t %x'
+//#define SIMULATE_WIMOD
+#define SIM_INTERVAL  100
+
+HardwareSerial loraSerial(2);
+#define WIMOD_IF_RX 23
+#define WIMOD_IF_TX 05
+WiMODLoRaWAN wimod(loraSerial);
+
+FastWiFi wifi(WIFI_SSID, WIFI_PASSWORD, HOSTNAME);
+AsyncMqttClient mqttClient;
+MqttGateway gateway(mqttClient);   // frames are buffered while the broker is away
+
+unsigned long lastConnect = 0;
+unsigned long lastPrint = 0;
+
+// rx data callback: copy only, publishing happens in loop()
+void onRxData(TWiMODLR_HCIMessage& rxMsg) {
+  TWiMODLORAWAN_RX_Data rxData;
+
+  if (wimod.convert(rxMsg, &rxData) && rxData.Length > 0) {
+    gateway.pushLoRaWan(rxData);
+  }
+}
+
+#ifdef SIMULATE_WIMOD
+void simulateRx() {
+  static unsigned long last = 0;
+  static uint8_t seq = 0;
+  TWiMODLORAWAN_RX_Data rxData;
+
+  if (millis() - last < SIM_INTERVAL) {
+    return;
+  }
+  last = millis();
+  memset(&rxData, 0, sizeof(rxData));
+  rxData.Port = 1 + seq % 4;
+  rxData.Length = 8;
+  for (int i = 0; i < rxData.Length; i++) {
+    rxData.Payload[i] = seq + i;
+  }
+  rxData.OptionalInfoAvaiable = true;
+  rxData.RSSI = -60 - (seq % 50);
+  rxData.SNR = 10 - (seq % 20);
+  seq++;
+  gateway.pushLoRaWan(rxData);
+}
+#endif
+
+void setup() {
+  Serial.begin(115200);
+  wifi.begin();
+
+  mqttClient.setServer(MQTT_HOST, MQTT_PORT);
+  mqttClient.setClientId(HOSTNAME);
+  gateway.begin("adn/group33/gw", 200);
+
+#ifndef SIMULATE_WIMOD
+  loraSerial.begin(WIMOD_LORAWAN_SERIAL_BAUDRATE, SERIAL_8N1, WIMOD_IF_RX, WIMOD_IF_TX);
+  wimod.begin();
+  wimod.RegisterRxUDataIndicationClient(onRxData);
+  wimod.RegisterRxCDataIndicationClient(onRxData);
+#endif
+}
+
+void loop() {
+#ifdef SIMULATE_WIMOD
+  simulateRx();
+#else
+  wimod.Process();
+#endif
+
+  wifi.process();
+  // no blocking connect: the radio keeps being served while the broker is away
+  if (!mqttClient.connected() && WiFi.status() == WL_CONNECTED && millis() - lastConnect > 5000) {
+    lastConnect = millis();
+    mqttClient.connect();
+  }
+  gateway.process(millis());
+
+  if (millis() - lastPrint > 10000) {
+    lastPrint = millis();
+    const MqttGatewayStats& st = gateway.stats();
+    Serial.printf("rx=%lu published=%lu batches=%lu dropped=%lu pending=%u\n",
+                  (unsigned long) st.received, (unsigned long) st.published,
+                  (unsigned long) st.batches, (unsigned long) st.dropped, gateway.pending());
+  }
+}
@@ -1,57 +1,83 @@
 #include <WiFi.h>
-#include <PubSubClient.h>
+#include <AsyncTCP.h>
+#include <AsyncMqttClient.h>
+#include <FastWiFi.h>
 #include <Adafruit_BME280.h>
+#include <MqttConnection.h>
+#include <MqttAsyncTransport.h>
+#include <TelemetrySchemas.h>
+#include <Scheduler.h>
+#include <time.h>
 #define LED_PIN 2
 #define WIFI_SSID     "ADN-IOT"
 #define WIFI_PASSWORD "WBNuyawB2a"
 #define MQTT_BROKER   "192.168.0.1"
-#define MQTT_TOPIC    "adn/group33/room"   
+#define MQTT_TOPIC    "adn/group33/room"
 #define HOSTNAME      "adn-group33"
+#define SAMPLE_PERIOD 30000
+#define BATCH_SAMPLES 4
+#define DEVICE_ID     33
+#define NTP_SERVER    "pool.ntp.org"
 
-WiFiClient wifiClient;
-PubSubClient mqtt(wifiClient);
+FastWiFi wifi(WIFI_SSID, WIFI_PASSWORD, HOSTNAME);
+AsyncMqttClient mqttClient;
+MqttAsyncTransport transport(mqttClient);
+MqttRamSpool spool;
+MqttConnection mqtt(transport, spool);
+int8_t roomTopic;
+TelemetryBatch batch(ROOM_SCHEMA, DEVICE_ID, SAMPLE_PERIOD);
 Adafruit_BME280 bme;
+Scheduler sched;
+void sample(void* ctx);
+SchedTask sampleTask("sample", sample);
 
-void connectWiFi() {
-  WiFi.mode(WIFI_STA);
-  WiFi.setHostname(HOSTNAME);
-  WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
-  while (WiFi.status() != WL_CONNECTED) delay(500);
-}
-digitalWrite(LED_PIN , HIGH);
-void connectMQTT() {
-  mqtt.setServer(MQTT_BROKER, 1883);
-  while (!mqtt.connected()) mqtt.connect(HOSTNAME, HOSTNAME, NULL);
+static uint32_t sampleTime(bool& unixTime) {
+  time_t now = time(NULL);
+  unixTime = now > 1600000000;
+  return unixTime ? (uint32_t) now : millis() / 1000;
 }
 
 void setup() {
   Serial.begin(115200);
-  connectWiFi();
-  connectMQTT();
-  bme.begin(0x76);          
+  pinMode(LED_PIN, OUTPUT);
+  wifi.begin();                            // connects in the background, process() in loop()
+  mqttClient.setServer(MQTT_BROKER, 1883);
+  mqttClient.setClientId(HOSTNAME);
+  mqttClient.setCredentials(HOSTNAME);
+  roomTopic = mqtt.addTopic(MQTT_TOPIC);
+  mqtt.setReplay(5, 200, true);
+  batch.setCapacity(BATCH_SAMPLES, MQTTC_MAX_PAYLOAD);
+  configTime(0, 0, NTP_SERVER);
+  bme.begin(0x76);
+  sched.begin();
+  sched.every(sampleTask, SAMPLE_PERIOD);   // fixed phase, no drift
 }
 
-void loop() {
-  if (!mqtt.connected()) connectMQTT();
-  mqtt.loop();
-
-  static unsigned long last = 0;
-  if (millis() - last > 30000) {     
-    last = millis();
-
-    float t = bme.readTemperature(); 
-    float h = bme.readHumidity();    
-    float p = bme.readPressure();    
+// sampling task, the reading goes into the batch, a full batch is published
+void sample(void* ctx) {
+  (void) ctx;
+  float t = bme.readTemperature();
+  float h = bme.readHumidity();
+  float p = bme.readPressure();
 
-    Serial.print("T="); Serial.print(t);
-    Serial.print(" H="); Serial.print(h);
-    Serial.print(" P="); Serial.println(p);
+  Serial.print("T="); Serial.print(t);
+  Serial.print(" H="); Serial.print(h);
+  Serial.print(" P="); Serial.println(p);
 
-    char payload[12];
-    memcpy(payload,      &t, 4);
-    memcpy(payload + 4,  &h, 4);
-    memcpy(payload + 8,  &p, 4);
+  float values[3] = { t, h, p };
+  bool unixTime;
+  batch.add(values, sampleTime(unixTime), unixTime);
 
-    mqtt.publish(MQTT_TOPIC, (uint8_t*)payload, 12);
+  if (batch.full()) {
+    uint8_t payload[MQTTC_MAX_PAYLOAD];
+    mqtt.publish(roomTopic, payload, batch.encode(payload, sizeof(payload)));
+    batch.clear();
   }
 }
+
+void loop() {
+  wifi.process();
+  mqtt.process(millis());
+  digitalWrite(LED_PIN, mqtt.connected() ? HIGH : LOW);
+  sched.run();
+}
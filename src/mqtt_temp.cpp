@@ -1,42 +1,77 @@
 #include <WiFi.h>
-#include <PubSubClient.h>
+#include <AsyncTCP.h>
+#include <AsyncMqttClient.h>
+#include <FastWiFi.h>
 #include <Adafruit_BME280.h>
-#include <string.h>
+#include <time.h>
+#include <MqttConnection.h>
+#include <MqttAsyncTransport.h>
+#include <TelemetrySchemas.h>
+#include <Scheduler.h>
 #define LED_PIN 2
 #define WIFI_SSID "ADN-IOT"
 #define WIFI_PASSWORD "WBNuyawB2a"
 #define MQTT_BROKER "192.168.0.1"
 #define MQTT_TOPIC "adn/group33/temp"
 #define HOSTNAME "adn-group33"
+#define SAMPLE_PERIOD 5000
+#define BATCH_SAMPLES 6                    // readings per publish
+#define DEVICE_ID 33
+#define NTP_SERVER "pool.ntp.org"
 
-WiFiClient wifiClient;
-PubSubClient mqttClient(wifiClient);
+FastWiFi wifi(WIFI_SSID, WIFI_PASSWORD, HOSTNAME);
+AsyncMqttClient mqttClient;
+MqttAsyncTransport transport(mqttClient);   // connect() returns at once, no stall while the broker is away
+MqttRamSpool spool;                        // readings taken while the broker is away
+MqttConnection mqtt(transport, spool);     // reconnects with backoff, never blocks loop()
+int8_t tempTopic;
+TelemetryBatch batch(TEMP_SCHEMA, DEVICE_ID, SAMPLE_PERIOD);
 Adafruit_BME280 bme;
+Scheduler sched;
+void sample(void* ctx);
+SchedTask sampleTask("sample", sample);
+
+// unix time once NTP answered, else uptime (the decoder dates the batch
+// with its arrival time then)
+static uint32_t sampleTime(bool& unixTime) {
+  time_t now = time(NULL);
+  unixTime = now > 1600000000;
+  return unixTime ? (uint32_t) now : millis() / 1000;
+}
 
 void setup() {
   Serial.begin(115200);
-  WiFi.mode(WIFI_STA);
-  WiFi.setHostname(HOSTNAME);
-  WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
-  while (WiFi.status() != WL_CONNECTED) delay(500);
+  wifi.begin();                            // connects in the background, process() in loop()
   mqttClient.setServer(MQTT_BROKER, 1883);
-  while (!mqttClient.connected()) mqttClient.connect(HOSTNAME, HOSTNAME, NULL);
+  mqttClient.setClientId(HOSTNAME);
+  mqttClient.setCredentials(HOSTNAME);     // user name only, as before
+  tempTopic = mqtt.addTopic(MQTT_TOPIC);
+  mqtt.setReplay(5, 200, true);            // age dates replayed uptime batches
+  batch.setCapacity(BATCH_SAMPLES, MQTTC_MAX_PAYLOAD);
+  configTime(0, 0, NTP_SERVER);
   bme.begin(0x76);
+  sched.begin();
+  sched.every(sampleTask, SAMPLE_PERIOD);   // fixed phase, no drift
 }
 
-void loop() {
-  if (!mqttClient.connected())
-    while (!mqttClient.connected()) mqttClient.connect(HOSTNAME, HOSTNAME, NULL);
-  mqttClient.loop();
-  static unsigned long lastPublish = 0;
-  if (millis() - lastPublish > 5000) {
-    lastPublish = millis();
-    float temp = bme.readTemperature();
-    Serial.print("Temp: ");
-    Serial.println(temp);
-    char payload[4];
-    memcpy(payload, &temp, 4);
-    mqtt.publish(MQTT_TOPIC, (uint8_t*)payload, 4);
-
+// sampling task, the reading goes into the batch, a full batch is published
+void sample(void* ctx) {
+  (void) ctx;
+  float temp = bme.readTemperature();
+  Serial.print("Temp: ");
+  Serial.println(temp);
+  bool unixTime;
+  uint32_t t = sampleTime(unixTime);
+  batch.add(&temp, t, unixTime);
+  if (batch.full()) {
+    uint8_t payload[MQTTC_MAX_PAYLOAD];
+    mqtt.publish(tempTopic, payload, batch.encode(payload, sizeof(payload)));
+    batch.clear();
   }
 }
+
+void loop() {
+  wifi.process();
+  mqtt.process(millis());
+  sched.run();
+}
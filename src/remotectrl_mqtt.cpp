@@ -0,0 +1,65 @@
+#include <WiFi.h>
+#include <FastWiFi.h>
+#include <AsyncTCP.h>
+#include <AsyncMqttClient.h>
+#include <HardwareSerial.h>
+#include <WiMODLR_BASE_PLUS.h>
+#include <RemoteCtrlBridge.h>
+
+#define LED_PIN 2
+#define WIFI_SSID "ADN-IOT"
+#define WIFI_PASS "WBNuyawB2a"
+
+#define MQTT_HOST IPAddress(192,168,0,01)
+#define MQTT_PORT 1883
+
+// WiMOD module with LR-BASE PLUS firmware, RemoteCtrl feature enabled
+HardwareSerial loraSerial(2);
+#define WIMOD_IF_RX 23
+#define WIMOD_IF_TX 05
+WiMODLRBASE_PLUS wimod(loraSerial);
+
+FastWiFi wifi(WIFI_SSID, WIFI_PASS);
+AsyncMqttClient mqttClient;
+RemoteCtrlBridge bridge(wimod, mqttClient);
+
+// (group, device, button bit) -> topic / payload; QoS 1 for the ack latency
+static const RemoteCtrlRoute routes[] = {
+  { 0x10, 0x1234, 0, "cmnd/sonoff05/POWER", "TOGGLE", 1 },
+  { 0x10, 0x1234, 1, "cmnd/sonoff06/POWER", "TOGGLE", 1 },
+  { 0x10, 0x1235, 0, "cmnd/sonoff05/POWER", "OFF",    1 },
+  { 0x10, 0x1235, 1, "cmnd/sonoff06/POWER", "OFF",    1 },
+};
+
+unsigned long lastConnect = 0;
+unsigned long lastPrint = 0;
+
+void setup() {
+  Serial.begin(115200);
+  pinMode(LED_PIN, OUTPUT);
+  wifi.connect();
+  digitalWrite(LED_PIN , HIGH);
+  mqttClient.setServer(MQTT_HOST, MQTT_PORT);   // connected from loop()
+
+  loraSerial.begin(WIMOD_LR_BASE_PLUS_SERIAL_BAUDRATE, SERIAL_8N1, WIMOD_IF_RX, WIMOD_IF_TX);
+  wimod.begin();
+  if (!bridge.begin(routes, sizeof(routes) / sizeof(routes[0]))) {
+    Serial.println("bad route table");
+  }
+}
+
+void loop() {
+  // no delay(): every pass reads the UART, a press is published inside process()
+  bridge.process();
+
+  // no blocking connect: presses are still read (counted offline) while the broker is away
+  if (!mqttClient.connected() && WiFi.status() == WL_CONNECTED && (lastConnect == 0 || millis() - lastConnect > 5000)) {
+    lastConnect = millis();
+    mqttClient.connect();
+  }
+
+  if (millis() - lastPrint >= 10000) {
+    lastPrint = millis();
+    bridge.printStats(Serial);
+  }
+}
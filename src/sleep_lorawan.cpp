@@ -0,0 +1,211 @@
+#include <Arduino.h>
+#include <HardwareSerial.h>
+#include <Preferences.h>
+#include <Wire.h>
+#include <Adafruit_BME280.h>
+#include <Adafruit_Sensor.h>
+#include <Adafruit_TSL2561_U.h>
+#include <WiMODLoRaWAN.h>
+#include <LoRaWAN/WiMODLoRaWAN_WarmBoot.h>
+#include <SleepNode.h>
+#include <TelemetrySchemas.h>
+
+// battery room node over LoRaWAN: the ESP32 is in deep sleep between
+// samples, the batch is kept in RTC memory and handed to the WiMOD module
+// when it is full. The module keeps the LoRaWAN session and runs with
+// automatic power saving, it sleeps between HCI messages (the HCI sends the
+// wakeup sequence) and does the TX / RX windows of an uplink on its own,
+// so the ESP32 can go back to sleep as soon as the uplink is accepted.
+
+HardwareSerial loraSerial(2);
+#define WIMOD_IF        loraSerial
+#define WIMOD_IF_RX     23
+#define WIMOD_IF_TX     05
+#define TELEMETRY_PORT  0x03
+#define DEVICE_ID       33
+#define SAMPLE_PERIOD   75000
+#define BATCH_SAMPLES   4         // 44 byte, fits SF12 (51 byte); one uplink per 5 min
+#define DEADLINE        900000
+#define JOIN_TIMEOUT    20000     // cold boot; the module goes on joining while we sleep
+
+const unsigned char APPEUI[] = { 0xAB, 0xCD, 0xEF, 0x12, 0x34, 0x45, 0x67, 0x89 };
+const unsigned char APPKEY[] = { 0xAB, 0xCD, 0xEF, 0x12, 0x34, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF, 0x12, 0x34, 0x45, 0x67, 0x89 };
+
+// estimate, ESP32 board + WiMOD module; see sleep_room
+const SleepNodeConfig SLEEP_CONFIG = {
+  SAMPLE_PERIOD, BATCH_SAMPLES, DEADLINE,
+  60,     // ms ROM boot
+  40,     // mA awake
+  45,     // mA awake + module awake (HCI)
+  150,    // uA deep sleep, module in power saving
+  10000,  // uC per uplink: ~200 ms TX at 44 mA + RX windows (SF7..SF9)
+  2000,   // mAh
+};
+
+RTC_DATA_ATTR SleepNodeState sleepState;   // kept in deep sleep
+RTC_DATA_ATTR bool loraJoined;
+SleepNode node(sleepState, SLEEP_CONFIG);
+
+WiMODLoRaWAN wimod(WIMOD_IF);
+WiMODLoRaWAN_WarmBoot warmBoot(wimod);
+Preferences prefs;
+Adafruit_BME280 bme;
+Adafruit_TSL2561_Unified tsl = Adafruit_TSL2561_Unified(TSL2561_ADDR_FLOAT, 12345);
+static TWiMODLORAWAN_TX_Data txData;
+
+void loraConfig(TWiMODLORAWAN_RadioStackConfig& radioCfg, TWiMODLORAWAN_JoinParams& joinParams) {
+  memset(&radioCfg, 0, sizeof(radioCfg));
+  radioCfg.DataRateIndex   = LoRaWAN_DataRate_EU868_LoRa_SF9_125kHz;
+  radioCfg.TXPowerLevel    = 14;
+  radioCfg.Options         = LORAWAN_STK_OPTION_DUTY_CYCLE_CTRL | LORAWAN_STK_OPTION_ADR;   // stationary node
+  radioCfg.PowerSavingMode = LoRaWAN_PowerSaving_On;   // module sleeps between HCI messages
+  radioCfg.Retransmissions = 7;
+  radioCfg.BandIndex       = LORAWAN_BAND_EU_868_RX2_SF9;
+  memcpy(joinParams.AppEUI, APPEUI, 8);
+  memcpy(joinParams.AppKey, APPKEY, 16);
+}
+
+void onJoinedNwk(TWiMODLR_HCIMessage& rxMsg) {
+  TWiMODLORAWAN_RX_JoinedNwkData joinedData;
+
+  if (wimod.convert(rxMsg, &joinedData)
+      && (joinedData.StatusFormat == LORAWAN_JOIN_NWK_IND_FORMAT_STATUS_JOIN_OK
+          || joinedData.StatusFormat == LORAWAN_JOIN_NWK_IND_FORMAT_STATUS_JOIN_OK_CH_INFO)) {
+    loraJoined = true;
+    prefs.putULong("cfghash", warmBoot.GetConfigHash());
+    Serial.printf("Joined, device address %08lx\n", (unsigned long) joinedData.DeviceAddress);
+  }
+}
+
+// cold boot: warm boot check, join if needed (waits up to JOIN_TIMEOUT)
+void startLora() {
+  TWiMODLORAWAN_RadioStackConfig radioCfg;
+  TWiMODLORAWAN_JoinParams joinParams;
+  uint32_t start = millis();
+
+  wimod.RegisterJoinedNwkIndicationClient(onJoinedNwk);
+  loraConfig(radioCfg, joinParams);
+  warmBoot.SetCompareDataRate(false);   // ADR changes it
+  switch (warmBoot.Start(radioCfg, joinParams, prefs.getULong("cfghash", WIMOD_WARMBOOT_NO_HASH))) {
+    case LoRaWAN_Boot_Warm_Active:
+    case LoRaWAN_Boot_Warm_Reactivated:
+      loraJoined = true;
+      break;
+    case LoRaWAN_Boot_Cold_Joining:
+      Serial.println("Joining...");
+      while (!loraJoined && millis() - start < JOIN_TIMEOUT) {
+        wimod.Process();
+        delay(10);
+      }
+      break;
+    default:
+      Serial.printf("WiMOD init failed: %d\n", (int) wimod.GetLastResponseStatus());
+      break;
+  }
+}
+
+// timer wake, not joined yet: the module may have finished the join while
+// we slept (the indication is lost then)
+void checkJoined() {
+  TWiMODLORAWAN_NwkStatus_Data status;
+
+  if (wimod.GetNwkStatus(&status) && status.NetworkStatus == LORAWAN_NWK_STATUS_ACTIVE_OTAA) {
+    TWiMODLORAWAN_RadioStackConfig radioCfg;
+    TWiMODLORAWAN_JoinParams joinParams;
+
+    loraConfig(radioCfg, joinParams);
+    loraJoined = true;
+    prefs.putULong("cfghash", warmBoot.CalcConfigHash(radioCfg, joinParams));
+  }
+}
+
+bool sendBatch() {
+  TelemetryBatch batch(ROOM_LUX_SCHEMA, DEVICE_ID, SAMPLE_PERIOD);
+
+  batch.setCapacity(node.count(), sizeof(txData.Payload));
+  for (uint8_t i = 0; i < node.count(); i++) {
+    const SleepNodeSample& s = node.sample(i);
+
+    batch.add(s.values, s.time, s.time > 1600000000);
+  }
+  txData.Port   = TELEMETRY_PORT;
+  txData.Length = batch.encode(txData.Payload, sizeof(txData.Payload));
+
+  // accepted by the module = sent, it transmits while we sleep
+  if (wimod.SendUData(&txData)) {
+    return true;
+  }
+  switch (wimod.GetLastResponseStatus()) {
+    case LORAWAN_STATUS_DEVICE_NOT_ACTIVATED:
+      loraJoined = false;   // session lost, re-checked on the next wakes
+      break;
+    case LORAWAN_STATUS_CHANNEL_BLOCKED:
+      Serial.println("TX blocked by duty cycle");
+      break;
+  }
+  return false;
+}
+
+void readSensors(float* values) {
+  sensors_event_t event;
+
+  Wire.begin();
+  if (bme.begin(0x76)) {
+    bme.setSampling(Adafruit_BME280::MODE_FORCED, Adafruit_BME280::SAMPLING_X1, Adafruit_BME280::SAMPLING_X1,
+                    Adafruit_BME280::SAMPLING_X1, Adafruit_BME280::FILTER_OFF);
+    bme.takeForcedMeasurement();
+    values[0] = bme.readTemperature();
+    values[1] = bme.readHumidity();
+    values[2] = bme.readPressure();
+  } else {
+    values[0] = values[1] = values[2] = NAN;
+  }
+  values[3] = NAN;
+  if (tsl.begin()) {
+    tsl.enableAutoRange(true);
+    tsl.setIntegrationTime(TSL2561_INTEGRATIONTIME_13MS);
+    if (tsl.getEvent(&event)) {
+      values[3] = event.light;
+    }
+  }
+}
+
+void setup() {
+  bool cold = node.begin();
+  float values[4];
+
+  Serial.begin(115200);
+  readSensors(values);
+  node.add(values, 4);
+  Serial.printf("T=%.2f H=%.2f P=%.0f L=%.1f queued=%u\n", values[0], values[1], values[2], values[3], node.count());
+
+  // the UART and the module are only woken if there is something to do
+  if (cold || node.sendDue()) {
+    node.radioOn();
+    WIMOD_IF.begin(WIMOD_LORAWAN_SERIAL_BAUDRATE, SERIAL_8N1, WIMOD_IF_RX, WIMOD_IF_TX);
+    wimod.begin();
+    prefs.begin("wimod", false);
+    if (cold) {
+      loraJoined = false;
+      startLora();
+    } else if (!loraJoined) {
+      checkJoined();
+    }
+    if (node.sendDue()) {
+      // not joined counts as failed, backs off like a blocked channel
+      bool ok = loraJoined && sendBatch();
+
+      node.sent(ok);
+      Serial.println(ok ? "Batch sent" : "Send failed, kept for the next try");
+      node.printStats(Serial);
+    }
+    node.radioOff();
+  }
+
+  Serial.flush();
+  node.sleep();
+}
+
+void loop() {
+  // not reached, every wake starts in setup()
+}
@@ -0,0 +1,152 @@
+#include <Arduino.h>
+#include <WiFi.h>
+#include <PubSubClient.h>
+#include <FastWiFi.h>
+#include <Wire.h>
+#include <Adafruit_BME280.h>
+#include <Adafruit_Sensor.h>
+#include <Adafruit_TSL2561_U.h>
+#include <SleepNode.h>
+#include <TelemetrySchemas.h>
+#include <time.h>
+
+// battery variant of mqtt_room: deep sleep between samples, the batch is
+// kept in RTC memory and Wi-Fi is only switched on to publish it
+
+#define WIFI_SSID       "ADN-IOT"
+#define WIFI_PASSWORD   "WBNuyawB2a"
+#define MQTT_BROKER     "192.168.0.1"
+#define MQTT_TOPIC      "adn/group33/room"
+#define HOSTNAME        "adn-group33"
+#define DEVICE_ID       33
+#define NTP_SERVER      "pool.ntp.org"
+#define SAMPLE_PERIOD   30000
+#define BATCH_SAMPLES   12        // one publish per 6 min
+#define DEADLINE        600000
+#define CONNECT_TIMEOUT 10000
+#define NTP_TIMEOUT     2000
+
+// estimate for a D1 mini32 on a LiPo; measure the board once and put the
+// currents here, the reported battery life is only as good as these
+const SleepNodeConfig SLEEP_CONFIG = {
+  SAMPLE_PERIOD, BATCH_SAMPLES, DEADLINE,
+  60,     // ms ROM boot
+  40,     // mA awake, radio off
+  120,    // mA Wi-Fi on
+  150,    // uA deep sleep: regulator, USB UART, sensors in standby
+  0,      // uC per send, Wi-Fi is all in the radio time
+  2000,   // mAh
+};
+
+RTC_DATA_ATTR SleepNodeState sleepState;   // kept in deep sleep
+SleepNode node(sleepState, SLEEP_CONFIG);
+
+FastWiFi wifi(WIFI_SSID, WIFI_PASSWORD, HOSTNAME);   // cached AP + lease: most of the wake time otherwise
+WiFiClient wifiClient;
+PubSubClient mqttClient(wifiClient);
+Adafruit_BME280 bme;
+Adafruit_TSL2561_Unified tsl = Adafruit_TSL2561_Unified(TSL2561_ADDR_FLOAT, 12345);
+
+// one reading; a missing sensor gives NaN (missing in the batch)
+void readSensors(float* values) {
+  Wire.begin();
+  if (bme.begin(0x76)) {
+    // forced mode: one conversion, then back to sleep
+    bme.setSampling(Adafruit_BME280::MODE_FORCED, Adafruit_BME280::SAMPLING_X1, Adafruit_BME280::SAMPLING_X1,
+                    Adafruit_BME280::SAMPLING_X1, Adafruit_BME280::FILTER_OFF);
+    bme.takeForcedMeasurement();
+    values[0] = bme.readTemperature();
+    values[1] = bme.readHumidity();
+    values[2] = bme.readPressure();
+  } else {
+    values[0] = values[1] = values[2] = NAN;
+  }
+
+  sensors_event_t event;
+
+  values[3] = NAN;
+  if (tsl.begin()) {
+    // getEvent() powers the TSL2561 up for one conversion only
+    tsl.enableAutoRange(true);
+    tsl.setIntegrationTime(TSL2561_INTEGRATIONTIME_13MS);
+    if (tsl.getEvent(&event)) {
+      values[3] = event.light;
+    }
+  }
+}
+
+// once: the system time runs on in deep sleep, later batches get unix time
+void syncTime() {
+  uint32_t start = millis();
+
+  configTime(0, 0, NTP_SERVER);
+  while (time(NULL) < 1600000000 && millis() - start < NTP_TIMEOUT) {
+    delay(10);
+  }
+}
+
+bool publishBatch() {
+  TelemetryBatch batch(ROOM_LUX_SCHEMA, DEVICE_ID, SAMPLE_PERIOD);
+  uint8_t payload[TELEMETRY_HEADER + 2 * TELEMETRY_MAX_FIELDS * TELEMETRY_MAX_SAMPLES];
+  bool ok;
+
+  batch.setCapacity(node.count(), sizeof(payload));
+  for (uint8_t i = 0; i < node.count(); i++) {
+    const SleepNodeSample& s = node.sample(i);
+
+    batch.add(s.values, s.time, s.time > 1600000000);
+  }
+
+  if (!wifi.connect(CONNECT_TIMEOUT)) {
+    Serial.println("Wi-Fi failed");
+    return false;
+  }
+  wifi.printTiming(Serial);
+  if (time(NULL) < 1600000000) {
+    syncTime();
+  }
+  mqttClient.setServer(MQTT_BROKER, 1883);
+  mqttClient.setSocketTimeout(2);
+  if (!mqttClient.connect(HOSTNAME, NULL, NULL)) {
+    Serial.println("MQTT connect failed");
+    return false;
+  }
+  ok = mqttClient.publish(MQTT_TOPIC, payload, batch.encode(payload, sizeof(payload)), false);
+  mqttClient.disconnect();
+  delay(10);   // let lwIP put the last segments on air before the radio goes off
+  return ok;
+}
+
+void setup() {
+  bool cold = node.begin();
+  float values[4];
+
+  Serial.begin(115200);
+  if (cold) {
+    Serial.println("Cold boot");
+  }
+
+  readSensors(values);
+  node.add(values, 4);
+  Serial.printf("T=%.2f H=%.2f P=%.0f L=%.1f queued=%u\n", values[0], values[1], values[2], values[3], node.count());
+
+  if (node.sendDue()) {
+    bool ok;
+
+    node.radioOn();
+    ok = publishBatch();
+    WiFi.disconnect(true);
+    WiFi.mode(WIFI_OFF);
+    node.radioOff();
+    node.sent(ok);
+    Serial.println(ok ? "Batch published" : "Publish failed, kept for the next try");
+    node.printStats(Serial);
+  }
+
+  Serial.flush();
+  node.sleep();
+}
+
+void loop() {
+  // not reached, every wake starts in setup()
+}
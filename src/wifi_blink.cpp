@@ -1,5 +1,6 @@
 #include <Arduino.h>
 #include <WiFi.h>
+#include <FastWiFi.h>
 
 #define WIFI_SSID     "ADN-IOT"        
 #define WIFI_PASSWORD "WBNuyawB2a"     
@@ -17,6 +18,8 @@ const uint16_t FAST_OFF = 100;
 
 const uint32_t CONNECT_TIMEOUT_MS = 10000;
 
+FastWiFi wifi(WIFI_SSID, WIFI_PASSWORD, ADNGROUP);
+
 static void blink(uint16_t on_ms, uint16_t off_ms) {
   digitalWrite(LED_BUILTIN, HIGH);
   delay(on_ms);
@@ -32,24 +35,23 @@ void setup() {
   pinMode(LED_BUILTIN, OUTPUT);
   digitalWrite(LED_BUILTIN, LOW);
 
-  WiFi.mode(WIFI_STA);
-  WiFi.setHostname(ADNGROUP);
-  WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
-
   Serial.print("Connecting to ");
   Serial.println(WIFI_SSID);
 
+  // slow blink from millis(), a blocking blink() would hold up the connect
   uint32_t start = millis();
-  while (WiFi.status() != WL_CONNECTED && (millis() - start) < CONNECT_TIMEOUT_MS) {
-    blink(SLOW_ON, SLOW_OFF);    // Trying to connect: slow blink
-    Serial.print('.');
+  wifi.begin();
+  while (!wifi.connected() && (millis() - start) < CONNECT_TIMEOUT_MS) {
+    wifi.process();
+    digitalWrite(LED_BUILTIN, (millis() - start) % (SLOW_ON + SLOW_OFF) < SLOW_ON ? HIGH : LOW);
+    delay(5);
   }
-  Serial.println();
 
-  if (WiFi.status() == WL_CONNECTED) {
+  if (wifi.connected()) {
     digitalWrite(LED_BUILTIN, HIGH);      // Connected: LED ON
     Serial.print("Connected! IP: ");
     Serial.println(WiFi.localIP());       // -> WiFi.localIP()
+    wifi.printTiming(Serial);
   } else {
     Serial.println("Connect failed after 10 s. Fast blinking.");
     while (true) {
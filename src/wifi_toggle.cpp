@@ -1,22 +1,38 @@
 #include <Arduino.h>
 #include <WiFi.h>
-#include <HTTPClient.h>
+#include <HttpPool.h>
 
 #define WIFI_SSID     "ADN-IOT"
 #define WIFI_PASSWORD "WBNuyawB2a"
 
 
-const char* SOCKET_IP = "192.168.0.51";  
-
-String makeToggleUrl(const char* ip) {
-  String url = "http://";
-  url += ip;
-  url += "/cm?cmnd=Power%20TOGGLE";
-  return url;
+const IPAddress SOCKET_IP(192, 168, 0, 51);
+#define TOGGLE_PATH "/cm?cmnd=Power%20TOGGLE"
+
+// keep-alive connection to the socket; TOGGLE is not idempotent, the pool
+// never pipelines or repeats it
+WiFiClient socketClient;
+HttpPool http;
+int8_t socketTarget;
+
+void onToggled(void* ctx, const HttpResult& res) {
+  (void) ctx;
+  if (res.status > 0) {
+    Serial.print("HTTP GET code: ");
+    Serial.println(res.status);
+    Serial.print("Response: ");
+    Serial.println(res.body);
+  } else {
+    Serial.print("HTTP GET failed, error: ");
+    Serial.println(res.status);
+  }
+  Serial.print("Latency [us]: ");
+  Serial.println(res.latencyUs);
 }
 
 const uint32_t TOGGLE_PERIOD_MS = 2000;   
 unsigned long lastToggle = 0;
+unsigned long toggles = 0;
 
 void setup() {
   Serial.begin(115200);
@@ -36,39 +52,26 @@ void setup() {
   Serial.println(WiFi.localIP());                  
 
  
-  delay(200);
+  socketTarget = http.addTarget(socketClient, SOCKET_IP);
+  http.setTimeouts(500, 1000, 2500);
 }
 
 void loop() {
-  
+  http.process();
+
   if (millis() - lastToggle >= TOGGLE_PERIOD_MS) {
     lastToggle = millis();
 
     if (WiFi.status() == WL_CONNECTED) {           
-      String url = makeToggleUrl(SOCKET_IP);
-
-      HTTPClient http;                              
-     
-      http.begin(url);                               
-      int httpCode = http.GET();                     
-
-      if (httpCode > 0) {
-        Serial.print("HTTP GET code: ");
-        Serial.println(httpCode);                    
-        String payload = http.getString();           
-        Serial.print("Response: ");
-        Serial.println(payload);                     
-      } else {
-        Serial.print("HTTP GET failed, error: ");
-        Serial.println(httpCode);                    
+      // the previous toggle still open: skip rather than queue them up
+      if (http.pending(socketTarget) == 0) {
+        http.request(socketTarget, TOGGLE_PATH, false, onToggled);
+        if (++toggles % 30 == 0) {
+          http.printStats(Serial);
+        }
       }
-
-      http.end();                                  
     } else {
       Serial.println("WiFi disconnected, skipping toggle.");
     }
   }
-
-
-  delay(10);
 }